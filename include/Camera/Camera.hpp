@@ -31,6 +31,11 @@ namespace Lexvi {
     };
 
     bool isInFrustum(const CameraFrustum& frustum, const CameraAABB& aabb);
+    // sphere: xyz = center, w = radius
+    bool isSphereInFrustum(const CameraFrustum& frustum, const glm::vec4& sphere);
+
+    // World bounds of a local box under an affine transform (tight for the box, not the mesh inside it)
+    CameraAABB TransformAABB(const CameraAABB& aabb, const glm::mat4& transform);
 
     bool IntersectPlanes(const CameraPlane& p1, const CameraPlane& p2, const CameraPlane& p3, glm::vec3& outPoint);
 
@@ -89,7 +94,7 @@ namespace Lexvi {
         glm::vec2 getZNearAndZFar() const;
         glm::mat4 getViewMatrix() const;
         glm::mat4 getProjectionMatrix() const;
-        CameraFrustum getFrustum() const;
+        const CameraFrustum& getFrustum() const;
 
         const CameraData& getCameraData() const{ return cameraData; };
 
@@ -2,26 +2,79 @@
 
 #include "Camera/Camera.hpp"
 #include "Shader/Shader.hpp"
+#include "Utils/IndirectBuffer.hpp"
 
 namespace Lexvi {
+	// Hashes a primitive's kind and generation parameters, objects built from the same parameters get the same id
+	unsigned int MakeGeometryID(const std::string& kind, const void* params, size_t size);
+
+	// Box of the vertex positions and a sphere around its center (xyz = center, w = radius)
+	template<typename VertexType>
+	void ComputeBounds(const std::vector<VertexType>& vertices, glm::vec3 VertexType::* position, CameraAABB& outBox, glm::vec4& outSphere) {
+		if (vertices.empty()) {
+			outBox = {};
+			outSphere = glm::vec4(0.0f);
+			return;
+		}
+
+		outBox = { vertices[0].*position, vertices[0].*position };
+		for (const VertexType& v : vertices) {
+			outBox.min = glm::min(outBox.min, v.*position);
+			outBox.max = glm::max(outBox.max, v.*position);
+		}
+		glm::vec3 center = (outBox.min + outBox.max) * 0.5f;
+
+		float radius2 = 0.0f;
+		for (const VertexType& v : vertices) {
+			glm::vec3 d = v.*position - center;
+			radius2 = std::max(radius2, glm::dot(d, d));
+		}
+		outSphere = glm::vec4(center, std::sqrt(radius2));
+	}
+
 	class IRenderable {
 	protected:
 		glm::mat4 transforms = (1.0f);
-		CameraAABB cameraAABB = {};
+		unsigned int geometryID = 0;
+
+		// Local bounds are set once when the geometry is built, world bounds follow setTransforms.
+		// Renderables without bounds are never culled and report a box covering everything.
+		CameraAABB localAABB = {};
+		glm::vec4 localSphere{ 0.0f };
+		CameraAABB cameraAABB = { glm::vec3(-UNBOUNDED_EXTENT), glm::vec3(UNBOUNDED_EXTENT) };
+		glm::vec4 worldSphere{ 0.0f, 0.0f, 0.0f, UNBOUNDED_EXTENT };
+		bool hasBounds = false;
+
+		void setLocalBounds(const CameraAABB& box, const glm::vec4& sphere);
 
 	public:
+		// finite so the spatial index can still compute areas of unbounded boxes
+		static constexpr float UNBOUNDED_EXTENT = 1e18f;
+
 		virtual ~IRenderable() = default;
 
 		virtual void Draw(const Shader* shader) = 0;
+		// Draws the geometry instanceCount times starting at gl_BaseInstance = baseInstance.
+		// Returns false if the renderable has no instanced path.
+		virtual bool DrawInstanced(const Shader* shader, uint32_t instanceCount, uint32_t baseInstance) { return false; };
+		// Single indexed draw (GL_TRIANGLES, GL_UNSIGNED_INT) from vao, without per-draw bindings.
+		// Renderables that provide one can be merged into multi-draw indirect calls.
+		virtual bool getDrawCommand(unsigned int& vao, DrawElementsIndirectCommand& command) const { return false; };
 
-		virtual void updateBoundingBox() {};
+		// Recomputes the world bounds from the local ones and the transforms
+		virtual void updateBoundingBox();
 
-		virtual void setTransforms(const glm::mat4& mat) { transforms = mat; }
+		virtual void setTransforms(const glm::mat4& mat) { transforms = mat; updateBoundingBox(); }
 		virtual glm::mat4 getTransforms() const { return transforms; };
 		virtual CameraAABB getBoundBox() const { return cameraAABB; };
-		virtual bool isVisible(const Camera& camera) const {
-			// default: always visible
-			return true;
-		}
+		// World space, xyz = center, w = radius
+		virtual glm::vec4 getBoundingSphere() const { return worldSphere; };
+		// Equal for objects whose geometry is identical (0 = unique), lets the renderer sort and instance them together
+		virtual unsigned int getGeometryID() const { return geometryID; };
+		// Sphere then box against the camera frustum, always true without bounds
+		virtual bool isVisible(const Camera& camera) const;
+		// For renderables that cull themselves (e.g. on the GPU): cull the following draws against
+		// frustum instead of their camera, nullptr restores it. Used by shadow and other off-camera passes.
+		virtual void setCullFrustum(const CameraFrustum* frustum) {};
 	};
 }
\ No newline at end of file
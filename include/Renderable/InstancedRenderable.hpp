@@ -13,8 +13,11 @@
 #include "Shader/ComputeShader.hpp"
 #include "Shader/Shader.hpp"
 #include "Camera/Camera.hpp"
-#include "Utils/UBO.hpp"
 #include "Utils/SSBO.hpp"
+#include "Renderer/FrameConstants.hpp"
+#include "Renderer/GLState.hpp"
+#include "Renderer/SpatialIndex.hpp"
+#include "Renderer/VisibilityBuffer.hpp"
 
 #include <glm/gtc/matrix_transform.hpp>
 
@@ -69,10 +72,10 @@ namespace Lexvi {
 		SSBO allSubInstancesSSBO;
 		SSBO visibleSubInstancesSSBO;
 		SSBO indirectBuffer;
-		UBO frustumUBO;
 
 		std::shared_ptr<ComputeShader> cullShader;
 		std::shared_ptr<Camera> camera;
+		const CameraFrustum* cullFrustum = nullptr; // overrides the camera's frustum when set
 
 	private:
 		MeshType baseMesh;
@@ -80,21 +83,55 @@ namespace Lexvi {
 
 		const uint32_t MAX_UPDATE_PER_FRAME = 10000;
 		const size_t DEFAULT_SUBINSTANCE_COUNT = 1'000'000;
-		GLint maxX, maxY, maxZ;
 		size_t MAX_SUBINSTANCE_COUNT = DEFAULT_SUBINSTANCE_COUNT;
 
 		DrawElementsIndirectCommand drawCmd = {};
 
+	private:
+		/* --- CPU spatial queries --- */
+		SpatialIndex* spatialIndex = nullptr;
+		CameraAABB localBounds = {};
+		std::vector<int32_t> subInstanceProxies; // [subInstance index, proxy]
+
 	public:
+		// cullShader tests against LexviCullPlane(i) from #include <Lexvi/Culling.glsl>, the frame
+		// constants' frustum unless setCullFrustum gave another one
 		InstanceSystem(std::function<void(MeshType&)> genMesh, std::shared_ptr<ComputeShader> cullShader)
 			: generateMeshFunc(genMesh), cullShader(cullShader)
 		{
 			InitSystem();
 		}
 
+		~InstanceSystem() {
+			SetSpatialIndex(nullptr, {});
+		}
+
 		inline void SetCurrentCamera(std::shared_ptr<Camera> cam) {
 			camera = cam;
 		}
+
+		inline void setCullFrustum(const CameraFrustum* frustum) override {
+			cullFrustum = frustum;
+		}
+
+		// Mirrors every active sub-instance into index as a leaf with this system as the object and the
+		// sub-instance as the user index. bounds is the mesh's local box, nullptr detaches.
+		inline void SetSpatialIndex(SpatialIndex* index, const CameraAABB& bounds) {
+			if (spatialIndex) {
+				for (int32_t& proxy : subInstanceProxies) {
+					if (proxy != SpatialIndex::NULL_NODE) spatialIndex->Remove(proxy);
+				}
+			}
+			subInstanceProxies.assign(allSubInstances.size(), SpatialIndex::NULL_NODE);
+
+			spatialIndex = index;
+			localBounds = bounds;
+			if (!spatialIndex) return;
+
+			for (size_t i = 0; i < allSubInstances.size(); ++i) {
+				if (allSubInstances[i].extraFlags.w > 0.5f) insertProxy(i);
+			}
+		}
 	private:
 
 		inline void InitSystem() {
@@ -125,17 +162,16 @@ namespace Lexvi {
 			glNamedBufferStorage(indirectBuffer.id, indirectBuffer.size, &drawCmd, GL_DYNAMIC_STORAGE_BIT);
 			BindSSBO(indirectBuffer);
 
-			// Allocate 6 vec4s worth of space (each vec4 = 16 bytes, so 6 * 16 = 96 bytes)
-			CreateUBO(frustumUBO, sizeof(glm::vec4) * 6, 2);
-
-			glGetIntegeri_v(GL_MAX_COMPUTE_WORK_GROUP_COUNT, 0, &maxX);
-			glGetIntegeri_v(GL_MAX_COMPUTE_WORK_GROUP_COUNT, 1, &maxY);
-			glGetIntegeri_v(GL_MAX_COMPUTE_WORK_GROUP_COUNT, 2, &maxZ);
-
 			ResizeSSBOs();
 		}
 
 	private:
+		inline void insertProxy(size_t index) {
+			if (subInstanceProxies.size() <= index) subInstanceProxies.resize(index + 1, SpatialIndex::NULL_NODE);
+			CameraAABB box = TransformAABB(localBounds, allSubInstances[index].model);
+			subInstanceProxies[index] = spatialIndex->Insert(box, this, static_cast<uint32_t>(index));
+		}
+
 		inline void setActive(const size_t& index, bool active) {
 			glm::vec4 v = allSubInstances[index].extraFlags;
 			v.z = active ? 1.0f : 0.0f;
@@ -157,9 +193,14 @@ namespace Lexvi {
 
 			entityMap[entityID].push_back(index);
 			pendingUpdates.push_back(index);
+			if (spatialIndex) insertProxy(index);
 		}
 
 		inline void FreeSubInstance(const size_t& index) {
+			if (spatialIndex && subInstanceProxies[index] != SpatialIndex::NULL_NODE) {
+				spatialIndex->Remove(subInstanceProxies[index]);
+				subInstanceProxies[index] = SpatialIndex::NULL_NODE;
+			}
 			freeIndices.push_back(index);
 			pendingUpdates.push_back(index);
 			setActive(index, false);
@@ -274,6 +315,18 @@ namespace Lexvi {
 			return ids;
 		}
 
+		// Descriptor for VisibilityBuffer::AddDraw, layout describes MeshType's vertex
+		inline VisibilityDrawDesc getVisibilityDraw(const VisibilityVertexLayout& layout, const std::string& material = "") const {
+			VisibilityDrawDesc desc;
+			desc.vbo = baseMesh.VBO;
+			desc.ebo = baseMesh.EBO;
+			desc.indexCount = static_cast<uint32_t>(baseMesh.indices.size());
+			desc.layout = layout;
+			desc.visibleInstances = visibleSubInstancesSSBO.id;
+			desc.material = material;
+			return desc;
+		}
+
 		inline void UpdateEntity(uint32_t& entityID, IOwner& entity) {
 			FreeEntity(entityID);
 			entityID = AddEntity(entity);
@@ -286,39 +339,22 @@ namespace Lexvi {
 			BindSSBO(visibleSubInstancesSSBO);
 			BindSSBO(indirectBuffer);
 
-			glm::vec4 frustumPlanes[6];
-			GetFrustumPlanesVec4(camera->getFrustum(), frustumPlanes);
-
+			// the camera's planes are already in the frame constants, only an override is uploaded
 			cullShader->use();
 			cullShader->setUint("InstanceCount", static_cast<uint32_t>(allSubInstances.size()));
 			cullShader->setVec3("cameraPos", camera->getPosition());
 			cullShader->setFloat("maxDistance", camera->getZNearAndZFar().y);
+			SetCullFrustumUniforms(*cullShader, cullFrustum);
 
-			UpdateUBO(frustumUBO, frustumPlanes, sizeof(glm::vec4) * 6, 0);
-
-			uint32_t threadsPerGroupX = 32; // match shader local_size_x
-			uint32_t threadsPerGroupY = 32; // match shader local_size_y
-			uint32_t threadsPerGroupZ = 1;  // match shader local_size_z
-
-			uint32_t totalThreads = static_cast<uint32_t>(allSubInstances.size());
-
-			if (totalThreads == 0) return;
-
-			// Total groups needed to cover all threads
-			uint32_t totalGroups = (totalThreads + threadsPerGroupX * threadsPerGroupY * threadsPerGroupZ - 1)
-				/ (threadsPerGroupX * threadsPerGroupY * threadsPerGroupZ);
-
-			// Try to divide groups into 3D grid
-			uint32_t groupsX = std::min(static_cast<uint32_t>(maxX), totalGroups);
-			uint32_t groupsY = std::min(static_cast<uint32_t>(maxY), (totalGroups + groupsX - 1) / groupsX);
-			uint32_t groupsZ = std::min(static_cast<uint32_t>(maxZ), (totalGroups + groupsX * groupsY - 1) / (groupsX * groupsY));
+			if (allSubInstances.empty()) return;
 
-			glDispatchCompute(groupsX, groupsY, groupsZ);
+			// local size comes from the cull shader itself, groups are split across the device limits
+			cullShader->DispatchThreads(static_cast<uint64_t>(allSubInstances.size()));
 			glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
 
 			shader->use();
-			glBindVertexArray(baseMesh.VAO);
-			glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer.id);
+			GLState::BindVertexArray(baseMesh.VAO);
+			GLState::BindDrawIndirectBuffer(indirectBuffer.id);
 			glDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, nullptr);
 		}
 	};
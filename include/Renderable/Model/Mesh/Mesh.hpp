@@ -3,29 +3,111 @@
 #include <Shader/Shader.hpp>
 #include <Textures/Textures.hpp>
 #include <Renderable/IRenderable/IRenderable.hpp>
+#include <Renderer/Material.hpp>
+#include <Renderable/Model/Mesh/VertexFormat.hpp>
+#include <Renderable/Model/Mesh/MeshSimplifier.hpp>
+#include <Renderable/Model/Mesh/Meshlet.hpp>
 
 namespace Lexvi {
+    class MeshArena;
 
-    struct Vertex {
-        glm::vec3 Position;
-        glm::vec3 Normal;
-        glm::vec2 TexCoords;
-        glm::vec3 Tangent;
-        glm::vec3 Bitangent;
+    // Geometry that is already in its GPU layout and index type, e.g. straight from the model cache
+    struct PackedMeshData {
+        VertexLayout layout = VertexLayout::Full;
+        GLenum indexType = GL_UNSIGNED_INT;
+        const void* vertices = nullptr;
+        uint32_t vertexCount = 0;
+        const void* indices = nullptr;
+        uint32_t indexCount = 0;
+        CameraAABB bounds = {};
+        glm::vec4 boundingSphere{ 0.0f };
+        // Index ranges relative to indices, the full mesh first. None means a single level of all indices.
+        const MeshLod* lods = nullptr;
+        uint32_t lodCount = 0;
+        // Clusters of the full mesh, index ranges relative to indices. May be empty.
+        const Meshlet* meshlets = nullptr;
+        uint32_t meshletCount = 0;
     };
 
+    // Where LODs are picked from, Renderer::BeginFrame points it at the frame's camera
+    struct LodView {
+        glm::vec3 cameraPosition{ 0.0f };
+        float projectionScale = 0.0f;   // pixels covered by one unit at distance 1, 0 always draws the full mesh
+        float pixelThreshold = 1.0f;    // the coarsest level whose error projects below this is drawn
+    };
+
+    LodView& GetLodView();
+
+    // An imported mesh converted to its GPU layout but not uploaded yet. PrepareMesh doesn't touch
+    // GL, so async loads build these on worker threads and only the upload waits for the GL thread.
+    struct PreparedMesh {
+        std::vector<Vertex> vertices;
+        std::vector<unsigned int> indices; // every LOD, the full mesh first
+        std::vector<MeshLod> lods;
+        std::vector<Meshlet> meshlets;
+        std::vector<uint8_t> packedVertices;
+        std::vector<uint16_t> shortIndices; // only filled for GL_UNSIGNED_SHORT
+        VertexLayout layout = VertexLayout::Full;
+        CameraAABB bounds = {};
+        glm::vec4 boundingSphere{ 0.0f };
+
+        // Points into the vectors above
+        PackedMeshData getData() const;
+    };
+
+    PreparedMesh PrepareMesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices, const MeshFormat& format, std::vector<MeshLod> lods = {}, std::vector<Meshlet> meshlets = {});
+
     class Mesh {
     public:
         std::vector<Vertex> vertices;
-        std::vector<unsigned int> indices;
+        std::vector<unsigned int> indices; // the full mesh, then the coarser LODs
         std::vector<Texture> textures;
 
-        Mesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices, std::vector<Texture> textures);
-        void Draw(const Shader* shader) const;
+        Mesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices, std::vector<Texture> textures, const MeshFormat& format = {});
+        // Uploads data as is, vertices and indices stay empty
+        Mesh(const PackedMeshData& data, std::vector<Texture> textures);
+        Mesh(PreparedMesh&& prepared, std::vector<Texture> textures);
+        void Draw(const Shader* shader, uint32_t lod = 0) const;
+        void DrawInstanced(const Shader* shader, uint32_t instanceCount, uint32_t baseInstance) const;
+
+        // Location inside getArena(), the index range is the full mesh
+        const MeshArena& getArena() const { return *arena; };
+        uint32_t getFirstIndex() const { return lods[0].firstIndex; };
+        uint32_t getIndexCount() const { return lods[0].indexCount; };
+        int32_t getBaseVertex() const { return baseVertex; };
+        // Local space, xyz = center, w = radius
+        glm::vec4 getBoundingSphere() const { return boundingSphere; };
+        const CameraAABB& getBoundBox() const { return boundingBox; };
+        bool isQuantized() const { return quantized; };
+        // Index ranges inside getArena(), the full mesh first
+        const std::vector<MeshLod>& getLods() const { return lods; };
+        // Clusters of the full mesh with index ranges inside getArena(), empty if none were built
+        const std::vector<Meshlet>& getMeshlets() const { return meshlets; };
+        // Coarsest level whose error stays under GetLodView()'s threshold when drawn with transforms
+        uint32_t selectLod(const glm::mat4& transforms) const;
+        // Local position from the stored one, identity unless quantized
+        glm::mat4 getDequantization() const;
+        // Entry in GetMaterialTextureTable(), registered on first request
+        uint32_t getMaterialIndex() const;
+        const std::shared_ptr<Material>& getMaterial() const { return material; };
 
     private:
-        unsigned int VAO, VBO, EBO;
-        void setupMesh();
+        MeshArena* arena = nullptr;
+        bool quantized = false;
+        std::vector<MeshLod> lods;
+        std::vector<Meshlet> meshlets;
+        int32_t baseVertex = 0;
+        glm::vec4 boundingSphere{ 0.0f };
+        CameraAABB boundingBox = {};
+
+        static constexpr uint32_t NO_MATERIAL = 0xFFFFFFFFu;
+        mutable uint32_t materialIndex = NO_MATERIAL;
+
+        std::shared_ptr<Material> material;
+
+        void upload(const PackedMeshData& data);
+        void drawElements(const Shader* shader, uint32_t instanceCount, uint32_t baseInstance, uint32_t lod) const;
+
     };
 
 }
\ No newline at end of file
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "Renderable/Model/Mesh/VertexFormat.hpp"
+
+namespace Lexvi {
+    // Where a mesh lives inside the arena, in elements (not bytes)
+    struct MeshRange {
+        uint32_t firstIndex = 0;
+        uint32_t indexCount = 0;
+        int32_t baseVertex = 0;
+        uint32_t vertexCount = 0;
+    };
+
+    // One vertex buffer, one index buffer and one VAO shared by every Mesh of a vertex layout and
+    // index type. Meshes are appended and never freed; when a buffer runs out it is reallocated at
+    // twice the size and copied on the GPU, the VAO keeps its name so nothing that cached it has to be updated.
+    class MeshArena {
+    public:
+        // one arena per layout and index type, see GetMeshArena
+        static constexpr uint32_t ARENA_COUNT = 6;
+
+    private:
+        unsigned int VAO = 0, VBO = 0, EBO = 0;
+        uint32_t vertexCapacity = 0, indexCapacity = 0;
+        uint32_t vertexCount = 0, indexCount = 0;
+
+        VertexLayout layout = VertexLayout::Full;
+        GLenum indexType = GL_UNSIGNED_INT;
+        uint32_t vertexSize = sizeof(Vertex);
+        uint32_t indexSize = sizeof(unsigned int);
+        uint32_t slot = 0;
+
+    public:
+        MeshArena(VertexLayout layout, GLenum indexType, uint32_t slot);
+        ~MeshArena();
+        MeshArena(const MeshArena&) = delete;
+        MeshArena& operator=(const MeshArena&) = delete;
+
+        // vertices are already in the arena's layout, indices in its index type
+        MeshRange Allocate(const void* vertices, uint32_t newVertices, const void* indices, uint32_t newIndices);
+        // Full layout, 32-bit indices only
+        MeshRange Allocate(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices);
+
+        unsigned int getVAO() const { return VAO; };
+        uint32_t getVertexCount() const { return vertexCount; };
+        uint32_t getIndexCount() const { return indexCount; };
+        VertexLayout getLayout() const { return layout; };
+        GLenum getIndexType() const { return indexType; };
+        uint32_t getIndexSize() const { return indexSize; };
+        // index in [0, ARENA_COUNT), lets batches keep one draw list per arena
+        uint32_t getSlot() const { return slot; };
+
+    private:
+        void create();
+        void growVertices(uint32_t required);
+        void growIndices(uint32_t required);
+    };
+
+    // Arena every Model loads into by default (Full, 32-bit indices), created on first use (needs a GL context)
+    MeshArena& GetMeshArena();
+    MeshArena& GetMeshArena(VertexLayout layout, GLenum indexType);
+    // nullptr if nothing has been loaded into that slot yet
+    MeshArena* GetMeshArenaBySlot(uint32_t slot);
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <vector>
+
+#include "Renderable/Model/Mesh/VertexFormat.hpp"
+
+namespace Lexvi {
+    struct MeshOptimizationStats {
+        uint32_t triangles = 0;
+        uint32_t verticesBefore = 0;
+        uint32_t verticesAfter = 0;
+        // vertex shader invocations, simulated on a POST_TRANSFORM_CACHE_SIZE entry FIFO
+        uint32_t transformsBefore = 0;
+        uint32_t transformsAfter = 0;
+
+        // Average cache miss ratio, transformed vertices per triangle: 3 without reuse, ~0.5 at best
+        float getACMRBefore() const { return triangles ? static_cast<float>(transformsBefore) / triangles : 0.0f; };
+        float getACMRAfter() const { return triangles ? static_cast<float>(transformsAfter) / triangles : 0.0f; };
+
+        MeshOptimizationStats& operator+=(const MeshOptimizationStats& other);
+    };
+
+    // What the ACMR figures assume. Real hardware varies, the orderings don't depend on it much.
+    constexpr uint32_t POST_TRANSFORM_CACHE_SIZE = 16;
+
+    // Runs in place on a triangle list, in this order:
+    //   welding       bitwise identical vertices become one, unreferenced ones go away
+    //   vertex cache  triangles reordered for post-transform cache hits (Forsyth's scoring)
+    //   overdraw      runs of triangles between cache restarts sorted so outward facing ones draw first
+    //   vertex fetch  vertices renumbered in first use order, so reads go through memory linearly
+    MeshOptimizationStats OptimizeMesh(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices);
+
+    // The vertex cache step alone, for index lists built later (e.g. LODs over the same vertices)
+    void OptimizeVertexCache(std::vector<unsigned int>& indices, size_t vertexCount);
+
+    // Transformed vertices for indices on a FIFO post-transform cache
+    uint32_t SimulateVertexCache(const std::vector<unsigned int>& indices, size_t vertexCount, uint32_t cacheSize = POST_TRANSFORM_CACHE_SIZE);
+}
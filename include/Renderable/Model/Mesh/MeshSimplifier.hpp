@@ -0,0 +1,35 @@
+#pragma once
+
+#include <vector>
+
+#include "Renderable/Model/Mesh/VertexFormat.hpp"
+
+namespace Lexvi {
+    struct MeshLodOptions {
+        uint32_t maxLevels = 4;     // coarser levels besides the full mesh, 0 only keeps the full mesh
+        float reduction = 0.5f;     // triangles of a level relative to the one before
+        float maxError = 0.05f;     // stop once a level would deviate more, relative to the mesh's bounding radius
+    };
+
+    // One level of a mesh's index buffer. error is how far (in mesh space) the level strays from the
+    // full mesh, LOD selection projects it to pixels.
+    struct MeshLod {
+        uint32_t firstIndex = 0;
+        uint32_t indexCount = 0;
+        float error = 0.0f;
+    };
+    static_assert(sizeof(MeshLod) == 12, "MeshLod is stored in the model cache as is");
+
+    // Garland-Heckbert quadric error simplification down to targetIndexCount indices, or until the next
+    // collapse would exceed maxError. Vertices are only ever merged into one another, so the result
+    // indexes the same vertex buffer. Vertices sharing a position (unwelded copies, hard normal edges)
+    // collapse together, each onto the vertex of the target position with the closest attributes, so
+    // meshes simplify without OptimizeMesh's welding. Only positions whose vertices disagree on UVs
+    // (texture seams) never move, and open borders are kept in place by extra planes.
+    std::vector<unsigned int> SimplifyMesh(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices,
+        size_t targetIndexCount, float maxError, float* resultError = nullptr);
+
+    // Appends the indices of each coarser level to indices (which hold the full mesh) and returns every
+    // level, the full mesh first. Stops early when a level would no longer remove enough triangles.
+    std::vector<MeshLod> GenerateLods(const std::vector<Vertex>& vertices, std::vector<unsigned int>& indices, const MeshLodOptions& options);
+}
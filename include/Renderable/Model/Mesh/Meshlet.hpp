@@ -0,0 +1,29 @@
+#pragma once
+
+#include <vector>
+
+#include "Renderable/Model/Mesh/VertexFormat.hpp"
+
+namespace Lexvi {
+    // A small, spatially tight run of a mesh's full-detail triangles that is culled on its own
+    struct Meshlet {
+        uint32_t firstIndex = 0;    // relative to the mesh's indices
+        uint32_t indexCount = 0;
+        glm::vec4 sphere{ 0.0f };   // mesh space, xyz = center, w = radius
+        glm::vec4 cone{ 0.0f };     // mesh space average normal, w = sine of the normals' spread; >= 1 never culled
+    };
+    static_assert(sizeof(Meshlet) == 40, "Meshlet is stored in the model cache as is");
+
+    constexpr uint32_t MESHLET_MAX_TRIANGLES = 124;
+    constexpr uint32_t MESHLET_MAX_VERTICES = 64;
+
+    // Grows meshlets over shared vertices, preferring triangles that add the fewest vertices and then
+    // those facing like the rest, so bounds and normal cones stay tight. When no connected triangle is
+    // left it continues from the nearest unassigned one, so islands don't end up as tiny meshlets.
+    // indices[0, indexCount) is rewritten so every meshlet is a contiguous range, vertex cache optimized
+    // within itself; meshlets keep the order of their first triangle.
+    std::vector<Meshlet> BuildMeshlets(const std::vector<Vertex>& vertices, std::vector<unsigned int>& indices, size_t indexCount);
+
+    // Whether the cone says every triangle of a meshlet faces away from cameraPosition (all in the meshlet's space)
+    bool IsMeshletBackfacing(const Meshlet& meshlet, const glm::vec3& cameraPosition);
+}
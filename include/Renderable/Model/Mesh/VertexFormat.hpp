@@ -0,0 +1,67 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "Camera/Camera.hpp"
+
+namespace Lexvi {
+
+    struct Vertex {
+        glm::vec3 Position;
+        glm::vec3 Normal;
+        glm::vec2 TexCoords;
+        glm::vec3 Tangent;
+        glm::vec3 Bitangent;
+    };
+
+    // Layout of the vertices on the GPU. Imported meshes keep the full Vertex on the CPU, meshes
+    // loaded from the model cache keep nothing.
+    //   Full             56 bytes, locations 0-4 as in Vertex
+    //   Packed           24 bytes, float position
+    //   PackedQuantized  20 bytes, unorm16 position inside the mesh bounds
+    // The packed layouts read location 0 as the position, 1 as an octahedral snorm16 normal (vec2),
+    // 2 as half float UVs and 3 as an octahedral tangent (ivec2) whose lowest bit is the bitangent
+    // sign. Vertex shaders decode them through Lexvi/VertexFormat.glsl.
+    enum class VertexLayout : uint8_t {
+        Full,
+        Packed,
+        PackedQuantized,
+    };
+
+    struct MeshFormat {
+        VertexLayout layout = VertexLayout::Full;
+        bool shortIndices = false; // GL_UNSIGNED_SHORT for meshes with at most 65536 vertices
+    };
+
+    struct PackedVertex {
+        glm::vec3 position;
+        int16_t normal[2];
+        uint16_t texCoords[2]; // half floats
+        int16_t tangent[2];
+    };
+    static_assert(sizeof(PackedVertex) == 24, "PackedVertex must stay tightly packed");
+
+    struct PackedQuantizedVertex {
+        uint16_t position[4]; // w unused, keeps the attribute 8-byte aligned
+        int16_t normal[2];
+        uint16_t texCoords[2];
+        int16_t tangent[2];
+    };
+    static_assert(sizeof(PackedQuantizedVertex) == 20, "PackedQuantizedVertex must stay tightly packed");
+
+    uint32_t GetVertexSize(VertexLayout layout);
+    // Enables and formats the attributes of layout on vao, all read from vertex buffer binding 0
+    void SetupVertexAttributes(unsigned int vao, VertexLayout layout);
+
+    // Maps a position stored in [0, 1] back into bounds: position * scale + offset
+    void GetPositionDequantization(const CameraAABB& bounds, glm::vec3& scale, glm::vec3& offset);
+
+    // Converts vertices to layout, bounds is only used by PackedQuantized. Returns the raw bytes.
+    std::vector<uint8_t> PackVertices(const std::vector<Vertex>& vertices, VertexLayout layout, const CameraAABB& bounds);
+
+    // Lexvi/VertexFormat.glsl: decoding helpers for the packed layouts. Quantized meshes set
+    // lexviPositionScale and lexviPositionOffset while they draw, every other draw sees identity.
+    std::string GetVertexFormatGLSL();
+}
@@ -1,23 +1,63 @@
 #pragma once
 
 #include "Mesh/Mesh.hpp"
+#include "Mesh/MeshOptimizer.hpp"
+#include "ModelCache.hpp"
 #include "Shader/Shader.hpp"
 #include <Renderable/IRenderable/IRenderable.hpp>
 
 namespace Lexvi {
+    struct ModelImportOptions {
+        // GPU vertex layout and index width of every mesh, see VertexLayout. The packed layouts need
+        // vertex shaders that decode through Lexvi/VertexFormat.glsl.
+        MeshFormat meshFormat;
+        // Weld and reorder imported triangles, see OptimizeMesh
+        bool optimize = true;
+        // Simplified levels per mesh, Draw picks one from the mesh's projected size
+        MeshLodOptions lods;
+        // Split the full-detail triangles into meshlets that ModelBatch culls one by one
+        bool meshlets = true;
+        // Bake the import into GetModelCache() and load from it on later runs
+        bool useCache = true;
+    };
+
     class Model : public IRenderable {
     public:
-        Model(const std::string& path) { loadModel(path); }
+        Model(const std::string& path, const ModelImportOptions& options = {}) : options(options) { loadModel(path); }
         void Draw(const Shader* shader) override;
+        bool DrawInstanced(const Shader* shader, uint32_t instanceCount, uint32_t baseInstance) override;
+
+        const std::vector<Mesh>& getMeshes() const { return meshes; };
+        // Summed over the meshes of an import, zero when they came from the model cache (already optimized)
+        const MeshOptimizationStats& getOptimizationStats() const { return optimizationStats; };
 
     private:
+        friend class ModelLoader;
+
+        static constexpr uint32_t IMPORT_FLAGS = aiProcess_Triangulate | aiProcess_CalcTangentSpace;
+
         std::vector<Mesh> meshes;
         std::string directory;
         std::vector<Texture> textures_loaded;
+        ModelImportOptions options;
+        MeshOptimizationStats optimizationStats;
+
+        // filled in by ModelLoader
+        Model(const ModelImportOptions& options) : options(options) {};
 
         void loadModel(const std::string& path);
+        void setSource(const std::string& path);
+        // material sort and bounds once every mesh is in
+        void finishLoad();
+        void computeBounds();
         void processNode(aiNode* node, const aiScene* scene);
         Mesh processMesh(aiMesh* mesh, const aiScene* scene);
-        std::vector<Texture> loadMaterialTextures(aiMaterial* mat, aiTextureType type, std::string typeName);
+        // path relative to the model's directory, loaded once per model
+        Texture loadTexture(const std::string& path, const std::string& typeName);
+
+        // CPU half of processMesh, safe on any thread
+        static PreparedMesh ImportMesh(const aiMesh* mesh, const ModelImportOptions& options, MeshOptimizationStats& stats);
+        static void ConvertMesh(const aiMesh* mesh, std::vector<Vertex>& vertices, std::vector<unsigned int>& indices);
+        static std::vector<ModelCache::TextureRef> GetTextureRefs(const aiMaterial* material);
     };
 }
\ No newline at end of file
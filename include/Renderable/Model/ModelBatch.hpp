@@ -0,0 +1,94 @@
+#pragma once
+
+#include "Renderable/Model/Model.hpp"
+#include "Renderable/Model/Mesh/MeshArena.hpp"
+#include "Renderable/IRenderable/IRenderable.hpp"
+#include "Renderer/HiZBuffer.hpp"
+#include "Renderer/ObjectData.hpp"
+#include "Shader/ComputeShader.hpp"
+#include "Utils/SSBO.hpp"
+
+namespace Lexvi {
+    // Draws many models with one glMultiDrawElementsIndirectCount per mesh arena (vertex layout and
+    // index type, one call unless import options are mixed). Every meshlet of every added model is a
+    // draw record (the whole mesh if it has none); a compute pass tests the records' bounding spheres
+    // against the frame constants frustum (or the one setCullFrustum gave), their normal cones against the camera position and,
+    // optionally, their spheres against last frame's Hi-Z pyramid, and compacts the visible ones into
+    // their arena's range of the indirect command buffer. Meshlets always draw the full detail mesh,
+    // LODs are left to Model::Draw. Quantized meshes have their dequantization folded into the
+    // ObjectData model matrix.
+    //
+    // Shaders read their entry through Lexvi/ObjectData.glsl compiled with LEXVI_MODEL_BATCH defined,
+    // which reads the batch's own binding, so queued ObjectData draws in the same flush are left alone.
+    // Nothing is bound per mesh: indices.x is the mesh's material index, textures are sampled through
+    // Lexvi/MaterialTextures.glsl.
+    class ModelBatch : public IRenderable {
+    private:
+        // std430 mirror of the records read by the cull shader
+        struct DrawRecord {
+            uint32_t indexCount;
+            uint32_t firstIndex;
+            int32_t baseVertex;
+            uint32_t objectIndex;
+            glm::vec4 sphere; // world space center, radius
+            glm::vec4 cone;   // world space axis, cutoff; >= 1 never culled
+            uint32_t arena;
+            uint32_t commandBase; // first command of the arena's range, set on upload
+            uint32_t padding[2];
+        };
+
+        struct Instance {
+            const Model* model;
+            uint32_t firstRecord;
+            uint32_t firstObject; // one ObjectData per mesh, shared by its meshlets
+            glm::mat4 transform;
+            glm::vec4 params;
+        };
+
+        std::vector<Instance> instances;
+        std::vector<DrawRecord> records;
+        std::vector<ObjectData> objectData;
+        uint32_t arenaRecords[MeshArena::ARENA_COUNT]{};
+        bool dirty = false;
+
+        bool useMeshlets = true;
+        bool coneCulling = true;
+        const HiZBuffer* hiZ = nullptr;
+        const CameraFrustum* cullFrustum = nullptr; // overrides the frame constants frustum when set
+
+        SSBO recordsSSBO{};
+        SSBO objectDataSSBO{};
+        SSBO commandsSSBO{};
+        SSBO drawCountSSBO{};
+
+        std::shared_ptr<ComputeShader> cullShader;
+
+    public:
+        // Without meshlets every mesh is a single record, as before they existed
+        explicit ModelBatch(bool useMeshlets = true) : useMeshlets(useMeshlets) {};
+        ~ModelBatch();
+        ModelBatch(const ModelBatch&) = delete;
+        ModelBatch& operator=(const ModelBatch&) = delete;
+
+        // The model must outlive the batch. Returns the instance handle.
+        uint32_t Add(const Model& model, const glm::mat4& transform, const glm::vec4& params = glm::vec4(0.0f));
+        void SetTransform(uint32_t instance, const glm::mat4& transform);
+        void Clear();
+
+        void Draw(const Shader* shader) override;
+        // While set (shadow cascades) the cone and Hi-Z tests are skipped, they only hold for the camera
+        void setCullFrustum(const CameraFrustum* frustum) override { cullFrustum = frustum; };
+
+        // Cone culling assumes back faces are culled, turn it off for double sided materials
+        void setConeCulling(bool enabled) { coneCulling = enabled; };
+        // Culls against hiZ while it's valid, nullptr to stop. The pyramid has to be enabled, see Renderer::getHiZ.
+        void setOcclusionCulling(const HiZBuffer* pyramid) { hiZ = pyramid; };
+
+        uint32_t getRecordCount() const { return static_cast<uint32_t>(records.size()); };
+
+    private:
+        uint32_t getRecordCount(const Mesh& mesh) const;
+        void writeInstance(uint32_t instance);
+        void upload();
+    };
+}
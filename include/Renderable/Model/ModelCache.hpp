@@ -0,0 +1,63 @@
+#pragma once
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "Renderable/Model/Mesh/Mesh.hpp"
+#include "Utils/MappedFile.hpp"
+
+namespace Lexvi {
+    // Baked copies of imported models, so later runs skip Assimp. One versioned .lxmesh file per
+    // model and import settings:
+    //   header          magic, version, key, table offsets
+    //   mesh table      vertex/index blob ranges, layout, index type, bounds, material, LOD and meshlet ranges
+    //   LOD table       index ranges relative to the mesh's index blob, errors
+    //   meshlet table   index ranges relative to the mesh's index blob, bounding spheres and normal cones
+    //   material table  texture ranges of the texture table (type and path offsets into the strings)
+    //   strings         null terminated
+    //   blobs           vertices in the mesh's GPU layout, indices in its index type, 16-byte aligned
+    // Files are memory mapped on load and the blobs go to the mesh arenas as they are, nothing is
+    // converted per vertex. Invalid, stale or truncated files are ignored and rewritten.
+    class ModelCache {
+    public:
+        // Returns the texture for a path relative to the model's directory and a texture type
+        using TextureLoader = std::function<Texture(const std::string& path, const std::string& type)>;
+
+        struct TextureRef {
+            std::string path; // relative to the model's directory
+            std::string type;
+        };
+
+        // A validated, still mapped entry. The mesh data points into file.
+        struct CachedModel {
+            MappedFile file;
+            std::vector<PackedMeshData> meshes;
+            std::vector<std::vector<TextureRef>> meshTextures;
+        };
+
+    private:
+        std::string directory;
+
+    public:
+        ModelCache() = default;
+        explicit ModelCache(std::string directory) : directory(std::move(directory)) {};
+
+        // Changes whenever the source file (path, size, modification time) or the import settings do.
+        // Contents aren't hashed, reading them would cost a good part of what the cache saves.
+        static uint64_t MakeKey(const std::string& sourcePath, const MeshFormat& format, uint32_t importFlags, bool optimized, const MeshLodOptions& lods, bool meshlets);
+
+        // Maps and validates the entry for key without touching GL, so it can run on any thread
+        bool Open(uint64_t key, CachedModel& model) const;
+        // Appends the cached meshes, false (and nothing appended) without a valid entry for key
+        bool Load(uint64_t key, std::vector<Mesh>& meshes, const TextureLoader& loadTexture) const;
+        // Meshes have to still hold their CPU vertices, i.e. come from an import
+        void Store(uint64_t key, const std::vector<Mesh>& meshes) const;
+
+    private:
+        std::string getPath(uint64_t key) const;
+    };
+
+    // Cache every Model uses, files go to "ModelCache/"
+    ModelCache& GetModelCache();
+}
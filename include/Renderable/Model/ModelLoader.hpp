@@ -0,0 +1,89 @@
+#pragma once
+
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "Renderable/Model/Model.hpp"
+#include "Utils/WorkerPool.hpp"
+
+namespace Lexvi {
+    enum class ModelLoadState : uint8_t {
+        Loading,
+        Ready,
+        Failed,
+    };
+
+    // Returned by ModelLoader::LoadAsync, poll it from the GL thread
+    class ModelHandle {
+    private:
+        friend class ModelLoader;
+
+        std::atomic<ModelLoadState> state{ ModelLoadState::Loading };
+        std::shared_ptr<Model> model;
+        std::string path;
+
+    public:
+        explicit ModelHandle(std::string path) : path(std::move(path)) {};
+
+        ModelLoadState getState() const { return state.load(std::memory_order_acquire); };
+        bool isReady() const { return getState() == ModelLoadState::Ready; };
+        bool isFailed() const { return getState() == ModelLoadState::Failed; };
+        // nullptr until ready
+        std::shared_ptr<Model> getModel() const { return isReady() ? model : nullptr; };
+        const std::string& getPath() const { return path; };
+    };
+
+    struct ModelLoaderStats {
+        uint32_t pending = 0;       // handles still loading
+        uint32_t uploads = 0;       // GL steps run by the last Update
+        float uploadTime = 0.0f;    // ms the last Update spent on them
+    };
+
+    // Loads models without stalling the frame. Workers run the Assimp import (or map the model cache
+    // entry), then convert the meshes and decode the textures in parallel, one job each. What needs
+    // GL, texture creation and the mesh arena uploads, waits for Update, which does them one at a
+    // time until the frame's budget is spent. Loads of the same file aren't shared.
+    class ModelLoader {
+    private:
+        struct LoadJob;
+
+        float uploadBudget = 2.0f; // ms
+        std::atomic<uint32_t> pending{ 0 };
+        ModelLoaderStats stats;
+
+        std::mutex readyMutex;
+        std::deque<std::shared_ptr<LoadJob>> ready;     // done on the workers
+        std::deque<std::shared_ptr<LoadJob>> uploads;   // GL thread only
+
+        // last so it joins before the queues above go away
+        std::unique_ptr<WorkerPool> workers;
+
+        void import(const std::shared_ptr<LoadJob>& job);
+        void taskDone(const std::shared_ptr<LoadJob>& job);
+        void queueUpload(const std::shared_ptr<LoadJob>& job);
+        // true once job's model is complete
+        bool uploadStep(LoadJob& job);
+        void finish(LoadJob& job, ModelLoadState state);
+
+    public:
+        ModelLoader() = default;
+        ~ModelLoader();
+        ModelLoader(const ModelLoader&) = delete;
+        ModelLoader& operator=(const ModelLoader&) = delete;
+
+        // Call from the GL thread. The workers start with the first load.
+        std::shared_ptr<ModelHandle> LoadAsync(const std::string& path, const ModelImportOptions& options = {});
+
+        // GL thread, once a frame (Engine::run does). Always makes some progress, however small the budget.
+        void Update();
+
+        void setUploadBudget(float milliseconds) { uploadBudget = milliseconds; };
+        float getUploadBudget() const { return uploadBudget; };
+        const ModelLoaderStats& getStats() const { return stats; };
+    };
+
+    ModelLoader& GetModelLoader();
+}
@@ -31,12 +31,8 @@ namespace Lexvi {
         Cylinder(float radius, float height, int segments);
 
         void Draw(const Shader* shader) override;
+        bool DrawInstanced(const Shader* shader, uint32_t instanceCount, uint32_t baseInstance) override;
+        bool getDrawCommand(unsigned int& vao, DrawElementsIndirectCommand& command) const override;
 
-        void updateBoundingBox() override;
-
-        void setTransforms(const glm::mat4& mat) override;
-        glm::mat4 getTransforms() const override;
-        CameraAABB getBoundBox() const override;
-        bool isVisible(const Camera& camera) const override;
     };
 }
\ No newline at end of file
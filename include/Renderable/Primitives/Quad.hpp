@@ -35,12 +35,10 @@ namespace Lexvi {
         Quad(float width, float height);
 
         void Draw(const Shader* shader) override;
+        bool DrawInstanced(const Shader* shader, uint32_t instanceCount, uint32_t baseInstance) override;
+        bool getDrawCommand(unsigned int& vao, DrawElementsIndirectCommand& command) const override;
 
-        void setTransforms(const glm::mat4& mat) override;
-        glm::mat4 getTransforms() const override;
-        CameraAABB getBoundBox() const override;
-        bool isVisible(const Camera& camera) const override;
-
+        // Moves the quad, keeps the rotation and scale of the transforms
         void setPosition(const glm::vec3& pos);
 
         void Bind() const;
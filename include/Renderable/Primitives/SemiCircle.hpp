@@ -13,6 +13,10 @@ namespace Lexvi {
         std::vector<SemiCircleVertex> vertices;
         std::vector<unsigned int> indices;
         unsigned int VAO = 0, VBO = 0, EBO = 0;
+
+        // Local bounds for whoever draws the mesh, sphere is xyz = center, w = radius
+        CameraAABB bounds = {};
+        glm::vec4 boundingSphere{ 0.0f };
     };
 
     // Generates a semicircle mesh in XY plane, z=0, with "vertexCount" along rim
@@ -25,5 +25,7 @@ namespace Lexvi {
 		Sphere(int stacks, int slices);
 
 		void Draw(const Shader* shader) override;
+		bool DrawInstanced(const Shader* shader, uint32_t instanceCount, uint32_t baseInstance) override;
+		bool getDrawCommand(unsigned int& vao, DrawElementsIndirectCommand& command) const override;
 	};
 }
\ No newline at end of file
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "Camera/Camera.hpp"
+#include "Renderable/IRenderable/IRenderable.hpp"
+
+namespace Lexvi {
+	// Frustum culls many world AABBs at once. Boxes are stored as structure of arrays and tested
+	// 8 (AVX2) or 4 (SSE2) at a time against the 6 planes, the instruction set is picked at runtime.
+	// Large sets are split into chunks culled on worker threads. The result is one bit per box.
+	class BatchCuller {
+	private:
+		std::vector<float> minX, minY, minZ;
+		std::vector<float> maxX, maxY, maxZ;
+		std::vector<uint64_t> visibility;
+		uint32_t visibleCount = 0;
+
+	public:
+		// Sets above this size are culled on worker threads
+		static constexpr size_t PARALLEL_THRESHOLD = 65536;
+
+		uint32_t Add(const CameraAABB& box);
+		void Set(uint32_t index, const CameraAABB& box);
+		void Resize(size_t count);
+		void Clear();
+
+		// Rebuilds the boxes from getBoundBox(), index i is objects[i]
+		void Update(const std::vector<IRenderable*>& objects);
+
+		void Cull(const CameraFrustum& frustum);
+
+		bool isVisible(uint32_t index) const { return (visibility[index >> 6] >> (index & 63)) & 1; }
+		// bit i of word i / 64 is box i, bits past size() are 0
+		const std::vector<uint64_t>& getVisibility() const { return visibility; }
+		uint32_t getVisibleCount() const { return visibleCount; }
+		size_t size() const { return minX.size(); }
+
+	private:
+		// begin is a multiple of 64 so chunks never share a visibility word
+		void cullRange(const CameraFrustum& frustum, size_t begin, size_t end);
+	};
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstdint>
+
+namespace Lexvi {
+	// Buffer binding points reserved by the engine. Game shaders should stay clear of these.
+	// InstanceSystem already owns SSBO 0-2.
+	namespace BindingPoints {
+		constexpr uint32_t ObjectDataSSBO = 3;
+
+		// ModelBatch culling
+		constexpr uint32_t BatchDrawRecordsSSBO = 4;
+		constexpr uint32_t BatchCommandsSSBO = 5;
+		constexpr uint32_t BatchDrawCountSSBO = 6;
+		// the batch's own ObjectData, read by the LEXVI_MODEL_BATCH variant of Lexvi/ObjectData.glsl
+		constexpr uint32_t BatchObjectDataSSBO = 21;
+
+		constexpr uint32_t MaterialTexturesSSBO = 7;
+
+		// texture array fallback of the material table
+		constexpr uint32_t MaterialArrayUnitBase = 16;
+		constexpr uint32_t MaxMaterialArrays = 16;
+
+		constexpr uint32_t FrameConstantsUBO = 8;
+		constexpr uint32_t MaterialParamsUBO = 9;
+
+		// clustered lighting
+		constexpr uint32_t LightsSSBO = 10;
+		constexpr uint32_t ClusterBoundsSSBO = 11;
+		constexpr uint32_t ClusterGridSSBO = 12;
+		constexpr uint32_t LightIndicesSSBO = 13;
+		constexpr uint32_t LightIndexCounterSSBO = 14;
+
+		// cascaded shadows
+		constexpr uint32_t ShadowDataUBO = 15;
+		constexpr uint32_t ShadowMapUnit = 15; // texture unit, below the material arrays
+
+		// deferred shading, texture units read by the resolve pass
+		constexpr uint32_t GBufferAlbedoUnit = 11;
+		constexpr uint32_t GBufferNormalUnit = 12;
+		constexpr uint32_t GBufferMaterialUnit = 13;
+		constexpr uint32_t GBufferDepthUnit = 14;
+
+		// visibility buffer resolve
+		constexpr uint32_t VisibilityUnit = 10; // texture unit
+		constexpr uint32_t VisibilityBinsSSBO = 16;
+		constexpr uint32_t VisibilityPixelsSSBO = 17;
+		constexpr uint32_t VisibilityVerticesSSBO = 18;
+		constexpr uint32_t VisibilityIndicesSSBO = 19;
+		constexpr uint32_t VisibilityInstancesSSBO = 20;
+
+		// depth pyramid read by occlusion culling passes
+		constexpr uint32_t HiZUnit = 9; // texture unit
+	}
+}
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <string>
+#include <glm/glm.hpp>
+
+#include "Camera/Camera.hpp"
+#include "Renderable/IRenderable/IRenderable.hpp"
+#include "Shader/Shader.hpp"
+#include "Utils/UBO.hpp"
+
+namespace Lexvi {
+	// std140 mirror of LexviShadowData
+	struct ShadowData {
+		glm::mat4 viewProjection[4]{};
+		glm::vec4 splits{ 0.0f }; // far view depth of each cascade
+		glm::vec4 params{ 0.0f }; // cascade count, 1 / resolution, depth bias, normal offset in texels
+	};
+
+	struct CascadedShadowSettings {
+		uint32_t cascadeCount = 4;
+		uint32_t resolution = 2048;
+		float splitLambda = 0.75f;        // 0 = uniform splits, 1 = logarithmic
+		float maxDistance = 0.0f;         // shadow range, 0 = the camera's zFar
+		uint32_t firstCachedCascade = 2;  // cascades from this one on cache their static casters
+		float cacheSlack = 1.25f;         // cached cascades cover this much more so camera moves don't redraw them
+		float casterMargin = 50.0f;       // extends each cascade towards the light for casters outside the view
+		float depthBias = 0.0005f;
+		float normalOffset = 1.5f;
+	};
+
+	struct CascadedShadowStats {
+		uint32_t cascadesRendered = 0; // uncached cascades, redrawn every frame
+		uint32_t cachesRefreshed = 0;  // cached cascades whose static casters were redrawn
+		uint32_t cachesReused = 0;
+		uint32_t casterDraws = 0;
+	};
+
+	// Cascaded shadow maps for one directional light, in a depth texture array with compare mode.
+	// Cascades are fitted to the bounding sphere of their slice of the view frustum and snapped to
+	// whole texels in light space, so they don't shimmer as the camera moves or turns.
+	//
+	// Near cascades are redrawn every frame. Far cascades keep their static casters in a second array
+	// that is only redrawn when the light turns, static geometry in range changes, or the camera leaves
+	// the enlarged area the cache was drawn for; each frame the cache is copied back and only dynamic
+	// casters are drawn on top, and even that is skipped while none are in range.
+	class CascadedShadowMap {
+	public:
+		static constexpr uint32_t MAX_CASCADES = 4;
+
+	private:
+		struct Caster {
+			IRenderable* object;
+			bool isStatic;
+		};
+
+		struct Cascade {
+			glm::mat4 viewProjection{ 1.0f };
+			CameraFrustum frustum{};
+			unsigned int fbo = 0;
+			unsigned int cacheFbo = 0;
+
+			// cached cascades
+			glm::vec3 cacheCenter{ 0.0f };
+			float cacheRadius = 0.0f;
+			bool cacheValid = false;
+			bool liveMatchesCache = false;
+		};
+
+		CascadedShadowSettings settings;
+		std::vector<Caster> casters;
+		Cascade cascades[MAX_CASCADES];
+		glm::vec3 lightDirection = glm::normalize(glm::vec3(-0.3f, -1.0f, -0.2f));
+
+		unsigned int shadowMap = 0;
+		unsigned int cacheMap = 0;
+		UBO shadowUBO{};
+		ShadowData shadowData{};
+		CascadedShadowStats stats;
+
+	public:
+		explicit CascadedShadowMap(const CascadedShadowSettings& settings = {});
+		~CascadedShadowMap();
+		CascadedShadowMap(const CascadedShadowMap&) = delete;
+		CascadedShadowMap& operator=(const CascadedShadowMap&) = delete;
+
+		// The object must stay alive until it is removed. Static casters are drawn into the caches, so
+		// moving one requires InvalidateStatic.
+		void AddCaster(IRenderable& obj, bool isStatic);
+		void RemoveCaster(IRenderable& obj);
+
+		// Direction the light travels in
+		void SetLightDirection(const glm::vec3& direction);
+		void InvalidateStatic();
+		// Only drops the cached cascades that overlap region
+		void InvalidateStatic(const CameraAABB& region);
+
+		// Draws what changed, uploads LexviShadowData and binds the map to BindingPoints::ShadowMapUnit.
+		// depthShader gets "lightSpaceMatrix" and "model". Viewport and framebuffer are restored.
+		void Render(const Camera& camera, const Shader& depthShader);
+
+		unsigned int getShadowMap() const { return shadowMap; }
+		const ShadowData& getShadowData() const { return shadowData; }
+		const CascadedShadowStats& getStats() const { return stats; }
+
+		// GLSL for #include <Lexvi/Shadows.glsl>
+		static std::string GetGLSL();
+
+	private:
+		void createResources();
+		void deleteResources();
+		glm::mat4 buildViewProjection(const glm::vec3& center, float radius) const;
+		bool anyDynamicCaster(const Cascade& cascade) const;
+		void drawCasters(const Shader& depthShader, const Cascade& cascade, bool isStatic);
+	};
+}
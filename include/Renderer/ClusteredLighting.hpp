@@ -0,0 +1,96 @@
+#pragma once
+
+#include <string>
+#include <glm/glm.hpp>
+
+#include "Camera/Camera.hpp"
+#include "Shader/ComputeShader.hpp"
+#include "Utils/SSBO.hpp"
+
+namespace Lexvi {
+	enum class LightType : uint32_t {
+		Point = 0,
+		Spot = 1,
+	};
+
+	// std430 mirror of LexviLight
+	struct Light {
+		glm::vec4 positionRange{ 0.0f };  // world position, range
+		glm::vec4 colorIntensity{ 1.0f }; // rgb, intensity
+		glm::vec4 directionType{ 0.0f };  // spot direction, LightType
+		glm::vec4 spotAngles{ 0.0f };     // cos(inner), cos(outer), unused, unused
+	};
+	static_assert(sizeof(Light) == 64, "Light must match the std430 LexviLight layout");
+
+	Light MakePointLight(const glm::vec3& position, const glm::vec3& color, float intensity, float range);
+	// angles in radians, measured from the direction
+	Light MakeSpotLight(const glm::vec3& position, const glm::vec3& direction, const glm::vec3& color, float intensity, float range, float innerAngle, float outerAngle);
+
+	// Clustered forward lighting. The view frustum is split into froxels, CLUSTERS_X * CLUSTERS_Y
+	// screen tiles and CLUSTERS_Z exponential depth slices between zNear and zFar. A compute pass
+	// bins every light's range sphere into the clusters once per frame; fragment shaders look up
+	// their cluster through Lexvi/Lighting.glsl and only loop over the lights that can reach it.
+	class ClusteredLighting {
+	public:
+		static constexpr uint32_t CLUSTERS_X = 16;
+		static constexpr uint32_t CLUSTERS_Y = 9;
+		static constexpr uint32_t CLUSTERS_Z = 24;
+		static constexpr uint32_t CLUSTER_COUNT = CLUSTERS_X * CLUSTERS_Y * CLUSTERS_Z;
+		// lights past this in one cluster are dropped
+		static constexpr uint32_t MAX_LIGHTS_PER_CLUSTER = 128;
+		// size of the shared index list, in average lights per cluster
+		static constexpr uint32_t AVERAGE_LIGHTS_PER_CLUSTER = 32;
+
+	private:
+		// view space AABB, std430
+		struct ClusterBounds {
+			glm::vec4 min;
+			glm::vec4 max;
+		};
+
+		std::vector<Light> lights;
+		std::vector<uint32_t> lightHandles;   // [index, handle]
+		std::vector<uint32_t> handleToIndex;  // [handle, index]
+		std::vector<uint32_t> freeHandles;
+		bool lightsDirty = false;
+		uint32_t uploadedLightCount = 0; // what the lights SSBO and the bins hold since the last Update
+
+		// cluster bounds only depend on the projection
+		glm::mat4 boundsProjection{ 0.0f };
+
+		SSBO lightsSSBO{};
+		SSBO boundsSSBO{};
+		SSBO gridSSBO{};
+		SSBO indicesSSBO{};
+		SSBO counterSSBO{};
+
+		std::shared_ptr<ComputeShader> binShader;
+
+	public:
+		ClusteredLighting() = default;
+		~ClusteredLighting();
+		ClusteredLighting(const ClusteredLighting&) = delete;
+		ClusteredLighting& operator=(const ClusteredLighting&) = delete;
+
+		// Handles stay valid until RemoveLight
+		uint32_t AddLight(const Light& light);
+		void SetLight(uint32_t handle, const Light& light);
+		void RemoveLight(uint32_t handle);
+		void Clear();
+
+		const Light& getLight(uint32_t handle) const { return lights[handleToIndex[handle]]; }
+		uint32_t getLightCount() const { return static_cast<uint32_t>(lights.size()); }
+		// Lights in the SSBO as of the last Update, the bound for shaders that loop over all of them
+		uint32_t getUploadedLightCount() const { return uploadedLightCount; }
+
+		// Called by the renderer after the frame constants are bound, bins the lights for camera
+		void Update(const Camera& camera);
+
+		// GLSL for #include <Lexvi/Lighting.glsl>
+		static std::string GetGLSL();
+
+	private:
+		void createBuffers();
+		void buildClusterBounds(const glm::mat4& projection, float zNear, float zFar);
+	};
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <string>
+#include <glm/glm.hpp>
+
+#include "Renderer/ClusteredLighting.hpp"
+#include "Shader/ComputeShader.hpp"
+#include "Utils/FrameBuffer.hpp"
+
+namespace Lexvi {
+	struct DeferredShadingSettings {
+		glm::vec3 sunDirection = glm::normalize(glm::vec3(-0.3f, -1.0f, -0.2f)); // direction the light travels
+		glm::vec3 sunColor{ 1.0f };
+		float sunIntensity = 0.0f;          // 0 = no sun
+		bool sunShadows = false;            // samples Lexvi/Shadows.glsl, a CascadedShadowMap has to be rendered this frame
+		glm::vec3 ambient{ 0.03f };
+		glm::vec4 background{ 0.0f };       // written where nothing was drawn
+	};
+
+	// Deferred path for scenes with heavy overdraw and many lights. Geometry is drawn once into a
+	// compact G-buffer, 14 bytes per pixel:
+	//   0: RGBA8  albedo, ambient occlusion
+	//   1: RG16   octahedral world normal
+	//   2: RG8    roughness, metallic
+	//   depth32F, positions are rebuilt from it
+	// A compute pass then splits the screen into TILE_SIZE tiles, culls the lights of the
+	// ClusteredLighting set against each tile's depth range, and shades every pixel once into an
+	// RGBA16F output.
+	//
+	// Geometry shaders write the G-buffer through Lexvi/GBuffer.glsl. The buffers are sized for the
+	// largest render size, so dynamic resolution changes never reallocate them.
+	class DeferredShading {
+	public:
+		static constexpr uint32_t TILE_SIZE = 16;
+		// lights past this in one tile are dropped
+		static constexpr uint32_t MAX_LIGHTS_PER_TILE = 256;
+
+	private:
+		DeferredShadingSettings settings;
+
+		FrameBuffer gBuffer;
+		unsigned int output = 0;
+		FrameBuffer outputFramebuffer; // wraps output for Composite
+
+		uint32_t renderWidth = 0, renderHeight = 0;
+		uint32_t capacityWidth = 0, capacityHeight = 0;
+		uint32_t allocatedWidth = 0, allocatedHeight = 0;
+
+		std::shared_ptr<ComputeShader> resolveShader;
+		std::shared_ptr<ComputeShader> resolveShaderShadowed;
+
+	public:
+		DeferredShading() = default;
+		~DeferredShading();
+		DeferredShading(const DeferredShading&) = delete;
+		DeferredShading& operator=(const DeferredShading&) = delete;
+
+		DeferredShadingSettings& getSettings() { return settings; }
+
+		// Called by the renderer every frame, only records the sizes. Nothing is allocated until the
+		// first geometry pass, games that stay forward never pay for the G-buffer.
+		void Resize(uint32_t renderWidth, uint32_t renderHeight, uint32_t capacityWidth, uint32_t capacityHeight);
+
+		// Allocates the G-buffer at the current capacity if it isn't already, without binding or clearing it
+		void PrepareGBuffer();
+		// Binds and clears the G-buffer, draw opaque geometry with G-buffer shaders afterwards
+		void BeginGeometryPass();
+		// Lights the G-buffer into getOutput()
+		void Resolve(const ClusteredLighting& lighting);
+		// Copies the lit image into framebuffer, plus depth so forward passes (transparents) can follow.
+		// Depth is only copied when the formats match, e.g. the dynamic resolution scene target; the
+		// default framebuffer usually has a packed depth-stencil format.
+		void Composite(unsigned int framebuffer, bool copyDepth = true);
+
+		const FrameBuffer& getGBuffer() const { return gBuffer; }
+		unsigned int getOutput() const { return output; }
+		void getRenderSize(uint32_t& width, uint32_t& height) const { width = renderWidth; height = renderHeight; }
+
+		// Lexvi/GBufferPacking.glsl: normal encoding, usable from any stage
+		static std::string GetPackingGLSL();
+		// Lexvi/GBuffer.glsl: fragment outputs and LexviWriteGBuffer
+		static std::string GetGLSL();
+
+	private:
+		void allocate();
+		void deleteOutput();
+	};
+}
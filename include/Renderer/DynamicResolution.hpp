@@ -0,0 +1,82 @@
+#pragma once
+
+#include "Utils/FrameBuffer.hpp"
+
+namespace Lexvi {
+	struct DynamicResolutionSettings {
+		bool enabled = false;
+		float targetFrameTime = 16.0f;   // GPU milliseconds per frame
+		float minScale = 0.5f;           // per axis
+		float maxScale = 1.0f;
+		float increaseThreshold = 0.85f; // scale back up once the GPU stays under this fraction of the target
+		uint32_t increaseDelay = 30;     // frames under the threshold before each step up
+		float maxIncrease = 1.05f;       // largest step up, drops are as large as needed
+		float smoothing = 0.2f;          // weight of the newest frame time
+		uint32_t granularity = 8;        // render sizes are multiples of this
+	};
+
+	struct DynamicResolutionStats {
+		float gpuTime = 0.0f; // smoothed, milliseconds
+		float scale = 1.0f;
+		uint32_t width = 0, height = 0;
+	};
+
+	// Renders the scene into an internal target whose viewport shrinks when the GPU misses the frame
+	// budget and grows back when there is headroom, then upscales it to the window with a filtered blit.
+	// The attachments are allocated at the largest scale, so changing scale never reallocates; only a
+	// window resize does. GPU time comes from timestamp queries read a few frames late so they never stall.
+	//
+	// Scene shaders see the scaled size in lexviResolution. Passes sampling the scene target have to
+	// scale their coordinates by getScale(), the texture is larger than the part that was drawn.
+	class DynamicResolution {
+	private:
+		static constexpr uint32_t QUERY_LATENCY = 4;
+
+		DynamicResolutionSettings settings;
+		DynamicResolutionStats stats;
+
+		FrameBuffer target;
+		uint32_t capacityWidth = 0, capacityHeight = 0;
+		uint32_t windowWidth = 0, windowHeight = 0;
+		uint32_t renderWidth = 0, renderHeight = 0;
+		float scale = 1.0f;
+
+		unsigned int queries[QUERY_LATENCY][2]{};
+		bool queryPending[QUERY_LATENCY]{};
+		uint32_t frame = 0;
+		uint32_t ignoreSamples = 0; // frames still in flight at the previous scale
+		uint32_t framesUnderBudget = 0;
+		float smoothedTime = 0.0f;
+
+	public:
+		DynamicResolution() = default;
+		~DynamicResolution();
+
+		DynamicResolution(const DynamicResolution&) = delete;
+		DynamicResolution& operator=(const DynamicResolution&) = delete;
+
+		void setSettings(const DynamicResolutionSettings& newSettings);
+		const DynamicResolutionSettings& getSettings() const { return settings; }
+		const DynamicResolutionStats& getStats() const { return stats; }
+
+		// Called by the renderer: reads finished timers and picks this frame's render size
+		void BeginFrame(uint32_t windowWidth, uint32_t windowHeight);
+		// Binds the scene target with the scaled viewport, or the window while disabled
+		void BeginScene();
+		// Upscales to the default framebuffer and restores the window viewport
+		void EndScene();
+
+		void getRenderSize(uint32_t& width, uint32_t& height) const;
+		// Largest render size at the current settings, the window size while disabled
+		void getCapacity(uint32_t& width, uint32_t& height) const;
+		float getScale() const { return scale; }
+		// The framebuffer the scene is drawn into this frame, 0 while disabled
+		unsigned int getSceneFramebuffer() const;
+		const FrameBuffer& getTarget() const { return target; }
+
+	private:
+		void readTimers();
+		void updateScale(float frameTime);
+		void resize();
+	};
+}
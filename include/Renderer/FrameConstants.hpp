@@ -0,0 +1,35 @@
+#pragma once
+
+#include <string>
+#include <glm/glm.hpp>
+
+namespace Lexvi {
+	class Camera;
+	class ComputeShader;
+	struct CameraFrustum;
+
+	// std140 mirror of the LexviFrameConstants block, only vec4/mat4 members so the C++ layout matches
+	struct FrameConstants {
+		glm::mat4 view{ 1.0f };
+		glm::mat4 projection{ 1.0f };
+		glm::mat4 viewProjection{ 1.0f };
+		glm::vec4 cameraPosition{ 0.0f };  // xyz, w unused
+		glm::vec4 clipPlanes{ 0.0f };      // zNear, zFar, fov (radians), aspect
+		glm::vec4 frustumPlanes[6]{};      // left, right, bottom, top, near, far (normal.xyz, distance)
+		glm::vec4 time{ 0.0f };            // seconds since start, delta time, frame index, unused
+		glm::vec4 resolution{ 0.0f };      // width, height, 1/width, 1/height
+	};
+	static_assert(sizeof(FrameConstants) % 16 == 0, "FrameConstants must keep std140 alignment");
+
+	FrameConstants BuildFrameConstants(const Camera* camera, float time, float deltaTime, uint32_t frameIndex, uint32_t width, uint32_t height);
+
+	// GLSL declaration of the block, available to shaders as #include <Lexvi/FrameConstants.glsl>
+	std::string GetFrameConstantsGLSL();
+
+	// GLSL for #include <Lexvi/Culling.glsl>, for culling compute shaders. LexviCullPlane(i) is the
+	// frame's frustum plane unless a pass (e.g. a shadow cascade) set its own with SetCullFrustumUniforms;
+	// lexviCullFrustumOverride tells camera-only tests (cones, Hi-Z) to stay off.
+	std::string GetCullingGLSL();
+	// nullptr culls against the frame constants' frustum
+	void SetCullFrustumUniforms(const ComputeShader& shader, const CameraFrustum* frustum);
+}
@@ -0,0 +1,212 @@
+#pragma once
+
+#include <map>
+
+#include "Utils/FrameBuffer.hpp"
+
+namespace Lexvi {
+	// Handle to one version of a frame graph texture, every Write returns a new version
+	using FrameGraphResource = uint32_t;
+	constexpr FrameGraphResource INVALID_FRAME_GRAPH_RESOURCE = 0xFFFFFFFFu;
+
+	struct FrameGraphTextureDesc {
+		unsigned int width = 0;  // 0 = graph size * scale
+		unsigned int height = 0;
+		float scale = 1.0f;
+		GLenum format = GL_RGBA8;
+		unsigned int levels = 1;
+	};
+
+	enum class FrameGraphAccess : uint8_t {
+		Attachment, // colour or depth target of the pass framebuffer
+		Sampled,    // texture fetches
+		Storage     // image load / store, later accesses get a memory barrier
+	};
+
+	struct FrameGraphStats {
+		uint32_t passes = 0;
+		uint32_t culledPasses = 0;
+		uint32_t transientTextures = 0; // textures declared by passes
+		uint32_t physicalTextures = 0;  // pool textures they were aliased onto
+		uint32_t barriers = 0;          // glMemoryBarrier calls
+		size_t pooledBytes = 0;         // whole pool, including textures idle this frame
+	};
+
+	class FrameGraph;
+
+	// Passed to a pass' setup, declares what the pass reads and writes
+	class FrameGraphBuilder {
+	private:
+		FrameGraph& graph;
+		uint32_t pass;
+
+	public:
+		FrameGraphBuilder(FrameGraph& graph, uint32_t pass) : graph(graph), pass(pass) {};
+
+		// Transient texture, its contents are undefined until a pass writes it
+		FrameGraphResource Create(const std::string& name, const FrameGraphTextureDesc& desc);
+		FrameGraphResource Read(FrameGraphResource resource, FrameGraphAccess access = FrameGraphAccess::Sampled);
+		// Returns the new version later passes have to read. Writing a version another pass produced keeps
+		// its contents, e.g. for blending on top, so that pass is kept too.
+		FrameGraphResource Write(FrameGraphResource resource, FrameGraphAccess access = FrameGraphAccess::Attachment);
+		// The pass is never culled, e.g. it writes buffers the graph doesn't know about
+		void SideEffect();
+	};
+
+	// Passed to a pass' execute, resolves handles to the textures picked for this frame
+	class FrameGraphResources {
+	private:
+		const FrameGraph& graph;
+		uint32_t pass;
+
+	public:
+		FrameGraphResources(const FrameGraph& graph, uint32_t pass) : graph(graph), pass(pass) {};
+
+		unsigned int getTexture(FrameGraphResource resource) const;
+		void getSize(FrameGraphResource resource, unsigned int& width, unsigned int& height) const;
+		// The framebuffer of the pass' attachments, already bound with the viewport set, 0 without attachments
+		unsigned int getFramebuffer() const;
+	};
+
+	// Per frame graph of render passes. Passes declare the textures they read and write and are run in
+	// the order they were added; passes whose results nobody reads are culled. Transient textures come
+	// from a pool and are only held from their first to their last use, so textures with disjoint
+	// lifetimes and the same size and format share memory. Framebuffers for each set of attachments are
+	// cached, and memory barriers are inserted after image stores.
+	//
+	// Imported textures and the backbuffer are the outputs of the graph, passes writing them are kept.
+	class FrameGraph {
+	private:
+		struct PassExecutor {
+			virtual ~PassExecutor() = default;
+			virtual void Execute(const FrameGraphResources& resources) = 0;
+		};
+
+		template<typename Data, typename ExecuteFn>
+		struct Pass : PassExecutor {
+			Data data{};
+			ExecuteFn execute;
+
+			Pass(ExecuteFn&& execute) : execute(std::move(execute)) {};
+			void Execute(const FrameGraphResources& resources) override { execute(static_cast<const Data&>(data), resources); }
+		};
+
+		struct ResourceEntry {
+			std::string name;
+			FrameGraphTextureDesc desc;
+			unsigned int width = 0, height = 0;
+			unsigned int texture = 0;
+			bool imported = false;
+			bool backbuffer = false;
+			int32_t pooled = -1;
+			int32_t firstUse = -1, lastUse = -1;
+		};
+
+		// one version of a resource
+		struct ResourceNode {
+			uint32_t resource;
+			int32_t writer = -1;
+			uint32_t readCount = 0;
+		};
+
+		struct PassAccess {
+			FrameGraphResource node;
+			FrameGraphAccess access;
+		};
+
+		struct PassNode {
+			std::string name;
+			std::unique_ptr<PassExecutor> executor;
+			std::vector<PassAccess> reads;
+			std::vector<PassAccess> writes;
+			bool sideEffect = false;
+			bool culled = false;
+			uint32_t refCount = 0;
+			unsigned int framebuffer = 0;
+		};
+
+		struct PooledTexture {
+			unsigned int id = 0;
+			unsigned int width = 0, height = 0;
+			GLenum format = 0;
+			unsigned int levels = 1;
+			uint32_t lastUsedFrame = 0;
+			bool inUse = false;
+		};
+
+		// pool textures idle for this many frames are deleted
+		static constexpr uint32_t POOL_FRAMES = 3;
+
+		unsigned int width = 0, height = 0;
+		unsigned int backbufferFramebuffer = 0;
+		uint32_t frame = 0;
+		bool compiled = false;
+
+		std::vector<PassNode> passes;
+		std::vector<ResourceEntry> resources;
+		std::vector<ResourceNode> nodes;
+
+		std::vector<PooledTexture> pool;
+		// key: (texture, GLState texture generation) for the colours in attachment order, then the depth (0 for none)
+		std::map<std::vector<unsigned int>, FrameBuffer> framebuffers;
+		// barrier bits a texture still needs since its last image store
+		std::unordered_map<unsigned int, GLbitfield> pendingBarriers;
+
+		FrameGraphStats stats;
+
+		friend class FrameGraphBuilder;
+		friend class FrameGraphResources;
+
+	public:
+		FrameGraph() = default;
+		~FrameGraph();
+
+		FrameGraph(const FrameGraph&) = delete;
+		FrameGraph& operator=(const FrameGraph&) = delete;
+
+		// Drops last frame's passes, pooled textures are kept. Sizes of 0 in texture descs are relative to this.
+		// backbuffer is the framebuffer ImportBackbuffer writes to, e.g. a scaled scene target.
+		void BeginFrame(unsigned int width, unsigned int height, unsigned int backbuffer = 0);
+
+		// setup(FrameGraphBuilder&, Data&) runs now, execute(const Data&, const FrameGraphResources&) runs in Execute
+		template<typename Data, typename SetupFn, typename ExecuteFn>
+		const Data& AddPass(const std::string& name, SetupFn&& setup, ExecuteFn&& execute);
+
+		// The texture stays owned by the caller, desc has to give its real size. Delete it after
+		// GLState::ForgetTexture (FrameBuffer does) so framebuffers cached for it are dropped.
+		FrameGraphResource Import(const std::string& name, unsigned int texture, const FrameGraphTextureDesc& desc);
+		FrameGraphResource Import(const std::string& name, const FrameBuffer& frameBuffer, FrameBufferAttachments attachment, unsigned int number = 0);
+		FrameGraphResource ImportBackbuffer(const std::string& name = "Backbuffer");
+
+		// Culls unused passes and computes lifetimes, Execute calls it if needed
+		void Compile();
+		void Execute();
+
+		// Deletes every pooled texture and cached framebuffer
+		void ReleasePool();
+
+		const FrameGraphStats& getStats() const { return stats; }
+		const std::string& getName(FrameGraphResource resource) const { return resources[nodes[resource].resource].name; }
+
+	private:
+		uint32_t addPass(const std::string& name, std::unique_ptr<PassExecutor> executor);
+		FrameGraphResource addResource(ResourceEntry&& entry);
+
+		void acquire(ResourceEntry& entry);
+		void release(ResourceEntry& entry);
+		unsigned int getFramebuffer(PassNode& pass);
+		GLbitfield collectBarriers(const PassNode& pass);
+		void evictIdle();
+	};
+
+	template<typename Data, typename SetupFn, typename ExecuteFn>
+	const Data& FrameGraph::AddPass(const std::string& name, SetupFn&& setup, ExecuteFn&& execute)
+	{
+		auto pass = std::make_unique<Pass<Data, std::decay_t<ExecuteFn>>>(std::decay_t<ExecuteFn>(std::forward<ExecuteFn>(execute)));
+		Data& data = pass->data;
+
+		FrameGraphBuilder builder(*this, addPass(name, std::move(pass)));
+		setup(builder, data);
+		return data;
+	}
+}
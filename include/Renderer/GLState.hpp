@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstdint>
+
+namespace Lexvi {
+	struct GLStateStats {
+		uint32_t issued = 0;   // calls that reached the driver
+		uint32_t filtered = 0; // calls skipped because the state was already set
+	};
+
+	// Shadow copy of the GL binding state. All engine binding goes through here so
+	// redundant calls never reach the driver.
+	namespace GLState {
+		void UseProgram(unsigned int program);
+		void BindVertexArray(unsigned int vao);
+		void BindTextureUnit(unsigned int unit, unsigned int texture);
+		void BindFramebuffer(unsigned int fbo);
+
+		// GL_SHADER_STORAGE_BUFFER or GL_UNIFORM_BUFFER
+		void BindBufferBase(GLenum target, unsigned int index, unsigned int buffer);
+		void BindDrawIndirectBuffer(unsigned int buffer);
+		void BindDispatchIndirectBuffer(unsigned int buffer);
+		void BindParameterBuffer(unsigned int buffer); // draw count for glMultiDraw*IndirectCount
+
+		void SetCullFace(bool enabled);
+		void SetCullMode(GLenum face);
+		void SetFrontFace(GLenum mode);
+		void SetBlend(bool enabled);
+		void SetBlendFunc(GLenum src, GLenum dst);
+		void SetDepthTest(bool enabled);
+		void SetDepthWrite(bool enabled);
+		void SetDepthFunc(GLenum func);
+
+		// Objects are forgotten on delete, GL may hand the same name out again
+		void ForgetProgram(unsigned int program);
+		void ForgetVertexArray(unsigned int vao);
+		void ForgetTexture(unsigned int texture);
+		void ForgetBuffer(unsigned int buffer);
+		void ForgetFramebuffer(unsigned int fbo);
+		// Bumped by ForgetTexture, tells caches keyed on texture names a reused name from the texture they saw
+		uint32_t GetTextureGeneration(unsigned int texture);
+
+		// Marks everything unknown, call after code outside the engine touched GL state
+		void Invalidate();
+
+		// Called by the engine at the start of every frame
+		void BeginFrame();
+		const GLStateStats& GetFrameStats(); // last completed frame
+	}
+}
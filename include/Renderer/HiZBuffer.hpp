@@ -0,0 +1,52 @@
+#pragma once
+
+#include <string>
+#include <glm/glm.hpp>
+
+#include "Shader/ComputeShader.hpp"
+
+namespace Lexvi {
+	// Max-depth mip pyramid of a frame's depth buffer for occlusion culling. Each texel holds the
+	// farthest depth below it, so something whose nearest depth lies beyond it is hidden there.
+	// The renderer builds it at the end of a frame, culling passes of the next frame test against it
+	// with the view-projection it was drawn with. Occluders that moved in between can let objects pop
+	// in a frame late, static geometry is exact.
+	//
+	// Compute shaders test world space spheres through Lexvi/HiZ.glsl after Bind.
+	class HiZBuffer {
+	private:
+		bool enabled = false;
+		bool valid = false;
+
+		unsigned int texture = 0;
+		uint32_t allocatedWidth = 0, allocatedHeight = 0;
+		uint32_t levels = 0;
+		uint32_t width = 0, height = 0; // part of level 0 built this frame
+		glm::mat4 viewProjection{ 1.0f };
+
+		std::shared_ptr<ComputeShader> copyShader;
+		std::shared_ptr<ComputeShader> reduceShader;
+
+	public:
+		HiZBuffer() = default;
+		~HiZBuffer();
+		HiZBuffer(const HiZBuffer&) = delete;
+		HiZBuffer& operator=(const HiZBuffer&) = delete;
+
+		// Off by default, the renderer only builds the pyramid while something culls against it
+		void setEnabled(bool enable) { enabled = enable; if (!enable) valid = false; }
+		bool isEnabled() const { return enabled; }
+		// False until the first Build, and after a frame without depth to build from
+		bool isValid() const { return valid; }
+
+		// Reduces the [0, width) x [0, height) part of depthTexture (textureWidth x textureHeight) drawn with viewProjection
+		void Build(unsigned int depthTexture, uint32_t textureWidth, uint32_t textureHeight, uint32_t width, uint32_t height, const glm::mat4& viewProjection);
+		void Invalidate() { valid = false; }
+
+		// Binds the pyramid to BindingPoints::HiZUnit and sets shader's Lexvi/HiZ.glsl uniforms
+		void Bind(const ComputeShader& shader) const;
+
+		// GLSL for Lexvi/HiZ.glsl: bool LexviHiZOccluded(vec4 worldSphere)
+		static std::string GetGLSL();
+	};
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+#include <unordered_map>
+
+#include "Shader/Shader.hpp"
+#include "Textures/Textures.hpp"
+#include "Utils/UBO.hpp"
+
+namespace Lexvi {
+	// std140 mirror of the LexviMaterialParams block
+	struct MaterialParams {
+		glm::vec4 baseColor{ 1.0f };
+		glm::vec4 emissive{ 0.0f };
+		glm::vec4 factors{ 1.0f, 0.0f, 1.0f, 0.5f }; // roughness, metallic, ao, alpha cutoff
+	};
+	static_assert(sizeof(MaterialParams) % 16 == 0, "MaterialParams must keep std140 alignment");
+
+	// Textures and parameters resolved once into a binding table. Sampler uniforms
+	// ("material.texture_diffuse1", ...) are written into each program the first time the material
+	// is bound with it, after that Bind only binds texture units and the parameter block.
+	class Material {
+	private:
+		struct TextureBinding {
+			uint32_t unit;
+			unsigned int texture;
+		};
+
+		struct SamplerBinding {
+			std::string uniform;
+			int unit;
+		};
+
+		uint32_t id = 0;
+		uint64_t key = 0;
+		std::vector<TextureBinding> textureBindings;
+		std::vector<SamplerBinding> samplerBindings;
+		std::vector<unsigned int> preparedPrograms;
+
+		MaterialParams params{};
+		UBO paramsUBO{};
+
+	public:
+		Material(uint32_t id, const std::vector<Texture>& textures, const MaterialParams& params);
+		~Material();
+		Material(const Material&) = delete;
+		Material& operator=(const Material&) = delete;
+
+		void Bind(const Shader& shader);
+
+		void setParams(const MaterialParams& newParams);
+		const MaterialParams& getParams() const { return params; }
+
+		// Small sequential id, use it as SubmitInfo::material so draws sort by material
+		uint32_t getID() const { return id; }
+		uint64_t getKey() const { return key; }
+
+		static uint64_t MakeKey(const std::vector<Texture>& textures, const MaterialParams& params);
+
+	private:
+		void prepare(const Shader& shader);
+	};
+
+	// Deduplicates materials: meshes with the same textures and parameters share one Material
+	class MaterialLibrary {
+	private:
+		std::unordered_map<uint64_t, std::shared_ptr<Material>> materials;
+		uint32_t nextID = 1;
+
+	public:
+		std::shared_ptr<Material> GetMaterial(const std::vector<Texture>& textures, const MaterialParams& params = {});
+		size_t size() const { return materials.size(); }
+		void Clear();
+	};
+
+	// Engine wide library, materials are created on first use (needs a GL context)
+	MaterialLibrary& GetMaterialLibrary();
+
+	// GLSL declaration of the parameter block, available to shaders as #include <Lexvi/Material.glsl>
+	std::string GetMaterialGLSL();
+}
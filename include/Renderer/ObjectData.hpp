@@ -0,0 +1,24 @@
+#pragma once
+
+#include <string>
+#include <glm/glm.hpp>
+
+namespace Lexvi {
+	// std430 mirror of one entry of the LexviObjectData block
+	struct ObjectData {
+		glm::mat4 model{ 1.0f };
+		glm::mat4 normalMatrix{ 1.0f }; // inverse transpose of model, kept as mat4 to avoid std430 mat3 padding
+		glm::uvec4 indices{ 0u };       // material, unused, unused, unused
+		glm::vec4 params{ 0.0f };       // free for game shaders (SubmitInfo::params)
+	};
+	static_assert(sizeof(ObjectData) % 16 == 0, "ObjectData must keep std430 alignment");
+
+	ObjectData BuildObjectData(const glm::mat4& model, uint32_t material, const glm::vec4& params);
+
+	// GLSL declaration of the block, available to shaders as #include <Lexvi/ObjectData.glsl>.
+	// Every draw the renderer issues for such a shader sets gl_BaseInstance to the object's entry (the
+	// lexviObjectBase uniform for renderables without an instanced path), vertex shaders read it
+	// through LEXVI_OBJECT_INDEX and pass it on as a flat varying. Compiled with LEXVI_MODEL_BATCH
+	// defined it reads ModelBatch's own block instead, so batches and queued draws never share a binding.
+	std::string GetObjectDataGLSL();
+}
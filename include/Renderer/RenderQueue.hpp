@@ -0,0 +1,111 @@
+#pragma once
+
+#include "Shader/Shader.hpp"
+#include "Camera/Camera.hpp"
+#include "Renderable/IRenderable/IRenderable.hpp"
+#include "Renderer/ObjectData.hpp"
+#include "Utils/IndirectBuffer.hpp"
+
+namespace Lexvi {
+	struct SubmitInfo {
+		uint8_t pass = 0;          // 0-15, lower passes are drawn first
+		bool translucent = false;  // drawn back to front after the opaques of the same pass
+		uint32_t material = 0;     // user id, draws sharing a material are kept together
+		glm::vec4 params{ 0.0f };  // copied to ObjectData::params
+	};
+
+	struct RenderQueueStats {
+		uint32_t submitted = 0;
+		uint32_t culled = 0;
+		uint32_t drawn = 0;
+		uint32_t drawCalls = 0;
+		uint32_t instancedBatches = 0; // draw calls covering more than one object
+		uint32_t multiDraws = 0;       // multi-draw indirect calls merging more than one command
+		uint32_t programChanges = 0;
+	};
+
+	// Per-frame list of draws, sorted by a 64 bit key before being issued.
+	//
+	// Key layout, most significant first:
+	//   opaque:      pass(4) | 0 | program(12) | material(12) | geometry(11) | depth(24)
+	//   translucent: pass(4) | 1 | ~depth(24)  | program(12) | material(12) | geometry(11)
+	//
+	// Ids are truncated to fit, a collision only costs a redundant state change since
+	// the flush compares the real objects and GLState filters repeated binds.
+	//
+	// Programs that declare the LexviObjectData block get no per-draw uniforms: every object's
+	// ObjectData is written to one per-flush SSBO and found through gl_BaseInstance. Runs of objects
+	// with the same geometry id become one instanced draw, and runs on the same VAO are merged into
+	// one glMultiDrawElementsIndirect. Other programs get the "model" uniform and one draw per object.
+	class RenderQueue {
+	private:
+		struct Item {
+			IRenderable* object;
+			const Shader* shader;
+			uint32_t material;
+			glm::vec4 params;
+		};
+
+		struct DrawOp {
+			enum Type : uint8_t { Single, Instanced, MultiDraw };
+			Type type = Single;
+			uint32_t first = 0;         // sorted range of objects covered by the op
+			uint32_t end = 0;
+			uint32_t baseInstance = 0;  // first ObjectData entry
+			unsigned int vao = 0;
+			uint32_t firstCommand = 0;
+			uint32_t commandCount = 0;
+		};
+
+		std::vector<Item> items;
+		std::vector<uint64_t> keys;
+		std::vector<uint32_t> order;
+
+		// radix sort scratch, kept between frames
+		std::vector<uint64_t> keysScratch;
+		std::vector<uint32_t> orderScratch;
+
+		std::vector<DrawOp> ops;
+		std::vector<ObjectData> objectData;
+		std::vector<DrawElementsIndirectCommand> commands;
+
+		unsigned int objectDataBuffer = 0;
+		size_t objectDataCapacity = 0;
+		unsigned int commandBuffer = 0;
+		size_t commandCapacity = 0;
+
+		std::unordered_map<unsigned int, bool> objectDataPrograms; // program -> declares the LexviObjectData block
+
+		RenderQueueStats stats;
+		RenderQueueStats lastStats;
+
+	public:
+		RenderQueue() = default;
+		~RenderQueue();
+		RenderQueue(const RenderQueue&) = delete;
+		RenderQueue& operator=(const RenderQueue&) = delete;
+
+		void Submit(IRenderable& obj, const Shader* shader, const Camera& camera, const SubmitInfo& info);
+		// For objects the caller already culled (e.g. with a BatchCuller), skips isVisible
+		void SubmitVisible(IRenderable& obj, const Shader* shader, const Camera& camera, const SubmitInfo& info);
+		// Counts objects culled outside the queue so the stats stay complete
+		void AddCulled(uint32_t count) { stats.submitted += count; stats.culled += count; }
+
+		// Sorts and issues every submitted draw, then empties the queue
+		void Flush();
+
+		size_t size() const { return items.size(); }
+		const RenderQueueStats& getStats() const { return lastStats; }
+
+		static uint64_t MakeKey(const SubmitInfo& info, unsigned int program, unsigned int geometry, float depth);
+		// true if the program declares the LexviObjectData block, cached per program
+		bool usesObjectData(const Shader* shader);
+
+	private:
+		void Sort();
+		// end of the run of objects starting at sorted index first that can share one instanced draw
+		size_t findBatchEnd(size_t first) const;
+		// groups the sorted objects into draws and uploads their object data and indirect commands
+		void buildDrawOps();
+	};
+}
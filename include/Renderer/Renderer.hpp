@@ -3,6 +3,18 @@
 #include "Shader/Shader.hpp"
 #include "Camera/Camera.hpp"
 #include "Renderable/IRenderable/IRenderable.hpp"
+#include "Renderer/FrameConstants.hpp"
+#include "Renderer/RenderQueue.hpp"
+#include "Renderer/BatchCuller.hpp"
+#include "Renderer/SpatialIndex.hpp"
+#include "Renderer/ClusteredLighting.hpp"
+#include "Renderer/FrameGraph.hpp"
+#include "Renderer/DynamicResolution.hpp"
+#include "Renderer/DeferredShading.hpp"
+#include "Renderer/VisibilityBuffer.hpp"
+#include "Renderer/HiZBuffer.hpp"
+#include "Utils/UBO.hpp"
+#include "Utils/SSBO.hpp"
 
 namespace Lexvi {
 	class Renderer
@@ -11,15 +23,87 @@ namespace Lexvi {
 		Shader* defaultShader = nullptr;
 		using Renderable_Shader = std::pair< std::shared_ptr<IRenderable>, std::shared_ptr<Shader>>;
 
+	private:
+		UBO frameConstantsUBO{};
+		FrameConstants frameConstants{};
+		uint32_t frameIndex = 0;
+
+		RenderQueue renderQueue;
+
+		// Draw(vector) scratch, kept between calls
+		struct DrawEntry {
+			IRenderable* object;
+			const Shader* shader;
+		};
+		struct DrawGroup {
+			uint32_t first = 0;        // range of drawEntries covered by the group
+			uint32_t end = 0;
+			uint32_t baseInstance = 0; // first ObjectData entry
+			bool objectData = false;
+		};
+		std::vector<DrawEntry> drawEntries;
+		std::vector<DrawGroup> drawGroups;
+		std::vector<ObjectData> drawObjectData;
+		SSBO drawObjectDataSSBO{};
+		RenderQueueStats drawStats;
+
+		ClusteredLighting lighting;
+		FrameGraph frameGraph;
+		DynamicResolution dynamicResolution;
+		DeferredShading deferredShading;
+		VisibilityBuffer visibilityBuffer;
+		HiZBuffer hiZ;
+
 	public:
 		Renderer() = default;
+		~Renderer();
+
+		// Called by the engine once the GL context exists
+		void Init();
+		// Called by the engine once per frame, uploads the shared frame constants UBO and binds the scene target
+		void BeginFrame(const Camera* camera, float time, float deltaTime, uint32_t width, uint32_t height);
+		// Called by the engine after Flush, builds the Hi-Z pyramid and upscales the scene to the window
+		void EndFrame();
+		const FrameConstants& getFrameConstants() const;
+
+		// Lights added here are binned every BeginFrame, shaders read them through Lexvi/Lighting.glsl
+		ClusteredLighting& getLighting();
+		// Reset every BeginFrame to the screen size, passes added during Game::render run on Execute
+		FrameGraph& getFrameGraph();
+		// The scene is drawn at the size in lexviResolution, bind getSceneFramebuffer() instead of 0
+		DynamicResolution& getDynamicResolution();
+		// Opaque geometry into the G-buffer, then Resolve with getLighting() and Composite into the scene framebuffer
+		DeferredShading& getDeferredShading();
+		// Alternative to the geometry pass for instanced geometry: AddDraw, Render and Resolve into the
+		// deferred G-buffer, then light it as usual. Draws are dropped every BeginFrame.
+		VisibilityBuffer& getVisibilityBuffer();
+		// Once enabled, rebuilt every EndFrame from the scene target's depth for the next frame's
+		// occlusion culling (e.g. ModelBatch). Stays invalid while dynamic resolution is disabled, the
+		// default framebuffer's depth can't be sampled.
+		HiZBuffer& getHiZ();
 
 		void setDefaultShader(Shader* shader);
 
 		void Draw(IRenderable& obj, const Camera& camera, const Shader* shader = nullptr) const;
-		void Draw(std::vector<Renderable_Shader>& objects, const Camera& camera) const;
+		// Drawn in order with the current blend state, Submit to get sorting instead. Consecutive objects
+		// with the same shader and geometry id become one instanced draw when the shader declares the
+		// LexviObjectData block, everything else is drawn one object at a time.
+		void Draw(std::vector<Renderable_Shader>& objects, const Camera& camera);
 		void Draw(std::vector<IRenderable>& objects, const Camera& camera, const Shader* shader = nullptr) const;
 
+		// Deferred drawing: submitted objects are culled, sorted by state and depth, and drawn on Flush.
+		// The object must stay alive until then.
+		void Submit(IRenderable& obj, const Camera& camera, const Shader* shader = nullptr, const SubmitInfo& info = {});
+		// Submits objects[i] for every visible bit of a culler that was Cull()ed against this camera
+		void Submit(const std::vector<IRenderable*>& objects, const BatchCuller& culler, const Camera& camera, const Shader* shader = nullptr, const SubmitInfo& info = {});
+		// Submits the whole-object leaves of index that intersect the camera frustum
+		void Submit(const SpatialIndex& index, const Camera& camera, const Shader* shader = nullptr, const SubmitInfo& info = {});
+		// Called by the engine after Game::render
+		void Flush();
+		const RenderQueueStats& getRenderQueueStats() const;
+		// Of the last Draw(vector) call
+		const RenderQueueStats& getDrawStats() const;
+
 		void DisableBackFaceCulling();
 		void EnableBackFaceCulling();
 		void SetBackFace(bool CW);
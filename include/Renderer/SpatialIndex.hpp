@@ -0,0 +1,247 @@
+#pragma once
+
+#include "Camera/Camera.hpp"
+#include "Renderable/IRenderable/IRenderable.hpp"
+
+namespace Lexvi {
+	// Dynamic AABB tree over scene bounds. Leaves store a box enlarged by a margin so small movements
+	// don't touch the tree, new leaves are placed by the surface area heuristic and the tree is kept
+	// balanced with rotations. Queries are conservative: they test the enlarged boxes.
+	//
+	// A leaf is either a whole renderable (userIndex == WHOLE_OBJECT) or one element of it, e.g. a
+	// sub-instance of an InstanceSystem, identified by userIndex.
+	class SpatialIndex {
+	public:
+		static constexpr int32_t NULL_NODE = -1;
+		static constexpr uint32_t WHOLE_OBJECT = 0xFFFFFFFFu;
+
+	private:
+		struct Node {
+			CameraAABB box;
+			int32_t parent = NULL_NODE; // next free node while unused
+			int32_t child1 = NULL_NODE;
+			int32_t child2 = NULL_NODE;
+			int32_t height = -1;        // 0 = leaf, -1 = unused
+			IRenderable* object = nullptr;
+			uint32_t userIndex = WHOLE_OBJECT;
+
+			bool isLeaf() const { return child1 == NULL_NODE; }
+		};
+
+		// traversal entries kept on the stack, deeper trees (before rebalancing catches up) spill to the heap
+		static constexpr int MAX_STACK = 128;
+
+		std::vector<Node> nodes;
+		int32_t root = NULL_NODE;
+		int32_t freeList = NULL_NODE;
+		uint32_t leafCount = 0;
+		uint32_t objectCount = 0;
+		float margin;
+
+	public:
+		explicit SpatialIndex(float margin = 0.1f) : margin(margin) {};
+
+		// Returns a proxy that stays valid until Remove
+		int32_t Insert(const CameraAABB& box, IRenderable* object, uint32_t userIndex = WHOLE_OBJECT);
+		int32_t Insert(IRenderable& object) { return Insert(object.getBoundBox(), &object); }
+		void Remove(int32_t proxy);
+
+		// Returns true if the leaf had to be reinserted
+		bool Move(int32_t proxy, const CameraAABB& box);
+		bool Update(int32_t proxy) { return Move(proxy, nodes[proxy].object->getBoundBox()); }
+		void Clear();
+
+		IRenderable* getObject(int32_t proxy) const { return nodes[proxy].object; }
+		uint32_t getUserIndex(int32_t proxy) const { return nodes[proxy].userIndex; }
+		const CameraAABB& getFatBox(int32_t proxy) const { return nodes[proxy].box; }
+
+		uint32_t size() const { return leafCount; }
+		uint32_t getObjectCount() const { return objectCount; } // WHOLE_OBJECT leaves
+		int32_t getHeight() const { return root == NULL_NODE ? 0 : nodes[root].height; }
+
+		// callback(proxy) returns false to stop the query
+		template<typename Callback>
+		void QueryAABB(const CameraAABB& box, Callback&& callback) const;
+		template<typename Callback>
+		void QuerySphere(const glm::vec3& center, float radius, Callback&& callback) const;
+		// Subtrees fully inside the frustum are reported without testing their leaves
+		template<typename Callback>
+		void QueryFrustum(const CameraFrustum& frustum, Callback&& callback) const;
+		// callback(proxy, maxDistance) returns the distance to clip the ray to: maxDistance to continue,
+		// the hit distance for closest hit queries, 0 to stop. direction has to be normalised.
+		template<typename Callback>
+		void Raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, Callback&& callback) const;
+
+	private:
+		int32_t allocateNode();
+		void freeNode(int32_t index);
+		void insertLeaf(int32_t leaf);
+		void removeLeaf(int32_t leaf);
+		int32_t balance(int32_t index);
+	};
+
+	namespace SpatialIndexDetail {
+		// LIFO that lives on the stack up to N entries and continues on the heap past it
+		template<typename T, int N>
+		class TraversalStack {
+		private:
+			T local[N];
+			std::vector<T> overflow;
+			int count = 0;
+
+		public:
+			void push(const T& value) {
+				if (count < N) local[count] = value;
+				else overflow.push_back(value);
+				++count;
+			}
+
+			T pop() {
+				--count;
+				if (count < N) return local[count];
+				T value = overflow.back();
+				overflow.pop_back();
+				return value;
+			}
+
+			bool empty() const { return count == 0; }
+		};
+
+		inline bool Overlaps(const CameraAABB& a, const CameraAABB& b) {
+			return glm::all(glm::lessThanEqual(a.min, b.max)) && glm::all(glm::lessThanEqual(b.min, a.max));
+		}
+
+		inline float DistanceSquared(const CameraAABB& box, const glm::vec3& point) {
+			glm::vec3 d = glm::max(glm::max(box.min - point, point - box.max), glm::vec3(0.0f));
+			return glm::dot(d, d);
+		}
+
+		// Slab test, returns the entry distance or -1 on a miss
+		inline float RayEntry(const CameraAABB& box, const glm::vec3& origin, const glm::vec3& inverseDirection, float maxDistance) {
+			glm::vec3 t0 = (box.min - origin) * inverseDirection;
+			glm::vec3 t1 = (box.max - origin) * inverseDirection;
+			glm::vec3 tMin = glm::min(t0, t1);
+			glm::vec3 tMax = glm::max(t0, t1);
+			float enter = std::max(std::max(tMin.x, tMin.y), std::max(tMin.z, 0.0f));
+			float exit = std::min(std::min(tMax.x, tMax.y), std::min(tMax.z, maxDistance));
+			return enter <= exit ? enter : -1.0f;
+		}
+	}
+
+	template<typename Callback>
+	void SpatialIndex::QueryAABB(const CameraAABB& box, Callback&& callback) const
+	{
+		if (root == NULL_NODE) return;
+
+		SpatialIndexDetail::TraversalStack<int32_t, MAX_STACK> stack;
+		stack.push(root);
+
+		while (!stack.empty()) {
+			const Node& node = nodes[stack.pop()];
+			if (!SpatialIndexDetail::Overlaps(node.box, box)) continue;
+
+			if (node.isLeaf()) {
+				if (!callback(static_cast<int32_t>(&node - nodes.data()))) return;
+			}
+			else {
+				stack.push(node.child1);
+				stack.push(node.child2);
+			}
+		}
+	}
+
+	template<typename Callback>
+	void SpatialIndex::QuerySphere(const glm::vec3& center, float radius, Callback&& callback) const
+	{
+		if (root == NULL_NODE) return;
+
+		float radiusSquared = radius * radius;
+		SpatialIndexDetail::TraversalStack<int32_t, MAX_STACK> stack;
+		stack.push(root);
+
+		while (!stack.empty()) {
+			const Node& node = nodes[stack.pop()];
+			if (SpatialIndexDetail::DistanceSquared(node.box, center) > radiusSquared) continue;
+
+			if (node.isLeaf()) {
+				if (!callback(static_cast<int32_t>(&node - nodes.data()))) return;
+			}
+			else {
+				stack.push(node.child1);
+				stack.push(node.child2);
+			}
+		}
+	}
+
+	template<typename Callback>
+	void SpatialIndex::QueryFrustum(const CameraFrustum& frustum, Callback&& callback) const
+	{
+		if (root == NULL_NODE) return;
+
+		// planes still to test per node, a parent fully inside a plane clears its bit for the subtree
+		struct Entry { int32_t node; uint8_t planes; };
+		SpatialIndexDetail::TraversalStack<Entry, MAX_STACK> stack;
+		stack.push({ root, 0x3F });
+
+		while (!stack.empty()) {
+			Entry entry = stack.pop();
+			const Node& node = nodes[entry.node];
+
+			uint8_t planes = entry.planes;
+			bool outside = false;
+			for (int i = 0; i < 6 && planes; ++i) {
+				if (!(planes & (1 << i))) continue;
+				const CameraPlane& plane = frustum.planes[i];
+
+				glm::vec3 positive = glm::mix(node.box.min, node.box.max, glm::greaterThanEqual(plane.normal, glm::vec3(0.0f)));
+				if (plane.getSignedDistanceToPlane(positive) < 0.0f) {
+					outside = true;
+					break;
+				}
+				glm::vec3 negative = glm::mix(node.box.max, node.box.min, glm::greaterThanEqual(plane.normal, glm::vec3(0.0f)));
+				if (plane.getSignedDistanceToPlane(negative) >= 0.0f) planes &= ~(1 << i);
+			}
+			if (outside) continue;
+
+			if (node.isLeaf()) {
+				if (!callback(entry.node)) return;
+			}
+			else {
+				stack.push({ node.child1, planes });
+				stack.push({ node.child2, planes });
+			}
+		}
+	}
+
+	template<typename Callback>
+	void SpatialIndex::Raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, Callback&& callback) const
+	{
+		if (root == NULL_NODE) return;
+
+		glm::vec3 inverseDirection = 1.0f / direction;
+		SpatialIndexDetail::TraversalStack<int32_t, MAX_STACK> stack;
+		stack.push(root);
+
+		while (!stack.empty()) {
+			int32_t index = stack.pop();
+			const Node& node = nodes[index];
+			if (SpatialIndexDetail::RayEntry(node.box, origin, inverseDirection, maxDistance) < 0.0f) continue;
+
+			if (node.isLeaf()) {
+				maxDistance = callback(index, maxDistance);
+				if (maxDistance <= 0.0f) return;
+				continue;
+			}
+
+			// nearer child on top so closest hit queries clip the ray early
+			float t1 = SpatialIndexDetail::RayEntry(nodes[node.child1].box, origin, inverseDirection, maxDistance);
+			float t2 = SpatialIndexDetail::RayEntry(nodes[node.child2].box, origin, inverseDirection, maxDistance);
+			if (t1 >= 0.0f && t2 >= 0.0f) {
+				stack.push(t1 < t2 ? node.child2 : node.child1);
+				stack.push(t1 < t2 ? node.child1 : node.child2);
+			}
+			else if (t1 >= 0.0f) stack.push(node.child1);
+			else if (t2 >= 0.0f) stack.push(node.child2);
+		}
+	}
+}
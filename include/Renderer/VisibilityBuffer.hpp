@@ -0,0 +1,110 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "Renderable/IRenderable/IRenderable.hpp"
+#include "Renderer/DeferredShading.hpp"
+#include "Shader/ComputeShader.hpp"
+#include "Shader/Shader.hpp"
+#include "Utils/FrameBuffer.hpp"
+
+namespace Lexvi {
+	// Byte offsets into one interleaved vertex, positions and normals are 3 floats. The raster pass
+	// reads the position from attribute 0 of the renderable's VAO.
+	struct VisibilityVertexLayout {
+		static constexpr uint32_t NONE = 0xFFFFFFFFu;
+
+		uint32_t stride = 0;
+		uint32_t positionOffset = 0;
+		uint32_t normalOffset = NONE; // NONE = flat face normals
+	};
+
+	// Everything the resolve needs to rebuild a triangle from its id: the draw's buffers are read
+	// back as SSBOs, instances come from the list the renderable's culling wrote this frame.
+	struct VisibilityDrawDesc {
+		unsigned int vbo = 0;
+		unsigned int ebo = 0;                 // GL_UNSIGNED_INT indices, firstIndex and baseVertex 0
+		uint32_t indexCount = 0;
+		VisibilityVertexLayout layout;
+		unsigned int visibleInstances = 0;    // SSBO of { mat4 model; vec4 extra; } indexed by gl_InstanceID
+
+		// GLSL defining void LexviVisibilityMaterial(inout LexviVisibilitySurface surface). The surface
+		// arrives with worldPosition, worldNormal, barycentrics, triangle, instance and instanceData set
+		// and albedo, roughness, metallic, occlusion preset to the default, empty = keep the default.
+		std::string material;
+	};
+
+	struct VisibilityBufferStats {
+		uint32_t draws = 0;
+		uint32_t droppedDraws = 0; // past MAX_DRAWS or with too many triangles for the id
+	};
+
+	// Visibility-buffer path for dense, instanced geometry. The raster pass writes only depth and
+	// one 32-bit id per pixel:
+	//   bits 28-31  draw
+	//   the rest    instance << triangleBits | gl_PrimitiveID, split per draw by its triangle count
+	// Resolve then bins the covered pixels by draw and runs one compute pass per draw over exactly
+	// its pixels, rebuilding the triangle from the index and vertex buffers, interpolating it with
+	// ray barycentrics and writing the result into the DeferredShading G-buffer. Overdraw costs one
+	// uint write instead of a full material evaluation, and lighting stays DeferredShading::Resolve.
+	//
+	// Draws are registered every frame before Render, the renderable must cull itself into
+	// visibleInstances during Draw (InstanceSystem::getVisibilityDraw fills the descriptor).
+	class VisibilityBuffer {
+	public:
+		// draw id 15 is reserved so the clear value never matches a real pixel
+		static constexpr uint32_t MAX_DRAWS = 15;
+		static constexpr uint32_t EMPTY = 0xFFFFFFFFu;
+
+	private:
+		struct Draw {
+			IRenderable* object = nullptr;
+			VisibilityDrawDesc desc;
+			uint32_t triangleBits = 0;
+			std::shared_ptr<ComputeShader> materialShader;
+		};
+
+		std::vector<Draw> draws;
+		VisibilityBufferStats stats;
+
+		unsigned int visibility = 0;  // R32UI at the G-buffer capacity
+		FrameBuffer framebuffer;      // visibility + the G-buffer depth
+		unsigned int allocatedDepth = 0;
+		uint32_t allocatedWidth = 0, allocatedHeight = 0;
+
+		unsigned int binBuffer = 0;   // counts, offsets, cursors and indirect commands per draw
+		unsigned int pixelBuffer = 0; // covered pixels sorted by draw
+		size_t pixelCapacity = 0;
+
+		std::shared_ptr<Shader> rasterShader;
+		std::shared_ptr<ComputeShader> countShader;
+		std::shared_ptr<ComputeShader> prefixShader;
+		std::shared_ptr<ComputeShader> scatterShader;
+		std::unordered_map<std::string, std::shared_ptr<ComputeShader>> materialShaders;
+
+	public:
+		VisibilityBuffer() = default;
+		~VisibilityBuffer();
+		VisibilityBuffer(const VisibilityBuffer&) = delete;
+		VisibilityBuffer& operator=(const VisibilityBuffer&) = delete;
+
+		// Drops last frame's draws
+		void Begin();
+		// Returns false if the draw can't be encoded, it is then skipped this frame
+		bool AddDraw(IRenderable& object, const VisibilityDrawDesc& desc);
+
+		// Rasterises the ids and the G-buffer depth
+		void Render(DeferredShading& deferred);
+		// Evaluates the materials into the G-buffer, follow with DeferredShading::Resolve
+		void Resolve(DeferredShading& deferred);
+
+		const VisibilityBufferStats& getStats() const { return stats; }
+		unsigned int getVisibility() const { return visibility; }
+
+	private:
+		void allocate(const DeferredShading& deferred);
+		void deleteResources();
+		std::shared_ptr<ComputeShader> getMaterialShader(const std::string& material, bool hasNormals);
+	};
+}
@@ -1,20 +1,33 @@
 #pragma once
 
 namespace Lexvi {
+    // GL_MAX_COMPUTE_WORK_GROUP_COUNT, queried once
+    glm::uvec3 GetMaxComputeWorkGroupCount();
+
     class ComputeShader
     {
     public:
         ComputeShader() = default;
+        // wraps an already linked program (see ShaderCache)
+        explicit ComputeShader(unsigned int programID);
         ComputeShader(std::string src, bool isFromFile = true);
 
         void use() const;
 
     private:
         void checkCompileErrors(unsigned int shader, std::string type);
+        void reflectWorkGroupSize();
 
     public:
         unsigned int ID;
 
+    private:
+        // local_size_x/y/z declared by the shader, read back after linking
+        glm::uvec3 localSize{ 1, 1, 1 };
+
+    public:
+        glm::uvec3 getLocalSize() const { return localSize; };
+
     public:
         void setBool(const std::string& name, bool value) const;
         void setInt(const std::string& name, int value) const;
@@ -23,6 +36,7 @@ namespace Lexvi {
         void setVec2(const std::string& name, const glm::vec2& value) const;
         void setVec2(const std::string& name, float x, float y) const;
         void setVec3(const std::string& name, const glm::vec3& value) const;
+        void setiVec2(const std::string& name, const glm::ivec2& value) const;
         void setiVec3(const std::string& name, const glm::ivec3& value) const;
         void setVec3(const std::string& name, float x, float y, float z) const;
         void setVec4(const std::string& name, const glm::vec4& value) const;
@@ -33,5 +47,14 @@ namespace Lexvi {
 
     public:
         void Dispatch(glm::uvec3 groupNum) const;
+
+        // One invocation per thread. Groups past the X limit spill into Y and Z, so the shader has to
+        // rebuild the flat index from gl_GlobalInvocationID and gl_NumWorkGroups and bounds-check it.
+        // Returns the group counts that were dispatched.
+        glm::uvec3 DispatchThreads(uint64_t threadCount) const;
+        glm::uvec3 DispatchThreads(glm::uvec3 threadCount) const;
+
+        // Group counts are read from a DispatchIndirectCommand at offset, typically written by another compute pass
+        void DispatchIndirect(unsigned int buffer, GLintptr offset = 0) const;
     };
 }
\ No newline at end of file
@@ -15,9 +15,13 @@ namespace Lexvi {
 
     public:
         Shader() = default;
+        // wraps an already linked program (see ShaderCache)
+        explicit Shader(unsigned int programID) : ID(programID) {};
         Shader(std::string vertexSrc, std::string fragmentSrc, std::string geometrySrc = "", bool isFromFile = true);
 
         void use() const;
+        // true if the linked program declares the named shader storage block
+        bool hasStorageBlock(const std::string& name) const;
     public:
         void setBool(const std::string& name, bool value) const;
         void setInt(const std::string& name, int value) const;
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <string>
+#include <memory>
+#include <unordered_map>
+
+#include "Shader/Shader.hpp"
+#include "Shader/ComputeShader.hpp"
+#include "Shader/ShaderPreprocessor.hpp"
+
+namespace Lexvi {
+    // Stores linked program binaries on disk, keyed by a hash of the expanded sources and the driver
+    class ProgramBinaryCache {
+    private:
+        std::string directory;
+        uint64_t driverHash = 0;
+        bool initialised = false;
+        bool supported = false;
+
+    public:
+        ProgramBinaryCache() = default;
+        explicit ProgramBinaryCache(std::string directory) : directory(std::move(directory)) {};
+
+        // Returns 0 when no valid binary exists for this key
+        unsigned int Load(uint64_t sourceHash);
+        void Store(uint64_t sourceHash, unsigned int program);
+
+    private:
+        // Deferred until first use so the cache can be constructed before the GL context exists
+        bool EnsureInitialised();
+        std::string getPath(uint64_t sourceHash) const;
+    };
+
+    struct ShaderCacheStats {
+        uint32_t requests = 0;
+        uint32_t variants = 0;       // distinct (files, defines) combinations seen
+        uint32_t programs = 0;       // distinct expanded sources
+        uint32_t deduplicated = 0;   // variants that reused another variant's program
+        uint32_t compiled = 0;
+        uint32_t loadedFromBinary = 0;
+    };
+
+    // Lazily compiles shader permutations. A variant is compiled the first time it is requested,
+    // variants whose expanded sources match share one program, and linked programs go through
+    // the ProgramBinaryCache so later runs skip the GLSL compiler.
+    class ShaderCache {
+    private:
+        std::unordered_map<uint64_t, std::shared_ptr<Shader>> shaderVariants;          // request key -> program
+        std::unordered_map<uint64_t, std::shared_ptr<Shader>> shaderPrograms;          // expanded source hash -> program
+        std::unordered_map<uint64_t, std::shared_ptr<ComputeShader>> computeVariants;
+        std::unordered_map<uint64_t, std::shared_ptr<ComputeShader>> computePrograms;
+
+        ProgramBinaryCache binaryCache;
+        ShaderCacheStats stats;
+
+    public:
+        ShaderCache() = default;
+        explicit ShaderCache(std::string binaryCacheDirectory) : binaryCache(std::move(binaryCacheDirectory)) {};
+
+        std::shared_ptr<Shader> GetShader(const std::string& vertexPath, const std::string& fragmentPath, const ShaderDefines& defines = {}, const std::string& geometryPath = "");
+        std::shared_ptr<ComputeShader> GetComputeShader(const std::string& path, const ShaderDefines& defines = {});
+
+        // For engine shaders embedded in the source; includes resolve against the registry
+        std::shared_ptr<Shader> GetShaderFromSource(const std::string& vertexSource, const std::string& fragmentSource, const ShaderDefines& defines = {}, const std::string& geometrySource = "");
+        std::shared_ptr<ComputeShader> GetComputeShaderFromSource(const std::string& source, const ShaderDefines& defines = {});
+
+        const ShaderCacheStats& getStats() const { return stats; }
+
+        // Drops the in-memory variants (on-disk binaries are kept)
+        void Clear();
+    };
+
+    // Engine wide cache, binaries are written to "ShaderCache/"
+    ShaderCache& GetShaderCache();
+}
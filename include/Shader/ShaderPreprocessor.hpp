@@ -0,0 +1,25 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace Lexvi {
+    // name -> value, an empty value emits a plain "#define NAME"
+    using ShaderDefines = std::vector<std::pair<std::string, std::string>>;
+
+    struct PreprocessedShader {
+        std::string source;
+        std::vector<std::string> files; // index = GLSL source-string number used in #line
+    };
+
+    // Registers an in-memory file that "#include <name>" resolves to before the filesystem
+    void RegisterShaderInclude(const std::string& name, const std::string& source);
+
+    bool ReadShaderFile(const std::string& path, std::string& outSource);
+
+    // Resolves #include (once per file) and injects defines, sorted by name, right after #version.
+    // Defines whose name never appears in the expanded source are dropped so that
+    // variants differing only by unused defines expand to identical text.
+    PreprocessedShader PreprocessShader(const std::string& source, const std::string& directory, const ShaderDefines& defines = {});
+    PreprocessedShader PreprocessShaderFile(const std::string& path, const ShaderDefines& defines = {});
+}
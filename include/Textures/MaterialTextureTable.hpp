@@ -0,0 +1,84 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+#include "Textures/Textures.hpp"
+
+namespace Lexvi {
+    // Texture kinds a material can reference, in table order
+    enum class MaterialTextureSlot : uint32_t {
+        Diffuse = 0,
+        Specular,
+        Normal,
+        Roughness,
+        Metallic,
+        AO,
+        Count
+    };
+
+    // Maps Texture::type ("texture_diffuse", ...) to its slot, Count if unknown
+    MaterialTextureSlot MaterialTextureSlotFromType(const std::string& type);
+
+    // Per-material texture references that shaders index instead of relying on bound units.
+    //
+    // With ARB_bindless_texture every slot holds a resident 64 bit handle. Without it, textures are
+    // copied into GL_TEXTURE_2D_ARRAY pages grouped by size and format, and a slot holds the page and
+    // layer; the pages are bound to consecutive units from BindingPoints::MaterialArrayUnitBase.
+    class MaterialTextureTable {
+    private:
+        // std430 mirror, per slot: bindless (handle lo, handle hi, 1, 0) or array (page, layer, 1, 0)
+        struct Entry {
+            glm::uvec4 slots[static_cast<uint32_t>(MaterialTextureSlot::Count)];
+        };
+
+        struct ArrayPage {
+            unsigned int texture = 0;
+            int width = 0;
+            int height = 0;
+            GLenum format = 0;
+            uint32_t layers = 0;
+            uint32_t capacity = 0;
+        };
+
+        bool initialised = false;
+        bool bindless = false;
+        bool dirty = false;
+
+        std::vector<Entry> entries;
+        std::unordered_map<uint64_t, uint32_t> materialLookup;    // hash of texture ids -> entry
+        std::unordered_map<unsigned int, glm::uvec4> textureSlots; // texture id -> slot value
+        std::vector<ArrayPage> pages;
+
+        unsigned int tableBuffer = 0;
+        size_t tableCapacity = 0;
+
+    public:
+        MaterialTextureTable() = default;
+        ~MaterialTextureTable();
+        MaterialTextureTable(const MaterialTextureTable&) = delete;
+        MaterialTextureTable& operator=(const MaterialTextureTable&) = delete;
+
+        // Returns the material index, identical texture sets share one entry
+        uint32_t AddMaterial(const std::vector<Texture>& textures);
+
+        // Uploads pending entries and binds the table (and array pages)
+        void Bind();
+
+        bool isBindless();
+        uint32_t getMaterialCount() const { return static_cast<uint32_t>(entries.size()); };
+
+        // GLSL for "Lexvi/MaterialTextures.glsl", matches the backend picked for this context
+        std::string GetGLSL();
+
+    private:
+        void EnsureInitialised();
+        glm::uvec4 resolveTexture(unsigned int texture);
+        glm::uvec4 addToArray(unsigned int texture);
+        void growPage(ArrayPage& page, uint32_t capacity);
+    };
+
+    // Engine wide table, created on first use (needs a GL context)
+    MaterialTextureTable& GetMaterialTextureTable();
+}
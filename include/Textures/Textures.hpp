@@ -1,5 +1,6 @@
 #pragma once
 
+#include <memory>
 #include <string>
 struct aiTexel;
 
@@ -11,11 +12,28 @@ namespace Lexvi {
         std::string path;
     };
 
+    // Pixels read by stb_image. Decoding doesn't touch GL so it can run on any thread, the texture
+    // is then created on the GL thread by TextureFromImage.
+    struct DecodedImage
+    {
+        std::shared_ptr<unsigned char> pixels;
+        int width = 0;
+        int height = 0;
+        int components = 0;
+        std::string path;
+    };
+
     unsigned int loadTexture(std::string path);
     unsigned int TextureFromFile(const char* path, const std::string& directory);
+    // path is relative to directory, as for TextureFromFile
+    bool DecodeTextureFile(const char* path, const std::string& directory, DecodedImage& image);
+    // 0 (and the same messages as TextureFromFile) for an image that failed to decode
+    unsigned int TextureFromImage(const DecodedImage& image);
     unsigned int TextureFromMemory(const unsigned char* data, size_t size);
     unsigned int TextureFromRawPixels(aiTexel* pixels, int width, int height);
     unsigned int GenerateDepthTexture(int width, int height);
+    // Same sampling state as GenerateDepthTexture, one layer per cascade / view
+    unsigned int GenerateDepthTextureArray(int width, int height, int layers);
 
     void CreateComputeTexture(Texture& tex, unsigned int width, unsigned int height);
     void BindComputeTexture(Texture& tex);
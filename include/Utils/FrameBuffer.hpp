@@ -26,6 +26,8 @@ namespace Lexvi {
 		unsigned int fbo = 0;
 		unsigned int width = 0, height = 0;
 		unsigned int colorAttachmentNum = 0;
+		bool ownsTextures = true;
+		std::vector<GLenum> colorFormats; // per colour attachment, GL_RGBA8 past the end
 
 		std::unordered_map<std::string, Texture> attachedTextures;
 
@@ -39,6 +41,13 @@ namespace Lexvi {
 
 		FrameBuffer(FrameBufferAttachments attachments, unsigned int colorAttachmentNum, unsigned int width, unsigned int height) : attachments(attachments), colorAttachmentNum(colorAttachmentNum), width(width), height(height) { CreateFrameBuffer(); };
 
+		// One colour attachment per format, e.g. a G-buffer. depthStencil adds DEPTH and/or STENCIL.
+		FrameBuffer(const std::vector<GLenum>& colorFormats, FrameBufferAttachments depthStencil, unsigned int width, unsigned int height);
+
+		// Renders into textures owned by someone else (e.g. the frame graph pool), they outlive the framebuffer.
+		// depthAttachment is GL_DEPTH_ATTACHMENT or GL_DEPTH_STENCIL_ATTACHMENT, depthTexture 0 for none.
+		FrameBuffer(const std::vector<unsigned int>& colorTextures, unsigned int depthTexture, GLenum depthAttachment, unsigned int width, unsigned int height);
+
 	public:
 		FrameBuffer(const FrameBuffer&) = delete;
 		FrameBuffer& operator=(const FrameBuffer&) = delete;
@@ -49,6 +58,8 @@ namespace Lexvi {
 			height = other.height;
 			attachments = other.attachments;
 			colorAttachmentNum = other.colorAttachmentNum;
+			ownsTextures = other.ownsTextures;
+			colorFormats = std::move(other.colorFormats);
 			attachedTextures = std::move(other.attachedTextures);
 
 			other.fbo = 0;
@@ -66,6 +77,8 @@ namespace Lexvi {
 				height = other.height;
 				attachments = other.attachments;
 				colorAttachmentNum = other.colorAttachmentNum;
+				ownsTextures = other.ownsTextures;
+				colorFormats = std::move(other.colorFormats);
 				attachedTextures = std::move(other.attachedTextures);
 
 				other.fbo = 0;
@@ -83,6 +96,8 @@ namespace Lexvi {
 
 		void getFrameBufferSize(unsigned int& width, unsigned int& height) const;
 
+		unsigned int getID() const { return fbo; }
+
 		void BindFrameBuffer() const;
 		void UnBindFrameBuffer() const;
 
@@ -1,5 +1,8 @@
 #pragma once
 
+#include <cstring>
+#include <string>
+
 namespace Lexvi {
 	namespace Hash {
 		struct IVec2Hash {
@@ -16,5 +19,28 @@ namespace Lexvi {
 				return a.x == b.x && a.y == b.y;
 			}
 		};
+
+		constexpr uint64_t FNV1A_OFFSET = 14695981039346656037ull;
+		constexpr uint64_t FNV1A_PRIME = 1099511628211ull;
+
+		// 64-bit FNV-1a, stable across runs (used for on-disk cache keys)
+		inline uint64_t FNV1a(const void* data, size_t size, uint64_t seed = FNV1A_OFFSET) {
+			const unsigned char* bytes = static_cast<const unsigned char*>(data);
+			uint64_t h = seed;
+			for (size_t i = 0; i < size; ++i) {
+				h ^= bytes[i];
+				h *= FNV1A_PRIME;
+			}
+			return h;
+		}
+
+		inline uint64_t FNV1a(const std::string& str, uint64_t seed = FNV1A_OFFSET) {
+			return FNV1a(str.data(), str.size(), seed);
+		}
+
+		// Without it a literal and a seed would pick the (data, size) overload and hash seed bytes
+		inline uint64_t FNV1a(const char* str, uint64_t seed = FNV1A_OFFSET) {
+			return FNV1a(str, std::strlen(str), seed);
+		}
 	}
-}
\ No newline at end of file
+}
@@ -8,4 +8,11 @@ namespace Lexvi {
 		GLsizei baseVertex = 0;
 		GLsizei baseInstance = 0;
 	};
+
+	// Layout read by glDispatchComputeIndirect
+	struct DispatchIndirectCommand {
+		GLuint numGroupsX = 0;
+		GLuint numGroupsY = 1;
+		GLuint numGroupsZ = 1;
+	};
 }
\ No newline at end of file
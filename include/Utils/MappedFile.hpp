@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+namespace Lexvi {
+	// Read-only memory mapping of a whole file. Pages are only read from disk when touched, so large
+	// blobs can be handed to GL without an intermediate copy.
+	class MappedFile {
+	private:
+		const uint8_t* bytes = nullptr;
+		size_t length = 0;
+#ifdef _WIN32
+		void* fileHandle = nullptr;
+		void* mappingHandle = nullptr;
+#endif
+
+	public:
+		MappedFile() = default;
+		~MappedFile();
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+
+		// false if the file is missing or empty
+		bool Open(const std::string& path);
+		void Close();
+
+		const uint8_t* data() const { return bytes; }
+		size_t size() const { return length; }
+	};
+}
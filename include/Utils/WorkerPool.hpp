@@ -0,0 +1,35 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Lexvi {
+	// Fixed set of threads running submitted jobs in order. Jobs may submit more jobs. Nothing here
+	// touches GL, jobs hand their results back to the GL thread themselves.
+	class WorkerPool {
+	private:
+		std::vector<std::thread> threads;
+		std::deque<std::function<void()>> jobs;
+		std::mutex mutex;
+		std::condition_variable wake;
+		bool stopping = false;
+
+		void work();
+
+	public:
+		// 0 uses one thread per core, minus the one driving GL
+		explicit WorkerPool(size_t threadCount = 0);
+		// Jobs still queued are dropped, running ones finish first
+		~WorkerPool();
+		WorkerPool(const WorkerPool&) = delete;
+		WorkerPool& operator=(const WorkerPool&) = delete;
+
+		void Submit(std::function<void()> job);
+
+		size_t getThreadCount() const { return threads.size(); };
+	};
+}
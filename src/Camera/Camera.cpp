@@ -27,6 +27,27 @@ bool Lexvi::isInFrustum(const CameraFrustum& frustum, const CameraAABB& aabb) {
     return true;
 }
 
+bool Lexvi::isSphereInFrustum(const CameraFrustum& frustum, const glm::vec4& sphere) {
+    for (int i = 0; i < 6; ++i) {
+        if (frustum.planes[i].getSignedDistanceToPlane(glm::vec3(sphere)) < -sphere.w) return false;
+    }
+    return true;
+}
+
+CameraAABB Lexvi::TransformAABB(const CameraAABB& aabb, const glm::mat4& transform) {
+    // Arvo: each output axis is the translation plus the min/max contribution of every input axis
+    glm::vec3 center = glm::vec3(transform[3]);
+    CameraAABB result{ center, center };
+
+    for (int i = 0; i < 3; ++i) {
+        glm::vec3 a = glm::vec3(transform[i]) * aabb.min[i];
+        glm::vec3 b = glm::vec3(transform[i]) * aabb.max[i];
+        result.min += glm::min(a, b);
+        result.max += glm::max(a, b);
+    }
+    return result;
+}
+
 bool Lexvi::IntersectPlanes(const CameraPlane& p1, const CameraPlane& p2, const CameraPlane& p3, glm::vec3& outPoint) {
     glm::vec3 n1 = p1.normal;
     glm::vec3 n2 = p2.normal;
@@ -127,7 +148,7 @@ void Lexvi::updateFrustum(CameraFrustum& frustum, const glm::mat4& projView) {
     }
 }
 
-CameraFrustum Lexvi::Camera::getFrustum() const
+const CameraFrustum& Lexvi::Camera::getFrustum() const
 {
     return frustum;
 }
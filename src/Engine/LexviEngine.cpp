@@ -6,6 +6,8 @@
 #include "Input/Input.hpp"
 #include "Camera/Camera.hpp"
 #include "Renderer/Renderer.hpp"
+#include "Renderer/GLState.hpp"
+#include "Renderable/Model/ModelLoader.hpp"
 
 #include <GLFW/glfw3.h>
 
@@ -81,13 +83,15 @@ void Engine::Init(const std::string& title, std::unique_ptr<Game> newGame)
 
 	inputSystem->framebuffer_size_callback(window, inputSystem->getScreenWidth(), inputSystem->getScreenHeight());
 
-	glEnable(GL_DEPTH_TEST);
-	glEnable(GL_BLEND);
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	GLState::SetDepthTest(true);
+	GLState::SetBlend(true);
+	GLState::SetBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
-	glEnable(GL_CULL_FACE);
-	glCullFace(GL_BACK);
-	glFrontFace(GL_CCW);
+	GLState::SetCullFace(true);
+	GLState::SetCullMode(GL_BACK);
+	GLState::SetFrontFace(GL_CCW);
+
+	renderer->Init();
 
 	IMGUI_CHECKVERSION();
 	ImGui::CreateContext();
@@ -119,12 +123,19 @@ void Engine::run()
 		float dt = frameTime - lastFrameTime;
 		lastFrameTime = frameTime;
 
+		GLState::BeginFrame();
+
+		// async loads finishing now are usable by this frame's update
+		GetModelLoader().Update();
+
 		inputSystem->Update();
 
 		game->update(*this, dt);
 
 		if (currentCamera) currentCamera->update(dt);
 
+		renderer->BeginFrame(currentCamera.get(), frameTime, dt, inputSystem->getScreenWidth(), inputSystem->getScreenHeight());
+
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
 		ImGui_ImplOpenGL3_NewFrame();
@@ -132,6 +143,8 @@ void Engine::run()
 		ImGui::NewFrame();
 
 		game->render(*renderer);
+		renderer->Flush();
+		renderer->EndFrame();
 
 #ifdef _DEBUG
 		float allocatedMB = g_allocatedBytes.load() / 1'000'000.0f;
@@ -142,6 +155,8 @@ void Engine::run()
 
 		ImGui::Render();
 		ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+		// the ImGui backend binds its own program, VAO and textures
+		GLState::Invalidate();
 
 		glfwSwapBuffers(window);
 	}
@@ -211,6 +226,27 @@ void Lexvi::Engine::ShowEngineStats(float allocatedMB)
 		ImGui::Text("Mem: %.2f MB", allocatedMB);
 	}
 
+	const GLStateStats& glStats = GLState::GetFrameStats();
+	ImGui::Text("GL state calls: %u issued, %u filtered", glStats.issued, glStats.filtered);
+
+	const RenderQueueStats& queueStats = renderer->getRenderQueueStats();
+	ImGui::Text("Render queue: %u drawn in %u calls (%u instanced, %u multi-draw), %u culled, %u programs",
+		queueStats.drawn, queueStats.drawCalls, queueStats.instancedBatches, queueStats.multiDraws, queueStats.culled, queueStats.programChanges);
+
+	const DynamicResolutionStats& resolutionStats = renderer->getDynamicResolution().getStats();
+	ImGui::Text("GPU: %.2f ms, rendering %ux%u (%.0f%%)", resolutionStats.gpuTime, resolutionStats.width, resolutionStats.height, resolutionStats.scale * 100.0f);
+
+	const FrameGraphStats& graphStats = renderer->getFrameGraph().getStats();
+	if (graphStats.passes) {
+		ImGui::Text("Frame graph: %u passes (%u culled), %u targets on %u textures, %.1f MB pooled",
+			graphStats.passes, graphStats.culledPasses, graphStats.transientTextures, graphStats.physicalTextures, graphStats.pooledBytes / 1'000'000.0f);
+	}
+
+	const ModelLoaderStats& loaderStats = GetModelLoader().getStats();
+	if (loaderStats.pending) {
+		ImGui::Text("Loading: %u models, %u uploads in %.2f ms", loaderStats.pending, loaderStats.uploads, loaderStats.uploadTime);
+	}
+
 	// Optional small bar to visualize FPS relative to 60
 	float barWidth = glm::clamp(fps / 60.0f, 0.0f, 1.0f);
 	ImVec2 size(200, 10);
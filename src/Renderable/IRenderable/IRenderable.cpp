@@ -2,4 +2,41 @@
 
 #include "Renderable/IRenderable/IRenderable.hpp"
 
-#include "Camera/Camera.hpp"
\ No newline at end of file
+#include "Camera/Camera.hpp"
+#include "Utils/Hash.hpp"
+
+unsigned int Lexvi::MakeGeometryID(const std::string& kind, const void* params, size_t size)
+{
+	uint64_t h = Hash::FNV1a(kind);
+	h = Hash::FNV1a(params, size, h);
+
+	unsigned int id = static_cast<unsigned int>(h ^ (h >> 32));
+	return id ? id : 1;
+}
+
+void Lexvi::IRenderable::setLocalBounds(const CameraAABB& box, const glm::vec4& sphere)
+{
+	localAABB = box;
+	localSphere = sphere;
+	hasBounds = true;
+	updateBoundingBox();
+}
+
+void Lexvi::IRenderable::updateBoundingBox()
+{
+	if (!hasBounds) return;
+
+	cameraAABB = TransformAABB(localAABB, transforms);
+
+	// radius grows with the largest axis scale
+	float scale = std::max(glm::length(glm::vec3(transforms[0])), std::max(glm::length(glm::vec3(transforms[1])), glm::length(glm::vec3(transforms[2]))));
+	worldSphere = glm::vec4(glm::vec3(transforms * glm::vec4(glm::vec3(localSphere), 1.0f)), localSphere.w * scale);
+}
+
+bool Lexvi::IRenderable::isVisible(const Camera& camera) const
+{
+	if (!hasBounds) return true;
+
+	const CameraFrustum& frustum = camera.getFrustum();
+	return isSphereInFrustum(frustum, worldSphere) && isInFrustum(frustum, cameraAABB);
+}
\ No newline at end of file
@@ -1,85 +1,161 @@
 #include "pch.h"
 
 #include "Renderable/Model/Mesh/Mesh.hpp"
+#include "Renderable/Model/Mesh/MeshArena.hpp"
+#include "Renderer/GLState.hpp"
+#include "Textures/MaterialTextureTable.hpp"
 
 namespace Lexvi {
 
-    Mesh::Mesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices, std::vector<Texture> textures)
-        : vertices(vertices), indices(indices), textures(textures)
+    Mesh::Mesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices, std::vector<Texture> textures, const MeshFormat& format)
+        : Mesh(PrepareMesh(std::move(vertices), std::move(indices), format), std::move(textures))
     {
-        setupMesh();
     }
 
-    void Mesh::Draw(const Shader* shader) const
+    Mesh::Mesh(const PackedMeshData& data, std::vector<Texture> textures)
+        : textures(textures)
     {
-        unsigned int diffuseNr = 1;
-        unsigned int specularNr = 1;
-        unsigned int normalNr = 1;
-        unsigned int roughNr = 1;
-        unsigned int metallicNr = 1;
-        unsigned int aoNr = 1;
-
-        for (unsigned int i = 0; i < textures.size(); i++) {
-            glBindTextureUnit(i, textures[i].id);
-
-            std::string number;
-            std::string name = textures[i].type;
-
-            if (name == "texture_diffuse")      number = std::to_string(diffuseNr++);
-            else if (name == "texture_specular") number = std::to_string(specularNr++);
-            else if (name == "texture_normal")   number = std::to_string(normalNr++);
-            else if (name == "texture_roughness") number = std::to_string(roughNr++);
-            else if (name == "texture_metallic")  number = std::to_string(metallicNr++);
-            else if (name == "texture_ao")        number = std::to_string(aoNr++);
-
-            shader->setInt("material." + (name + number), i);
+        upload(data);
+        material = GetMaterialLibrary().GetMaterial(this->textures);
+    }
+
+    Mesh::Mesh(PreparedMesh&& prepared, std::vector<Texture> textures)
+        : textures(textures)
+    {
+        upload(prepared.getData());
+        vertices = std::move(prepared.vertices);
+        indices = std::move(prepared.indices);
+        material = GetMaterialLibrary().GetMaterial(this->textures);
+    }
+
+    PreparedMesh PrepareMesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices, const MeshFormat& format, std::vector<MeshLod> lods, std::vector<Meshlet> meshlets)
+    {
+        PreparedMesh prepared;
+        prepared.layout = format.layout;
+        prepared.lods = std::move(lods);
+        prepared.meshlets = std::move(meshlets);
+
+        // quantization needs the bounds first
+        ComputeBounds(vertices, &Vertex::Position, prepared.bounds, prepared.boundingSphere);
+        prepared.packedVertices = PackVertices(vertices, format.layout, prepared.bounds);
+
+        // indices are mesh relative, so the vertex count of this mesh alone decides
+        if (format.shortIndices && vertices.size() <= 65536) prepared.shortIndices.assign(indices.begin(), indices.end());
+
+        prepared.vertices = std::move(vertices);
+        prepared.indices = std::move(indices);
+        return prepared;
+    }
+
+    PackedMeshData PreparedMesh::getData() const
+    {
+        bool shortened = !shortIndices.empty();
+
+        PackedMeshData data;
+        data.layout = layout;
+        data.indexType = shortened ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+        data.vertices = packedVertices.data();
+        data.vertexCount = static_cast<uint32_t>(vertices.size());
+        data.indices = shortened ? static_cast<const void*>(shortIndices.data()) : static_cast<const void*>(indices.data());
+        data.indexCount = static_cast<uint32_t>(indices.size());
+        data.bounds = bounds;
+        data.boundingSphere = boundingSphere;
+        data.lods = lods.data();
+        data.lodCount = static_cast<uint32_t>(lods.size());
+        data.meshlets = meshlets.data();
+        data.meshletCount = static_cast<uint32_t>(meshlets.size());
+        return data;
+    }
+
+    LodView& GetLodView()
+    {
+        static LodView view;
+        return view;
+    }
+
+    void Mesh::Draw(const Shader* shader, uint32_t lod) const
+    {
+        drawElements(shader, 1, 0, lod);
+    }
+
+    void Mesh::DrawInstanced(const Shader* shader, uint32_t instanceCount, uint32_t baseInstance) const
+    {
+        drawElements(shader, instanceCount, baseInstance, 0);
+    }
+
+    void Mesh::drawElements(const Shader* shader, uint32_t instanceCount, uint32_t baseInstance, uint32_t lod) const
+    {
+        const MeshLod& level = lods[std::min<size_t>(lod, lods.size() - 1)];
+
+        material->Bind(*shader);
+
+        // only quantized meshes touch the uniforms, and they put the identity back for everyone else
+        glm::vec3 scale, offset;
+        if (quantized) {
+            GetPositionDequantization(boundingBox, scale, offset);
+            shader->setVec3("lexviPositionScale", scale);
+            shader->setVec3("lexviPositionOffset", offset);
         }
 
-        glBindVertexArray(VAO);
-        glDrawElements(GL_TRIANGLES, static_cast<GLsizei>(indices.size()), GL_UNSIGNED_INT, 0);
+        GLState::BindVertexArray(arena->getVAO());
+        glDrawElementsInstancedBaseVertexBaseInstance(GL_TRIANGLES, static_cast<GLsizei>(level.indexCount), arena->getIndexType(),
+            reinterpret_cast<const void*>(static_cast<uintptr_t>(level.firstIndex) * arena->getIndexSize()), instanceCount, baseVertex, baseInstance);
+
+        if (quantized) {
+            shader->setVec3("lexviPositionScale", glm::vec3(1.0f));
+            shader->setVec3("lexviPositionOffset", glm::vec3(0.0f));
+        }
     }
 
-    void Mesh::setupMesh() {
-        GLuint VAO, VBO, EBO;
-        glCreateVertexArrays(1, &VAO);
-        glCreateBuffers(1, &VBO);
-        glCreateBuffers(1, &EBO);
+    uint32_t Mesh::selectLod(const glm::mat4& transforms) const
+    {
+        const LodView& view = GetLodView();
+        if (lods.size() < 2 || view.projectionScale <= 0.0f) return 0;
 
-        // Upload vertex data
-        glNamedBufferData(VBO, vertices.size() * sizeof(Vertex), vertices.data(), GL_STATIC_DRAW);
+        glm::vec3 center = glm::vec3(transforms * glm::vec4(glm::vec3(boundingSphere), 1.0f));
+        float scale = std::max({ glm::length(glm::vec3(transforms[0])), glm::length(glm::vec3(transforms[1])), glm::length(glm::vec3(transforms[2])) });
 
-        // Upload index data
-        glNamedBufferData(EBO, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
+        // nearest point of the bounding sphere, full detail once the camera is inside it
+        float distance = glm::length(center - view.cameraPosition) - boundingSphere.w * scale;
+        if (distance <= 0.0f) return 0;
 
-        // Bind buffers to VAO
-        glVertexArrayVertexBuffer(VAO, 0, VBO, 0, sizeof(Vertex));
-        glVertexArrayElementBuffer(VAO, EBO);
+        float pixelsPerUnit = scale * view.projectionScale / distance;
+        for (uint32_t lod = static_cast<uint32_t>(lods.size()) - 1; lod > 0; --lod) {
+            if (lods[lod].error * pixelsPerUnit <= view.pixelThreshold) return lod;
+        }
+        return 0;
+    }
 
-        // Enable and describe vertex attributes
-        // Position
-        glEnableVertexArrayAttrib(VAO, 0);
-        glVertexArrayAttribFormat(VAO, 0, 3, GL_FLOAT, GL_FALSE, offsetof(Vertex, Position));
-        glVertexArrayAttribBinding(VAO, 0, 0);
+    glm::mat4 Mesh::getDequantization() const
+    {
+        if (!quantized) return glm::mat4(1.0f);
 
-        // Normal
-        glEnableVertexArrayAttrib(VAO, 1);
-        glVertexArrayAttribFormat(VAO, 1, 3, GL_FLOAT, GL_FALSE, offsetof(Vertex, Normal));
-        glVertexArrayAttribBinding(VAO, 1, 0);
+        glm::vec3 scale, offset;
+        GetPositionDequantization(boundingBox, scale, offset);
+        return glm::scale(glm::translate(glm::mat4(1.0f), offset), scale);
+    }
+
+    uint32_t Mesh::getMaterialIndex() const
+    {
+        // lazy so meshes that never take the indexed path don't copy their textures into the table
+        if (materialIndex == NO_MATERIAL) materialIndex = GetMaterialTextureTable().AddMaterial(textures);
+        return materialIndex;
+    }
 
-        // TexCoords
-        glEnableVertexArrayAttrib(VAO, 2);
-        glVertexArrayAttribFormat(VAO, 2, 2, GL_FLOAT, GL_FALSE, offsetof(Vertex, TexCoords));
-        glVertexArrayAttribBinding(VAO, 2, 0);
+    void Mesh::upload(const PackedMeshData& data) {
+        boundingBox = data.bounds;
+        boundingSphere = data.boundingSphere;
+        quantized = data.layout == VertexLayout::PackedQuantized;
 
-        // Tangent
-        glEnableVertexArrayAttrib(VAO, 3);
-        glVertexArrayAttribFormat(VAO, 3, 3, GL_FLOAT, GL_FALSE, offsetof(Vertex, Tangent));
-        glVertexArrayAttribBinding(VAO, 3, 0);
+        arena = &GetMeshArena(data.layout, data.indexType);
+        MeshRange range = arena->Allocate(data.vertices, data.vertexCount, data.indices, data.indexCount);
+        baseVertex = range.baseVertex;
 
-        // Bitangent
-        glEnableVertexArrayAttrib(VAO, 4);
-        glVertexArrayAttribFormat(VAO, 4, 3, GL_FLOAT, GL_FALSE, offsetof(Vertex, Bitangent));
-        glVertexArrayAttribBinding(VAO, 4, 0);
+        lods.assign(data.lods, data.lods + data.lodCount);
+        if (lods.empty()) lods.push_back({ 0, range.indexCount, 0.0f });
+        for (MeshLod& lod : lods) lod.firstIndex += range.firstIndex;
 
+        meshlets.assign(data.meshlets, data.meshlets + data.meshletCount);
+        for (Meshlet& meshlet : meshlets) meshlet.firstIndex += range.firstIndex;
     }
 }
\ No newline at end of file
@@ -0,0 +1,115 @@
+#include "pch.h"
+
+#include "Renderable/Model/Mesh/MeshArena.hpp"
+#include "Renderer/GLState.hpp"
+
+namespace Lexvi {
+    namespace {
+        constexpr uint32_t INITIAL_VERTEX_CAPACITY = 1 << 18;
+        constexpr uint32_t INITIAL_INDEX_CAPACITY = 1 << 20;
+
+        std::unique_ptr<MeshArena> arenas[MeshArena::ARENA_COUNT];
+
+        // Returns a new buffer of newSize bytes holding the first usedSize bytes of the old one
+        unsigned int GrowBuffer(unsigned int oldBuffer, size_t usedSize, size_t newSize) {
+            unsigned int buffer;
+            glCreateBuffers(1, &buffer);
+            glNamedBufferData(buffer, newSize, nullptr, GL_STATIC_DRAW);
+
+            if (oldBuffer) {
+                if (usedSize) glCopyNamedBufferSubData(oldBuffer, buffer, 0, 0, usedSize);
+                GLState::ForgetBuffer(oldBuffer);
+                glDeleteBuffers(1, &oldBuffer);
+            }
+            return buffer;
+        }
+    }
+
+    MeshArena::MeshArena(VertexLayout layout, GLenum indexType, uint32_t slot)
+        : layout(layout), indexType(indexType), slot(slot)
+    {
+        vertexSize = GetVertexSize(layout);
+        indexSize = (indexType == GL_UNSIGNED_SHORT) ? sizeof(uint16_t) : sizeof(uint32_t);
+    }
+
+    MeshArena::~MeshArena()
+    {
+        if (!VAO) return;
+        GLState::ForgetVertexArray(VAO);
+        GLState::ForgetBuffer(VBO);
+        GLState::ForgetBuffer(EBO);
+        glDeleteVertexArrays(1, &VAO);
+        glDeleteBuffers(1, &VBO);
+        glDeleteBuffers(1, &EBO);
+    }
+
+    void MeshArena::create()
+    {
+        glCreateVertexArrays(1, &VAO);
+        SetupVertexAttributes(VAO, layout);
+
+        growVertices(INITIAL_VERTEX_CAPACITY);
+        growIndices(INITIAL_INDEX_CAPACITY);
+    }
+
+    void MeshArena::growVertices(uint32_t required)
+    {
+        uint32_t capacity = std::max(required, vertexCapacity * 2);
+        VBO = GrowBuffer(VBO, static_cast<size_t>(vertexCount) * vertexSize, static_cast<size_t>(capacity) * vertexSize);
+        vertexCapacity = capacity;
+        glVertexArrayVertexBuffer(VAO, 0, VBO, 0, vertexSize);
+    }
+
+    void MeshArena::growIndices(uint32_t required)
+    {
+        uint32_t capacity = std::max(required, indexCapacity * 2);
+        EBO = GrowBuffer(EBO, static_cast<size_t>(indexCount) * indexSize, static_cast<size_t>(capacity) * indexSize);
+        indexCapacity = capacity;
+        glVertexArrayElementBuffer(VAO, EBO);
+    }
+
+    MeshRange MeshArena::Allocate(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices)
+    {
+        assert(layout == VertexLayout::Full && indexType == GL_UNSIGNED_INT);
+        return Allocate(vertices.data(), static_cast<uint32_t>(vertices.size()), indices.data(), static_cast<uint32_t>(indices.size()));
+    }
+
+    MeshRange MeshArena::Allocate(const void* vertices, uint32_t newVertices, const void* indices, uint32_t newIndices)
+    {
+        if (!VAO) create();
+
+        if (vertexCount + newVertices > vertexCapacity) growVertices(vertexCount + newVertices);
+        if (indexCount + newIndices > indexCapacity) growIndices(indexCount + newIndices);
+
+        MeshRange range{};
+        range.firstIndex = indexCount;
+        range.indexCount = newIndices;
+        range.baseVertex = static_cast<int32_t>(vertexCount);
+        range.vertexCount = newVertices;
+
+        // indices stay mesh relative, baseVertex offsets them at draw time
+        glNamedBufferSubData(VBO, static_cast<GLintptr>(vertexCount) * vertexSize, static_cast<GLsizeiptr>(newVertices) * vertexSize, vertices);
+        glNamedBufferSubData(EBO, static_cast<GLintptr>(indexCount) * indexSize, static_cast<GLsizeiptr>(newIndices) * indexSize, indices);
+
+        vertexCount += newVertices;
+        indexCount += newIndices;
+        return range;
+    }
+
+    MeshArena& GetMeshArena()
+    {
+        return GetMeshArena(VertexLayout::Full, GL_UNSIGNED_INT);
+    }
+
+    MeshArena& GetMeshArena(VertexLayout layout, GLenum indexType)
+    {
+        uint32_t slot = static_cast<uint32_t>(layout) * 2 + (indexType == GL_UNSIGNED_SHORT ? 1 : 0);
+        if (!arenas[slot]) arenas[slot] = std::make_unique<MeshArena>(layout, indexType, slot);
+        return *arenas[slot];
+    }
+
+    MeshArena* GetMeshArenaBySlot(uint32_t slot)
+    {
+        return slot < MeshArena::ARENA_COUNT ? arenas[slot].get() : nullptr;
+    }
+}
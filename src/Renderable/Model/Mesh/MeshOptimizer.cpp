@@ -0,0 +1,271 @@
+#include "pch.h"
+
+#include "Renderable/Model/Mesh/MeshOptimizer.hpp"
+#include "Utils/Hash.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace Lexvi {
+    namespace {
+        constexpr uint32_t NONE = 0xFFFFFFFFu;
+
+        // Forsyth, "Linear-Speed Vertex Cache Optimisation". The scoring cache is a little larger than
+        // the one simulated for ACMR, as in the paper.
+        constexpr int32_t SCORE_CACHE_SIZE = 32;
+        constexpr float CACHE_DECAY_POWER = 1.5f;
+        constexpr float LAST_TRIANGLE_SCORE = 0.75f;
+        constexpr float VALENCE_BOOST_SCALE = 2.0f;
+        constexpr float VALENCE_BOOST_POWER = 0.5f;
+
+        float VertexScore(int32_t cachePosition, uint32_t liveTriangles) {
+            if (liveTriangles == 0) return -1.0f; // nothing left to draw with it
+
+            float score = 0.0f;
+            if (cachePosition >= 0) {
+                // the last triangle's vertices score lower so strips don't just keep going one way
+                if (cachePosition < 3) score = LAST_TRIANGLE_SCORE;
+                else score = std::pow(1.0f - static_cast<float>(cachePosition - 3) / (SCORE_CACHE_SIZE - 3), CACHE_DECAY_POWER);
+            }
+            return score + VALENCE_BOOST_SCALE * std::pow(static_cast<float>(liveTriangles), -VALENCE_BOOST_POWER);
+        }
+
+        void WeldVertices(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices) {
+            // Vertex has no padding, so equal bytes mean an equal vertex
+            auto hash = [&](uint32_t v) { return static_cast<size_t>(Hash::FNV1a(&vertices[v], sizeof(Vertex))); };
+            auto equal = [&](uint32_t a, uint32_t b) { return std::memcmp(&vertices[a], &vertices[b], sizeof(Vertex)) == 0; };
+            std::unordered_map<uint32_t, uint32_t, decltype(hash), decltype(equal)> unique(vertices.size(), hash, equal);
+
+            std::vector<uint32_t> remap(vertices.size(), NONE);
+            std::vector<Vertex> welded;
+            welded.reserve(vertices.size());
+
+            for (unsigned int& index : indices) {
+                if (remap[index] == NONE) {
+                    auto [it, inserted] = unique.try_emplace(index, static_cast<uint32_t>(welded.size()));
+                    if (inserted) welded.push_back(vertices[index]);
+                    remap[index] = it->second;
+                }
+                index = remap[index];
+            }
+            vertices = std::move(welded);
+        }
+
+    }
+
+    void OptimizeVertexCache(std::vector<unsigned int>& indices, size_t vertexCount)
+    {
+        size_t triangleCount = indices.size() / 3;
+
+        // triangles of each vertex, emitted ones are swapped past the live count
+        std::vector<uint32_t> liveTriangles(vertexCount, 0);
+        for (unsigned int index : indices) ++liveTriangles[index];
+
+        std::vector<uint32_t> adjacencyOffset(vertexCount + 1, 0);
+        for (size_t v = 0; v < vertexCount; ++v) adjacencyOffset[v + 1] = adjacencyOffset[v] + liveTriangles[v];
+
+        std::vector<uint32_t> adjacency(indices.size());
+        {
+            std::vector<uint32_t> fill(adjacencyOffset.begin(), adjacencyOffset.end() - 1);
+            for (size_t t = 0; t < triangleCount; ++t)
+                for (int k = 0; k < 3; ++k) adjacency[fill[indices[t * 3 + k]]++] = static_cast<uint32_t>(t);
+        }
+
+        std::vector<int32_t> cachePosition(vertexCount, -1);
+        std::vector<float> vertexScore(vertexCount);
+        for (size_t v = 0; v < vertexCount; ++v) vertexScore[v] = VertexScore(-1, liveTriangles[v]);
+
+        std::vector<float> triangleScore(triangleCount);
+        for (size_t t = 0; t < triangleCount; ++t)
+            triangleScore[t] = vertexScore[indices[t * 3]] + vertexScore[indices[t * 3 + 1]] + vertexScore[indices[t * 3 + 2]];
+
+        std::vector<bool> emitted(triangleCount, false);
+        std::vector<unsigned int> output;
+        output.reserve(indices.size());
+
+        std::vector<uint32_t> cache, nextCache;
+        cache.reserve(SCORE_CACHE_SIZE + 3);
+        nextCache.reserve(SCORE_CACHE_SIZE + 3);
+
+        size_t cursor = 0; // fallback scan, every triangle before it is emitted
+        uint32_t best = triangleCount ? 0 : NONE;
+
+        while (best != NONE) {
+            emitted[best] = true;
+            const unsigned int* triangle = &indices[best * 3];
+            output.insert(output.end(), triangle, triangle + 3);
+
+            for (int k = 0; k < 3; ++k) {
+                uint32_t v = triangle[k];
+                uint32_t* begin = &adjacency[adjacencyOffset[v]];
+                uint32_t* end = begin + liveTriangles[v];
+                std::iter_swap(std::find(begin, end, best), end - 1);
+                --liveTriangles[v];
+            }
+
+            // the triangle's vertices move to the front, the rest shift back
+            nextCache.assign(triangle, triangle + 3);
+            for (uint32_t v : cache)
+                if (v != triangle[0] && v != triangle[1] && v != triangle[2]) nextCache.push_back(v);
+            std::swap(cache, nextCache);
+
+            // rescore everything that moved, including what just fell out of the cache
+            for (size_t i = 0; i < cache.size(); ++i) {
+                uint32_t v = cache[i];
+                cachePosition[v] = i < SCORE_CACHE_SIZE ? static_cast<int32_t>(i) : -1;
+                vertexScore[v] = VertexScore(cachePosition[v], liveTriangles[v]);
+            }
+
+            best = NONE;
+            float bestScore = -1.0f;
+            for (size_t i = 0; i < cache.size(); ++i) {
+                uint32_t v = cache[i];
+                for (uint32_t a = adjacencyOffset[v]; a < adjacencyOffset[v] + liveTriangles[v]; ++a) {
+                    uint32_t t = adjacency[a];
+                    const unsigned int* other = &indices[t * 3];
+                    triangleScore[t] = vertexScore[other[0]] + vertexScore[other[1]] + vertexScore[other[2]];
+                    if (triangleScore[t] > bestScore) {
+                        bestScore = triangleScore[t];
+                        best = t;
+                    }
+                }
+            }
+            if (cache.size() > SCORE_CACHE_SIZE) cache.resize(SCORE_CACHE_SIZE);
+
+            // nothing left around the cache, continue with the next triangle in the input
+            if (best == NONE) {
+                while (cursor < triangleCount && emitted[cursor]) ++cursor;
+                if (cursor < triangleCount) best = static_cast<uint32_t>(cursor);
+            }
+        }
+
+        indices = std::move(output);
+    }
+
+    namespace {
+        // Sander et al., "Fast Triangle Reordering for Vertex Locality and Reduced Overdraw". A triangle
+        // missing the cache on all three vertices starts a new cluster, so reordering whole clusters
+        // keeps nearly all of the cache hits.
+        void OptimizeOverdraw(std::vector<unsigned int>& indices, const std::vector<Vertex>& vertices) {
+            size_t triangleCount = indices.size() / 3;
+
+            std::vector<uint32_t> clusterStart;
+            {
+                std::vector<uint32_t> cachedAt(vertices.size(), 0);
+                uint32_t time = POST_TRANSFORM_CACHE_SIZE + 1; // FIFO clock, a vertex is cached if its entry is recent enough
+                for (size_t t = 0; t < triangleCount; ++t) {
+                    uint32_t misses = 0;
+                    for (int k = 0; k < 3; ++k) {
+                        uint32_t v = indices[t * 3 + k];
+                        if (time - cachedAt[v] > POST_TRANSFORM_CACHE_SIZE) {
+                            cachedAt[v] = time++;
+                            ++misses;
+                        }
+                    }
+                    if (t == 0 || misses == 3) clusterStart.push_back(static_cast<uint32_t>(t));
+                }
+            }
+            if (clusterStart.size() < 2) return;
+            clusterStart.push_back(static_cast<uint32_t>(triangleCount));
+
+            size_t clusterCount = clusterStart.size() - 1;
+            std::vector<glm::vec3> centroid(clusterCount, glm::vec3(0.0f));
+            std::vector<glm::vec3> normal(clusterCount, glm::vec3(0.0f));
+            glm::vec3 meshCentroid(0.0f);
+            float meshArea = 0.0f;
+
+            for (size_t c = 0; c < clusterCount; ++c) {
+                float area = 0.0f;
+                for (uint32_t t = clusterStart[c]; t < clusterStart[c + 1]; ++t) {
+                    const glm::vec3& p0 = vertices[indices[t * 3]].Position;
+                    const glm::vec3& p1 = vertices[indices[t * 3 + 1]].Position;
+                    const glm::vec3& p2 = vertices[indices[t * 3 + 2]].Position;
+                    glm::vec3 n = glm::cross(p1 - p0, p2 - p0); // length is twice the area
+                    float a = glm::length(n);
+                    centroid[c] += (p0 + p1 + p2) * (a / 3.0f);
+                    normal[c] += n;
+                    area += a;
+                }
+                meshCentroid += centroid[c];
+                meshArea += area;
+                centroid[c] = area > 0.0f ? centroid[c] / area : vertices[indices[clusterStart[c] * 3]].Position;
+                float length = glm::length(normal[c]);
+                normal[c] = length > 0.0f ? normal[c] / length : glm::vec3(0.0f);
+            }
+            if (meshArea > 0.0f) meshCentroid /= meshArea;
+
+            // clusters far out along their own normal are likely to cover the rest, draw them first
+            std::vector<float> sortKey(clusterCount);
+            for (size_t c = 0; c < clusterCount; ++c) sortKey[c] = glm::dot(centroid[c] - meshCentroid, normal[c]);
+
+            std::vector<uint32_t> order(clusterCount);
+            for (size_t c = 0; c < clusterCount; ++c) order[c] = static_cast<uint32_t>(c);
+            std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return sortKey[a] > sortKey[b]; });
+
+            std::vector<unsigned int> output;
+            output.reserve(indices.size());
+            for (uint32_t c : order)
+                output.insert(output.end(), indices.begin() + clusterStart[c] * 3, indices.begin() + clusterStart[c + 1] * 3);
+            indices = std::move(output);
+        }
+
+        void OptimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices) {
+            std::vector<uint32_t> remap(vertices.size(), NONE);
+            std::vector<Vertex> ordered;
+            ordered.reserve(vertices.size());
+
+            for (unsigned int& index : indices) {
+                if (remap[index] == NONE) {
+                    remap[index] = static_cast<uint32_t>(ordered.size());
+                    ordered.push_back(vertices[index]);
+                }
+                index = remap[index];
+            }
+            vertices = std::move(ordered);
+        }
+    }
+
+    MeshOptimizationStats& MeshOptimizationStats::operator+=(const MeshOptimizationStats& other)
+    {
+        triangles += other.triangles;
+        verticesBefore += other.verticesBefore;
+        verticesAfter += other.verticesAfter;
+        transformsBefore += other.transformsBefore;
+        transformsAfter += other.transformsAfter;
+        return *this;
+    }
+
+    uint32_t SimulateVertexCache(const std::vector<unsigned int>& indices, size_t vertexCount, uint32_t cacheSize)
+    {
+        std::vector<uint32_t> cachedAt(vertexCount, 0);
+        uint32_t time = cacheSize + 1;
+        uint32_t transforms = 0;
+
+        for (unsigned int index : indices) {
+            if (time - cachedAt[index] > cacheSize) {
+                cachedAt[index] = time++;
+                ++transforms;
+            }
+        }
+        return transforms;
+    }
+
+    MeshOptimizationStats OptimizeMesh(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices)
+    {
+        MeshOptimizationStats stats;
+        stats.triangles = static_cast<uint32_t>(indices.size() / 3);
+        stats.verticesBefore = static_cast<uint32_t>(vertices.size());
+        stats.transformsBefore = SimulateVertexCache(indices, vertices.size());
+
+        if (indices.size() % 3 == 0) {
+            WeldVertices(vertices, indices);
+            OptimizeVertexCache(indices, vertices.size());
+            OptimizeOverdraw(indices, vertices);
+            OptimizeVertexFetch(vertices, indices);
+        }
+
+        stats.verticesAfter = static_cast<uint32_t>(vertices.size());
+        stats.transformsAfter = SimulateVertexCache(indices, vertices.size());
+        return stats;
+    }
+}
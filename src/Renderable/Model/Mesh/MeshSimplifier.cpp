@@ -0,0 +1,309 @@
+#include "pch.h"
+
+#include "Renderable/Model/Mesh/MeshSimplifier.hpp"
+#include "Renderable/Model/Mesh/MeshOptimizer.hpp"
+#include "Renderable/IRenderable/IRenderable.hpp"
+#include "Utils/Hash.hpp"
+
+#include <algorithm>
+#include <limits>
+
+namespace Lexvi {
+    namespace {
+        // border planes are weighted up so open edges barely move
+        constexpr double BORDER_WEIGHT = 10.0;
+        // levels have to drop at least this much of the previous one to be worth keeping
+        constexpr float MIN_LEVEL_REDUCTION = 0.85f;
+        constexpr size_t MIN_LEVEL_TRIANGLES = 16;
+        constexpr double NO_COLLAPSE = std::numeric_limits<double>::max();
+
+        // Symmetric 4x4 sum of weighted plane equations, weight keeps the total so errors stay distances
+        struct Quadric {
+            double a2 = 0, ab = 0, ac = 0, ad = 0;
+            double b2 = 0, bc = 0, bd = 0;
+            double c2 = 0, cd = 0;
+            double d2 = 0;
+            double weight = 0;
+
+            void addPlane(const glm::dvec3& n, double d, double w) {
+                a2 += w * n.x * n.x; ab += w * n.x * n.y; ac += w * n.x * n.z; ad += w * n.x * d;
+                b2 += w * n.y * n.y; bc += w * n.y * n.z; bd += w * n.y * d;
+                c2 += w * n.z * n.z; cd += w * n.z * d;
+                d2 += w * d * d;
+                weight += w;
+            }
+
+            Quadric& operator+=(const Quadric& q) {
+                a2 += q.a2; ab += q.ab; ac += q.ac; ad += q.ad;
+                b2 += q.b2; bc += q.bc; bd += q.bd;
+                c2 += q.c2; cd += q.cd;
+                d2 += q.d2;
+                weight += q.weight;
+                return *this;
+            }
+
+            // weighted mean squared distance of p to the planes
+            double error(const glm::dvec3& p) const {
+                double e = a2 * p.x * p.x + b2 * p.y * p.y + c2 * p.z * p.z
+                    + 2.0 * (ab * p.x * p.y + ac * p.x * p.z + bc * p.y * p.z)
+                    + 2.0 * (ad * p.x + bd * p.y + cd * p.z) + d2;
+                return std::max(e, 0.0) / (weight > 0.0 ? weight : 1.0);
+            }
+        };
+
+        struct Collapse {
+            uint32_t source;
+            uint32_t target;
+            double cost; // squared distance
+        };
+
+        // Index of the first vertex at each vertex's position
+        std::vector<uint32_t> ShareablePositions(const std::vector<Vertex>& vertices) {
+            auto hash = [&](uint32_t v) { return static_cast<size_t>(Hash::FNV1a(&vertices[v].Position, sizeof(glm::vec3))); };
+            auto equal = [&](uint32_t a, uint32_t b) { return vertices[a].Position == vertices[b].Position; };
+            std::unordered_map<uint32_t, uint32_t, decltype(hash), decltype(equal)> first(vertices.size(), hash, equal);
+
+            std::vector<uint32_t> canonical(vertices.size());
+            for (uint32_t v = 0; v < vertices.size(); ++v) canonical[v] = first.try_emplace(v, v).first->second;
+            return canonical;
+        }
+
+        uint64_t EdgeKey(uint32_t a, uint32_t b) {
+            return a < b ? (static_cast<uint64_t>(a) << 32) | b : (static_cast<uint64_t>(b) << 32) | a;
+        }
+
+        // Moving position source onto target must not turn any remaining triangle around it over or on its side
+        bool FlipsTriangles(uint32_t source, uint32_t target, const std::vector<Vertex>& vertices, const std::vector<uint32_t>& canonical,
+            const std::vector<unsigned int>& indices, const std::vector<uint32_t>& adjacencyOffset, const std::vector<uint32_t>& adjacency) {
+            const glm::vec3& moved = vertices[target].Position;
+
+            for (uint32_t a = adjacencyOffset[source]; a < adjacencyOffset[source + 1]; ++a) {
+                const unsigned int* triangle = &indices[adjacency[a] * 3];
+                uint32_t corners[3] = { canonical[triangle[0]], canonical[triangle[1]], canonical[triangle[2]] };
+                if (corners[0] == target || corners[1] == target || corners[2] == target) continue; // collapses away
+
+                glm::vec3 p[3], q[3];
+                for (int k = 0; k < 3; ++k) {
+                    p[k] = vertices[triangle[k]].Position;
+                    q[k] = corners[k] == source ? moved : p[k];
+                }
+                glm::vec3 before = glm::cross(p[1] - p[0], p[2] - p[0]);
+                glm::vec3 after = glm::cross(q[1] - q[0], q[2] - q[0]);
+                // slivers standing up on the surface are as bad as folds, keep turns under ~75 degrees
+                if (glm::dot(before, after) <= 0.25f * glm::length(before) * glm::length(after)) return true;
+            }
+            return false;
+        }
+
+        // The vertex of a position group that best continues v's attributes, UVs first, then normals
+        uint32_t MatchingVertex(uint32_t v, const uint32_t* first, const uint32_t* last, const std::vector<Vertex>& vertices) {
+            uint32_t best = *first;
+            float bestScore = std::numeric_limits<float>::max();
+            for (const uint32_t* w = first; w != last; ++w) {
+                glm::vec2 uv = vertices[*w].TexCoords - vertices[v].TexCoords;
+                float score = glm::dot(uv, uv) * 4.0f + (1.0f - glm::dot(vertices[*w].Normal, vertices[v].Normal));
+                if (score < bestScore) {
+                    bestScore = score;
+                    best = *w;
+                }
+            }
+            return best;
+        }
+    }
+
+    std::vector<unsigned int> SimplifyMesh(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices,
+        size_t targetIndexCount, float maxError, float* resultError)
+    {
+        std::vector<unsigned int> result = indices;
+        double worstCost = 0.0;
+
+        if (indices.size() % 3 != 0 || vertices.empty()) {
+            if (resultError) *resultError = 0.0f;
+            return result;
+        }
+
+        size_t vertexCount = vertices.size();
+        // Topology is simplified per position, the vertices sharing one (unwelded copies, hard edges)
+        // move together. Positions are named by their canonical vertex.
+        std::vector<uint32_t> canonical = ShareablePositions(vertices);
+        std::vector<uint32_t> groupOffset(vertexCount + 1, 0), groupMembers(vertexCount);
+        for (uint32_t v = 0; v < vertexCount; ++v) ++groupOffset[canonical[v] + 1];
+        for (size_t v = 0; v < vertexCount; ++v) groupOffset[v + 1] += groupOffset[v];
+        {
+            std::vector<uint32_t> fill(groupOffset.begin(), groupOffset.end() - 1);
+            for (uint32_t v = 0; v < vertexCount; ++v) groupMembers[fill[canonical[v]]++] = v;
+        }
+
+        // texture seams would tear open if only one side moved, so positions whose vertices disagree on UVs stay
+        std::vector<bool> locked(vertexCount, false);
+        for (uint32_t v = 0; v < vertexCount; ++v) {
+            if (vertices[v].TexCoords != vertices[canonical[v]].TexCoords) locked[canonical[v]] = true;
+        }
+
+        // edge use counts by position, so seams don't look like borders
+        std::unordered_map<uint64_t, uint32_t> edgeUse;
+        edgeUse.reserve(indices.size());
+        for (size_t i = 0; i < indices.size(); i += 3) {
+            for (int k = 0; k < 3; ++k) ++edgeUse[EdgeKey(canonical[indices[i + k]], canonical[indices[i + (k + 1) % 3]])];
+        }
+
+        std::vector<Quadric> quadrics(vertexCount);
+        for (size_t i = 0; i < indices.size(); i += 3) {
+            glm::dvec3 p[3] = { glm::dvec3(vertices[indices[i]].Position), glm::dvec3(vertices[indices[i + 1]].Position), glm::dvec3(vertices[indices[i + 2]].Position) };
+            glm::dvec3 normal = glm::cross(p[1] - p[0], p[2] - p[0]);
+            double length = glm::length(normal);
+            if (length <= 0.0) continue;
+
+            normal /= length;
+            double area = length * 0.5;
+            for (int k = 0; k < 3; ++k) quadrics[canonical[indices[i + k]]].addPlane(normal, -glm::dot(normal, p[0]), area);
+
+            // a plane through each open edge, perpendicular to the triangle
+            for (int k = 0; k < 3; ++k) {
+                uint32_t a = indices[i + k], b = indices[i + (k + 1) % 3];
+                if (edgeUse[EdgeKey(canonical[a], canonical[b])] != 1) continue;
+
+                glm::dvec3 edge = p[(k + 1) % 3] - p[k];
+                double edgeLength2 = glm::dot(edge, edge);
+                if (edgeLength2 <= 0.0) continue;
+
+                glm::dvec3 border = glm::normalize(glm::cross(edge, normal));
+                double d = -glm::dot(border, p[k]);
+                quadrics[canonical[a]].addPlane(border, d, edgeLength2 * BORDER_WEIGHT);
+                quadrics[canonical[b]].addPlane(border, d, edgeLength2 * BORDER_WEIGHT);
+            }
+        }
+
+        double maxCost = static_cast<double>(maxError) * maxError;
+        std::vector<uint64_t> edges;
+        std::vector<Collapse> collapses;
+        std::vector<uint32_t> adjacencyOffset(vertexCount + 1), adjacency;
+        std::vector<uint32_t> remap(vertexCount);       // per position
+        std::vector<uint32_t> vertexRemap(vertexCount); // per vertex of a moved position
+        std::vector<bool> touched(vertexCount);
+
+        // Each pass collapses an independent set of the cheapest edges, then rebuilds. Cheaper than
+        // keeping a heap of every edge up to date, and the passes get shorter as the mesh shrinks.
+        while (result.size() > targetIndexCount) {
+            edges.clear();
+            for (size_t i = 0; i < result.size(); i += 3) {
+                for (int k = 0; k < 3; ++k) {
+                    uint32_t a = canonical[result[i + k]], b = canonical[result[i + (k + 1) % 3]];
+                    if (a != b) edges.push_back(EdgeKey(a, b));
+                }
+            }
+            std::sort(edges.begin(), edges.end());
+            edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+
+            collapses.clear();
+            for (uint64_t edge : edges) {
+                uint32_t a = static_cast<uint32_t>(edge >> 32), b = static_cast<uint32_t>(edge);
+                Quadric q = quadrics[a];
+                q += quadrics[b];
+
+                // the surviving vertex keeps its position, the removed one can't be locked
+                double costA = locked[b] ? NO_COLLAPSE : q.error(glm::dvec3(vertices[a].Position)); // b onto a
+                double costB = locked[a] ? NO_COLLAPSE : q.error(glm::dvec3(vertices[b].Position)); // a onto b
+                if (costA == NO_COLLAPSE && costB == NO_COLLAPSE) continue;
+
+                if (costB <= costA) collapses.push_back({ a, b, costB });
+                else collapses.push_back({ b, a, costA });
+            }
+            if (collapses.empty()) break;
+            std::sort(collapses.begin(), collapses.end(), [](const Collapse& x, const Collapse& y) { return x.cost < y.cost; });
+
+            std::fill(adjacencyOffset.begin(), adjacencyOffset.end(), 0);
+            for (unsigned int index : result) ++adjacencyOffset[canonical[index] + 1];
+            for (size_t v = 0; v < vertexCount; ++v) adjacencyOffset[v + 1] += adjacencyOffset[v];
+            adjacency.resize(result.size());
+            {
+                std::vector<uint32_t> fill(adjacencyOffset.begin(), adjacencyOffset.end() - 1);
+                for (size_t i = 0; i < result.size(); ++i) adjacency[fill[canonical[result[i]]]++] = static_cast<uint32_t>(i / 3);
+            }
+
+            for (uint32_t v = 0; v < vertexCount; ++v) remap[v] = v;
+            std::fill(touched.begin(), touched.end(), false);
+
+            size_t triangles = result.size() / 3;
+            size_t targetTriangles = targetIndexCount / 3;
+            size_t applied = 0;
+
+            for (const Collapse& collapse : collapses) {
+                if (collapse.cost > maxCost || triangles <= targetTriangles) break;
+                if (touched[collapse.source] || touched[collapse.target]) continue;
+                if (FlipsTriangles(collapse.source, collapse.target, vertices, canonical, result, adjacencyOffset, adjacency)) continue;
+
+                // the whole ring around source changes, nothing in it may collapse again this pass
+                for (uint32_t a = adjacencyOffset[collapse.source]; a < adjacencyOffset[collapse.source + 1]; ++a) {
+                    const unsigned int* triangle = &result[adjacency[a] * 3];
+                    uint32_t corners[3] = { canonical[triangle[0]], canonical[triangle[1]], canonical[triangle[2]] };
+                    bool removed = corners[0] == collapse.target || corners[1] == collapse.target || corners[2] == collapse.target;
+                    if (removed) --triangles;
+                    for (int k = 0; k < 3; ++k) touched[corners[k]] = true;
+                }
+
+                remap[collapse.source] = collapse.target;
+                const uint32_t* targetFirst = &groupMembers[groupOffset[collapse.target]];
+                const uint32_t* targetLast = targetFirst + (groupOffset[collapse.target + 1] - groupOffset[collapse.target]);
+                for (uint32_t m = groupOffset[collapse.source]; m < groupOffset[collapse.source + 1]; ++m) {
+                    vertexRemap[groupMembers[m]] = MatchingVertex(groupMembers[m], targetFirst, targetLast, vertices);
+                }
+                quadrics[collapse.target] += quadrics[collapse.source];
+                worstCost = std::max(worstCost, collapse.cost);
+                ++applied;
+            }
+            if (applied == 0) break;
+
+            size_t write = 0;
+            for (size_t i = 0; i < result.size(); i += 3) {
+                unsigned int corner[3];
+                uint32_t position[3];
+                for (int k = 0; k < 3; ++k) {
+                    unsigned int v = result[i + k];
+                    position[k] = remap[canonical[v]];
+                    corner[k] = position[k] == canonical[v] ? v : vertexRemap[v];
+                }
+                if (position[0] == position[1] || position[1] == position[2] || position[0] == position[2]) continue;
+                result[write++] = corner[0];
+                result[write++] = corner[1];
+                result[write++] = corner[2];
+            }
+            result.resize(write);
+        }
+
+        if (resultError) *resultError = static_cast<float>(std::sqrt(worstCost));
+        return result;
+    }
+
+    std::vector<MeshLod> GenerateLods(const std::vector<Vertex>& vertices, std::vector<unsigned int>& indices, const MeshLodOptions& options)
+    {
+        std::vector<MeshLod> lods = { { 0, static_cast<uint32_t>(indices.size()), 0.0f } };
+        if (options.maxLevels == 0 || indices.size() % 3 != 0) return lods;
+
+        CameraAABB box;
+        glm::vec4 sphere;
+        ComputeBounds(vertices, &Vertex::Position, box, sphere);
+        float maxError = options.maxError * sphere.w;
+
+        // every level starts over from the full mesh so its error is measured against it
+        const std::vector<unsigned int> full = indices;
+        size_t previous = full.size();
+
+        for (uint32_t level = 0; level < options.maxLevels; ++level) {
+            size_t target = static_cast<size_t>(previous / 3 * options.reduction) * 3;
+            if (target < MIN_LEVEL_TRIANGLES * 3) break;
+
+            float error = 0.0f;
+            std::vector<unsigned int> simplified = SimplifyMesh(vertices, full, target, maxError, &error);
+            if (simplified.empty() || simplified.size() > previous * MIN_LEVEL_REDUCTION) break;
+
+            OptimizeVertexCache(simplified, vertices.size());
+
+            // errors only ever grow along the chain, selection relies on it
+            lods.push_back({ static_cast<uint32_t>(indices.size()), static_cast<uint32_t>(simplified.size()), std::max(error, lods.back().error) });
+            indices.insert(indices.end(), simplified.begin(), simplified.end());
+            previous = simplified.size();
+        }
+        return lods;
+    }
+}
@@ -0,0 +1,285 @@
+#include "pch.h"
+
+#include "Renderable/Model/Mesh/Meshlet.hpp"
+#include "Renderable/Model/Mesh/MeshOptimizer.hpp"
+
+#include <algorithm>
+#include <limits>
+
+namespace Lexvi {
+    namespace {
+        constexpr uint32_t NONE = 0xFFFFFFFFu;
+        // normals spreading wider than about 84 degrees from the axis make the cone useless
+        constexpr float MIN_CONE_DOT = 0.1f;
+        // how many cells away from a meshlet's center a new seed is looked for, further ones would blow up its bounds
+        constexpr int SEED_SEARCH_RINGS = 4;
+
+        // Triangle centroids bucketed on a uniform grid, assigned triangles are dropped from their cell as they're met
+        class CentroidGrid {
+            glm::vec3 origin{ 0.0f };
+            float cellSize = 1.0f;
+            glm::ivec3 dims{ 1 };
+            std::vector<uint32_t> cellOffset;
+            std::vector<uint32_t> cellEnd;
+            std::vector<uint32_t> cellTriangles;
+
+            glm::ivec3 cellOf(const glm::vec3& p) const {
+                return glm::clamp(glm::ivec3((p - origin) / cellSize), glm::ivec3(0), dims - 1);
+            }
+            uint32_t cellIndex(const glm::ivec3& c) const {
+                return static_cast<uint32_t>((c.z * dims.y + c.y) * dims.x + c.x);
+            }
+
+        public:
+            explicit CentroidGrid(const std::vector<glm::vec3>& centroids) {
+                glm::vec3 boxMin(std::numeric_limits<float>::max()), boxMax(-std::numeric_limits<float>::max());
+                for (const glm::vec3& c : centroids) {
+                    boxMin = glm::min(boxMin, c);
+                    boxMax = glm::max(boxMax, c);
+                }
+                glm::vec3 extent = boxMax - boxMin;
+                float maxExtent = std::max(extent.x, std::max(extent.y, extent.z));
+
+                // about a triangle per cell filling the box, meshes are surfaces so occupied cells hold more
+                int resolution = std::max(1, static_cast<int>(std::cbrt(static_cast<double>(centroids.size()))));
+                origin = boxMin;
+                cellSize = maxExtent > 0.0f ? maxExtent / resolution : 1.0f;
+                for (int a = 0; a < 3; ++a) dims[a] = std::clamp(static_cast<int>(extent[a] / cellSize) + 1, 1, resolution);
+
+                cellOffset.assign(static_cast<size_t>(dims.x) * dims.y * dims.z + 1, 0);
+                for (const glm::vec3& c : centroids) ++cellOffset[cellIndex(cellOf(c)) + 1];
+                for (size_t i = 1; i < cellOffset.size(); ++i) cellOffset[i] += cellOffset[i - 1];
+                cellEnd.assign(cellOffset.begin() + 1, cellOffset.end());
+
+                cellTriangles.resize(centroids.size());
+                std::vector<uint32_t> fill(cellOffset.begin(), cellOffset.end() - 1);
+                for (size_t t = 0; t < centroids.size(); ++t) cellTriangles[fill[cellIndex(cellOf(centroids[t]))]++] = static_cast<uint32_t>(t);
+            }
+
+            // Nearest unassigned triangle to point that accept takes, NONE if there's none within SEED_SEARCH_RINGS
+            template<typename Accept>
+            uint32_t findNearest(const glm::vec3& point, const std::vector<glm::vec3>& centroids, const std::vector<bool>& assigned, Accept&& accept) {
+                glm::ivec3 center = cellOf(point);
+                uint32_t best = NONE;
+                float bestDistance2 = std::numeric_limits<float>::max();
+
+                for (int ring = 0; ring <= SEED_SEARCH_RINGS; ++ring) {
+                    // nothing in this ring can be closer than its inner edge
+                    float bound = (ring - 1) * cellSize;
+                    if (best != NONE && bound > 0.0f && bound * bound >= bestDistance2) break;
+
+                    glm::ivec3 lo = glm::max(center - ring, glm::ivec3(0));
+                    glm::ivec3 hi = glm::min(center + ring, dims - 1);
+                    for (int z = lo.z; z <= hi.z; ++z) {
+                        for (int y = lo.y; y <= hi.y; ++y) {
+                            for (int x = lo.x; x <= hi.x; ++x) {
+                                glm::ivec3 d = glm::abs(glm::ivec3(x, y, z) - center);
+                                if (std::max(d.x, std::max(d.y, d.z)) != ring) continue;
+
+                                uint32_t cell = cellIndex(glm::ivec3(x, y, z));
+                                for (uint32_t i = cellOffset[cell]; i < cellEnd[cell];) {
+                                    uint32_t t = cellTriangles[i];
+                                    if (assigned[t]) {
+                                        cellTriangles[i] = cellTriangles[--cellEnd[cell]];
+                                        continue;
+                                    }
+                                    ++i;
+
+                                    glm::vec3 offset = centroids[t] - point;
+                                    float distance2 = glm::dot(offset, offset);
+                                    if (distance2 < bestDistance2 && accept(t)) {
+                                        bestDistance2 = distance2;
+                                        best = t;
+                                    }
+                                }
+                            }
+                        }
+                    }
+                }
+                return best;
+            }
+        };
+
+        void ComputeMeshletBounds(Meshlet& meshlet, const std::vector<Vertex>& vertices, const unsigned int* indices) {
+            glm::vec3 boxMin(std::numeric_limits<float>::max()), boxMax(-std::numeric_limits<float>::max());
+            for (uint32_t i = 0; i < meshlet.indexCount; ++i) {
+                boxMin = glm::min(boxMin, vertices[indices[i]].Position);
+                boxMax = glm::max(boxMax, vertices[indices[i]].Position);
+            }
+            glm::vec3 center = (boxMin + boxMax) * 0.5f;
+
+            float radius2 = 0.0f;
+            glm::vec3 normalSum(0.0f);
+            for (uint32_t i = 0; i < meshlet.indexCount; i += 3) {
+                const glm::vec3& p0 = vertices[indices[i]].Position;
+                const glm::vec3& p1 = vertices[indices[i + 1]].Position;
+                const glm::vec3& p2 = vertices[indices[i + 2]].Position;
+                for (const glm::vec3* p : { &p0, &p1, &p2 }) radius2 = std::max(radius2, glm::dot(*p - center, *p - center));
+                normalSum += glm::cross(p1 - p0, p2 - p0); // area weighted
+            }
+            meshlet.sphere = glm::vec4(center, std::sqrt(radius2));
+
+            float length = glm::length(normalSum);
+            if (length <= 0.0f) {
+                meshlet.cone = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+                return;
+            }
+            glm::vec3 axis = normalSum / length;
+
+            float minDot = 1.0f;
+            for (uint32_t i = 0; i < meshlet.indexCount; i += 3) {
+                const glm::vec3& p0 = vertices[indices[i]].Position;
+                glm::vec3 n = glm::cross(vertices[indices[i + 1]].Position - p0, vertices[indices[i + 2]].Position - p0);
+                float nLength = glm::length(n);
+                if (nLength > 0.0f) minDot = std::min(minDot, glm::dot(n / nLength, axis));
+            }
+
+            // culled when the view direction is within 90 degrees minus the spread of the axis' reverse
+            float cutoff = minDot <= MIN_CONE_DOT ? 1.0f : std::sqrt(1.0f - minDot * minDot);
+            meshlet.cone = glm::vec4(axis, cutoff);
+        }
+    }
+
+    std::vector<Meshlet> BuildMeshlets(const std::vector<Vertex>& vertices, std::vector<unsigned int>& indices, size_t indexCount)
+    {
+        std::vector<Meshlet> meshlets;
+        if (indexCount == 0 || indexCount % 3 != 0) return meshlets;
+
+        size_t triangleCount = indexCount / 3;
+        size_t vertexCount = vertices.size();
+
+        std::vector<uint32_t> adjacencyOffset(vertexCount + 1, 0);
+        for (size_t i = 0; i < indexCount; ++i) ++adjacencyOffset[indices[i] + 1];
+        for (size_t v = 0; v < vertexCount; ++v) adjacencyOffset[v + 1] += adjacencyOffset[v];
+        std::vector<uint32_t> adjacency(indexCount);
+        {
+            std::vector<uint32_t> fill(adjacencyOffset.begin(), adjacencyOffset.end() - 1);
+            for (size_t i = 0; i < indexCount; ++i) adjacency[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+        }
+
+        std::vector<glm::vec3> normals(triangleCount);
+        std::vector<glm::vec3> centroids(triangleCount);
+        for (size_t t = 0; t < triangleCount; ++t) {
+            const glm::vec3& p0 = vertices[indices[t * 3]].Position;
+            const glm::vec3& p1 = vertices[indices[t * 3 + 1]].Position;
+            const glm::vec3& p2 = vertices[indices[t * 3 + 2]].Position;
+            glm::vec3 n = glm::cross(p1 - p0, p2 - p0);
+            float length = glm::length(n);
+            normals[t] = length > 0.0f ? n / length : glm::vec3(0.0f);
+            centroids[t] = (p0 + p1 + p2) / 3.0f;
+        }
+        CentroidGrid grid(centroids);
+
+        std::vector<bool> assigned(triangleCount, false);
+        std::vector<uint32_t> vertexMeshlet(vertexCount, NONE); // last meshlet that used the vertex
+        std::vector<uint32_t> candidates;
+        std::vector<unsigned int> output;
+        output.reserve(indexCount);
+
+        size_t cursor = 0;
+        while (true) {
+            while (cursor < triangleCount && assigned[cursor]) ++cursor;
+            if (cursor == triangleCount) break;
+
+            uint32_t id = static_cast<uint32_t>(meshlets.size());
+            Meshlet meshlet;
+            meshlet.firstIndex = static_cast<uint32_t>(output.size());
+
+            uint32_t meshletVertices = 0;
+            uint32_t meshletTriangles = 0;
+            glm::vec3 normalSum(0.0f);
+            glm::vec3 centroidSum(0.0f);
+            candidates.clear();
+
+            uint32_t next = static_cast<uint32_t>(cursor);
+            while (next != NONE) {
+                assigned[next] = true;
+                ++meshletTriangles;
+                normalSum += normals[next];
+                centroidSum += centroids[next];
+                for (int k = 0; k < 3; ++k) {
+                    uint32_t v = indices[next * 3 + k];
+                    output.push_back(v);
+                    if (vertexMeshlet[v] == id) continue;
+
+                    vertexMeshlet[v] = id;
+                    ++meshletVertices;
+                    for (uint32_t a = adjacencyOffset[v]; a < adjacencyOffset[v + 1]; ++a)
+                        if (!assigned[adjacency[a]]) candidates.push_back(adjacency[a]);
+                }
+                if (meshletTriangles == MESHLET_MAX_TRIANGLES) break;
+
+                // fewest new vertices first, then the one facing most like the meshlet so far
+                next = NONE;
+                uint32_t bestExtra = 4;
+                float bestFacing = -2.0f;
+                size_t write = 0;
+                auto extraVertices = [&](uint32_t t) {
+                    uint32_t extra = 0;
+                    for (int k = 0; k < 3; ++k) extra += vertexMeshlet[indices[t * 3 + k]] == id ? 0 : 1;
+                    return extra;
+                };
+                for (uint32_t t : candidates) {
+                    if (assigned[t]) continue;
+                    candidates[write++] = t;
+
+                    uint32_t extra = extraVertices(t);
+                    if (meshletVertices + extra > MESHLET_MAX_VERTICES) continue;
+
+                    float facing = glm::dot(normals[t], normalSum);
+                    if (extra < bestExtra || (extra == bestExtra && facing > bestFacing)) {
+                        bestExtra = extra;
+                        bestFacing = facing;
+                        next = t;
+                    }
+                }
+                candidates.resize(write); // a triangle can be listed once per vertex, that's harmless
+
+                // ran out of connected triangles (an island or a pocket enclosed by other meshlets),
+                // keep filling from the closest unassigned ones instead of leaving a fragment; those
+                // share no vertex with the meshlet so they need room for three
+                if (next == NONE && meshletVertices + 3 <= MESHLET_MAX_VERTICES) {
+                    next = grid.findNearest(centroidSum / static_cast<float>(meshletTriangles), centroids, assigned,
+                        [&](uint32_t t) { return meshletVertices + extraVertices(t) <= MESHLET_MAX_VERTICES; });
+                }
+            }
+
+            meshlet.indexCount = static_cast<uint32_t>(output.size()) - meshlet.firstIndex;
+            ComputeMeshletBounds(meshlet, vertices, output.data() + meshlet.firstIndex);
+            meshlets.push_back(meshlet);
+        }
+
+        // the build order follows adjacency, not the post-transform cache, so each meshlet is reordered
+        // on its own (local ids keep it proportional to the meshlet rather than the mesh)
+        std::vector<unsigned int> local;
+        std::vector<unsigned int> localToVertex;
+        std::vector<uint32_t> vertexToLocal(vertexCount, NONE);
+        for (const Meshlet& meshlet : meshlets) {
+            local.clear();
+            localToVertex.clear();
+            for (uint32_t i = meshlet.firstIndex; i < meshlet.firstIndex + meshlet.indexCount; ++i) {
+                unsigned int v = output[i];
+                if (vertexToLocal[v] == NONE) {
+                    vertexToLocal[v] = static_cast<uint32_t>(localToVertex.size());
+                    localToVertex.push_back(v);
+                }
+                local.push_back(vertexToLocal[v]);
+            }
+
+            OptimizeVertexCache(local, localToVertex.size());
+            for (uint32_t i = 0; i < meshlet.indexCount; ++i) output[meshlet.firstIndex + i] = localToVertex[local[i]];
+            for (unsigned int v : localToVertex) vertexToLocal[v] = NONE;
+        }
+
+        std::copy(output.begin(), output.end(), indices.begin());
+        return meshlets;
+    }
+
+    bool IsMeshletBackfacing(const Meshlet& meshlet, const glm::vec3& cameraPosition)
+    {
+        if (meshlet.cone.w >= 1.0f) return false;
+
+        glm::vec3 toCenter = glm::vec3(meshlet.sphere) - cameraPosition;
+        return glm::dot(toCenter, glm::vec3(meshlet.cone)) >= meshlet.cone.w * glm::length(toCenter) + meshlet.sphere.w;
+    }
+}
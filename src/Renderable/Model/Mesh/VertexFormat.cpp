@@ -0,0 +1,172 @@
+#include "pch.h"
+
+#include "Renderable/Model/Mesh/VertexFormat.hpp"
+
+#include <glm/gtc/packing.hpp>
+
+namespace Lexvi {
+    namespace {
+        int16_t ToSnorm16(float value) {
+            return static_cast<int16_t>(std::round(glm::clamp(value, -1.0f, 1.0f) * 32767.0f));
+        }
+
+        uint16_t ToUnorm16(float value) {
+            return static_cast<uint16_t>(std::round(glm::clamp(value, 0.0f, 1.0f) * 65535.0f));
+        }
+
+        // Octahedral projection of a unit vector onto [-1, 1]^2
+        glm::vec2 OctahedralEncode(glm::vec3 n) {
+            n /= std::abs(n.x) + std::abs(n.y) + std::abs(n.z);
+            glm::vec2 p(n.x, n.y);
+            if (n.z < 0.0f) {
+                p = (1.0f - glm::abs(glm::vec2(n.y, n.x))) * glm::vec2(n.x >= 0.0f ? 1.0f : -1.0f, n.y >= 0.0f ? 1.0f : -1.0f);
+            }
+            return p;
+        }
+
+        glm::vec3 SafeNormal(const glm::vec3& n) {
+            float length = glm::length(n);
+            return length > 1e-8f ? n / length : glm::vec3(0.0f, 0.0f, 1.0f);
+        }
+
+        // Tangent made orthogonal to the normal, any perpendicular when the mesh had none (no UVs)
+        glm::vec3 OrthogonalTangent(const glm::vec3& normal, const glm::vec3& tangent) {
+            glm::vec3 t = tangent - normal * glm::dot(normal, tangent);
+            if (glm::dot(t, t) > 1e-12f) return glm::normalize(t);
+
+            glm::vec3 axis = std::abs(normal.x) < 0.9f ? glm::vec3(1.0f, 0.0f, 0.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+            return glm::normalize(glm::cross(normal, axis));
+        }
+
+        // Shared by both packed layouts, everything but the position
+        template<typename PackedType>
+        void PackAttributes(const Vertex& vertex, PackedType& packed) {
+            glm::vec3 normal = SafeNormal(vertex.Normal);
+            glm::vec2 n = OctahedralEncode(normal);
+            packed.normal[0] = ToSnorm16(n.x);
+            packed.normal[1] = ToSnorm16(n.y);
+
+            uint32_t uv = glm::packHalf2x16(vertex.TexCoords);
+            packed.texCoords[0] = static_cast<uint16_t>(uv & 0xFFFFu);
+            packed.texCoords[1] = static_cast<uint16_t>(uv >> 16);
+
+            glm::vec3 tangent = OrthogonalTangent(normal, vertex.Tangent);
+            glm::vec2 t = OctahedralEncode(tangent);
+            // the bitangent is cross(N, T) * sign, the sign takes the lowest bit of x
+            bool flipped = glm::dot(glm::cross(normal, tangent), vertex.Bitangent) < 0.0f;
+            packed.tangent[0] = static_cast<int16_t>((ToSnorm16(t.x) & ~1) | (flipped ? 1 : 0));
+            packed.tangent[1] = ToSnorm16(t.y);
+        }
+    }
+
+    uint32_t GetVertexSize(VertexLayout layout)
+    {
+        switch (layout) {
+        case VertexLayout::Packed: return sizeof(PackedVertex);
+        case VertexLayout::PackedQuantized: return sizeof(PackedQuantizedVertex);
+        default: return sizeof(Vertex);
+        }
+    }
+
+    void SetupVertexAttributes(unsigned int vao, VertexLayout layout)
+    {
+        auto attribute = [vao](GLuint location) {
+            glEnableVertexArrayAttrib(vao, location);
+            glVertexArrayAttribBinding(vao, location, 0);
+        };
+
+        if (layout == VertexLayout::Full) {
+            // Position, Normal, TexCoords, Tangent, Bitangent
+            for (GLuint i = 0; i < 5; ++i) attribute(i);
+            glVertexArrayAttribFormat(vao, 0, 3, GL_FLOAT, GL_FALSE, offsetof(Vertex, Position));
+            glVertexArrayAttribFormat(vao, 1, 3, GL_FLOAT, GL_FALSE, offsetof(Vertex, Normal));
+            glVertexArrayAttribFormat(vao, 2, 2, GL_FLOAT, GL_FALSE, offsetof(Vertex, TexCoords));
+            glVertexArrayAttribFormat(vao, 3, 3, GL_FLOAT, GL_FALSE, offsetof(Vertex, Tangent));
+            glVertexArrayAttribFormat(vao, 4, 3, GL_FLOAT, GL_FALSE, offsetof(Vertex, Bitangent));
+            return;
+        }
+
+        for (GLuint i = 0; i < 4; ++i) attribute(i);
+        if (layout == VertexLayout::Packed) {
+            glVertexArrayAttribFormat(vao, 0, 3, GL_FLOAT, GL_FALSE, offsetof(PackedVertex, position));
+            glVertexArrayAttribFormat(vao, 1, 2, GL_SHORT, GL_TRUE, offsetof(PackedVertex, normal));
+            glVertexArrayAttribFormat(vao, 2, 2, GL_HALF_FLOAT, GL_FALSE, offsetof(PackedVertex, texCoords));
+            glVertexArrayAttribIFormat(vao, 3, 2, GL_SHORT, offsetof(PackedVertex, tangent));
+        }
+        else {
+            glVertexArrayAttribFormat(vao, 0, 3, GL_UNSIGNED_SHORT, GL_TRUE, offsetof(PackedQuantizedVertex, position));
+            glVertexArrayAttribFormat(vao, 1, 2, GL_SHORT, GL_TRUE, offsetof(PackedQuantizedVertex, normal));
+            glVertexArrayAttribFormat(vao, 2, 2, GL_HALF_FLOAT, GL_FALSE, offsetof(PackedQuantizedVertex, texCoords));
+            glVertexArrayAttribIFormat(vao, 3, 2, GL_SHORT, offsetof(PackedQuantizedVertex, tangent));
+        }
+    }
+
+    void GetPositionDequantization(const CameraAABB& bounds, glm::vec3& scale, glm::vec3& offset)
+    {
+        scale = bounds.max - bounds.min;
+        offset = bounds.min;
+    }
+
+    std::vector<uint8_t> PackVertices(const std::vector<Vertex>& vertices, VertexLayout layout, const CameraAABB& bounds)
+    {
+        std::vector<uint8_t> bytes(vertices.size() * GetVertexSize(layout));
+
+        if (layout == VertexLayout::Full) {
+            if (!vertices.empty()) std::memcpy(bytes.data(), vertices.data(), bytes.size());
+            return bytes;
+        }
+
+        if (layout == VertexLayout::Packed) {
+            PackedVertex* packed = reinterpret_cast<PackedVertex*>(bytes.data());
+            for (size_t i = 0; i < vertices.size(); ++i) {
+                packed[i].position = vertices[i].Position;
+                PackAttributes(vertices[i], packed[i]);
+            }
+            return bytes;
+        }
+
+        // flat axes keep a zero extent, anything divided by it maps to 0
+        glm::vec3 extent = bounds.max - bounds.min;
+        glm::vec3 inverseExtent(
+            extent.x > 0.0f ? 1.0f / extent.x : 0.0f,
+            extent.y > 0.0f ? 1.0f / extent.y : 0.0f,
+            extent.z > 0.0f ? 1.0f / extent.z : 0.0f);
+
+        PackedQuantizedVertex* packed = reinterpret_cast<PackedQuantizedVertex*>(bytes.data());
+        for (size_t i = 0; i < vertices.size(); ++i) {
+            glm::vec3 local = (vertices[i].Position - bounds.min) * inverseExtent;
+            packed[i].position[0] = ToUnorm16(local.x);
+            packed[i].position[1] = ToUnorm16(local.y);
+            packed[i].position[2] = ToUnorm16(local.z);
+            packed[i].position[3] = 0;
+            PackAttributes(vertices[i], packed[i]);
+        }
+        return bytes;
+    }
+
+    std::string GetVertexFormatGLSL()
+    {
+        return
+            "// Set by quantized meshes while they draw, identity otherwise\n"
+            "uniform vec3 lexviPositionScale = vec3(1.0);\n"
+            "uniform vec3 lexviPositionOffset = vec3(0.0);\n"
+            "\n"
+            "vec3 LexviDecodePosition(vec3 stored) {\n"
+            "    return stored * lexviPositionScale + lexviPositionOffset;\n"
+            "}\n"
+            "\n"
+            "// Octahedral [-1, 1]^2 back to a unit vector\n"
+            "vec3 LexviDecodeOctahedral(vec2 f) {\n"
+            "    vec3 n = vec3(f, 1.0 - abs(f.x) - abs(f.y));\n"
+            "    float t = clamp(-n.z, 0.0, 1.0);\n"
+            "    n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);\n"
+            "    return normalize(n);\n"
+            "}\n"
+            "\n"
+            "// xyz = tangent, w = bitangent sign: bitangent = cross(normal, tangent) * w\n"
+            "vec4 LexviDecodeTangent(ivec2 stored) {\n"
+            "    float handedness = (stored.x & 1) != 0 ? -1.0 : 1.0;\n"
+            "    return vec4(LexviDecodeOctahedral(max(vec2(stored) / 32767.0, vec2(-1.0))), handedness);\n"
+            "}\n";
+    }
+}
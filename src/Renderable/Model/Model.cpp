@@ -1,30 +1,81 @@
 #include "pch.h"
 
 #include "Renderable/Model/Model.hpp"
+#include "Renderable/Model/ModelCache.hpp"
 
 namespace fs = std::filesystem;
 
 namespace Lexvi {
-
     void Model::Draw(const Shader* shader)
     {
         for (unsigned int i = 0; i < meshes.size(); i++)
-            meshes[i].Draw(shader);
+            meshes[i].Draw(shader, meshes[i].selectLod(transforms));
+    }
+
+    bool Model::DrawInstanced(const Shader* shader, uint32_t instanceCount, uint32_t baseInstance)
+    {
+        // instances each have their own transform, they all draw at full detail
+        for (unsigned int i = 0; i < meshes.size(); i++)
+            meshes[i].DrawInstanced(shader, instanceCount, baseInstance);
+        return true;
+    }
+
+    void Model::setSource(const std::string& path) {
+        fs::path p(path);
+        directory = p.parent_path().string();
+        // models loaded from the same file share their geometry id
+        geometryID = MakeGeometryID("Model", path.data(), path.size());
     }
 
     void Model::loadModel(const std::string& path) {
-        Assimp::Importer importer;
-        const aiScene* scene = importer.ReadFile(path,
-            aiProcess_Triangulate | aiProcess_CalcTangentSpace);
+        setSource(path);
+
+        uint64_t cacheKey = options.useCache ? ModelCache::MakeKey(path, options.meshFormat, IMPORT_FLAGS, options.optimize, options.lods, options.meshlets) : 0;
+        auto loader = [this](const std::string& texturePath, const std::string& type) { return loadTexture(texturePath, type); };
+        bool cached = options.useCache && GetModelCache().Load(cacheKey, meshes, loader);
+
+        if (!cached) {
+            Assimp::Importer importer;
+            const aiScene* scene = importer.ReadFile(path, IMPORT_FLAGS);
+
+            if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) {
+                std::cerr << "ASSIMP:: " << importer.GetErrorString() << std::endl;
+                return;
+            }
 
-        if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) {
-            std::cerr << "ASSIMP:: " << importer.GetErrorString() << std::endl;
-            return;
+            processNode(scene->mRootNode, scene);
+            if (options.useCache) GetModelCache().Store(cacheKey, meshes);
         }
 
-        fs::path p(path);
-        directory = p.parent_path().string();
-        processNode(scene->mRootNode, scene);
+        finishLoad();
+    }
+
+    void Model::finishLoad() {
+        // meshes sharing a material draw back to back so Draw skips the redundant binds
+        std::stable_sort(meshes.begin(), meshes.end(), [](const Mesh& a, const Mesh& b) {
+            return a.getMaterial()->getID() < b.getMaterial()->getID();
+        });
+
+        computeBounds();
+    }
+
+    void Model::computeBounds() {
+        if (meshes.empty()) return;
+
+        CameraAABB box = meshes[0].getBoundBox();
+        for (const Mesh& mesh : meshes) {
+            box.min = glm::min(box.min, mesh.getBoundBox().min);
+            box.max = glm::max(box.max, mesh.getBoundBox().max);
+        }
+
+        // sphere around the model's box that encloses every mesh sphere
+        glm::vec3 center = (box.min + box.max) * 0.5f;
+        float radius = 0.0f;
+        for (const Mesh& mesh : meshes) {
+            glm::vec4 sphere = mesh.getBoundingSphere();
+            radius = std::max(radius, glm::length(glm::vec3(sphere) - center) + sphere.w);
+        }
+        setLocalBounds(box, glm::vec4(center, radius));
     }
 
     void Model::processNode(aiNode* node, const aiScene* scene) {
@@ -38,12 +89,44 @@ namespace Lexvi {
     }
 
     Mesh Model::processMesh(aiMesh* mesh, const aiScene* scene) {
+        std::vector<Texture> textures;
+        for (const ModelCache::TextureRef& texture : GetTextureRefs(scene->mMaterials[mesh->mMaterialIndex]))
+            textures.push_back(loadTexture(texture.path, texture.type));
+
+        MeshOptimizationStats stats;
+        PreparedMesh prepared = ImportMesh(mesh, options, stats);
+        optimizationStats += stats;
+        return Mesh(std::move(prepared), std::move(textures));
+    }
+
+    PreparedMesh Model::ImportMesh(const aiMesh* mesh, const ModelImportOptions& options, MeshOptimizationStats& stats) {
         std::vector<Vertex> vertices;
         std::vector<unsigned int> indices;
-        std::vector<Texture> textures;
+        ConvertMesh(mesh, vertices, indices);
+
+        // points and lines Triangulate left alone would be torn apart by the triangle reordering
+        bool triangles = mesh->mPrimitiveTypes == aiPrimitiveType_TRIANGLE;
+        if (options.optimize && triangles)
+            stats = OptimizeMesh(vertices, indices);
+
+        // meshlets reorder the full mesh's triangles, so they're built before the LODs are appended
+        std::vector<Meshlet> meshlets;
+        if (options.meshlets && triangles) {
+            meshlets = BuildMeshlets(vertices, indices, indices.size());
+            // the triangle order OptimizeMesh measured is gone
+            if (options.optimize) stats.transformsAfter = SimulateVertexCache(indices, vertices.size());
+        }
+
+        std::vector<MeshLod> lods;
+        if (triangles) lods = GenerateLods(vertices, indices, options.lods);
 
+        return PrepareMesh(std::move(vertices), std::move(indices), options.meshFormat, std::move(lods), std::move(meshlets));
+    }
+
+    void Model::ConvertMesh(const aiMesh* mesh, std::vector<Vertex>& vertices, std::vector<unsigned int>& indices) {
+        vertices.resize(mesh->mNumVertices);
         for (unsigned int i = 0; i < mesh->mNumVertices; i++) {
-            Vertex vertex;
+            Vertex& vertex = vertices[i];
             vertex.Position = glm::vec3(mesh->mVertices[i].x, mesh->mVertices[i].y, mesh->mVertices[i].z);
             vertex.Normal = glm::vec3(mesh->mNormals[i].x, mesh->mNormals[i].y, mesh->mNormals[i].z);
 
@@ -65,66 +148,56 @@ namespace Lexvi {
                 mesh->mBitangents[i].y,
                 mesh->mBitangents[i].z)
                 : glm::vec3(0.0f);
-            vertices.push_back(vertex);
         }
 
+        // Triangulate leaves points and lines as they are, so faces aren't all 3 indices
+        size_t indexCount = 0;
+        for (unsigned int i = 0; i < mesh->mNumFaces; i++)
+            indexCount += mesh->mFaces[i].mNumIndices;
+
+        indices.clear();
+        indices.reserve(indexCount);
         for (unsigned int i = 0; i < mesh->mNumFaces; i++) {
-            aiFace face = mesh->mFaces[i];
-            for (unsigned int j = 0; j < face.mNumIndices; j++)
-                indices.push_back(face.mIndices[j]);
+            const aiFace& face = mesh->mFaces[i];
+            indices.insert(indices.end(), face.mIndices, face.mIndices + face.mNumIndices);
         }
+    }
 
-        if (mesh->mMaterialIndex >= 0) {
-            aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
-
-            auto diffuseMaps = loadMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse");
-            textures.insert(textures.end(), diffuseMaps.begin(), diffuseMaps.end());
-
-            auto specularMaps = loadMaterialTextures(material, aiTextureType_SPECULAR, "texture_specular");
-            textures.insert(textures.end(), specularMaps.begin(), specularMaps.end());
-
-            auto normalMaps = loadMaterialTextures(material, aiTextureType_NORMALS, "texture_normal");
-            textures.insert(textures.end(), normalMaps.begin(), normalMaps.end());
-
-            auto heightMaps = loadMaterialTextures(material, aiTextureType_HEIGHT, "texture_normal");
-            textures.insert(textures.end(), heightMaps.begin(), heightMaps.end());
-
-            auto roughMaps = loadMaterialTextures(material, aiTextureType_SHININESS, "texture_roughness");
-            textures.insert(textures.end(), roughMaps.begin(), roughMaps.end());
-
-            auto metalMaps = loadMaterialTextures(material, aiTextureType_METALNESS, "texture_metallic");
-            textures.insert(textures.end(), metalMaps.begin(), metalMaps.end());
-
-            auto aoMaps = loadMaterialTextures(material, aiTextureType_AMBIENT, "texture_ao");
-            textures.insert(textures.end(), aoMaps.begin(), aoMaps.end());
+    std::vector<ModelCache::TextureRef> Model::GetTextureRefs(const aiMaterial* material) {
+        static const std::pair<aiTextureType, const char*> types[] = {
+            { aiTextureType_DIFFUSE, "texture_diffuse" },
+            { aiTextureType_SPECULAR, "texture_specular" },
+            { aiTextureType_NORMALS, "texture_normal" },
+            { aiTextureType_HEIGHT, "texture_normal" },
+            { aiTextureType_SHININESS, "texture_roughness" },
+            { aiTextureType_METALNESS, "texture_metallic" },
+            { aiTextureType_AMBIENT, "texture_ao" },
+        };
+
+        std::vector<ModelCache::TextureRef> textures;
+        for (const auto& [type, typeName] : types) {
+            for (unsigned int i = 0; i < material->GetTextureCount(type); i++) {
+                aiString str;
+                material->GetTexture(type, i, &str);
+                textures.push_back({ str.C_Str(), typeName });
+            }
         }
-
-        return Mesh(vertices, indices, textures);
+        return textures;
     }
 
-    std::vector<Texture> Model::loadMaterialTextures(aiMaterial* mat, aiTextureType type, std::string typeName) {
-        std::vector<Texture> textures;
-        for (unsigned int i = 0; i < mat->GetTextureCount(type); i++) {
-            aiString str;
-            mat->GetTexture(type, i, &str);
-
-            bool skip = false;
-            for (auto& t : textures_loaded) {
-                if (std::strcmp(t.path.c_str(), str.C_Str()) == 0) {
-                    textures.push_back(t);
-                    skip = true;
-                    break;
-                }
-            }
-            if (!skip) {
-                Texture texture;
-                texture.id = TextureFromFile(str.C_Str(), directory);
-                texture.type = typeName;
-                texture.path = str.C_Str();
-                textures.push_back(texture);
-                textures_loaded.push_back(texture);
+    Texture Model::loadTexture(const std::string& path, const std::string& typeName) {
+        for (auto& t : textures_loaded) {
+            if (t.path == path) {
+                // the first type it was loaded as wins, as before
+                return t;
             }
         }
-        return textures;
+
+        Texture texture;
+        texture.id = TextureFromFile(path.c_str(), directory);
+        texture.type = typeName;
+        texture.path = path;
+        textures_loaded.push_back(texture);
+        return texture;
     }
 }
\ No newline at end of file
@@ -0,0 +1,239 @@
+#include "pch.h"
+
+#include "Renderable/Model/ModelBatch.hpp"
+#include "Renderable/Model/Mesh/MeshArena.hpp"
+#include "Renderer/BindingPoints.hpp"
+#include "Renderer/FrameConstants.hpp"
+#include "Renderer/GLState.hpp"
+#include "Shader/ShaderCache.hpp"
+#include "Textures/MaterialTextureTable.hpp"
+#include "Utils/IndirectBuffer.hpp"
+
+namespace Lexvi {
+    namespace {
+        const char* CULL_SHADER_SOURCE = R"(#version 460
+layout(local_size_x = 64) in;
+
+#include <Lexvi/Culling.glsl>
+#include <Lexvi/HiZ.glsl>
+
+struct DrawRecord {
+    uint indexCount;
+    uint firstIndex;
+    int baseVertex;
+    uint objectIndex;
+    vec4 sphere;
+    vec4 cone;
+    uint arena;
+    uint commandBase;
+};
+
+struct DrawCommand {
+    uint count;
+    uint instanceCount;
+    uint firstIndex;
+    int baseVertex;
+    uint baseInstance;
+};
+
+layout(std430, binding = LEXVI_RECORDS_BINDING) readonly buffer Records { DrawRecord records[]; };
+layout(std430, binding = LEXVI_COMMANDS_BINDING) writeonly buffer Commands { DrawCommand commands[]; };
+layout(std430, binding = LEXVI_DRAW_COUNT_BINDING) buffer DrawCount { uint drawCount[]; }; // per arena
+
+uniform uint recordCount;
+uniform bool coneCulling;
+uniform bool occlusionCulling;
+
+void main() {
+    uint group = gl_WorkGroupID.x + gl_WorkGroupID.y * gl_NumWorkGroups.x + gl_WorkGroupID.z * gl_NumWorkGroups.x * gl_NumWorkGroups.y;
+    uint index = group * gl_WorkGroupSize.x + gl_LocalInvocationIndex;
+    if (index >= recordCount) return;
+
+    DrawRecord record = records[index];
+    for (int i = 0; i < 6; ++i) {
+        vec4 plane = LexviCullPlane(i);
+        if (dot(plane.xyz, record.sphere.xyz) + plane.w < -record.sphere.w) return;
+    }
+
+    // every normal of the meshlet points away from anywhere the camera could see it from
+    if (coneCulling && record.cone.w < 1.0) {
+        vec3 toCenter = record.sphere.xyz - lexviCameraPosition.xyz;
+        if (dot(toCenter, record.cone.xyz) >= record.cone.w * length(toCenter) + record.sphere.w) return;
+    }
+
+    if (occlusionCulling && LexviHiZOccluded(record.sphere)) return;
+
+    uint slot = atomicAdd(drawCount[record.arena], 1u);
+    commands[record.commandBase + slot] = DrawCommand(record.indexCount, 1u, record.firstIndex, record.baseVertex, record.objectIndex);
+}
+)";
+
+        void EnsureCapacity(SSBO& ssbo, size_t size, uint32_t bindingPoint) {
+            if (!ssbo.id) CreateSSBO(ssbo, size, bindingPoint);
+            else if (ssbo.size < size) ResizeSSBO(ssbo, size * 2);
+        }
+    }
+
+    ModelBatch::~ModelBatch()
+    {
+        for (SSBO* ssbo : { &recordsSSBO, &objectDataSSBO, &commandsSSBO, &drawCountSSBO }) {
+            if (ssbo->id) DeleteSSBO(*ssbo);
+        }
+    }
+
+    uint32_t ModelBatch::Add(const Model& model, const glm::mat4& transform, const glm::vec4& params)
+    {
+        uint32_t instance = static_cast<uint32_t>(instances.size());
+        instances.push_back({ &model, static_cast<uint32_t>(records.size()), static_cast<uint32_t>(objectData.size()), transform, params });
+
+        const std::vector<Mesh>& meshes = model.getMeshes();
+        size_t recordCount = 0;
+        for (const Mesh& mesh : meshes) recordCount += getRecordCount(mesh);
+        records.resize(records.size() + recordCount);
+        objectData.resize(objectData.size() + meshes.size());
+
+        writeInstance(instance);
+        return instance;
+    }
+
+    void ModelBatch::SetTransform(uint32_t instance, const glm::mat4& transform)
+    {
+        instances[instance].transform = transform;
+        writeInstance(instance);
+    }
+
+    void ModelBatch::Clear()
+    {
+        instances.clear();
+        records.clear();
+        objectData.clear();
+        dirty = true;
+    }
+
+    uint32_t ModelBatch::getRecordCount(const Mesh& mesh) const
+    {
+        return useMeshlets && !mesh.getMeshlets().empty() ? static_cast<uint32_t>(mesh.getMeshlets().size()) : 1u;
+    }
+
+    void ModelBatch::writeInstance(uint32_t instance)
+    {
+        const Instance& inst = instances[instance];
+        const std::vector<Mesh>& meshes = inst.model->getMeshes();
+
+        // uniform scale bound for the sphere radius
+        glm::vec3 scales(glm::length(glm::vec3(inst.transform[0])),
+                         glm::length(glm::vec3(inst.transform[1])),
+                         glm::length(glm::vec3(inst.transform[2])));
+        float scale = std::max({ scales.x, scales.y, scales.z });
+
+        // cones only survive rotations and uniform scales; mirroring flips which side is the front
+        glm::mat3 rotation(inst.transform);
+        bool keepCones = scale - std::min({ scales.x, scales.y, scales.z }) <= scale * 1e-3f;
+        float handedness = glm::determinant(rotation) < 0.0f ? -1.0f : 1.0f;
+
+        auto worldSphere = [&](const glm::vec4& local) {
+            glm::vec3 center = glm::vec3(inst.transform * glm::vec4(glm::vec3(local), 1.0f));
+            return glm::vec4(center, local.w * scale);
+        };
+
+        uint32_t index = inst.firstRecord;
+        for (uint32_t i = 0; i < meshes.size(); ++i) {
+            const Mesh& mesh = meshes[i];
+            uint32_t object = inst.firstObject + i;
+            uint32_t arena = mesh.getArena().getSlot();
+
+            if (!useMeshlets || mesh.getMeshlets().empty()) {
+                records[index++] = { mesh.getIndexCount(), mesh.getFirstIndex(), mesh.getBaseVertex(), object, worldSphere(mesh.getBoundingSphere()), glm::vec4(0.0f, 0.0f, 0.0f, 1.0f), arena };
+            }
+            else {
+                for (const Meshlet& meshlet : mesh.getMeshlets()) {
+                    glm::vec4 cone(0.0f, 0.0f, 0.0f, 1.0f);
+                    if (keepCones && meshlet.cone.w < 1.0f) cone = glm::vec4(glm::normalize(rotation * glm::vec3(meshlet.cone)) * handedness, meshlet.cone.w);
+                    records[index++] = { meshlet.indexCount, meshlet.firstIndex, mesh.getBaseVertex(), object, worldSphere(meshlet.sphere), cone, arena };
+                }
+            }
+
+            objectData[object] = BuildObjectData(inst.transform, mesh.getMaterialIndex(), inst.params);
+            // normals aren't quantized, only the position part of the matrix changes
+            if (mesh.isQuantized()) objectData[object].model = inst.transform * mesh.getDequantization();
+        }
+        dirty = true;
+    }
+
+    void ModelBatch::upload()
+    {
+        size_t count = records.size();
+        EnsureCapacity(recordsSSBO, count * sizeof(DrawRecord), BindingPoints::BatchDrawRecordsSSBO);
+        EnsureCapacity(objectDataSSBO, objectData.size() * sizeof(ObjectData), BindingPoints::BatchObjectDataSSBO);
+        EnsureCapacity(commandsSSBO, count * sizeof(DrawElementsIndirectCommand), BindingPoints::BatchCommandsSSBO);
+        EnsureCapacity(drawCountSSBO, MeshArena::ARENA_COUNT * sizeof(uint32_t), BindingPoints::BatchDrawCountSSBO);
+
+        // every arena gets a contiguous range of the command buffer, as large as its record count
+        std::fill(std::begin(arenaRecords), std::end(arenaRecords), 0u);
+        for (const DrawRecord& record : records) arenaRecords[record.arena]++;
+        uint32_t bases[MeshArena::ARENA_COUNT];
+        uint32_t base = 0;
+        for (uint32_t i = 0; i < MeshArena::ARENA_COUNT; ++i) {
+            bases[i] = base;
+            base += arenaRecords[i];
+        }
+        for (DrawRecord& record : records) record.commandBase = bases[record.arena];
+
+        UpdateSSBO(recordsSSBO, records.data(), count * sizeof(DrawRecord), 0);
+        UpdateSSBO(objectDataSSBO, objectData.data(), objectData.size() * sizeof(ObjectData), 0);
+        dirty = false;
+    }
+
+    void ModelBatch::Draw(const Shader* shader)
+    {
+        if (records.empty()) return;
+
+        if (!cullShader) {
+            cullShader = GetShaderCache().GetComputeShaderFromSource(CULL_SHADER_SOURCE, {
+                { "LEXVI_RECORDS_BINDING", std::to_string(BindingPoints::BatchDrawRecordsSSBO) },
+                { "LEXVI_COMMANDS_BINDING", std::to_string(BindingPoints::BatchCommandsSSBO) },
+                { "LEXVI_DRAW_COUNT_BINDING", std::to_string(BindingPoints::BatchDrawCountSSBO) },
+            });
+        }
+        if (dirty) upload();
+
+        uint32_t count = static_cast<uint32_t>(records.size());
+
+        // cull: visible records are appended to their arena's range of the command buffer
+        uint32_t zero = 0;
+        glClearNamedBufferData(drawCountSSBO.id, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+        BindSSBO(recordsSSBO);
+        BindSSBO(commandsSSBO);
+        BindSSBO(drawCountSSBO);
+
+        cullShader->use();
+        cullShader->setUint("recordCount", count);
+        // cones and the pyramid are only valid from the camera, another frustum sees other sides and depths
+        SetCullFrustumUniforms(*cullShader, cullFrustum);
+        cullShader->setBool("coneCulling", coneCulling && !cullFrustum);
+        bool occlusion = !cullFrustum && hiZ && hiZ->isValid();
+        cullShader->setBool("occlusionCulling", occlusion);
+        if (occlusion) hiZ->Bind(*cullShader);
+        cullShader->DispatchThreads(static_cast<uint64_t>(count));
+        glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+
+        // draw: one call per arena for every visible meshlet of every model
+        shader->use();
+        BindSSBO(objectDataSSBO);
+        GetMaterialTextureTable().Bind();
+        GLState::BindDrawIndirectBuffer(commandsSSBO.id);
+        GLState::BindParameterBuffer(drawCountSSBO.id);
+
+        uint32_t base = 0;
+        for (uint32_t i = 0; i < MeshArena::ARENA_COUNT; ++i) {
+            if (arenaRecords[i] == 0) continue;
+
+            const MeshArena* arena = GetMeshArenaBySlot(i);
+            GLState::BindVertexArray(arena->getVAO());
+            glMultiDrawElementsIndirectCount(GL_TRIANGLES, arena->getIndexType(),
+                reinterpret_cast<const void*>(static_cast<uintptr_t>(base) * sizeof(DrawElementsIndirectCommand)),
+                static_cast<GLintptr>(i) * sizeof(uint32_t), arenaRecords[i], 0);
+            base += arenaRecords[i];
+        }
+    }
+}
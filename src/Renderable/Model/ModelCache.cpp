@@ -0,0 +1,390 @@
+#include "pch.h"
+
+#include "Renderable/Model/ModelCache.hpp"
+#include "Renderable/Model/Mesh/MeshArena.hpp"
+#include "Utils/Hash.hpp"
+
+#include <iomanip>
+
+namespace fs = std::filesystem;
+
+namespace Lexvi {
+    namespace {
+        constexpr uint32_t CACHE_MAGIC = 0x534D584C; // "LXMS"
+        constexpr uint32_t CACHE_VERSION = 5;
+        constexpr uint64_t BLOB_ALIGNMENT = 16;
+
+        struct CacheHeader {
+            uint32_t magic;
+            uint32_t version;
+            uint64_t key;
+            uint32_t meshCount;
+            uint32_t materialCount;
+            uint32_t textureCount;
+            uint32_t stringSize;
+            uint32_t lodCount;
+            uint32_t meshletCount;
+            uint64_t meshTable;     // byte offsets from the start of the file
+            uint64_t lodTable;
+            uint64_t meshletTable;
+            uint64_t materialTable;
+            uint64_t textureTable;
+            uint64_t strings;
+            uint64_t fileSize;
+        };
+
+        struct CacheMesh {
+            uint64_t vertexOffset;
+            uint64_t indexOffset;
+            uint32_t vertexCount;
+            uint32_t indexCount;
+            uint32_t material;
+            uint32_t layout;        // VertexLayout
+            uint32_t indexType;     // GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+            uint32_t firstLod;
+            uint32_t lodCount;
+            uint32_t firstMeshlet;
+            uint32_t meshletCount;
+            uint32_t padding;
+            glm::vec3 boundsMin;
+            glm::vec3 boundsMax;
+            glm::vec4 boundingSphere;
+        };
+
+        struct CacheMaterial {
+            uint32_t firstTexture;
+            uint32_t textureCount;
+        };
+
+        struct CacheTexture {
+            uint32_t type; // offsets into the string table
+            uint32_t path;
+        };
+
+        uint64_t Align(uint64_t offset) {
+            return (offset + BLOB_ALIGNMENT - 1) / BLOB_ALIGNMENT * BLOB_ALIGNMENT;
+        }
+
+        uint32_t IndexSize(uint32_t indexType) {
+            return indexType == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(uint32_t);
+        }
+
+        bool InRange(uint64_t offset, uint64_t size, uint64_t fileSize) {
+            return offset <= fileSize && size <= fileSize - offset;
+        }
+
+        // a corrupt blob would otherwise reach the GPU and the bounds code as out-of-range vertex reads
+        template<typename Index>
+        bool IndicesInRange(const uint8_t* data, uint32_t indexCount, uint32_t vertexCount) {
+            const Index* indices = reinterpret_cast<const Index*>(data);
+            for (uint32_t i = 0; i < indexCount; ++i) {
+                if (indices[i] >= vertexCount) return false;
+            }
+            return true;
+        }
+
+        template<typename T>
+        void WriteVector(std::ofstream& file, const std::vector<T>& values) {
+            if (!values.empty()) file.write(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(T));
+        }
+
+        void Pad(std::ofstream& file, uint64_t& offset, uint64_t target) {
+            static const char zeros[BLOB_ALIGNMENT] = {};
+            file.write(zeros, static_cast<std::streamsize>(target - offset));
+            offset = target;
+        }
+    }
+
+    uint64_t ModelCache::MakeKey(const std::string& sourcePath, const MeshFormat& format, uint32_t importFlags, bool optimized, const MeshLodOptions& lods, bool meshlets)
+    {
+        std::error_code ec;
+        uint64_t size = fs::file_size(sourcePath, ec);
+        if (ec) size = 0;
+        int64_t modified = static_cast<int64_t>(fs::last_write_time(sourcePath, ec).time_since_epoch().count());
+        if (ec) modified = 0;
+
+        uint64_t key = Hash::FNV1a("model");
+        key = Hash::FNV1a(sourcePath, key);
+        key = Hash::FNV1a(&size, sizeof(size), key);
+        key = Hash::FNV1a(&modified, sizeof(modified), key);
+        uint32_t settings[] = { CACHE_VERSION, static_cast<uint32_t>(format.layout), format.shortIndices ? 1u : 0u, importFlags, optimized ? 1u : 0u, lods.maxLevels, meshlets ? 1u : 0u };
+        key = Hash::FNV1a(settings, sizeof(settings), key);
+        float lodSettings[] = { lods.reduction, lods.maxError };
+        return Hash::FNV1a(lodSettings, sizeof(lodSettings), key);
+    }
+
+    std::string ModelCache::getPath(uint64_t key) const
+    {
+        std::stringstream name;
+        name << std::hex << std::setw(16) << std::setfill('0') << key << ".lxmesh";
+        return (fs::path(directory) / name.str()).string();
+    }
+
+    bool ModelCache::Open(uint64_t key, CachedModel& model) const
+    {
+        if (directory.empty()) return false;
+
+        MappedFile& file = model.file;
+        if (!file.Open(getPath(key))) return false;
+
+        const uint8_t* data = file.data();
+        uint64_t fileSize = file.size();
+        if (fileSize < sizeof(CacheHeader)) return false;
+
+        CacheHeader header;
+        std::memcpy(&header, data, sizeof(header));
+        if (header.magic != CACHE_MAGIC || header.version != CACHE_VERSION || header.key != key || header.fileSize != fileSize) return false;
+
+        if (!InRange(header.meshTable, static_cast<uint64_t>(header.meshCount) * sizeof(CacheMesh), fileSize) ||
+            !InRange(header.lodTable, static_cast<uint64_t>(header.lodCount) * sizeof(MeshLod), fileSize) ||
+            !InRange(header.meshletTable, static_cast<uint64_t>(header.meshletCount) * sizeof(Meshlet), fileSize) ||
+            !InRange(header.materialTable, static_cast<uint64_t>(header.materialCount) * sizeof(CacheMaterial), fileSize) ||
+            !InRange(header.textureTable, static_cast<uint64_t>(header.textureCount) * sizeof(CacheTexture), fileSize) ||
+            !InRange(header.strings, header.stringSize, fileSize) ||
+            header.stringSize == 0 || data[header.strings + header.stringSize - 1] != '\0') {
+            return false;
+        }
+
+        // tables are 8-byte aligned by Store, read them in place
+        const CacheMesh* meshTable = reinterpret_cast<const CacheMesh*>(data + header.meshTable);
+        const MeshLod* lodTable = reinterpret_cast<const MeshLod*>(data + header.lodTable);
+        const Meshlet* meshletTable = reinterpret_cast<const Meshlet*>(data + header.meshletTable);
+        const CacheMaterial* materialTable = reinterpret_cast<const CacheMaterial*>(data + header.materialTable);
+        const CacheTexture* textureTable = reinterpret_cast<const CacheTexture*>(data + header.textureTable);
+        const char* strings = reinterpret_cast<const char*>(data + header.strings);
+
+        // everything is checked before anything is handed out so a bad file leaves nothing behind
+        for (uint32_t i = 0; i < header.meshCount; ++i) {
+            const CacheMesh& mesh = meshTable[i];
+            if (mesh.layout > static_cast<uint32_t>(VertexLayout::PackedQuantized)) return false;
+            if (mesh.indexType != GL_UNSIGNED_SHORT && mesh.indexType != GL_UNSIGNED_INT) return false;
+            if (mesh.material >= header.materialCount) return false;
+            uint64_t vertexBytes = static_cast<uint64_t>(mesh.vertexCount) * GetVertexSize(static_cast<VertexLayout>(mesh.layout));
+            uint64_t indexBytes = static_cast<uint64_t>(mesh.indexCount) * IndexSize(mesh.indexType);
+            if (!InRange(mesh.vertexOffset, vertexBytes, fileSize) || !InRange(mesh.indexOffset, indexBytes, fileSize)) return false;
+            if (mesh.indexOffset % IndexSize(mesh.indexType) != 0) return false;
+            bool indicesValid = mesh.indexType == GL_UNSIGNED_SHORT
+                ? IndicesInRange<uint16_t>(data + mesh.indexOffset, mesh.indexCount, mesh.vertexCount)
+                : IndicesInRange<uint32_t>(data + mesh.indexOffset, mesh.indexCount, mesh.vertexCount);
+            if (!indicesValid) return false;
+            if (mesh.lodCount == 0 || !InRange(mesh.firstLod, mesh.lodCount, header.lodCount)) return false;
+            for (uint32_t l = 0; l < mesh.lodCount; ++l) {
+                const MeshLod& lod = lodTable[mesh.firstLod + l];
+                if (!InRange(lod.firstIndex, lod.indexCount, mesh.indexCount)) return false;
+            }
+            if (!InRange(mesh.firstMeshlet, mesh.meshletCount, header.meshletCount)) return false;
+            for (uint32_t m = 0; m < mesh.meshletCount; ++m) {
+                const Meshlet& meshlet = meshletTable[mesh.firstMeshlet + m];
+                if (!InRange(meshlet.firstIndex, meshlet.indexCount, mesh.indexCount)) return false;
+            }
+        }
+        for (uint32_t i = 0; i < header.materialCount; ++i) {
+            const CacheMaterial& material = materialTable[i];
+            if (!InRange(material.firstTexture, material.textureCount, header.textureCount)) return false;
+        }
+        for (uint32_t i = 0; i < header.textureCount; ++i) {
+            if (textureTable[i].type >= header.stringSize || textureTable[i].path >= header.stringSize) return false;
+        }
+
+        model.meshes.clear();
+        model.meshTextures.clear();
+        model.meshes.reserve(header.meshCount);
+        model.meshTextures.reserve(header.meshCount);
+        for (uint32_t i = 0; i < header.meshCount; ++i) {
+            const CacheMesh& mesh = meshTable[i];
+            const CacheMaterial& material = materialTable[mesh.material];
+
+            std::vector<TextureRef> textures;
+            textures.reserve(material.textureCount);
+            for (uint32_t t = 0; t < material.textureCount; ++t) {
+                const CacheTexture& texture = textureTable[material.firstTexture + t];
+                textures.push_back({ strings + texture.path, strings + texture.type });
+            }
+            model.meshTextures.push_back(std::move(textures));
+
+            PackedMeshData& packed = model.meshes.emplace_back();
+            packed.layout = static_cast<VertexLayout>(mesh.layout);
+            packed.indexType = mesh.indexType;
+            packed.vertices = data + mesh.vertexOffset;
+            packed.vertexCount = mesh.vertexCount;
+            packed.indices = data + mesh.indexOffset;
+            packed.indexCount = mesh.indexCount;
+            packed.bounds = { mesh.boundsMin, mesh.boundsMax };
+            packed.boundingSphere = mesh.boundingSphere;
+            packed.lods = lodTable + mesh.firstLod;
+            packed.lodCount = mesh.lodCount;
+            packed.meshlets = meshletTable + mesh.firstMeshlet;
+            packed.meshletCount = mesh.meshletCount;
+        }
+        return true;
+    }
+
+    bool ModelCache::Load(uint64_t key, std::vector<Mesh>& meshes, const TextureLoader& loadTexture) const
+    {
+        CachedModel model;
+        if (!Open(key, model)) return false;
+
+        meshes.reserve(meshes.size() + model.meshes.size());
+        for (size_t i = 0; i < model.meshes.size(); ++i) {
+            std::vector<Texture> textures;
+            textures.reserve(model.meshTextures[i].size());
+            for (const TextureRef& texture : model.meshTextures[i]) textures.push_back(loadTexture(texture.path, texture.type));
+            meshes.emplace_back(model.meshes[i], textures);
+        }
+        return true;
+    }
+
+    void ModelCache::Store(uint64_t key, const std::vector<Mesh>& meshes) const
+    {
+        if (directory.empty()) return;
+
+        std::error_code ec;
+        fs::create_directories(directory, ec);
+        if (ec) return;
+
+        std::vector<CacheMesh> meshTable(meshes.size());
+        std::vector<MeshLod> lodTable;
+        std::vector<Meshlet> meshletTable;
+        std::vector<CacheMaterial> materialTable;
+        std::vector<CacheTexture> textureTable;
+        std::string strings(1, '\0'); // offset 0 is the empty string
+
+        std::unordered_map<std::string, uint32_t> stringOffsets;
+        auto addString = [&](const std::string& str) {
+            auto it = stringOffsets.find(str);
+            if (it != stringOffsets.end()) return it->second;
+            uint32_t offset = static_cast<uint32_t>(strings.size());
+            strings.append(str);
+            strings.push_back('\0');
+            stringOffsets.emplace(str, offset);
+            return offset;
+        };
+
+        // meshes with the same texture list share a material entry
+        std::unordered_map<std::string, uint32_t> materialIds;
+        for (size_t i = 0; i < meshes.size(); ++i) {
+            const Mesh& mesh = meshes[i];
+
+            std::string signature;
+            for (const Texture& texture : mesh.textures) signature += texture.type + '\n' + texture.path + '\n';
+
+            auto it = materialIds.find(signature);
+            if (it == materialIds.end()) {
+                CacheMaterial material{ static_cast<uint32_t>(textureTable.size()), static_cast<uint32_t>(mesh.textures.size()) };
+                for (const Texture& texture : mesh.textures) textureTable.push_back({ addString(texture.type), addString(texture.path) });
+                it = materialIds.emplace(signature, static_cast<uint32_t>(materialTable.size())).first;
+                materialTable.push_back(material);
+            }
+
+            const MeshArena& arena = mesh.getArena();
+            CacheMesh& entry = meshTable[i];
+            entry = {};
+            entry.vertexCount = static_cast<uint32_t>(mesh.vertices.size());
+            entry.indexCount = static_cast<uint32_t>(mesh.indices.size());
+            entry.material = it->second;
+            entry.layout = static_cast<uint32_t>(arena.getLayout());
+            entry.indexType = arena.getIndexType();
+            entry.boundsMin = mesh.getBoundBox().min;
+            entry.boundsMax = mesh.getBoundBox().max;
+            entry.boundingSphere = mesh.getBoundingSphere();
+
+            // the arena offsets go, ranges are stored relative to the mesh's own indices
+            entry.firstLod = static_cast<uint32_t>(lodTable.size());
+            entry.lodCount = static_cast<uint32_t>(mesh.getLods().size());
+            for (MeshLod lod : mesh.getLods()) {
+                lod.firstIndex -= mesh.getFirstIndex();
+                lodTable.push_back(lod);
+            }
+            entry.firstMeshlet = static_cast<uint32_t>(meshletTable.size());
+            entry.meshletCount = static_cast<uint32_t>(mesh.getMeshlets().size());
+            for (Meshlet meshlet : mesh.getMeshlets()) {
+                meshlet.firstIndex -= mesh.getFirstIndex();
+                meshletTable.push_back(meshlet);
+            }
+        }
+
+        CacheHeader header{};
+        header.magic = CACHE_MAGIC;
+        header.version = CACHE_VERSION;
+        header.key = key;
+        header.meshCount = static_cast<uint32_t>(meshTable.size());
+        header.materialCount = static_cast<uint32_t>(materialTable.size());
+        header.textureCount = static_cast<uint32_t>(textureTable.size());
+        header.stringSize = static_cast<uint32_t>(strings.size());
+        header.lodCount = static_cast<uint32_t>(lodTable.size());
+        header.meshletCount = static_cast<uint32_t>(meshletTable.size());
+        header.meshTable = Align(sizeof(CacheHeader));
+        header.lodTable = Align(header.meshTable + meshTable.size() * sizeof(CacheMesh));
+        header.meshletTable = Align(header.lodTable + lodTable.size() * sizeof(MeshLod));
+        header.materialTable = Align(header.meshletTable + meshletTable.size() * sizeof(Meshlet));
+        header.textureTable = Align(header.materialTable + materialTable.size() * sizeof(CacheMaterial));
+        header.strings = Align(header.textureTable + textureTable.size() * sizeof(CacheTexture));
+
+        uint64_t blobOffset = Align(header.strings + strings.size());
+        for (size_t i = 0; i < meshes.size(); ++i) {
+            CacheMesh& entry = meshTable[i];
+            entry.vertexOffset = blobOffset;
+            blobOffset = Align(blobOffset + static_cast<uint64_t>(entry.vertexCount) * GetVertexSize(static_cast<VertexLayout>(entry.layout)));
+            entry.indexOffset = blobOffset;
+            blobOffset = Align(blobOffset + static_cast<uint64_t>(entry.indexCount) * IndexSize(entry.indexType));
+        }
+        header.fileSize = blobOffset;
+
+        std::ofstream file(getPath(key), std::ios::binary | std::ios::trunc);
+        if (!file) return;
+
+        uint64_t offset = 0;
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        offset += sizeof(header);
+        Pad(file, offset, header.meshTable);
+        WriteVector(file, meshTable);
+        offset += meshTable.size() * sizeof(CacheMesh);
+        Pad(file, offset, header.lodTable);
+        WriteVector(file, lodTable);
+        offset += lodTable.size() * sizeof(MeshLod);
+        Pad(file, offset, header.meshletTable);
+        WriteVector(file, meshletTable);
+        offset += meshletTable.size() * sizeof(Meshlet);
+        Pad(file, offset, header.materialTable);
+        WriteVector(file, materialTable);
+        offset += materialTable.size() * sizeof(CacheMaterial);
+        Pad(file, offset, header.textureTable);
+        WriteVector(file, textureTable);
+        offset += textureTable.size() * sizeof(CacheTexture);
+        Pad(file, offset, header.strings);
+        file.write(strings.data(), strings.size());
+        offset += strings.size();
+
+        // blobs are packed the same way Mesh packed them for the GPU
+        for (size_t i = 0; i < meshes.size(); ++i) {
+            const Mesh& mesh = meshes[i];
+            const CacheMesh& entry = meshTable[i];
+
+            Pad(file, offset, entry.vertexOffset);
+            std::vector<uint8_t> vertices = PackVertices(mesh.vertices, static_cast<VertexLayout>(entry.layout), mesh.getBoundBox());
+            WriteVector(file, vertices);
+            offset += vertices.size();
+
+            Pad(file, offset, entry.indexOffset);
+            if (entry.indexType == GL_UNSIGNED_SHORT) {
+                std::vector<uint16_t> indices(mesh.indices.begin(), mesh.indices.end());
+                WriteVector(file, indices);
+                offset += indices.size() * sizeof(uint16_t);
+            }
+            else {
+                WriteVector(file, mesh.indices);
+                offset += mesh.indices.size() * sizeof(unsigned int);
+            }
+        }
+        Pad(file, offset, header.fileSize);
+
+        // a short write leaves a file whose size doesn't match its header, Load ignores it
+        if (!file) std::cout << "ERROR::MODELCACHE::WRITE_FAILED " << getPath(key) << std::endl;
+    }
+
+    ModelCache& GetModelCache()
+    {
+        static ModelCache cache("ModelCache");
+        return cache;
+    }
+}
@@ -0,0 +1,232 @@
+#include "pch.h"
+
+#include "Renderable/Model/ModelLoader.hpp"
+
+#include <chrono>
+
+namespace fs = std::filesystem;
+
+namespace Lexvi {
+    struct ModelLoader::LoadJob {
+        std::shared_ptr<ModelHandle> handle;
+        std::string path;
+        std::string directory;
+        ModelImportOptions options;
+        uint64_t cacheKey = 0;
+
+        // workers
+        bool fromCache = false;
+        ModelCache::CachedModel cached;
+        std::unique_ptr<Assimp::Importer> importer; // owns the scene until every mesh is converted
+        std::vector<const aiMesh*> sourceMeshes;
+        std::vector<PreparedMesh> prepared;
+        std::vector<MeshOptimizationStats> meshStats;
+        std::vector<std::vector<ModelCache::TextureRef>> meshTextures;
+        std::vector<ModelCache::TextureRef> imageRefs; // one per distinct path
+        std::vector<DecodedImage> images;
+        std::atomic<uint32_t> remainingTasks{ 0 };
+
+        // GL thread
+        std::shared_ptr<Model> model;
+        size_t nextImage = 0;
+        size_t nextMesh = 0;
+
+        size_t getMeshCount() const { return fromCache ? cached.meshes.size() : prepared.size(); };
+    };
+
+    namespace {
+        // same order as Model::processNode
+        void CollectMeshes(const aiNode* node, const aiScene* scene, std::vector<const aiMesh*>& meshes) {
+            for (unsigned int i = 0; i < node->mNumMeshes; i++) meshes.push_back(scene->mMeshes[node->mMeshes[i]]);
+            for (unsigned int i = 0; i < node->mNumChildren; i++) CollectMeshes(node->mChildren[i], scene, meshes);
+        }
+    }
+
+    ModelLoader::~ModelLoader()
+    {
+        // workers may still be holding jobs that point back here
+        workers.reset();
+    }
+
+    std::shared_ptr<ModelHandle> ModelLoader::LoadAsync(const std::string& path, const ModelImportOptions& options)
+    {
+        if (!workers) workers = std::make_unique<WorkerPool>();
+
+        auto job = std::make_shared<LoadJob>();
+        job->handle = std::make_shared<ModelHandle>(path);
+        job->path = path;
+        job->options = options;
+
+        pending.fetch_add(1, std::memory_order_relaxed);
+        workers->Submit([this, job] { import(job); });
+        return job->handle;
+    }
+
+    void ModelLoader::import(const std::shared_ptr<LoadJob>& job)
+    {
+        job->directory = fs::path(job->path).parent_path().string();
+
+        if (job->options.useCache) {
+            job->cacheKey = ModelCache::MakeKey(job->path, job->options.meshFormat, Model::IMPORT_FLAGS, job->options.optimize, job->options.lods, job->options.meshlets);
+            job->fromCache = GetModelCache().Open(job->cacheKey, job->cached);
+        }
+
+        if (job->fromCache) {
+            job->meshTextures = job->cached.meshTextures;
+        }
+        else {
+            job->importer = std::make_unique<Assimp::Importer>();
+            const aiScene* scene = job->importer->ReadFile(job->path, Model::IMPORT_FLAGS);
+
+            if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) {
+                std::cerr << "ASSIMP:: " << job->importer->GetErrorString() << std::endl;
+                job->importer.reset();
+                finish(*job, ModelLoadState::Failed);
+                return;
+            }
+
+            CollectMeshes(scene->mRootNode, scene, job->sourceMeshes);
+            job->prepared.resize(job->sourceMeshes.size());
+            job->meshStats.resize(job->sourceMeshes.size());
+            job->meshTextures.reserve(job->sourceMeshes.size());
+            for (const aiMesh* mesh : job->sourceMeshes)
+                job->meshTextures.push_back(Model::GetTextureRefs(scene->mMaterials[mesh->mMaterialIndex]));
+        }
+
+        // decoded once per path, Model::loadTexture hands out the same texture to every mesh using it
+        for (const auto& textures : job->meshTextures) {
+            for (const ModelCache::TextureRef& texture : textures) {
+                bool known = std::any_of(job->imageRefs.begin(), job->imageRefs.end(),
+                    [&](const ModelCache::TextureRef& ref) { return ref.path == texture.path; });
+                if (!known) job->imageRefs.push_back(texture);
+            }
+        }
+        job->images.resize(job->imageRefs.size());
+
+        size_t meshTasks = job->fromCache ? 0 : job->sourceMeshes.size();
+        size_t imageTasks = job->images.size();
+        if (meshTasks + imageTasks == 0) {
+            queueUpload(job);
+            return;
+        }
+
+        // set before the first submit, a task may finish before the others are queued
+        job->remainingTasks.store(static_cast<uint32_t>(meshTasks + imageTasks), std::memory_order_relaxed);
+
+        for (size_t i = 0; i < meshTasks; ++i) {
+            workers->Submit([this, job, i] {
+                job->prepared[i] = Model::ImportMesh(job->sourceMeshes[i], job->options, job->meshStats[i]);
+                taskDone(job);
+            });
+        }
+        for (size_t i = 0; i < imageTasks; ++i) {
+            workers->Submit([this, job, i] {
+                DecodeTextureFile(job->imageRefs[i].path.c_str(), job->directory, job->images[i]);
+                taskDone(job);
+            });
+        }
+    }
+
+    void ModelLoader::taskDone(const std::shared_ptr<LoadJob>& job)
+    {
+        if (job->remainingTasks.fetch_sub(1, std::memory_order_acq_rel) != 1) return;
+
+        job->sourceMeshes.clear();
+        job->importer.reset();
+        queueUpload(job);
+    }
+
+    void ModelLoader::queueUpload(const std::shared_ptr<LoadJob>& job)
+    {
+        std::lock_guard<std::mutex> lock(readyMutex);
+        ready.push_back(job);
+    }
+
+    void ModelLoader::Update()
+    {
+        stats.uploads = 0;
+        stats.uploadTime = 0.0f;
+
+        {
+            std::lock_guard<std::mutex> lock(readyMutex);
+            while (!ready.empty()) {
+                uploads.push_back(std::move(ready.front()));
+                ready.pop_front();
+            }
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        while (!uploads.empty()) {
+            if (uploadStep(*uploads.front())) uploads.pop_front();
+            ++stats.uploads;
+
+            stats.uploadTime = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+            if (stats.uploadTime >= uploadBudget) break;
+        }
+
+        stats.pending = pending.load(std::memory_order_relaxed);
+    }
+
+    bool ModelLoader::uploadStep(LoadJob& job)
+    {
+        if (!job.model) {
+            job.model.reset(new Model(job.options));
+            job.model->setSource(job.path);
+            job.model->meshes.reserve(job.getMeshCount());
+        }
+        Model& model = *job.model;
+
+        // textures first, every mesh after them finds its own through loadTexture
+        if (job.nextImage < job.images.size()) {
+            const ModelCache::TextureRef& ref = job.imageRefs[job.nextImage];
+            DecodedImage& image = job.images[job.nextImage];
+
+            Texture texture;
+            texture.id = TextureFromImage(image);
+            texture.type = ref.type;
+            texture.path = ref.path;
+            model.textures_loaded.push_back(texture);
+
+            image.pixels.reset();
+            ++job.nextImage;
+            return false;
+        }
+
+        if (job.nextMesh < job.getMeshCount()) {
+            size_t i = job.nextMesh++;
+
+            std::vector<Texture> textures;
+            textures.reserve(job.meshTextures[i].size());
+            for (const ModelCache::TextureRef& texture : job.meshTextures[i])
+                textures.push_back(model.loadTexture(texture.path, texture.type));
+
+            if (job.fromCache) model.meshes.emplace_back(job.cached.meshes[i], std::move(textures));
+            else model.meshes.emplace_back(std::move(job.prepared[i]), std::move(textures));
+            return false;
+        }
+
+        for (const MeshOptimizationStats& stats : job.meshStats) model.optimizationStats += stats;
+        model.finishLoad();
+
+        // the model is complete and only read from here on, the file is written off the GL thread
+        if (!job.fromCache && job.options.useCache) {
+            workers->Submit([model = job.model, key = job.cacheKey] { GetModelCache().Store(key, model->getMeshes()); });
+        }
+
+        finish(job, ModelLoadState::Ready);
+        return true;
+    }
+
+    void ModelLoader::finish(LoadJob& job, ModelLoadState state)
+    {
+        if (state == ModelLoadState::Ready) job.handle->model = job.model;
+        job.handle->state.store(state, std::memory_order_release);
+        pending.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    ModelLoader& GetModelLoader()
+    {
+        static ModelLoader loader;
+        return loader;
+    }
+}
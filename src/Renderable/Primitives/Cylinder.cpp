@@ -1,6 +1,7 @@
 #include "pch.h"
 
 #include "Renderable/Primitives/Cylinder.hpp"
+#include "Renderer/GLState.hpp"
 
 namespace Lexvi {
     glm::vec3 EvalCurve(float theta, float y, float r) {
@@ -53,6 +54,7 @@ namespace Lexvi {
         }
 
         if (mesh.VAO != 0) {
+            GLState::ForgetVertexArray(mesh.VAO);
             glDeleteVertexArrays(1, &mesh.VAO);
             glDeleteBuffers(1, &mesh.VBO);
             glDeleteBuffers(1, &mesh.EBO);
@@ -82,36 +84,37 @@ namespace Lexvi {
     Cylinder::Cylinder(float radius, float height, int segments) : radius(radius), height(height), segments(segments)
     {
         GenerateCylinderMesh(cylinderMesh, radius, height, segments);
+
+        float params[3] = { radius, height, static_cast<float>(segments) };
+        geometryID = MakeGeometryID("Cylinder", params, sizeof(params));
+
+        CameraAABB box;
+        glm::vec4 sphere;
+        ComputeBounds(cylinderMesh.vertices, &CylinderVertex::position, box, sphere);
+        setLocalBounds(box, sphere);
     }
 
     void Cylinder::Draw(const Shader* shader)
     {
         shader->use();
-        glBindVertexArray(cylinderMesh.VAO);
+        GLState::BindVertexArray(cylinderMesh.VAO);
         glDrawElements(GL_TRIANGLES, static_cast<GLsizei>(cylinderMesh.indices.size()), GL_UNSIGNED_INT, nullptr);
     }
 
-    void Cylinder::updateBoundingBox()
+    bool Cylinder::DrawInstanced(const Shader* shader, uint32_t instanceCount, uint32_t baseInstance)
     {
+        shader->use();
+        GLState::BindVertexArray(cylinderMesh.VAO);
+        glDrawElementsInstancedBaseInstance(GL_TRIANGLES, static_cast<GLsizei>(cylinderMesh.indices.size()), GL_UNSIGNED_INT, nullptr, instanceCount, baseInstance);
+        return true;
     }
 
-    void Cylinder::setTransforms(const glm::mat4& mat)
-    {
-    }
-
-    glm::mat4 Cylinder::getTransforms() const
-    {
-        return glm::mat4();
-    }
-
-    CameraAABB Cylinder::getBoundBox() const
-    {
-        return CameraAABB();
-    }
-
-    bool Cylinder::isVisible(const Camera& camera) const
+    bool Cylinder::getDrawCommand(unsigned int& vao, DrawElementsIndirectCommand& command) const
     {
-        std::cout << "implement culling for cylinder";
+        vao = cylinderMesh.VAO;
+        command = {};
+        command.count = static_cast<GLsizei>(cylinderMesh.indices.size());
+        command.instanceCount = 1;
         return true;
     }
 }
\ No newline at end of file
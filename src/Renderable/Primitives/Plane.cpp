@@ -1,10 +1,12 @@
 #include "pch.h"
 
 #include "Renderable/Primitives/Plane.hpp"
+#include "Renderer/GLState.hpp"
 
 namespace Lexvi {
     void SetupPlaneBuffers(PlaneMesh& plane) {
         if (plane.VAO != 0) {
+            GLState::ForgetVertexArray(plane.VAO);
             glDeleteVertexArrays(1, &plane.VAO);
             glDeleteBuffers(1, &plane.VBO);
             glDeleteBuffers(1, &plane.EBO);
@@ -91,48 +93,50 @@ namespace Lexvi {
     Plane::Plane(int gridSizeX, int gridSizeZ, float spacing) : size(glm::vec3(gridSizeX, 1.0f, gridSizeZ)), position(0.0f)
     {
         GeneratePlane(planeMesh, gridSizeX, gridSizeZ, spacing);
+
+        float params[3] = { static_cast<float>(gridSizeX), static_cast<float>(gridSizeZ), spacing };
+        geometryID = MakeGeometryID("Plane", params, sizeof(params));
+
+        CameraAABB box;
+        glm::vec4 sphere;
+        ComputeBounds(planeMesh.vertices, &PlaneVertex::position, box, sphere);
+        setLocalBounds(box, sphere);
     }
 
     void Plane::Draw(const Shader* shader)
     {
         shader->use();
-        glBindVertexArray(planeMesh.VAO);
+        GLState::BindVertexArray(planeMesh.VAO);
         glDrawElements(GL_TRIANGLES, static_cast<GLsizei>(planeMesh.indices.size()), GL_UNSIGNED_INT, nullptr);
     }
 
-    void Plane::setTransforms(const glm::mat4& mat)
-    {
-    }
-
-    glm::mat4 Plane::getTransforms() const
-    {
-        return glm::mat4(transforms);
-    }
-
-    CameraAABB Plane::getBoundBox() const
+    bool Plane::DrawInstanced(const Shader* shader, uint32_t instanceCount, uint32_t baseInstance)
     {
-        CameraAABB aabb{};
-
-        aabb.min = position - size / 2.0f;
-        aabb.max = position + size / 2.0f;
-
-        return aabb;
+        shader->use();
+        GLState::BindVertexArray(planeMesh.VAO);
+        glDrawElementsInstancedBaseInstance(GL_TRIANGLES, static_cast<GLsizei>(planeMesh.indices.size()), GL_UNSIGNED_INT, nullptr, instanceCount, baseInstance);
+        return true;
     }
 
-    bool Plane::isVisible(const Camera& camera) const
+    bool Plane::getDrawCommand(unsigned int& vao, DrawElementsIndirectCommand& command) const
     {
-        //return isInFrustum(camera.getFrustum(), getBoundBox());
+        vao = planeMesh.VAO;
+        command = {};
+        command.count = static_cast<GLsizei>(planeMesh.indices.size());
+        command.instanceCount = 1;
         return true;
     }
 
     void Plane::setPosition(glm::vec3 position)
     {
         this->position = position;
+        transforms[3] = glm::vec4(position, 1.0f);
+        updateBoundingBox();
     }
 
     void PlaneMesh::Bind() const
     {
-        glBindVertexArray(VAO);
+        GLState::BindVertexArray(VAO);
     }
 
     void Plane::Bind() const {
@@ -1,10 +1,12 @@
 #include "pch.h"
 #include "Renderable/Primitives/Quad.hpp"
+#include "Renderer/GLState.hpp"
 
 namespace Lexvi {
 
     void SetupQuadBuffers(QuadMesh& quad) {
         if (quad.VAO != 0) {
+            GLState::ForgetVertexArray(quad.VAO);
             glDeleteVertexArrays(1, &quad.VAO);
             glDeleteBuffers(1, &quad.VBO);
             glDeleteBuffers(1, &quad.EBO);
@@ -51,39 +53,45 @@ namespace Lexvi {
 
     Quad::Quad(float width, float height) : size(width, height), position(0.0f) {
         GenerateQuad(quadMesh, width, height);
+
+        float params[2] = { width, height };
+        geometryID = MakeGeometryID("Quad", params, sizeof(params));
+
+        CameraAABB box;
+        glm::vec4 sphere;
+        ComputeBounds(quadMesh.vertices, &QuadVertex::position, box, sphere);
+        setLocalBounds(box, sphere);
     }
 
     void Quad::Draw(const Shader* shader) {
         shader->use();
-        glBindVertexArray(quadMesh.VAO);
+        GLState::BindVertexArray(quadMesh.VAO);
         glDrawElements(GL_TRIANGLES, static_cast<GLsizei>(quadMesh.indices.size()), GL_UNSIGNED_INT, nullptr);
     }
 
-    void Quad::setTransforms(const glm::mat4& mat) {
-        transforms = mat;
-    }
-
-    glm::mat4 Quad::getTransforms() const {
-        return glm::mat4(transforms);
-    }
-
-    CameraAABB Quad::getBoundBox() const {
-        CameraAABB aabb{};
-        aabb.min = glm::vec3(position.x - size.x / 2.0f, position.y - 0.0f, position.z - size.y / 2.0f);
-        aabb.max = glm::vec3(position.x + size.x / 2.0f, position.y + 0.0f, position.z + size.y / 2.0f);
-        return aabb;
+    bool Quad::DrawInstanced(const Shader* shader, uint32_t instanceCount, uint32_t baseInstance) {
+        shader->use();
+        GLState::BindVertexArray(quadMesh.VAO);
+        glDrawElementsInstancedBaseInstance(GL_TRIANGLES, static_cast<GLsizei>(quadMesh.indices.size()), GL_UNSIGNED_INT, nullptr, instanceCount, baseInstance);
+        return true;
     }
 
-    bool Quad::isVisible(const Camera& camera) const {
-        return isInFrustum(camera.getFrustum(), getBoundBox());
+    bool Quad::getDrawCommand(unsigned int& vao, DrawElementsIndirectCommand& command) const {
+        vao = quadMesh.VAO;
+        command = {};
+        command.count = static_cast<GLsizei>(quadMesh.indices.size());
+        command.instanceCount = 1;
+        return true;
     }
 
     void Quad::setPosition(const glm::vec3& pos) {
         position = pos;
+        transforms[3] = glm::vec4(pos, 1.0f);
+        updateBoundingBox();
     }
 
     void QuadMesh::Bind() const {
-        glBindVertexArray(VAO);
+        GLState::BindVertexArray(VAO);
     }
 
     void Quad::Bind() const {
@@ -1,6 +1,7 @@
 #include "pch.h"
 
 #include "Renderable/Primitives/SemiCircle.hpp"
+#include "Renderer/GLState.hpp"
 
 namespace Lexvi {
     // Generates a semicircle mesh in XY plane, z=0, with "vertexCount" along rim
@@ -36,8 +37,11 @@ namespace Lexvi {
             mesh.indices.push_back(i + 1);
         }
 
+        ComputeBounds(mesh.vertices, &SemiCircleVertex::position, mesh.bounds, mesh.boundingSphere);
+
         // Delete old buffers if they exist
         if (mesh.VAO != 0) {
+            GLState::ForgetVertexArray(mesh.VAO);
             glDeleteVertexArrays(1, &mesh.VAO);
             glDeleteBuffers(1, &mesh.VBO);
             glDeleteBuffers(1, &mesh.EBO);
@@ -65,7 +69,7 @@ namespace Lexvi {
 
     void DrawSemiCircleMesh(SemiCircleMesh& mesh, Shader& shader, uint32_t instanceCount) {
         shader.use();
-        glBindVertexArray(mesh.VAO);
+        GLState::BindVertexArray(mesh.VAO);
 
         if (instanceCount > 1) {
             glDrawElementsInstanced(GL_TRIANGLES,  static_cast<GLsizei>(mesh.indices.size()), GL_UNSIGNED_INT, nullptr, static_cast<GLsizei>(instanceCount));
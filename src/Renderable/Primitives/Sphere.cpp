@@ -1,6 +1,7 @@
 #include "pch.h"
 
 #include "Renderable/Primitives/Sphere.hpp"
+#include "Renderer/GLState.hpp"
 
 namespace Lexvi {
 	void generateUnitSphere(SphereMesh& sphere, int stacks, int slices) {
@@ -30,12 +31,35 @@ namespace Lexvi {
 
 	Sphere::Sphere(int stacks, int slices) {
 		generateUnitSphere(sphereMesh, stacks, slices);
+
+		int params[2] = { stacks, slices };
+		geometryID = MakeGeometryID("Sphere", params, sizeof(params));
+
+		// exact for the unit sphere, the tessellation stays inside it
+		setLocalBounds({ glm::vec3(-1.0f), glm::vec3(1.0f) }, glm::vec4(0.0f, 0.0f, 0.0f, 1.0f));
 	}
 
 	void Sphere::Draw(const Shader* shader)
 	{
 		shader->use();
-		glBindVertexArray(sphereMesh.VAO);
+		GLState::BindVertexArray(sphereMesh.VAO);
 		glDrawElements(GL_TRIANGLES, static_cast<GLsizei>(sphereMesh.indices.size()), GL_UNSIGNED_INT, nullptr);
 	}
+
+	bool Sphere::DrawInstanced(const Shader* shader, uint32_t instanceCount, uint32_t baseInstance)
+	{
+		shader->use();
+		GLState::BindVertexArray(sphereMesh.VAO);
+		glDrawElementsInstancedBaseInstance(GL_TRIANGLES, static_cast<GLsizei>(sphereMesh.indices.size()), GL_UNSIGNED_INT, nullptr, instanceCount, baseInstance);
+		return true;
+	}
+
+	bool Sphere::getDrawCommand(unsigned int& vao, DrawElementsIndirectCommand& command) const
+	{
+		vao = sphereMesh.VAO;
+		command = {};
+		command.count = static_cast<GLsizei>(sphereMesh.indices.size());
+		command.instanceCount = 1;
+		return true;
+	}
 }
\ No newline at end of file
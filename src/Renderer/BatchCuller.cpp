@@ -0,0 +1,179 @@
+#include "pch.h"
+
+#include "Renderer/BatchCuller.hpp"
+
+#include <bit>
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define LEXVI_TARGET_AVX2
+#else
+#define LEXVI_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#endif
+
+namespace Lexvi {
+	namespace {
+		bool CpuHasAVX2() {
+#ifdef _MSC_VER
+			int info[4];
+			__cpuid(info, 0);
+			if (info[0] < 7) return false;
+
+			// the OS has to save the YMM registers as well
+			__cpuid(info, 1);
+			bool osxsave = (info[2] & (1 << 27)) != 0;
+			bool fma = (info[2] & (1 << 12)) != 0;
+			if (!osxsave || !fma || (_xgetbv(0) & 0x6) != 0x6) return false;
+
+			__cpuidex(info, 7, 0);
+			return (info[1] & (1 << 5)) != 0;
+#else
+			return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#endif
+		}
+
+		const bool HAS_AVX2 = CpuHasAVX2();
+
+		// Positive vertex of every box for each plane: the max corner on axes where the normal is
+		// positive. The normal is shared by all boxes, so this picks arrays instead of blending.
+		struct PlaneSetup {
+			float nx, ny, nz, d;
+			const float* px;
+			const float* py;
+			const float* pz;
+		};
+
+		struct Boxes {
+			const float* minX; const float* minY; const float* minZ;
+			const float* maxX; const float* maxY; const float* maxZ;
+		};
+
+		void SetupPlanes(const CameraFrustum& frustum, const Boxes& boxes, PlaneSetup out[6]) {
+			for (int i = 0; i < 6; ++i) {
+				const CameraPlane& plane = frustum.planes[i];
+				out[i] = {
+					plane.normal.x, plane.normal.y, plane.normal.z, plane.distance,
+					plane.normal.x >= 0.0f ? boxes.maxX : boxes.minX,
+					plane.normal.y >= 0.0f ? boxes.maxY : boxes.minY,
+					plane.normal.z >= 0.0f ? boxes.maxZ : boxes.minZ,
+				};
+			}
+		}
+
+		bool CullScalar(const PlaneSetup planes[6], size_t i) {
+			for (int p = 0; p < 6; ++p) {
+				const PlaneSetup& plane = planes[p];
+				if (plane.nx * plane.px[i] + plane.ny * plane.py[i] + plane.nz * plane.pz[i] + plane.d < 0.0f) return false;
+			}
+			return true;
+		}
+
+		// 4 boxes, bit j set if box i + j is inside
+		uint32_t CullSSE(const PlaneSetup planes[6], size_t i) {
+			__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+			for (int p = 0; p < 6; ++p) {
+				const PlaneSetup& plane = planes[p];
+				__m128 dist = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane.nx), _mm_loadu_ps(plane.px + i)), _mm_set1_ps(plane.d));
+				dist = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane.ny), _mm_loadu_ps(plane.py + i)), dist);
+				dist = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane.nz), _mm_loadu_ps(plane.pz + i)), dist);
+				inside = _mm_and_ps(inside, _mm_cmpge_ps(dist, _mm_setzero_ps()));
+			}
+			return static_cast<uint32_t>(_mm_movemask_ps(inside));
+		}
+
+		// 8 boxes, bit j set if box i + j is inside
+		LEXVI_TARGET_AVX2 uint32_t CullAVX2(const PlaneSetup planes[6], size_t i) {
+			__m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+			for (int p = 0; p < 6; ++p) {
+				const PlaneSetup& plane = planes[p];
+				__m256 dist = _mm256_fmadd_ps(_mm256_set1_ps(plane.nx), _mm256_loadu_ps(plane.px + i), _mm256_set1_ps(plane.d));
+				dist = _mm256_fmadd_ps(_mm256_set1_ps(plane.ny), _mm256_loadu_ps(plane.py + i), dist);
+				dist = _mm256_fmadd_ps(_mm256_set1_ps(plane.nz), _mm256_loadu_ps(plane.pz + i), dist);
+				inside = _mm256_and_ps(inside, _mm256_cmp_ps(dist, _mm256_setzero_ps(), _CMP_GE_OQ));
+			}
+			return static_cast<uint32_t>(_mm256_movemask_ps(inside));
+		}
+	}
+
+	uint32_t BatchCuller::Add(const CameraAABB& box)
+	{
+		uint32_t index = static_cast<uint32_t>(size());
+		Resize(index + 1);
+		Set(index, box);
+		return index;
+	}
+
+	void BatchCuller::Set(uint32_t index, const CameraAABB& box)
+	{
+		minX[index] = box.min.x; minY[index] = box.min.y; minZ[index] = box.min.z;
+		maxX[index] = box.max.x; maxY[index] = box.max.y; maxZ[index] = box.max.z;
+	}
+
+	void BatchCuller::Resize(size_t count)
+	{
+		for (auto* array : { &minX, &minY, &minZ, &maxX, &maxY, &maxZ }) array->resize(count, 0.0f);
+		visibility.assign((count + 63) / 64, 0);
+	}
+
+	void BatchCuller::Clear()
+	{
+		Resize(0);
+		visibleCount = 0;
+	}
+
+	void BatchCuller::Update(const std::vector<IRenderable*>& objects)
+	{
+		Resize(objects.size());
+		for (uint32_t i = 0; i < objects.size(); ++i) Set(i, objects[i]->getBoundBox());
+	}
+
+	void BatchCuller::cullRange(const CameraFrustum& frustum, size_t begin, size_t end)
+	{
+		Boxes boxes{ minX.data(), minY.data(), minZ.data(), maxX.data(), maxY.data(), maxZ.data() };
+		PlaneSetup planes[6];
+		SetupPlanes(frustum, boxes, planes);
+
+		for (size_t word = begin; word < end; word += 64) {
+			size_t wordEnd = std::min(word + 64, end);
+			uint64_t bits = 0;
+			size_t i = word;
+
+			if (HAS_AVX2) {
+				for (; i + 8 <= wordEnd; i += 8) bits |= static_cast<uint64_t>(CullAVX2(planes, i)) << (i - word);
+			}
+			for (; i + 4 <= wordEnd; i += 4) bits |= static_cast<uint64_t>(CullSSE(planes, i)) << (i - word);
+			for (; i < wordEnd; ++i) {
+				if (CullScalar(planes, i)) bits |= uint64_t(1) << (i - word);
+			}
+
+			visibility[word / 64] = bits;
+		}
+	}
+
+	void BatchCuller::Cull(const CameraFrustum& frustum)
+	{
+		size_t count = size();
+
+		if (count < PARALLEL_THRESHOLD) {
+			cullRange(frustum, 0, count);
+		}
+		else {
+			size_t workers = std::max<size_t>(1, std::thread::hardware_concurrency());
+			// chunks rounded up to whole visibility words
+			size_t chunk = ((count + workers - 1) / workers + 63) & ~size_t(63);
+
+			std::vector<std::thread> threads;
+			for (size_t begin = chunk; begin < count; begin += chunk) {
+				threads.emplace_back([this, &frustum, begin, chunk, count]() {
+					cullRange(frustum, begin, std::min(begin + chunk, count));
+				});
+			}
+			// first chunk on the calling thread
+			cullRange(frustum, 0, std::min(chunk, count));
+			for (std::thread& thread : threads) thread.join();
+		}
+
+		visibleCount = 0;
+		for (uint64_t word : visibility) visibleCount += static_cast<uint32_t>(std::popcount(word));
+	}
+}
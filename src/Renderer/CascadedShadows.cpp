@@ -0,0 +1,282 @@
+#include "pch.h"
+
+#include "Renderer/CascadedShadows.hpp"
+#include "Renderer/BindingPoints.hpp"
+#include "Renderer/GLState.hpp"
+#include "Textures/Textures.hpp"
+
+namespace Lexvi {
+	namespace {
+		void ClearDepth(unsigned int fbo) {
+			float one = 1.0f;
+			glClearNamedFramebufferfv(fbo, GL_DEPTH, 0, &one);
+		}
+	}
+
+	CascadedShadowMap::CascadedShadowMap(const CascadedShadowSettings& settings) : settings(settings)
+	{
+		this->settings.cascadeCount = std::clamp(settings.cascadeCount, 1u, MAX_CASCADES);
+		this->settings.firstCachedCascade = std::min(settings.firstCachedCascade, this->settings.cascadeCount);
+	}
+
+	CascadedShadowMap::~CascadedShadowMap()
+	{
+		deleteResources();
+	}
+
+	void CascadedShadowMap::createResources()
+	{
+		int resolution = static_cast<int>(settings.resolution);
+		int layers = static_cast<int>(settings.cascadeCount);
+
+		shadowMap = GenerateDepthTextureArray(resolution, resolution, layers);
+		if (settings.firstCachedCascade < settings.cascadeCount) cacheMap = GenerateDepthTextureArray(resolution, resolution, layers);
+
+		for (uint32_t i = 0; i < settings.cascadeCount; ++i) {
+			Cascade& cascade = cascades[i];
+			glCreateFramebuffers(1, &cascade.fbo);
+			glNamedFramebufferTextureLayer(cascade.fbo, GL_DEPTH_ATTACHMENT, shadowMap, 0, i);
+			glNamedFramebufferDrawBuffer(cascade.fbo, GL_NONE);
+
+			if (i < settings.firstCachedCascade) continue;
+			glCreateFramebuffers(1, &cascade.cacheFbo);
+			glNamedFramebufferTextureLayer(cascade.cacheFbo, GL_DEPTH_ATTACHMENT, cacheMap, 0, i);
+			glNamedFramebufferDrawBuffer(cascade.cacheFbo, GL_NONE);
+		}
+
+		CreateUBO(shadowUBO, sizeof(ShadowData), BindingPoints::ShadowDataUBO);
+	}
+
+	void CascadedShadowMap::deleteResources()
+	{
+		for (Cascade& cascade : cascades) {
+			for (unsigned int* fbo : { &cascade.fbo, &cascade.cacheFbo }) {
+				if (!*fbo) continue;
+				GLState::ForgetFramebuffer(*fbo);
+				glDeleteFramebuffers(1, fbo);
+				*fbo = 0;
+			}
+		}
+		for (unsigned int* texture : { &shadowMap, &cacheMap }) {
+			if (!*texture) continue;
+			GLState::ForgetTexture(*texture);
+			glDeleteTextures(1, texture);
+			*texture = 0;
+		}
+		if (shadowUBO.id) DeleteUBO(shadowUBO);
+	}
+
+	void CascadedShadowMap::AddCaster(IRenderable& obj, bool isStatic)
+	{
+		casters.push_back({ &obj, isStatic });
+		if (isStatic) InvalidateStatic(obj.getBoundBox());
+	}
+
+	void CascadedShadowMap::RemoveCaster(IRenderable& obj)
+	{
+		auto it = std::find_if(casters.begin(), casters.end(), [&](const Caster& c) { return c.object == &obj; });
+		if (it == casters.end()) return;
+
+		if (it->isStatic) InvalidateStatic(obj.getBoundBox());
+		casters.erase(it);
+	}
+
+	void CascadedShadowMap::SetLightDirection(const glm::vec3& direction)
+	{
+		glm::vec3 normalised = glm::normalize(direction);
+		if (normalised == lightDirection) return;
+
+		lightDirection = normalised;
+		InvalidateStatic();
+	}
+
+	void CascadedShadowMap::InvalidateStatic()
+	{
+		for (Cascade& cascade : cascades) cascade.cacheValid = false;
+	}
+
+	void CascadedShadowMap::InvalidateStatic(const CameraAABB& region)
+	{
+		for (Cascade& cascade : cascades) {
+			if (cascade.cacheValid && isInFrustum(cascade.frustum, region)) cascade.cacheValid = false;
+		}
+	}
+
+	glm::mat4 CascadedShadowMap::buildViewProjection(const glm::vec3& center, float radius) const
+	{
+		glm::vec3 up = std::abs(lightDirection.y) > 0.99f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+		glm::mat4 lightView = glm::lookAt(glm::vec3(0.0f), lightDirection, up);
+
+		// moving the center in whole texels keeps the rasterised depth stable between frames
+		glm::vec3 c = glm::vec3(lightView * glm::vec4(center, 1.0f));
+		float texel = 2.0f * radius / static_cast<float>(settings.resolution);
+		c.x = std::floor(c.x / texel) * texel;
+		c.y = std::floor(c.y / texel) * texel;
+
+		// the light looks down -z, casters between the light and the sphere are at larger z
+		glm::mat4 projection = glm::ortho(c.x - radius, c.x + radius, c.y - radius, c.y + radius,
+			-(c.z + radius + settings.casterMargin), -(c.z - radius));
+		return projection * lightView;
+	}
+
+	bool CascadedShadowMap::anyDynamicCaster(const Cascade& cascade) const
+	{
+		for (const Caster& caster : casters) {
+			if (!caster.isStatic && isInFrustum(cascade.frustum, caster.object->getBoundBox())) return true;
+		}
+		return false;
+	}
+
+	void CascadedShadowMap::drawCasters(const Shader& depthShader, const Cascade& cascade, bool isStatic)
+	{
+		depthShader.use();
+		depthShader.setMat4("lightSpaceMatrix", cascade.viewProjection);
+
+		for (const Caster& caster : casters) {
+			if (caster.isStatic != isStatic) continue;
+			if (!isInFrustum(cascade.frustum, caster.object->getBoundBox())) continue;
+
+			depthShader.setMat4("model", caster.object->getTransforms());
+			caster.object->setCullFrustum(&cascade.frustum);
+			caster.object->Draw(&depthShader);
+			caster.object->setCullFrustum(nullptr);
+			stats.casterDraws++;
+		}
+	}
+
+	void CascadedShadowMap::Render(const Camera& camera, const Shader& depthShader)
+	{
+		if (!shadowMap) createResources();
+		stats = {};
+
+		GLint viewport[4];
+		GLint previousFbo = 0;
+		glGetIntegerv(GL_VIEWPORT, viewport);
+		glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previousFbo);
+
+		GLsizei resolution = static_cast<GLsizei>(settings.resolution);
+		glViewport(0, 0, resolution, resolution);
+		GLState::SetDepthTest(true);
+		GLState::SetDepthWrite(true);
+		// casters in front of the near plane are clamped onto it instead of clipped
+		glEnable(GL_DEPTH_CLAMP);
+
+		glm::vec2 nearFar = camera.getZNearAndZFar();
+		float zNear = nearFar.x;
+		float zFar = settings.maxDistance > 0.0f ? std::min(settings.maxDistance, nearFar.y) : nearFar.y;
+		const glm::mat4& view = camera.getCameraData().view;
+
+		float splitNear = zNear;
+		for (uint32_t i = 0; i < settings.cascadeCount; ++i) {
+			Cascade& cascade = cascades[i];
+
+			// practical split scheme, blend of uniform and logarithmic
+			float p = static_cast<float>(i + 1) / settings.cascadeCount;
+			float logSplit = zNear * std::pow(zFar / zNear, p);
+			float uniformSplit = zNear + (zFar - zNear) * p;
+			float splitFar = uniformSplit + (logSplit - uniformSplit) * settings.splitLambda;
+
+			// bounding sphere of the slice, independent of the view direction so the cascade never resizes
+			CameraFrustum slice;
+			updateFrustum(slice, glm::perspective(glm::radians(camera.getFOV()), camera.getAspectRatio(), splitNear, splitFar) * view);
+			std::vector<glm::vec3> corners = GetFrustumCorners(slice);
+
+			glm::vec3 center(0.0f);
+			for (const glm::vec3& corner : corners) center += corner;
+			center /= static_cast<float>(std::max<size_t>(corners.size(), 1));
+
+			float radius = 0.0f;
+			for (const glm::vec3& corner : corners) radius = std::max(radius, glm::length(corner - center));
+			radius = std::ceil(radius * 16.0f) / 16.0f;
+
+			if (i < settings.firstCachedCascade) {
+				cascade.viewProjection = buildViewProjection(center, radius);
+				updateFrustum(cascade.frustum, cascade.viewProjection);
+
+				GLState::BindFramebuffer(cascade.fbo);
+				ClearDepth(cascade.fbo);
+				drawCasters(depthShader, cascade, true);
+				drawCasters(depthShader, cascade, false);
+				stats.cascadesRendered++;
+			}
+			else {
+				bool covered = cascade.cacheValid && glm::length(center - cascade.cacheCenter) + radius <= cascade.cacheRadius;
+				if (!covered) {
+					cascade.cacheCenter = center;
+					cascade.cacheRadius = radius * settings.cacheSlack;
+					cascade.viewProjection = buildViewProjection(cascade.cacheCenter, cascade.cacheRadius);
+					updateFrustum(cascade.frustum, cascade.viewProjection);
+
+					GLState::BindFramebuffer(cascade.cacheFbo);
+					ClearDepth(cascade.cacheFbo);
+					drawCasters(depthShader, cascade, true);
+					cascade.cacheValid = true;
+					cascade.liveMatchesCache = false;
+					stats.cachesRefreshed++;
+				}
+				else {
+					stats.cachesReused++;
+				}
+
+				bool dynamicInRange = anyDynamicCaster(cascade);
+				if (dynamicInRange || !cascade.liveMatchesCache) {
+					glCopyImageSubData(cacheMap, GL_TEXTURE_2D_ARRAY, 0, 0, 0, static_cast<GLint>(i),
+						shadowMap, GL_TEXTURE_2D_ARRAY, 0, 0, 0, static_cast<GLint>(i), resolution, resolution, 1);
+
+					GLState::BindFramebuffer(cascade.fbo);
+					drawCasters(depthShader, cascade, false);
+					cascade.liveMatchesCache = !dynamicInRange;
+				}
+			}
+
+			shadowData.viewProjection[i] = cascade.viewProjection;
+			shadowData.splits[i] = splitFar;
+			splitNear = splitFar;
+		}
+
+		glDisable(GL_DEPTH_CLAMP);
+		GLState::BindFramebuffer(static_cast<unsigned int>(previousFbo));
+		glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+
+		shadowData.params = glm::vec4(static_cast<float>(settings.cascadeCount), 1.0f / settings.resolution, settings.depthBias, settings.normalOffset);
+		UpdateUBO(shadowUBO, &shadowData, sizeof(ShadowData), 0);
+		GLState::BindBufferBase(GL_UNIFORM_BUFFER, BindingPoints::ShadowDataUBO, shadowUBO.id);
+		GLState::BindTextureUnit(BindingPoints::ShadowMapUnit, shadowMap);
+	}
+
+	std::string CascadedShadowMap::GetGLSL()
+	{
+		return
+			"layout(std140, binding = " + std::to_string(BindingPoints::ShadowDataUBO) + ") uniform LexviShadowData {\n"
+			"    mat4 lexviShadowViewProjection[" + std::to_string(MAX_CASCADES) + "];\n"
+			"    vec4 lexviShadowSplits;\n"
+			"    vec4 lexviShadowParams;\n"
+			"};\n"
+			"layout(binding = " + std::to_string(BindingPoints::ShadowMapUnit) + ") uniform sampler2DArrayShadow lexviShadowMap;\n"
+			"\n"
+			"// 1 = lit, 0 = shadowed. viewDepth is the positive distance along the view axis, normal is unit length.\n"
+			"float LexviShadow(vec3 worldPos, vec3 normal, float viewDepth) {\n"
+			"    int count = int(lexviShadowParams.x);\n"
+			"    if (count == 0 || viewDepth >= lexviShadowSplits[count - 1]) return 1.0;\n"
+			"\n"
+			"    int cascade = 0;\n"
+			"    while (cascade < count - 1 && viewDepth >= lexviShadowSplits[cascade]) cascade++;\n"
+			"    mat4 lightSpace = lexviShadowViewProjection[cascade];\n"
+			"\n"
+			"    // offset along the normal by a few texels of this cascade (ortho width = 2 / m00) against acne\n"
+			"    float texelWorld = 2.0 / lightSpace[0][0] * lexviShadowParams.y;\n"
+			"    vec4 clip = lightSpace * vec4(worldPos + normal * texelWorld * lexviShadowParams.w, 1.0);\n"
+			"    vec3 coords = clip.xyz / clip.w * 0.5 + 0.5;\n"
+			"    float reference = coords.z - lexviShadowParams.z;\n"
+			"\n"
+			"    float lit = 0.0;\n"
+			"    for (int x = -1; x <= 1; ++x) {\n"
+			"        for (int y = -1; y <= 1; ++y) {\n"
+			"            vec2 uv = coords.xy + vec2(x, y) * lexviShadowParams.y;\n"
+			"            lit += texture(lexviShadowMap, vec4(uv, float(cascade), reference));\n"
+			"        }\n"
+			"    }\n"
+			"    return lit / 9.0;\n"
+			"}\n";
+	}
+}
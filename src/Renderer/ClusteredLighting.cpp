@@ -0,0 +1,304 @@
+#include "pch.h"
+
+#include "Renderer/ClusteredLighting.hpp"
+#include "Renderer/BindingPoints.hpp"
+#include "Renderer/GLState.hpp"
+#include "Shader/ShaderCache.hpp"
+
+namespace Lexvi {
+	namespace {
+		constexpr uint32_t NO_INDEX = 0xFFFFFFFFu;
+
+		const char* BIN_SHADER_SOURCE = R"(#version 460
+layout(local_size_x = 128) in;
+
+#include <Lexvi/FrameConstants.glsl>
+
+struct Light {
+    vec4 positionRange;
+    vec4 colorIntensity;
+    vec4 directionType;
+    vec4 spotAngles;
+};
+
+struct ClusterBounds {
+    vec4 minPoint;
+    vec4 maxPoint;
+};
+
+layout(std430, binding = LEXVI_LIGHTS_BINDING) readonly buffer Lights { Light lights[]; };
+layout(std430, binding = LEXVI_BOUNDS_BINDING) readonly buffer Bounds { ClusterBounds clusters[]; };
+layout(std430, binding = LEXVI_GRID_BINDING) writeonly buffer Grid { uvec2 grid[]; };
+layout(std430, binding = LEXVI_INDICES_BINDING) writeonly buffer Indices { uint lightIndices[]; };
+layout(std430, binding = LEXVI_COUNTER_BINDING) buffer Counter { uint indexCount; };
+
+uniform uint lightCount;
+uniform uint clusterCount;
+uniform uint indexCapacity;
+
+// view space center and range of a batch of lights, shared by the whole group
+shared vec4 batch[gl_WorkGroupSize.x];
+
+void main() {
+    uint group = gl_WorkGroupID.x + gl_WorkGroupID.y * gl_NumWorkGroups.x + gl_WorkGroupID.z * gl_NumWorkGroups.x * gl_NumWorkGroups.y;
+    uint index = group * gl_WorkGroupSize.x + gl_LocalInvocationIndex;
+    bool active = index < clusterCount;
+
+    ClusterBounds bounds = ClusterBounds(vec4(0.0), vec4(0.0));
+    if (active) bounds = clusters[index];
+
+    uint visible[LEXVI_MAX_LIGHTS_PER_CLUSTER];
+    uint count = 0u;
+
+    // no early return: every invocation has to reach the barriers
+    for (uint base = 0u; base < lightCount; base += gl_WorkGroupSize.x) {
+        uint light = base + gl_LocalInvocationIndex;
+        if (light < lightCount) {
+            vec4 positionRange = lights[light].positionRange;
+            batch[gl_LocalInvocationIndex] = vec4((lexviView * vec4(positionRange.xyz, 1.0)).xyz, positionRange.w);
+        }
+        barrier();
+
+        uint batchSize = min(gl_WorkGroupSize.x, lightCount - base);
+        for (uint i = 0u; active && i < batchSize && count < LEXVI_MAX_LIGHTS_PER_CLUSTER; ++i) {
+            vec4 sphere = batch[i];
+            vec3 d = clamp(sphere.xyz, bounds.minPoint.xyz, bounds.maxPoint.xyz) - sphere.xyz;
+            if (dot(d, d) <= sphere.w * sphere.w) visible[count++] = base + i;
+        }
+        barrier();
+    }
+
+    if (!active) return;
+
+    uint offset = atomicAdd(indexCount, count);
+    count = offset >= indexCapacity ? 0u : min(count, indexCapacity - offset);
+    for (uint i = 0u; i < count; ++i) lightIndices[offset + i] = visible[i];
+    grid[index] = uvec2(offset, count);
+}
+)";
+	}
+
+	Light MakePointLight(const glm::vec3& position, const glm::vec3& color, float intensity, float range)
+	{
+		Light light{};
+		light.positionRange = glm::vec4(position, range);
+		light.colorIntensity = glm::vec4(color, intensity);
+		light.directionType = glm::vec4(0.0f, -1.0f, 0.0f, static_cast<float>(LightType::Point));
+		return light;
+	}
+
+	Light MakeSpotLight(const glm::vec3& position, const glm::vec3& direction, const glm::vec3& color, float intensity, float range, float innerAngle, float outerAngle)
+	{
+		Light light{};
+		light.positionRange = glm::vec4(position, range);
+		light.colorIntensity = glm::vec4(color, intensity);
+		light.directionType = glm::vec4(glm::normalize(direction), static_cast<float>(LightType::Spot));
+		light.spotAngles = glm::vec4(std::cos(innerAngle), std::cos(outerAngle), 0.0f, 0.0f);
+		return light;
+	}
+
+	ClusteredLighting::~ClusteredLighting()
+	{
+		for (SSBO* ssbo : { &lightsSSBO, &boundsSSBO, &gridSSBO, &indicesSSBO, &counterSSBO }) {
+			if (ssbo->id) DeleteSSBO(*ssbo);
+		}
+	}
+
+	uint32_t ClusteredLighting::AddLight(const Light& light)
+	{
+		uint32_t handle;
+		if (freeHandles.empty()) {
+			handle = static_cast<uint32_t>(handleToIndex.size());
+			handleToIndex.push_back(NO_INDEX);
+		}
+		else {
+			handle = freeHandles.back();
+			freeHandles.pop_back();
+		}
+
+		handleToIndex[handle] = static_cast<uint32_t>(lights.size());
+		lights.push_back(light);
+		lightHandles.push_back(handle);
+		lightsDirty = true;
+		return handle;
+	}
+
+	void ClusteredLighting::SetLight(uint32_t handle, const Light& light)
+	{
+		lights[handleToIndex[handle]] = light;
+		lightsDirty = true;
+	}
+
+	void ClusteredLighting::RemoveLight(uint32_t handle)
+	{
+		// swap with the last light so the uploaded list stays dense
+		uint32_t index = handleToIndex[handle];
+		uint32_t last = static_cast<uint32_t>(lights.size() - 1);
+
+		lights[index] = lights[last];
+		lightHandles[index] = lightHandles[last];
+		handleToIndex[lightHandles[index]] = index;
+
+		lights.pop_back();
+		lightHandles.pop_back();
+		handleToIndex[handle] = NO_INDEX;
+		freeHandles.push_back(handle);
+		lightsDirty = true;
+	}
+
+	void ClusteredLighting::Clear()
+	{
+		lights.clear();
+		lightHandles.clear();
+		handleToIndex.clear();
+		freeHandles.clear();
+		lightsDirty = true;
+	}
+
+	void ClusteredLighting::createBuffers()
+	{
+		CreateSSBO(lightsSSBO, 64 * sizeof(Light), BindingPoints::LightsSSBO);
+		CreateSSBO(boundsSSBO, CLUSTER_COUNT * sizeof(ClusterBounds), BindingPoints::ClusterBoundsSSBO);
+		CreateSSBO(gridSSBO, CLUSTER_COUNT * sizeof(glm::uvec2), BindingPoints::ClusterGridSSBO);
+		CreateSSBO(indicesSSBO, CLUSTER_COUNT * AVERAGE_LIGHTS_PER_CLUSTER * sizeof(uint32_t), BindingPoints::LightIndicesSSBO);
+		CreateSSBO(counterSSBO, sizeof(uint32_t), BindingPoints::LightIndexCounterSSBO);
+	}
+
+	void ClusteredLighting::buildClusterBounds(const glm::mat4& projection, float zNear, float zFar)
+	{
+		glm::mat4 inverseProjection = glm::inverse(projection);
+		std::vector<ClusterBounds> bounds(CLUSTER_COUNT);
+
+		// point on the near plane for an NDC xy, the froxel corners lie on the rays through them
+		auto nearPoint = [&](float x, float y) {
+			glm::vec4 p = inverseProjection * glm::vec4(x, y, -1.0f, 1.0f);
+			return glm::vec3(p) / p.w;
+		};
+
+		for (uint32_t z = 0; z < CLUSTERS_Z; ++z) {
+			// exponential slices, must match LexviClusterLights
+			float sliceNear = zNear * std::pow(zFar / zNear, static_cast<float>(z) / CLUSTERS_Z);
+			float sliceFar = zNear * std::pow(zFar / zNear, static_cast<float>(z + 1) / CLUSTERS_Z);
+
+			for (uint32_t y = 0; y < CLUSTERS_Y; ++y) {
+				for (uint32_t x = 0; x < CLUSTERS_X; ++x) {
+					float x0 = 2.0f * x / CLUSTERS_X - 1.0f, x1 = 2.0f * (x + 1) / CLUSTERS_X - 1.0f;
+					float y0 = 2.0f * y / CLUSTERS_Y - 1.0f, y1 = 2.0f * (y + 1) / CLUSTERS_Y - 1.0f;
+					glm::vec3 corners[4] = { nearPoint(x0, y0), nearPoint(x1, y0), nearPoint(x0, y1), nearPoint(x1, y1) };
+
+					glm::vec3 min(std::numeric_limits<float>::max());
+					glm::vec3 max(-std::numeric_limits<float>::max());
+					for (const glm::vec3& corner : corners) {
+						// view space looks down -z
+						for (float depth : { sliceNear, sliceFar }) {
+							glm::vec3 p = corner * (depth / -corner.z);
+							min = glm::min(min, p);
+							max = glm::max(max, p);
+						}
+					}
+
+					uint32_t index = x + y * CLUSTERS_X + z * CLUSTERS_X * CLUSTERS_Y;
+					bounds[index] = { glm::vec4(min, 0.0f), glm::vec4(max, 0.0f) };
+				}
+			}
+		}
+
+		UpdateSSBO(boundsSSBO, bounds.data(), bounds.size() * sizeof(ClusterBounds), 0);
+		boundsProjection = projection;
+	}
+
+	void ClusteredLighting::Update(const Camera& camera)
+	{
+		if (!gridSSBO.id) createBuffers();
+
+		const glm::mat4& projection = camera.getCameraData().projection;
+		if (projection != boundsProjection) {
+			glm::vec2 nearFar = camera.getZNearAndZFar();
+			buildClusterBounds(projection, nearFar.x, nearFar.y);
+		}
+
+		if (lightsDirty) {
+			size_t size = std::max<size_t>(lights.size(), 1) * sizeof(Light);
+			if (lightsSSBO.size < size) ResizeSSBO(lightsSSBO, size * 2);
+			if (!lights.empty()) UpdateSSBO(lightsSSBO, lights.data(), lights.size() * sizeof(Light), 0);
+			lightsDirty = false;
+		}
+		uploadedLightCount = static_cast<uint32_t>(lights.size());
+
+		for (SSBO* ssbo : { &lightsSSBO, &boundsSSBO, &gridSSBO, &indicesSSBO, &counterSSBO }) BindSSBO(*ssbo);
+
+		uint32_t zero = 0;
+		glClearNamedBufferData(counterSSBO.id, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+		if (lights.empty()) {
+			// nothing to bin, shaders read empty clusters
+			glClearNamedBufferData(gridSSBO.id, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+			return;
+		}
+
+		// compiled on the first frame with lights, games without lights never pay for it
+		if (!binShader) binShader = GetShaderCache().GetComputeShaderFromSource(BIN_SHADER_SOURCE, {
+			{ "LEXVI_LIGHTS_BINDING", std::to_string(BindingPoints::LightsSSBO) },
+			{ "LEXVI_BOUNDS_BINDING", std::to_string(BindingPoints::ClusterBoundsSSBO) },
+			{ "LEXVI_GRID_BINDING", std::to_string(BindingPoints::ClusterGridSSBO) },
+			{ "LEXVI_INDICES_BINDING", std::to_string(BindingPoints::LightIndicesSSBO) },
+			{ "LEXVI_COUNTER_BINDING", std::to_string(BindingPoints::LightIndexCounterSSBO) },
+			{ "LEXVI_MAX_LIGHTS_PER_CLUSTER", std::to_string(MAX_LIGHTS_PER_CLUSTER) },
+		});
+
+		binShader->use();
+		binShader->setUint("lightCount", static_cast<uint32_t>(lights.size()));
+		binShader->setUint("clusterCount", CLUSTER_COUNT);
+		binShader->setUint("indexCapacity", CLUSTER_COUNT * AVERAGE_LIGHTS_PER_CLUSTER);
+		binShader->DispatchThreads(static_cast<uint64_t>(CLUSTER_COUNT));
+		glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+	}
+
+	std::string ClusteredLighting::GetGLSL()
+	{
+		return
+			"#include <Lexvi/FrameConstants.glsl>\n"
+			"\n"
+			"#define LEXVI_LIGHT_POINT 0u\n"
+			"#define LEXVI_LIGHT_SPOT 1u\n"
+			"const uvec3 LEXVI_CLUSTER_GRID = uvec3(" + std::to_string(CLUSTERS_X) + "u, " + std::to_string(CLUSTERS_Y) + "u, " + std::to_string(CLUSTERS_Z) + "u);\n"
+			"\n"
+			"struct LexviLight {\n"
+			"    vec4 positionRange;\n"
+			"    vec4 colorIntensity;\n"
+			"    vec4 directionType;\n"
+			"    vec4 spotAngles;\n"
+			"};\n"
+			"\n"
+			"layout(std430, binding = " + std::to_string(BindingPoints::LightsSSBO) + ") readonly buffer LexviLights { LexviLight lexviLights[]; };\n"
+			"layout(std430, binding = " + std::to_string(BindingPoints::ClusterGridSSBO) + ") readonly buffer LexviClusterGrid { uvec2 lexviClusterGrid[]; };\n"
+			"layout(std430, binding = " + std::to_string(BindingPoints::LightIndicesSSBO) + ") readonly buffer LexviLightIndices { uint lexviLightIndices[]; };\n"
+			"\n"
+			"// x = first entry in lexviLightIndices, y = light count of the fragment's cluster.\n"
+			"// viewDepth is the positive distance along the view axis.\n"
+			"uvec2 LexviClusterLights(vec2 fragCoord, float viewDepth) {\n"
+			"    float zNear = lexviClipPlanes.x;\n"
+			"    float zFar = lexviClipPlanes.y;\n"
+			"    uvec2 tile = uvec2(clamp(fragCoord * lexviResolution.zw, 0.0, 0.9999) * vec2(LEXVI_CLUSTER_GRID.xy));\n"
+			"    float slice = log(max(viewDepth, zNear) / zNear) / log(zFar / zNear) * float(LEXVI_CLUSTER_GRID.z);\n"
+			"    uint z = min(uint(slice), LEXVI_CLUSTER_GRID.z - 1u);\n"
+			"    return lexviClusterGrid[tile.x + tile.y * LEXVI_CLUSTER_GRID.x + z * LEXVI_CLUSTER_GRID.x * LEXVI_CLUSTER_GRID.y];\n"
+			"}\n"
+			"\n"
+			"// Writes the direction towards the light and returns its intensity at worldPos, 0 past the range\n"
+			"float LexviLightAttenuation(LexviLight light, vec3 worldPos, out vec3 L) {\n"
+			"    vec3 toLight = light.positionRange.xyz - worldPos;\n"
+			"    float distance2 = dot(toLight, toLight);\n"
+			"    L = toLight * inversesqrt(max(distance2, 1e-8));\n"
+			"\n"
+			"    // inverse square, windowed to reach 0 at the range\n"
+			"    float ratio = distance2 / (light.positionRange.w * light.positionRange.w);\n"
+			"    float window = clamp(1.0 - ratio * ratio, 0.0, 1.0);\n"
+			"    float attenuation = window * window / (distance2 + 1.0);\n"
+			"\n"
+			"    if (uint(light.directionType.w) == LEXVI_LIGHT_SPOT) {\n"
+			"        attenuation *= smoothstep(light.spotAngles.y, light.spotAngles.x, dot(-L, light.directionType.xyz));\n"
+			"    }\n"
+			"    return attenuation * light.colorIntensity.w;\n"
+			"}\n";
+	}
+}
@@ -0,0 +1,331 @@
+#include "pch.h"
+
+#include "Renderer/DeferredShading.hpp"
+#include "Renderer/BindingPoints.hpp"
+#include "Renderer/GLState.hpp"
+#include "Shader/ShaderCache.hpp"
+
+namespace Lexvi {
+	namespace {
+		const char* RESOLVE_SHADER_SOURCE = R"(#version 460
+layout(local_size_x = LEXVI_TILE_SIZE, local_size_y = LEXVI_TILE_SIZE) in;
+
+#include <Lexvi/Lighting.glsl>
+#include <Lexvi/GBufferPacking.glsl>
+#if LEXVI_SUN_SHADOWS
+#include <Lexvi/Shadows.glsl>
+#endif
+
+layout(binding = LEXVI_ALBEDO_UNIT) uniform sampler2D gAlbedo;
+layout(binding = LEXVI_NORMAL_UNIT) uniform sampler2D gNormal;
+layout(binding = LEXVI_MATERIAL_UNIT) uniform sampler2D gMaterial;
+layout(binding = LEXVI_DEPTH_UNIT) uniform sampler2D gDepth;
+layout(rgba16f, binding = 0) uniform writeonly image2D outputImage;
+
+uniform uint lightCount;
+uniform vec2 renderSize;
+uniform vec3 sunDirection;
+uniform vec3 sunRadiance;
+uniform vec3 ambient;
+uniform vec4 background;
+
+shared uint tileMinDepth;
+shared uint tileMaxDepth;
+shared uint tileLightCount;
+shared uint tileLights[LEXVI_MAX_LIGHTS_PER_TILE];
+
+const float PI = 3.14159265;
+
+// view space point at distance 1 along the view axis for an NDC xy
+vec3 ViewRay(vec2 ndc) {
+    return vec3((ndc.x + lexviProjection[2][0]) / lexviProjection[0][0], (ndc.y + lexviProjection[2][1]) / lexviProjection[1][1], -1.0);
+}
+
+// positive distance along the view axis
+float ViewDepth(float depth) {
+    return lexviProjection[3][2] / (depth * 2.0 - 1.0 + lexviProjection[2][2]);
+}
+
+// Cook-Torrance, GGX distribution, Schlick-GGX geometry and Schlick fresnel
+vec3 Shade(vec3 N, vec3 V, vec3 L, vec3 radiance, vec3 albedo, float roughness, float metallic) {
+    float NdotL = max(dot(N, L), 0.0);
+    if (NdotL <= 0.0) return vec3(0.0);
+
+    vec3 H = normalize(V + L);
+    float NdotV = max(dot(N, V), 1e-4);
+    float NdotH = max(dot(N, H), 0.0);
+
+    float a = roughness * roughness;
+    float a2 = a * a;
+    float d = NdotH * NdotH * (a2 - 1.0) + 1.0;
+    float D = a2 / (PI * d * d);
+
+    float k = (roughness + 1.0) * (roughness + 1.0) / 8.0;
+    float G = NdotV / (NdotV * (1.0 - k) + k) * NdotL / (NdotL * (1.0 - k) + k);
+
+    vec3 F0 = mix(vec3(0.04), albedo, metallic);
+    vec3 F = F0 + (1.0 - F0) * pow(1.0 - max(dot(H, V), 0.0), 5.0);
+
+    vec3 specular = D * G * F / (4.0 * NdotV * NdotL);
+    vec3 diffuse = (1.0 - F) * (1.0 - metallic) * albedo / PI;
+    return (diffuse + specular) * radiance * NdotL;
+}
+
+void main() {
+    ivec2 pixel = ivec2(gl_GlobalInvocationID.xy);
+    bool inside = all(lessThan(vec2(gl_GlobalInvocationID.xy), renderSize));
+
+    if (gl_LocalInvocationIndex == 0u) {
+        tileMinDepth = 0x7F7FFFFFu;
+        tileMaxDepth = 0u;
+        tileLightCount = 0u;
+    }
+    barrier();
+
+    // depth range of the tile, positive floats order like their bits
+    float depth = inside ? texelFetch(gDepth, pixel, 0).r : 1.0;
+    bool geometry = depth < 1.0;
+    float viewDepth = ViewDepth(depth);
+    if (geometry) {
+        atomicMin(tileMinDepth, floatBitsToUint(viewDepth));
+        atomicMax(tileMaxDepth, floatBitsToUint(viewDepth));
+    }
+    barrier();
+
+    if (tileMaxDepth > 0u) {
+        float minDepth = uintBitsToFloat(tileMinDepth);
+        float maxDepth = uintBitsToFloat(tileMaxDepth);
+
+        // side planes of the tile through the eye, normals point inwards
+        vec2 tileMin = vec2(gl_WorkGroupID.xy * gl_WorkGroupSize.xy) / renderSize * 2.0 - 1.0;
+        vec2 tileMax = vec2((gl_WorkGroupID.xy + 1u) * gl_WorkGroupSize.xy) / renderSize * 2.0 - 1.0;
+        vec3 c00 = ViewRay(tileMin);
+        vec3 c10 = ViewRay(vec2(tileMax.x, tileMin.y));
+        vec3 c01 = ViewRay(vec2(tileMin.x, tileMax.y));
+        vec3 c11 = ViewRay(tileMax);
+        vec3 planes[4] = vec3[4](
+            normalize(cross(c00, c01)),
+            normalize(cross(c11, c10)),
+            normalize(cross(c10, c00)),
+            normalize(cross(c01, c11))
+        );
+
+        uint threadCount = gl_WorkGroupSize.x * gl_WorkGroupSize.y;
+        for (uint i = gl_LocalInvocationIndex; i < lightCount; i += threadCount) {
+            vec4 positionRange = lexviLights[i].positionRange;
+            vec3 center = (lexviView * vec4(positionRange.xyz, 1.0)).xyz;
+            float radius = positionRange.w;
+
+            bool visible = -center.z + radius >= minDepth && -center.z - radius <= maxDepth;
+            for (int p = 0; p < 4 && visible; ++p) visible = dot(planes[p], center) >= -radius;
+
+            if (visible) {
+                uint slot = atomicAdd(tileLightCount, 1u);
+                if (slot < LEXVI_MAX_LIGHTS_PER_TILE) tileLights[slot] = i;
+            }
+        }
+    }
+    barrier();
+
+    if (!inside) return;
+    if (!geometry) {
+        imageStore(outputImage, pixel, background);
+        return;
+    }
+
+    vec4 albedoOcclusion = texelFetch(gAlbedo, pixel, 0);
+    vec3 albedo = albedoOcclusion.rgb;
+    vec3 N = LexviDecodeNormal(texelFetch(gNormal, pixel, 0).xy);
+    vec2 material = texelFetch(gMaterial, pixel, 0).xy;
+    float roughness = max(material.x, 0.04);
+    float metallic = material.y;
+
+    // the view matrix is rigid, its inverse is the transposed rotation
+    vec2 ndc = (vec2(pixel) + 0.5) / renderSize * 2.0 - 1.0;
+    vec3 viewPos = ViewRay(ndc) * viewDepth;
+    vec3 worldPos = transpose(mat3(lexviView)) * (viewPos - lexviView[3].xyz);
+    vec3 V = normalize(lexviCameraPosition.xyz - worldPos);
+
+    vec3 color = ambient * albedo * albedoOcclusion.a;
+
+    if (any(greaterThan(sunRadiance, vec3(0.0)))) {
+        float lit = 1.0;
+#if LEXVI_SUN_SHADOWS
+        lit = LexviShadow(worldPos, N, viewDepth);
+#endif
+        color += Shade(N, V, -sunDirection, sunRadiance * lit, albedo, roughness, metallic);
+    }
+
+    uint count = min(tileLightCount, uint(LEXVI_MAX_LIGHTS_PER_TILE));
+    for (uint i = 0u; i < count; ++i) {
+        LexviLight light = lexviLights[tileLights[i]];
+        vec3 L;
+        float attenuation = LexviLightAttenuation(light, worldPos, L);
+        if (attenuation > 0.0) color += Shade(N, V, L, light.colorIntensity.rgb * attenuation, albedo, roughness, metallic);
+    }
+
+    imageStore(outputImage, pixel, vec4(color, 1.0));
+}
+)";
+	}
+
+	DeferredShading::~DeferredShading()
+	{
+		deleteOutput();
+	}
+
+	void DeferredShading::Resize(uint32_t renderWidth, uint32_t renderHeight, uint32_t capacityWidth, uint32_t capacityHeight)
+	{
+		this->renderWidth = std::max(renderWidth, 1u);
+		this->renderHeight = std::max(renderHeight, 1u);
+		this->capacityWidth = std::max(capacityWidth, this->renderWidth);
+		this->capacityHeight = std::max(capacityHeight, this->renderHeight);
+	}
+
+	void DeferredShading::PrepareGBuffer()
+	{
+		if (allocatedWidth != capacityWidth || allocatedHeight != capacityHeight) allocate();
+	}
+
+	void DeferredShading::BeginGeometryPass()
+	{
+		PrepareGBuffer();
+
+		gBuffer.BindFrameBuffer();
+		glViewport(0, 0, renderWidth, renderHeight);
+		// the albedo alpha holds occlusion, not coverage
+		GLState::SetBlend(false);
+
+		// only the rendered area, the rest of the capacity is never read
+		glEnable(GL_SCISSOR_TEST);
+		glScissor(0, 0, renderWidth, renderHeight);
+		float zero[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+		float one = 1.0f;
+		for (int i = 0; i < 3; ++i) glClearNamedFramebufferfv(gBuffer.getID(), GL_COLOR, i, zero);
+		GLState::SetDepthWrite(true);
+		glClearNamedFramebufferfv(gBuffer.getID(), GL_DEPTH, 0, &one);
+		glDisable(GL_SCISSOR_TEST);
+	}
+
+	void DeferredShading::Resolve(const ClusteredLighting& lighting)
+	{
+		if (!output) return;
+
+		std::shared_ptr<ComputeShader>& shader = settings.sunShadows ? resolveShaderShadowed : resolveShader;
+		if (!shader) shader = GetShaderCache().GetComputeShaderFromSource(RESOLVE_SHADER_SOURCE, {
+			{ "LEXVI_TILE_SIZE", std::to_string(TILE_SIZE) },
+			{ "LEXVI_MAX_LIGHTS_PER_TILE", std::to_string(MAX_LIGHTS_PER_TILE) },
+			{ "LEXVI_ALBEDO_UNIT", std::to_string(BindingPoints::GBufferAlbedoUnit) },
+			{ "LEXVI_NORMAL_UNIT", std::to_string(BindingPoints::GBufferNormalUnit) },
+			{ "LEXVI_MATERIAL_UNIT", std::to_string(BindingPoints::GBufferMaterialUnit) },
+			{ "LEXVI_DEPTH_UNIT", std::to_string(BindingPoints::GBufferDepthUnit) },
+			{ "LEXVI_SUN_SHADOWS", settings.sunShadows ? "1" : "0" },
+		});
+
+		GLState::BindTextureUnit(BindingPoints::GBufferAlbedoUnit, gBuffer.getAttachment(COLOR, 0)->id);
+		GLState::BindTextureUnit(BindingPoints::GBufferNormalUnit, gBuffer.getAttachment(COLOR, 1)->id);
+		GLState::BindTextureUnit(BindingPoints::GBufferMaterialUnit, gBuffer.getAttachment(COLOR, 2)->id);
+		GLState::BindTextureUnit(BindingPoints::GBufferDepthUnit, gBuffer.getAttachment(DEPTH)->id);
+		glBindImageTexture(0, output, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA16F);
+
+		shader->use();
+		shader->setUint("lightCount", lighting.getUploadedLightCount());
+		shader->setVec2("renderSize", glm::vec2(static_cast<float>(renderWidth), static_cast<float>(renderHeight)));
+		shader->setVec3("sunDirection", glm::normalize(settings.sunDirection));
+		shader->setVec3("sunRadiance", settings.sunColor * settings.sunIntensity);
+		shader->setVec3("ambient", settings.ambient);
+		shader->setVec4("background", settings.background);
+
+		shader->Dispatch(glm::uvec3((renderWidth + TILE_SIZE - 1) / TILE_SIZE, (renderHeight + TILE_SIZE - 1) / TILE_SIZE, 1));
+
+		// Composite blits it, post passes sample it
+		glMemoryBarrier(GL_FRAMEBUFFER_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT);
+	}
+
+	void DeferredShading::Composite(unsigned int framebuffer, bool copyDepth)
+	{
+		if (!output) return;
+
+		glBlitNamedFramebuffer(outputFramebuffer.getID(), framebuffer,
+			0, 0, renderWidth, renderHeight,
+			0, 0, renderWidth, renderHeight,
+			GL_COLOR_BUFFER_BIT, GL_NEAREST);
+
+		if (copyDepth) {
+			glBlitNamedFramebuffer(gBuffer.getID(), framebuffer,
+				0, 0, renderWidth, renderHeight,
+				0, 0, renderWidth, renderHeight,
+				GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+		}
+
+		GLState::BindFramebuffer(framebuffer);
+		glViewport(0, 0, renderWidth, renderHeight);
+		// back to the engine default for forward passes
+		GLState::SetBlend(true);
+	}
+
+	void DeferredShading::allocate()
+	{
+		gBuffer = FrameBuffer({ GL_RGBA8, GL_RG16, GL_RG8 }, DEPTH, capacityWidth, capacityHeight);
+
+		// texelFetch of the depth needs plain sampling, GenerateDepthTexture sets compare mode for shadows
+		glTextureParameteri(gBuffer.getAttachment(DEPTH)->id, GL_TEXTURE_COMPARE_MODE, GL_NONE);
+
+		deleteOutput();
+		glCreateTextures(GL_TEXTURE_2D, 1, &output);
+		glTextureStorage2D(output, 1, GL_RGBA16F, capacityWidth, capacityHeight);
+		glTextureParameteri(output, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTextureParameteri(output, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTextureParameteri(output, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTextureParameteri(output, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		outputFramebuffer = FrameBuffer(std::vector<unsigned int>{ output }, 0, GL_DEPTH_ATTACHMENT, capacityWidth, capacityHeight);
+
+		allocatedWidth = capacityWidth;
+		allocatedHeight = capacityHeight;
+	}
+
+	void DeferredShading::deleteOutput()
+	{
+		if (!output) return;
+
+		outputFramebuffer = FrameBuffer();
+		GLState::ForgetTexture(output);
+		glDeleteTextures(1, &output);
+		output = 0;
+	}
+
+	std::string DeferredShading::GetPackingGLSL()
+	{
+		return
+			"// Octahedral unit vector encoding into [0, 1]^2\n"
+			"vec2 LexviEncodeNormal(vec3 n) {\n"
+			"    n /= abs(n.x) + abs(n.y) + abs(n.z);\n"
+			"    if (n.z < 0.0) n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);\n"
+			"    return n.xy * 0.5 + 0.5;\n"
+			"}\n"
+			"\n"
+			"vec3 LexviDecodeNormal(vec2 encoded) {\n"
+			"    vec2 f = encoded * 2.0 - 1.0;\n"
+			"    vec3 n = vec3(f, 1.0 - abs(f.x) - abs(f.y));\n"
+			"    float t = clamp(-n.z, 0.0, 1.0);\n"
+			"    n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);\n"
+			"    return normalize(n);\n"
+			"}\n";
+	}
+
+	std::string DeferredShading::GetGLSL()
+	{
+		return
+			"#include <Lexvi/GBufferPacking.glsl>\n"
+			"\n"
+			"layout(location = 0) out vec4 lexviGBufferAlbedo;   // albedo, ambient occlusion\n"
+			"layout(location = 1) out vec2 lexviGBufferNormal;   // octahedral world normal\n"
+			"layout(location = 2) out vec2 lexviGBufferMaterial; // roughness, metallic\n"
+			"\n"
+			"void LexviWriteGBuffer(vec3 albedo, vec3 worldNormal, float roughness, float metallic, float occlusion) {\n"
+			"    lexviGBufferAlbedo = vec4(albedo, occlusion);\n"
+			"    lexviGBufferNormal = LexviEncodeNormal(normalize(worldNormal));\n"
+			"    lexviGBufferMaterial = vec2(roughness, metallic);\n"
+			"}\n";
+	}
+}
@@ -0,0 +1,176 @@
+#include "pch.h"
+
+#include "Renderer/DynamicResolution.hpp"
+#include "Renderer/GLState.hpp"
+
+namespace Lexvi {
+	DynamicResolution::~DynamicResolution()
+	{
+		if (queries[0][0]) glDeleteQueries(QUERY_LATENCY * 2, &queries[0][0]);
+	}
+
+	void DynamicResolution::setSettings(const DynamicResolutionSettings& newSettings)
+	{
+		settings = newSettings;
+		settings.minScale = glm::clamp(settings.minScale, 0.1f, 1.0f);
+		settings.maxScale = glm::clamp(settings.maxScale, settings.minScale, 2.0f);
+		settings.granularity = std::max(1u, settings.granularity);
+
+		scale = glm::clamp(scale, settings.minScale, settings.maxScale);
+		framesUnderBudget = 0;
+
+		// capacity depends on maxScale
+		capacityWidth = capacityHeight = 0;
+	}
+
+	void DynamicResolution::BeginFrame(uint32_t windowWidth, uint32_t windowHeight)
+	{
+		if (!queries[0][0]) glCreateQueries(GL_TIMESTAMP, QUERY_LATENCY * 2, &queries[0][0]);
+
+		this->windowWidth = std::max(windowWidth, 1u);
+		this->windowHeight = std::max(windowHeight, 1u);
+
+		readTimers();
+
+		if (!settings.enabled) {
+			renderWidth = this->windowWidth;
+			renderHeight = this->windowHeight;
+		}
+		else {
+			resize();
+
+			auto scaled = [&](uint32_t size, uint32_t capacity) {
+				uint32_t granularity = settings.granularity;
+				uint32_t pixels = static_cast<uint32_t>(size * scale + 0.5f);
+				pixels = (pixels + granularity / 2) / granularity * granularity;
+				return glm::clamp(pixels, std::min(granularity, capacity), capacity);
+			};
+			renderWidth = scaled(this->windowWidth, capacityWidth);
+			renderHeight = scaled(this->windowHeight, capacityHeight);
+		}
+
+		stats.scale = settings.enabled ? scale : 1.0f;
+		stats.width = renderWidth;
+		stats.height = renderHeight;
+	}
+
+	void DynamicResolution::BeginScene()
+	{
+		unsigned int* timer = queries[frame % QUERY_LATENCY];
+		glQueryCounter(timer[0], GL_TIMESTAMP);
+
+		if (!settings.enabled) return;
+
+		target.BindFrameBuffer();
+		glViewport(0, 0, renderWidth, renderHeight);
+	}
+
+	void DynamicResolution::EndScene()
+	{
+		if (settings.enabled) {
+			// whole pixels when nothing is scaled
+			GLenum filter = (renderWidth == windowWidth && renderHeight == windowHeight) ? GL_NEAREST : GL_LINEAR;
+			glBlitNamedFramebuffer(target.getID(), 0,
+				0, 0, renderWidth, renderHeight,
+				0, 0, windowWidth, windowHeight,
+				GL_COLOR_BUFFER_BIT, filter);
+
+			GLState::BindFramebuffer(0);
+			glViewport(0, 0, windowWidth, windowHeight);
+		}
+
+		uint32_t slot = frame % QUERY_LATENCY;
+		glQueryCounter(queries[slot][1], GL_TIMESTAMP);
+		queryPending[slot] = true;
+		frame++;
+	}
+
+	void DynamicResolution::getRenderSize(uint32_t& width, uint32_t& height) const
+	{
+		width = renderWidth;
+		height = renderHeight;
+	}
+
+	void DynamicResolution::getCapacity(uint32_t& width, uint32_t& height) const
+	{
+		width = settings.enabled ? capacityWidth : windowWidth;
+		height = settings.enabled ? capacityHeight : windowHeight;
+	}
+
+	unsigned int DynamicResolution::getSceneFramebuffer() const
+	{
+		return settings.enabled ? target.getID() : 0;
+	}
+
+	void DynamicResolution::readTimers()
+	{
+		// oldest first, that is the slot written this frame so it has to be free
+		for (uint32_t i = 0; i < QUERY_LATENCY; ++i) {
+			uint32_t slot = (frame + i) % QUERY_LATENCY;
+			if (!queryPending[slot]) continue;
+
+			GLint available = GL_FALSE;
+			glGetQueryObjectiv(queries[slot][1], GL_QUERY_RESULT_AVAILABLE, &available);
+			// only waits if the GPU is a whole ring of frames behind
+			if (!available && i > 0) break;
+
+			GLuint64 begin = 0, end = 0;
+			glGetQueryObjectui64v(queries[slot][0], GL_QUERY_RESULT, &begin);
+			glGetQueryObjectui64v(queries[slot][1], GL_QUERY_RESULT, &end);
+			queryPending[slot] = false;
+
+			updateScale(static_cast<float>(end - begin) / 1'000'000.0f);
+		}
+	}
+
+	void DynamicResolution::updateScale(float frameTime)
+	{
+		if (ignoreSamples > 0) {
+			ignoreSamples--;
+			return;
+		}
+
+		smoothedTime = (smoothedTime == 0.0f) ? frameTime : glm::mix(smoothedTime, frameTime, settings.smoothing);
+		stats.gpuTime = smoothedTime;
+
+		if (!settings.enabled) return;
+
+		// GPU time roughly follows the pixel count, the square of the scale
+		float ratio = settings.targetFrameTime / smoothedTime;
+		float newScale = scale;
+
+		if (smoothedTime > settings.targetFrameTime) {
+			newScale = std::max(settings.minScale, scale * std::sqrt(ratio));
+			framesUnderBudget = 0;
+		}
+		else if (smoothedTime < settings.targetFrameTime * settings.increaseThreshold) {
+			if (++framesUnderBudget >= settings.increaseDelay) {
+				newScale = std::min(settings.maxScale, scale * std::min(std::sqrt(ratio), settings.maxIncrease));
+				framesUnderBudget = 0;
+			}
+		}
+		else {
+			framesUnderBudget = 0;
+		}
+
+		if (newScale != scale) {
+			scale = newScale;
+			// frames already queued were drawn at the old scale, start measuring afresh
+			ignoreSamples = QUERY_LATENCY;
+			smoothedTime = 0.0f;
+		}
+	}
+
+	void DynamicResolution::resize()
+	{
+		uint32_t width = static_cast<uint32_t>(std::ceil(windowWidth * settings.maxScale));
+		uint32_t height = static_cast<uint32_t>(std::ceil(windowHeight * settings.maxScale));
+		if (width == capacityWidth && height == capacityHeight) return;
+
+		capacityWidth = width;
+		capacityHeight = height;
+
+		if (target.getID()) target.ResizeFrameBuffer(width, height);
+		else target = FrameBuffer(COLOR | DEPTH, width, height);
+	}
+}
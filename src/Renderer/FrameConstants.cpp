@@ -0,0 +1,69 @@
+#include "pch.h"
+
+#include "Renderer/FrameConstants.hpp"
+#include "Renderer/BindingPoints.hpp"
+#include "Camera/Camera.hpp"
+#include "Shader/ComputeShader.hpp"
+
+namespace Lexvi {
+	FrameConstants BuildFrameConstants(const Camera* camera, float time, float deltaTime, uint32_t frameIndex, uint32_t width, uint32_t height)
+	{
+		FrameConstants constants{};
+
+		if (camera) {
+			const CameraData& data = camera->getCameraData();
+			glm::vec2 clip = camera->getZNearAndZFar();
+
+			constants.view = data.view;
+			constants.projection = data.projection;
+			constants.viewProjection = data.projection * data.view;
+			constants.cameraPosition = glm::vec4(camera->getPosition(), 1.0f);
+			constants.clipPlanes = glm::vec4(clip.x, clip.y, glm::radians(camera->getFOV()), camera->getAspectRatio());
+			GetFrustumPlanesVec4(camera->getFrustum(), constants.frustumPlanes);
+		}
+
+		constants.time = glm::vec4(time, deltaTime, static_cast<float>(frameIndex), 0.0f);
+
+		float w = static_cast<float>(std::max(width, 1u));
+		float h = static_cast<float>(std::max(height, 1u));
+		constants.resolution = glm::vec4(w, h, 1.0f / w, 1.0f / h);
+
+		return constants;
+	}
+
+	std::string GetFrameConstantsGLSL()
+	{
+		return
+			"layout(std140, binding = " + std::to_string(BindingPoints::FrameConstantsUBO) + ") uniform LexviFrameConstants {\n"
+			"    mat4 lexviView;\n"
+			"    mat4 lexviProjection;\n"
+			"    mat4 lexviViewProjection;\n"
+			"    vec4 lexviCameraPosition;\n"
+			"    vec4 lexviClipPlanes;\n"
+			"    vec4 lexviFrustumPlanes[6];\n"
+			"    vec4 lexviTime;\n"
+			"    vec4 lexviResolution;\n"
+			"};\n";
+	}
+
+	std::string GetCullingGLSL()
+	{
+		return
+			"#include <Lexvi/FrameConstants.glsl>\n"
+			"uniform bool lexviCullFrustumOverride;\n"
+			"uniform vec4 lexviCullFrustumPlanes[6];\n"
+			"vec4 LexviCullPlane(int i) {\n"
+			"    return lexviCullFrustumOverride ? lexviCullFrustumPlanes[i] : lexviFrustumPlanes[i];\n"
+			"}\n";
+	}
+
+	void SetCullFrustumUniforms(const ComputeShader& shader, const CameraFrustum* frustum)
+	{
+		shader.setBool("lexviCullFrustumOverride", frustum != nullptr);
+		if (!frustum) return;
+
+		glm::vec4 planes[6];
+		GetFrustumPlanesVec4(*frustum, planes);
+		for (int i = 0; i < 6; ++i) shader.setVec4("lexviCullFrustumPlanes[" + std::to_string(i) + "]", planes[i]);
+	}
+}
@@ -0,0 +1,485 @@
+#include "pch.h"
+
+#include "Renderer/FrameGraph.hpp"
+#include "Renderer/GLState.hpp"
+
+namespace Lexvi {
+	namespace {
+		constexpr GLbitfield ALL_IMAGE_BARRIERS = GL_TEXTURE_FETCH_BARRIER_BIT | GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_FRAMEBUFFER_BARRIER_BIT;
+
+		bool IsDepthFormat(GLenum format) {
+			switch (format) {
+			case GL_DEPTH_COMPONENT16:
+			case GL_DEPTH_COMPONENT24:
+			case GL_DEPTH_COMPONENT32:
+			case GL_DEPTH_COMPONENT32F:
+			case GL_DEPTH24_STENCIL8:
+			case GL_DEPTH32F_STENCIL8:
+				return true;
+			default:
+				return false;
+			}
+		}
+
+		bool HasStencil(GLenum format) {
+			return format == GL_DEPTH24_STENCIL8 || format == GL_DEPTH32F_STENCIL8;
+		}
+
+		// framebuffer keys are (texture, generation) pairs, a deleted texture leaves its pair behind
+		bool IsStaleKey(const std::vector<unsigned int>& key) {
+			for (size_t i = 0; i < key.size(); i += 2) {
+				if (key[i] != 0 && key[i + 1] != GLState::GetTextureGeneration(key[i])) return true;
+			}
+			return false;
+		}
+
+		// integer textures are incomplete with linear filtering, even for texelFetch
+		bool IsIntegerFormat(GLenum format) {
+			switch (format) {
+			case GL_R8UI: case GL_R16UI: case GL_R32UI:
+			case GL_RG8UI: case GL_RG16UI: case GL_RG32UI:
+			case GL_RGBA8UI: case GL_RGBA16UI: case GL_RGBA32UI:
+			case GL_R8I: case GL_R16I: case GL_R32I:
+			case GL_RG32I: case GL_RGBA32I:
+				return true;
+			default:
+				return false;
+			}
+		}
+
+		size_t BytesPerPixel(GLenum format) {
+			switch (format) {
+			case GL_R8: case GL_R8UI: case GL_R8I: case GL_STENCIL_INDEX8:
+				return 1;
+			case GL_RG8: case GL_R16F: case GL_R16UI: case GL_R16I: case GL_DEPTH_COMPONENT16:
+				return 2;
+			case GL_RGBA16F: case GL_RGBA16UI: case GL_RG32F: case GL_RG32UI: case GL_RG32I: case GL_DEPTH32F_STENCIL8:
+				return 8;
+			case GL_RGBA32F: case GL_RGBA32UI: case GL_RGBA32I:
+				return 16;
+			default:
+				return 4;
+			}
+		}
+
+		GLbitfield BarrierFor(FrameGraphAccess access) {
+			switch (access) {
+			case FrameGraphAccess::Attachment: return GL_FRAMEBUFFER_BARRIER_BIT;
+			case FrameGraphAccess::Sampled: return GL_TEXTURE_FETCH_BARRIER_BIT;
+			case FrameGraphAccess::Storage: return GL_SHADER_IMAGE_ACCESS_BARRIER_BIT;
+			}
+			return 0;
+		}
+	}
+
+	FrameGraphResource FrameGraphBuilder::Create(const std::string& name, const FrameGraphTextureDesc& desc)
+	{
+		FrameGraph::ResourceEntry entry;
+		entry.name = name;
+		entry.desc = desc;
+		entry.width = desc.width ? desc.width : std::max(1u, static_cast<unsigned int>(graph.width * desc.scale));
+		entry.height = desc.height ? desc.height : std::max(1u, static_cast<unsigned int>(graph.height * desc.scale));
+
+		return graph.addResource(std::move(entry));
+	}
+
+	FrameGraphResource FrameGraphBuilder::Read(FrameGraphResource resource, FrameGraphAccess access)
+	{
+		assert(resource < graph.nodes.size());
+
+		graph.passes[pass].reads.push_back({ resource, access });
+		return resource;
+	}
+
+	FrameGraphResource FrameGraphBuilder::Write(FrameGraphResource resource, FrameGraphAccess access)
+	{
+		assert(resource < graph.nodes.size());
+
+		FrameGraph::PassNode& passNode = graph.passes[pass];
+		uint32_t entry = graph.nodes[resource].resource;
+
+		// the previous contents are kept, whoever produced them has to run first
+		if (graph.nodes[resource].writer >= 0) passNode.reads.push_back({ resource, access });
+		if (graph.resources[entry].imported) passNode.sideEffect = true;
+
+		graph.nodes.push_back({ entry, static_cast<int32_t>(pass) });
+		FrameGraphResource version = static_cast<FrameGraphResource>(graph.nodes.size() - 1);
+
+		passNode.writes.push_back({ version, access });
+		return version;
+	}
+
+	void FrameGraphBuilder::SideEffect()
+	{
+		graph.passes[pass].sideEffect = true;
+	}
+
+	unsigned int FrameGraphResources::getTexture(FrameGraphResource resource) const
+	{
+		return graph.resources[graph.nodes[resource].resource].texture;
+	}
+
+	void FrameGraphResources::getSize(FrameGraphResource resource, unsigned int& width, unsigned int& height) const
+	{
+		const FrameGraph::ResourceEntry& entry = graph.resources[graph.nodes[resource].resource];
+		width = entry.width;
+		height = entry.height;
+	}
+
+	unsigned int FrameGraphResources::getFramebuffer() const
+	{
+		return graph.passes[pass].framebuffer;
+	}
+
+	FrameGraph::~FrameGraph()
+	{
+		ReleasePool();
+	}
+
+	void FrameGraph::BeginFrame(unsigned int width, unsigned int height, unsigned int backbuffer)
+	{
+		this->width = width;
+		this->height = height;
+		backbufferFramebuffer = backbuffer;
+		frame++;
+
+		passes.clear();
+		resources.clear();
+		nodes.clear();
+		compiled = false;
+
+		evictIdle();
+	}
+
+	FrameGraphResource FrameGraph::Import(const std::string& name, unsigned int texture, const FrameGraphTextureDesc& desc)
+	{
+		ResourceEntry entry;
+		entry.name = name;
+		entry.desc = desc;
+		entry.width = desc.width;
+		entry.height = desc.height;
+		entry.texture = texture;
+		entry.imported = true;
+
+		return addResource(std::move(entry));
+	}
+
+	FrameGraphResource FrameGraph::Import(const std::string& name, const FrameBuffer& frameBuffer, FrameBufferAttachments attachment, unsigned int number)
+	{
+		FrameGraphTextureDesc desc;
+		frameBuffer.getFrameBufferSize(desc.width, desc.height);
+		// the formats CreateFrameBuffer allocates
+		desc.format = (attachment == DEPTH) ? GL_DEPTH_COMPONENT32F
+			: (attachment == STENCIL) ? GL_STENCIL_INDEX8
+			: GL_RGBA8;
+
+		return Import(name, frameBuffer.getAttachment(attachment, number)->id, desc);
+	}
+
+	FrameGraphResource FrameGraph::ImportBackbuffer(const std::string& name)
+	{
+		ResourceEntry entry;
+		entry.name = name;
+		entry.width = width;
+		entry.height = height;
+		entry.imported = true;
+		entry.backbuffer = true;
+
+		return addResource(std::move(entry));
+	}
+
+	void FrameGraph::Compile()
+	{
+		// a pass is needed while a version it wrote is read, a version is needed while a kept pass reads it
+		for (auto& node : nodes) node.readCount = 0;
+		for (auto& pass : passes) {
+			pass.culled = false;
+			pass.refCount = static_cast<uint32_t>(pass.writes.size());
+			for (const auto& read : pass.reads) nodes[read.node].readCount++;
+		}
+
+		std::vector<FrameGraphResource> unread;
+		for (FrameGraphResource i = 0; i < nodes.size(); ++i) {
+			if (nodes[i].readCount == 0) unread.push_back(i);
+		}
+
+		auto cull = [&](PassNode& pass) {
+			pass.culled = true;
+			for (const auto& read : pass.reads) {
+				if (--nodes[read.node].readCount == 0) unread.push_back(read.node);
+			}
+		};
+
+		for (auto& pass : passes) {
+			if (pass.refCount == 0 && !pass.sideEffect) cull(pass);
+		}
+
+		while (!unread.empty()) {
+			const ResourceNode& node = nodes[unread.back()];
+			unread.pop_back();
+			if (node.writer < 0) continue;
+
+			PassNode& writer = passes[node.writer];
+			if (writer.sideEffect || writer.culled) continue;
+			if (--writer.refCount == 0) cull(writer);
+		}
+
+		// lifetimes over the passes that survived
+		for (auto& entry : resources) entry.firstUse = entry.lastUse = -1;
+
+		stats = {};
+		for (int32_t i = 0; i < static_cast<int32_t>(passes.size()); ++i) {
+			const PassNode& pass = passes[i];
+			if (pass.culled) {
+				stats.culledPasses++;
+				continue;
+			}
+
+			auto use = [&](const PassAccess& access) {
+				ResourceEntry& entry = resources[nodes[access.node].resource];
+				if (entry.firstUse < 0) entry.firstUse = i;
+				entry.lastUse = i;
+			};
+			for (const auto& read : pass.reads) use(read);
+			for (const auto& write : pass.writes) use(write);
+		}
+
+		stats.passes = static_cast<uint32_t>(passes.size());
+		for (const auto& entry : resources) {
+			if (!entry.imported && entry.firstUse >= 0) stats.transientTextures++;
+		}
+
+		compiled = true;
+	}
+
+	void FrameGraph::Execute()
+	{
+		if (!compiled) Compile();
+
+		GLint previousViewport[4];
+		glGetIntegerv(GL_VIEWPORT, previousViewport);
+
+		for (int32_t i = 0; i < static_cast<int32_t>(passes.size()); ++i) {
+			PassNode& pass = passes[i];
+			if (pass.culled) continue;
+
+			auto forEachEntry = [&](auto&& function) {
+				for (const auto& read : pass.reads) function(resources[nodes[read.node].resource]);
+				for (const auto& write : pass.writes) function(resources[nodes[write.node].resource]);
+			};
+
+			forEachEntry([&](ResourceEntry& entry) {
+				if (!entry.imported && entry.firstUse == i && entry.pooled < 0) acquire(entry);
+			});
+
+			GLbitfield barriers = collectBarriers(pass);
+			if (barriers) {
+				glMemoryBarrier(barriers);
+				stats.barriers++;
+			}
+
+			pass.framebuffer = getFramebuffer(pass);
+			pass.executor->Execute(FrameGraphResources(*this, static_cast<uint32_t>(i)));
+
+			// image stores are incoherent until the next barrier
+			for (const auto& write : pass.writes) {
+				if (write.access == FrameGraphAccess::Storage) pendingBarriers[resources[nodes[write.node].resource].texture] = ALL_IMAGE_BARRIERS;
+			}
+
+			forEachEntry([&](ResourceEntry& entry) {
+				if (!entry.imported && entry.lastUse == i) release(entry);
+			});
+		}
+
+		GLState::BindFramebuffer(backbufferFramebuffer);
+		glViewport(previousViewport[0], previousViewport[1], previousViewport[2], previousViewport[3]);
+
+		for (const auto& pooled : pool) {
+			if (pooled.lastUsedFrame == frame) stats.physicalTextures++;
+			size_t bytes = static_cast<size_t>(pooled.width) * pooled.height * BytesPerPixel(pooled.format);
+			stats.pooledBytes += pooled.levels > 1 ? bytes * 4 / 3 : bytes;
+		}
+	}
+
+	void FrameGraph::ReleasePool()
+	{
+		framebuffers.clear();
+
+		for (auto& pooled : pool) {
+			GLState::ForgetTexture(pooled.id);
+			glDeleteTextures(1, &pooled.id);
+		}
+		pool.clear();
+		pendingBarriers.clear();
+	}
+
+	uint32_t FrameGraph::addPass(const std::string& name, std::unique_ptr<PassExecutor> executor)
+	{
+		PassNode pass;
+		pass.name = name;
+		pass.executor = std::move(executor);
+		passes.push_back(std::move(pass));
+
+		compiled = false;
+		return static_cast<uint32_t>(passes.size() - 1);
+	}
+
+	FrameGraphResource FrameGraph::addResource(ResourceEntry&& entry)
+	{
+		resources.push_back(std::move(entry));
+		nodes.push_back({ static_cast<uint32_t>(resources.size() - 1) });
+
+		compiled = false;
+		return static_cast<FrameGraphResource>(nodes.size() - 1);
+	}
+
+	void FrameGraph::acquire(ResourceEntry& entry)
+	{
+		// any idle texture of the same shape, its previous user is done with it
+		for (size_t i = 0; i < pool.size(); ++i) {
+			PooledTexture& pooled = pool[i];
+			if (pooled.inUse || pooled.width != entry.width || pooled.height != entry.height
+				|| pooled.format != entry.desc.format || pooled.levels != entry.desc.levels) continue;
+
+			pooled.inUse = true;
+			pooled.lastUsedFrame = frame;
+			entry.pooled = static_cast<int32_t>(i);
+			entry.texture = pooled.id;
+			return;
+		}
+
+		PooledTexture pooled;
+		pooled.width = entry.width;
+		pooled.height = entry.height;
+		pooled.format = entry.desc.format;
+		pooled.levels = std::max(1u, entry.desc.levels);
+		pooled.lastUsedFrame = frame;
+		pooled.inUse = true;
+
+		glCreateTextures(GL_TEXTURE_2D, 1, &pooled.id);
+		glTextureStorage2D(pooled.id, pooled.levels, pooled.format, pooled.width, pooled.height);
+
+		GLenum filter = IsIntegerFormat(pooled.format) ? GL_NEAREST : GL_LINEAR;
+		GLenum minFilter = (pooled.levels > 1 && filter == GL_LINEAR) ? GL_LINEAR_MIPMAP_LINEAR : filter;
+		glTextureParameteri(pooled.id, GL_TEXTURE_MIN_FILTER, minFilter);
+		glTextureParameteri(pooled.id, GL_TEXTURE_MAG_FILTER, filter);
+		glTextureParameteri(pooled.id, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTextureParameteri(pooled.id, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+		pool.push_back(pooled);
+		entry.pooled = static_cast<int32_t>(pool.size() - 1);
+		entry.texture = pooled.id;
+	}
+
+	void FrameGraph::release(ResourceEntry& entry)
+	{
+		if (entry.pooled < 0) return;
+
+		pool[entry.pooled].inUse = false;
+		entry.pooled = -1;
+	}
+
+	unsigned int FrameGraph::getFramebuffer(PassNode& pass)
+	{
+		std::vector<unsigned int> colors;
+		unsigned int depth = 0;
+		GLenum depthAttachment = GL_DEPTH_ATTACHMENT;
+		const ResourceEntry* sizeSource = nullptr;
+		bool backbuffer = false;
+
+		auto attach = [&](const PassAccess& access) {
+			if (access.access != FrameGraphAccess::Attachment) return;
+
+			const ResourceEntry& entry = resources[nodes[access.node].resource];
+			if (!sizeSource) sizeSource = &entry;
+			if (entry.backbuffer) {
+				backbuffer = true;
+				return;
+			}
+
+			if (IsDepthFormat(entry.desc.format)) {
+				depth = entry.texture;
+				depthAttachment = HasStencil(entry.desc.format) ? GL_DEPTH_STENCIL_ATTACHMENT : GL_DEPTH_ATTACHMENT;
+			}
+			// a version read and written by the same pass is attached once
+			else if (std::find(colors.begin(), colors.end(), entry.texture) == colors.end()) {
+				colors.push_back(entry.texture);
+			}
+		};
+		for (const auto& write : pass.writes) attach(write);
+		for (const auto& read : pass.reads) attach(read);
+
+		if (!sizeSource) return 0;
+
+		glViewport(0, 0, sizeSource->width, sizeSource->height);
+		if (backbuffer) {
+			GLState::BindFramebuffer(backbufferFramebuffer);
+			return backbufferFramebuffer;
+		}
+
+		// the generation keeps an imported texture's reused name from matching the old texture's framebuffer
+		std::vector<unsigned int> key;
+		key.reserve((colors.size() + 1) * 2);
+		for (unsigned int color : colors) {
+			key.push_back(color);
+			key.push_back(GLState::GetTextureGeneration(color));
+		}
+		key.push_back(depth);
+		key.push_back(depth ? GLState::GetTextureGeneration(depth) : 0);
+
+		auto it = framebuffers.find(key);
+		if (it == framebuffers.end()) {
+			it = framebuffers.try_emplace(std::move(key), colors, depth, depthAttachment, sizeSource->width, sizeSource->height).first;
+		}
+
+		it->second.BindFrameBuffer();
+		return it->second.getID();
+	}
+
+	GLbitfield FrameGraph::collectBarriers(const PassNode& pass)
+	{
+		if (pendingBarriers.empty()) return 0;
+
+		GLbitfield barriers = 0;
+		auto check = [&](const PassAccess& access) {
+			auto it = pendingBarriers.find(resources[nodes[access.node].resource].texture);
+			if (it != pendingBarriers.end()) barriers |= it->second & BarrierFor(access.access);
+		};
+		for (const auto& read : pass.reads) check(read);
+		for (const auto& write : pass.writes) check(write);
+
+		if (!barriers) return 0;
+
+		// glMemoryBarrier covers every texture for the bits it is given
+		for (auto it = pendingBarriers.begin(); it != pendingBarriers.end();) {
+			it->second &= ~barriers;
+			if (it->second == 0) it = pendingBarriers.erase(it);
+			else ++it;
+		}
+		return barriers;
+	}
+
+	void FrameGraph::evictIdle()
+	{
+		for (size_t i = 0; i < pool.size();) {
+			PooledTexture& pooled = pool[i];
+			if (pooled.inUse || frame - pooled.lastUsedFrame <= POOL_FRAMES) {
+				++i;
+				continue;
+			}
+
+			pendingBarriers.erase(pooled.id);
+			GLState::ForgetTexture(pooled.id);
+			glDeleteTextures(1, &pooled.id);
+
+			pool[i] = pool.back();
+			pool.pop_back();
+		}
+
+		// covers the pool textures deleted above and imported ones their owner deleted since
+		for (auto it = framebuffers.begin(); it != framebuffers.end();) {
+			if (IsStaleKey(it->first)) it = framebuffers.erase(it);
+			else ++it;
+		}
+	}
+}
@@ -0,0 +1,225 @@
+#include "pch.h"
+
+#include "Renderer/GLState.hpp"
+
+namespace Lexvi {
+	namespace {
+		constexpr unsigned int UNKNOWN = 0xFFFFFFFFu;
+		constexpr uint32_t MAX_TEXTURE_UNITS = 192;
+		constexpr uint32_t MAX_BUFFER_BINDINGS = 96;
+
+		// -1 = unknown, 0 = disabled, 1 = enabled
+		using TriState = int8_t;
+
+		struct State {
+			unsigned int program = UNKNOWN;
+			unsigned int vao = UNKNOWN;
+			unsigned int fbo = UNKNOWN;
+			unsigned int drawIndirectBuffer = UNKNOWN;
+			unsigned int dispatchIndirectBuffer = UNKNOWN;
+			unsigned int parameterBuffer = UNKNOWN;
+			std::array<unsigned int, MAX_TEXTURE_UNITS> textureUnits;
+			std::array<unsigned int, MAX_BUFFER_BINDINGS> storageBuffers;
+			std::array<unsigned int, MAX_BUFFER_BINDINGS> uniformBuffers;
+
+			TriState cullFace = -1;
+			TriState blend = -1;
+			TriState depthTest = -1;
+			TriState depthWrite = -1;
+			GLenum cullMode = UNKNOWN;
+			GLenum frontFace = UNKNOWN;
+			GLenum blendSrc = UNKNOWN;
+			GLenum blendDst = UNKNOWN;
+			GLenum depthFunc = UNKNOWN;
+
+			State() {
+				textureUnits.fill(UNKNOWN);
+				storageBuffers.fill(UNKNOWN);
+				uniformBuffers.fill(UNKNOWN);
+			}
+		};
+
+		State state;
+		std::unordered_map<unsigned int, uint32_t> textureGenerations; // only names that were deleted at least once
+		GLStateStats currentFrame;
+		GLStateStats lastFrame;
+
+		// Returns true if the caller has to issue the GL call
+		template<typename T>
+		bool Changed(T& cached, T value) {
+			if (cached == value) {
+				currentFrame.filtered++;
+				return false;
+			}
+			cached = value;
+			currentFrame.issued++;
+			return true;
+		}
+
+		void SetCapability(TriState& cached, GLenum cap, bool enabled) {
+			if (!Changed(cached, static_cast<TriState>(enabled ? 1 : 0))) return;
+			if (enabled) glEnable(cap);
+			else glDisable(cap);
+		}
+
+		template<size_t N>
+		void ForgetIn(std::array<unsigned int, N>& bindings, unsigned int name) {
+			for (auto& bound : bindings) {
+				if (bound == name) bound = UNKNOWN;
+			}
+		}
+	}
+
+	void GLState::UseProgram(unsigned int program)
+	{
+		if (Changed(state.program, program)) glUseProgram(program);
+	}
+
+	void GLState::BindVertexArray(unsigned int vao)
+	{
+		if (Changed(state.vao, vao)) glBindVertexArray(vao);
+	}
+
+	void GLState::BindTextureUnit(unsigned int unit, unsigned int texture)
+	{
+		if (unit >= MAX_TEXTURE_UNITS) {
+			currentFrame.issued++;
+			glBindTextureUnit(unit, texture);
+			return;
+		}
+		if (Changed(state.textureUnits[unit], texture)) glBindTextureUnit(unit, texture);
+	}
+
+	void GLState::BindFramebuffer(unsigned int fbo)
+	{
+		if (Changed(state.fbo, fbo)) glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+	}
+
+	void GLState::BindBufferBase(GLenum target, unsigned int index, unsigned int buffer)
+	{
+		auto* bindings = (target == GL_SHADER_STORAGE_BUFFER) ? &state.storageBuffers
+			: (target == GL_UNIFORM_BUFFER) ? &state.uniformBuffers
+			: nullptr;
+
+		if (!bindings || index >= MAX_BUFFER_BINDINGS) {
+			currentFrame.issued++;
+			glBindBufferBase(target, index, buffer);
+			return;
+		}
+		if (Changed((*bindings)[index], buffer)) glBindBufferBase(target, index, buffer);
+	}
+
+	void GLState::BindDrawIndirectBuffer(unsigned int buffer)
+	{
+		if (Changed(state.drawIndirectBuffer, buffer)) glBindBuffer(GL_DRAW_INDIRECT_BUFFER, buffer);
+	}
+
+	void GLState::BindDispatchIndirectBuffer(unsigned int buffer)
+	{
+		if (Changed(state.dispatchIndirectBuffer, buffer)) glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, buffer);
+	}
+
+	void GLState::BindParameterBuffer(unsigned int buffer)
+	{
+		if (Changed(state.parameterBuffer, buffer)) glBindBuffer(GL_PARAMETER_BUFFER, buffer);
+	}
+
+	void GLState::SetCullFace(bool enabled)
+	{
+		SetCapability(state.cullFace, GL_CULL_FACE, enabled);
+	}
+
+	void GLState::SetCullMode(GLenum face)
+	{
+		if (Changed(state.cullMode, face)) glCullFace(face);
+	}
+
+	void GLState::SetFrontFace(GLenum mode)
+	{
+		if (Changed(state.frontFace, mode)) glFrontFace(mode);
+	}
+
+	void GLState::SetBlend(bool enabled)
+	{
+		SetCapability(state.blend, GL_BLEND, enabled);
+	}
+
+	void GLState::SetBlendFunc(GLenum src, GLenum dst)
+	{
+		if (state.blendSrc == src && state.blendDst == dst) {
+			currentFrame.filtered++;
+			return;
+		}
+		state.blendSrc = src;
+		state.blendDst = dst;
+		currentFrame.issued++;
+		glBlendFunc(src, dst);
+	}
+
+	void GLState::SetDepthTest(bool enabled)
+	{
+		SetCapability(state.depthTest, GL_DEPTH_TEST, enabled);
+	}
+
+	void GLState::SetDepthWrite(bool enabled)
+	{
+		if (Changed(state.depthWrite, static_cast<TriState>(enabled ? 1 : 0))) glDepthMask(enabled ? GL_TRUE : GL_FALSE);
+	}
+
+	void GLState::SetDepthFunc(GLenum func)
+	{
+		if (Changed(state.depthFunc, func)) glDepthFunc(func);
+	}
+
+	void GLState::ForgetProgram(unsigned int program)
+	{
+		if (state.program == program) state.program = UNKNOWN;
+	}
+
+	void GLState::ForgetVertexArray(unsigned int vao)
+	{
+		if (state.vao == vao) state.vao = UNKNOWN;
+	}
+
+	void GLState::ForgetTexture(unsigned int texture)
+	{
+		ForgetIn(state.textureUnits, texture);
+		textureGenerations[texture]++;
+	}
+
+	uint32_t GLState::GetTextureGeneration(unsigned int texture)
+	{
+		auto it = textureGenerations.find(texture);
+		return it != textureGenerations.end() ? it->second : 0;
+	}
+
+	void GLState::ForgetBuffer(unsigned int buffer)
+	{
+		ForgetIn(state.storageBuffers, buffer);
+		ForgetIn(state.uniformBuffers, buffer);
+		if (state.drawIndirectBuffer == buffer) state.drawIndirectBuffer = UNKNOWN;
+		if (state.dispatchIndirectBuffer == buffer) state.dispatchIndirectBuffer = UNKNOWN;
+		if (state.parameterBuffer == buffer) state.parameterBuffer = UNKNOWN;
+	}
+
+	void GLState::ForgetFramebuffer(unsigned int fbo)
+	{
+		if (state.fbo == fbo) state.fbo = UNKNOWN;
+	}
+
+	void GLState::Invalidate()
+	{
+		state = State();
+	}
+
+	void GLState::BeginFrame()
+	{
+		lastFrame = currentFrame;
+		currentFrame = {};
+	}
+
+	const GLStateStats& GLState::GetFrameStats()
+	{
+		return lastFrame;
+	}
+}
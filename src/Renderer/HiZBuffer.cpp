@@ -0,0 +1,170 @@
+#include "pch.h"
+
+#include "Renderer/HiZBuffer.hpp"
+#include "Renderer/BindingPoints.hpp"
+#include "Renderer/GLState.hpp"
+#include "Shader/ShaderCache.hpp"
+
+namespace Lexvi {
+	namespace {
+		const char* COPY_SHADER_SOURCE = R"(#version 460
+layout(local_size_x = 8, local_size_y = 8) in;
+
+layout(binding = LEXVI_DEPTH_UNIT) uniform sampler2D depth;
+layout(r32f, binding = 1) writeonly uniform image2D destination;
+
+uniform ivec2 size;
+
+void main() {
+    ivec2 pixel = ivec2(gl_GlobalInvocationID.xy);
+    if (any(greaterThanEqual(pixel, size))) return;
+    imageStore(destination, pixel, vec4(texelFetch(depth, pixel, 0).r));
+}
+)";
+
+		const char* REDUCE_SHADER_SOURCE = R"(#version 460
+layout(local_size_x = 8, local_size_y = 8) in;
+
+layout(r32f, binding = 0) readonly uniform image2D source;
+layout(r32f, binding = 1) writeonly uniform image2D destination;
+
+uniform ivec2 sourceSize;
+uniform ivec2 destinationSize;
+
+void main() {
+    ivec2 pixel = ivec2(gl_GlobalInvocationID.xy);
+    if (any(greaterThanEqual(pixel, destinationSize))) return;
+
+    // levels are rounded up, the last row and column of an odd level clamp onto themselves
+    ivec2 base = pixel * 2;
+    ivec2 last = sourceSize - 1;
+    float farthest = max(max(imageLoad(source, min(base, last)).r, imageLoad(source, min(base + ivec2(1, 0), last)).r),
+                         max(imageLoad(source, min(base + ivec2(0, 1), last)).r, imageLoad(source, min(base + ivec2(1, 1), last)).r));
+    imageStore(destination, pixel, vec4(farthest));
+}
+)";
+
+		uint32_t LevelSize(uint32_t size, uint32_t level) {
+			return std::max(1u, (size + (1u << level) - 1) >> level);
+		}
+	}
+
+	HiZBuffer::~HiZBuffer()
+	{
+		if (texture) {
+			GLState::ForgetTexture(texture);
+			glDeleteTextures(1, &texture);
+		}
+	}
+
+	void HiZBuffer::Build(unsigned int depthTexture, uint32_t textureWidth, uint32_t textureHeight, uint32_t width, uint32_t height, const glm::mat4& viewProjection)
+	{
+		if (!enabled || !depthTexture || width == 0 || height == 0) {
+			valid = false;
+			return;
+		}
+
+		if (!copyShader) {
+			copyShader = GetShaderCache().GetComputeShaderFromSource(COPY_SHADER_SOURCE, {
+				{ "LEXVI_DEPTH_UNIT", std::to_string(BindingPoints::HiZUnit) },
+			});
+			reduceShader = GetShaderCache().GetComputeShaderFromSource(REDUCE_SHADER_SOURCE, {});
+		}
+
+		// sized like the depth texture, so dynamic resolution only changes the part that is built
+		if (textureWidth != allocatedWidth || textureHeight != allocatedHeight) {
+			if (texture) {
+				GLState::ForgetTexture(texture);
+				glDeleteTextures(1, &texture);
+			}
+			allocatedWidth = textureWidth;
+			allocatedHeight = textureHeight;
+			levels = 1;
+			while (LevelSize(std::max(allocatedWidth, allocatedHeight), levels - 1) > 1) ++levels;
+
+			glCreateTextures(GL_TEXTURE_2D, 1, &texture);
+			glTextureStorage2D(texture, levels, GL_R32F, allocatedWidth, allocatedHeight);
+			glTextureParameteri(texture, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+			glTextureParameteri(texture, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+			glTextureParameteri(texture, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+			glTextureParameteri(texture, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		}
+
+		this->width = std::min(width, allocatedWidth);
+		this->height = std::min(height, allocatedHeight);
+		this->viewProjection = viewProjection;
+
+		// read as plain depth values, not as a shadow map
+		glTextureParameteri(depthTexture, GL_TEXTURE_COMPARE_MODE, GL_NONE);
+		GLState::BindTextureUnit(BindingPoints::HiZUnit, depthTexture);
+		glBindImageTexture(1, texture, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+
+		copyShader->use();
+		copyShader->setiVec2("size", glm::ivec2(this->width, this->height));
+		copyShader->DispatchThreads(glm::uvec3(this->width, this->height, 1));
+
+		reduceShader->use();
+		for (uint32_t level = 1; level < levels; ++level) {
+			glm::ivec2 sourceSize(LevelSize(this->width, level - 1), LevelSize(this->height, level - 1));
+			glm::ivec2 destinationSize(LevelSize(this->width, level), LevelSize(this->height, level));
+
+			glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+			glBindImageTexture(0, texture, level - 1, GL_FALSE, 0, GL_READ_ONLY, GL_R32F);
+			glBindImageTexture(1, texture, level, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+			reduceShader->setiVec2("sourceSize", sourceSize);
+			reduceShader->setiVec2("destinationSize", destinationSize);
+			reduceShader->DispatchThreads(glm::uvec3(destinationSize.x, destinationSize.y, 1));
+		}
+		glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+
+		valid = true;
+	}
+
+	void HiZBuffer::Bind(const ComputeShader& shader) const
+	{
+		GLState::BindTextureUnit(BindingPoints::HiZUnit, texture);
+		shader.setMat4("lexviHiZViewProjection", viewProjection);
+		shader.setVec2("lexviHiZSize", glm::vec2(width, height));
+		shader.setInt("lexviHiZLevels", static_cast<int>(levels));
+	}
+
+	std::string HiZBuffer::GetGLSL()
+	{
+		return "#define LEXVI_HIZ_UNIT " + std::to_string(BindingPoints::HiZUnit) + "\n" + R"(
+layout(binding = LEXVI_HIZ_UNIT) uniform sampler2D lexviHiZ;
+uniform mat4 lexviHiZViewProjection;
+uniform vec2 lexviHiZSize;  // built part of level 0, in texels
+uniform int lexviHiZLevels;
+
+// True if a world space sphere lies behind everything drawn where it projects to. Spheres crossing
+// the camera plane or outside the old view are never occluded.
+bool LexviHiZOccluded(vec4 sphere) {
+    vec3 ndcMin = vec3(1e30);
+    vec3 ndcMax = vec3(-1e30);
+    for (int i = 0; i < 8; ++i) {
+        vec3 corner = sphere.xyz + sphere.w * vec3((i & 1) != 0 ? 1.0 : -1.0, (i & 2) != 0 ? 1.0 : -1.0, (i & 4) != 0 ? 1.0 : -1.0);
+        vec4 clip = lexviHiZViewProjection * vec4(corner, 1.0);
+        if (clip.w <= 0.0) return false;
+        vec3 ndc = clip.xyz / clip.w;
+        ndcMin = min(ndcMin, ndc);
+        ndcMax = max(ndcMax, ndc);
+    }
+    if (any(greaterThan(ndcMin.xy, vec2(1.0))) || any(lessThan(ndcMax.xy, vec2(-1.0)))) return false;
+
+    vec2 texelMin = clamp((ndcMin.xy * 0.5 + 0.5) * lexviHiZSize, vec2(0.0), lexviHiZSize - 1.0);
+    vec2 texelMax = clamp((ndcMax.xy * 0.5 + 0.5) * lexviHiZSize, vec2(0.0), lexviHiZSize - 1.0);
+
+    // the level where the box spans at most 2x2 texels
+    vec2 extent = texelMax - texelMin;
+    int level = clamp(int(ceil(log2(max(max(extent.x, extent.y), 1.0)))), 0, lexviHiZLevels - 1);
+    ivec2 last = ivec2(ceil(lexviHiZSize / float(1 << level))) - 1;
+    ivec2 a = min(ivec2(texelMin) >> level, last);
+    ivec2 b = min(ivec2(texelMax) >> level, last);
+
+    float farthest = max(max(texelFetch(lexviHiZ, a, level).r, texelFetch(lexviHiZ, ivec2(b.x, a.y), level).r),
+                         max(texelFetch(lexviHiZ, ivec2(a.x, b.y), level).r, texelFetch(lexviHiZ, b, level).r));
+    return ndcMin.z * 0.5 + 0.5 > farthest;
+}
+)";
+	}
+}
@@ -0,0 +1,119 @@
+#include "pch.h"
+
+#include "Renderer/Material.hpp"
+#include "Renderer/BindingPoints.hpp"
+#include "Renderer/GLState.hpp"
+#include "Utils/Hash.hpp"
+
+namespace Lexvi {
+	namespace {
+		const char* NUMBERED_TYPES[] = {
+			"texture_diffuse",
+			"texture_specular",
+			"texture_normal",
+			"texture_roughness",
+			"texture_metallic",
+			"texture_ao",
+		};
+	}
+
+	uint64_t Material::MakeKey(const std::vector<Texture>& textures, const MaterialParams& params)
+	{
+		uint64_t h = Hash::FNV1A_OFFSET;
+		for (const Texture& texture : textures) {
+			h = Hash::FNV1a(&texture.id, sizeof(texture.id), h);
+			h = Hash::FNV1a(texture.type, h);
+		}
+		return Hash::FNV1a(&params, sizeof(params), h);
+	}
+
+	Material::Material(uint32_t id, const std::vector<Texture>& textures, const MaterialParams& params)
+		: id(id), key(MakeKey(textures, params)), params(params)
+	{
+		// same naming as the old per-draw path: known types are numbered per type, others use the bare type
+		uint32_t counters[std::size(NUMBERED_TYPES)] = {};
+
+		for (uint32_t i = 0; i < textures.size(); ++i) {
+			const Texture& texture = textures[i];
+			textureBindings.push_back({ i, texture.id });
+
+			std::string number;
+			for (size_t t = 0; t < std::size(NUMBERED_TYPES); ++t) {
+				if (texture.type == NUMBERED_TYPES[t]) {
+					number = std::to_string(++counters[t]);
+					break;
+				}
+			}
+			samplerBindings.push_back({ "material." + texture.type + number, static_cast<int>(i) });
+		}
+
+		CreateUBO(paramsUBO, sizeof(MaterialParams), BindingPoints::MaterialParamsUBO);
+		UpdateUBO(paramsUBO, &params, sizeof(MaterialParams), 0);
+	}
+
+	Material::~Material()
+	{
+		if (paramsUBO.id) DeleteUBO(paramsUBO);
+	}
+
+	void Material::prepare(const Shader& shader)
+	{
+		// sampler uniforms are program state, they only need writing once per program
+		for (const SamplerBinding& sampler : samplerBindings) {
+			int location = glGetUniformLocation(shader.ID, sampler.uniform.c_str());
+			if (location >= 0) glProgramUniform1i(shader.ID, location, sampler.unit);
+		}
+		preparedPrograms.push_back(shader.ID);
+	}
+
+	void Material::Bind(const Shader& shader)
+	{
+		if (std::find(preparedPrograms.begin(), preparedPrograms.end(), shader.ID) == preparedPrograms.end()) {
+			prepare(shader);
+		}
+
+		for (const TextureBinding& binding : textureBindings) {
+			GLState::BindTextureUnit(binding.unit, binding.texture);
+		}
+		GLState::BindBufferBase(GL_UNIFORM_BUFFER, BindingPoints::MaterialParamsUBO, paramsUBO.id);
+	}
+
+	void Material::setParams(const MaterialParams& newParams)
+	{
+		params = newParams;
+		UpdateUBO(paramsUBO, &params, sizeof(MaterialParams), 0);
+	}
+
+	std::shared_ptr<Material> MaterialLibrary::GetMaterial(const std::vector<Texture>& textures, const MaterialParams& params)
+	{
+		uint64_t key = Material::MakeKey(textures, params);
+
+		auto existing = materials.find(key);
+		if (existing != materials.end()) return existing->second;
+
+		auto material = std::make_shared<Material>(nextID++, textures, params);
+		materials[key] = material;
+		return material;
+	}
+
+	void MaterialLibrary::Clear()
+	{
+		materials.clear();
+	}
+
+	MaterialLibrary& GetMaterialLibrary()
+	{
+		static MaterialLibrary library;
+		return library;
+	}
+
+	std::string GetMaterialGLSL()
+	{
+		return
+			"layout(std140, binding = " + std::to_string(BindingPoints::MaterialParamsUBO) + ") uniform LexviMaterialParams {\n"
+			"    vec4 lexviBaseColor;\n"
+			"    vec4 lexviEmissive;\n"
+			"    vec4 lexviMaterialFactors; // roughness, metallic, ao, alpha cutoff\n"
+			"};\n";
+	}
+}
@@ -0,0 +1,46 @@
+#include "pch.h"
+
+#include "Renderer/ObjectData.hpp"
+#include "Renderer/BindingPoints.hpp"
+
+namespace Lexvi {
+	ObjectData BuildObjectData(const glm::mat4& model, uint32_t material, const glm::vec4& params)
+	{
+		ObjectData data{};
+		data.model = model;
+		data.normalMatrix = glm::mat4(glm::transpose(glm::inverse(glm::mat3(model))));
+		data.indices = glm::uvec4(material, 0u, 0u, 0u);
+		data.params = params;
+		return data;
+	}
+
+	std::string GetObjectDataGLSL()
+	{
+		return
+			"struct LexviObject {\n"
+			"    mat4 model;\n"
+			"    mat4 normalMatrix;\n"
+			"    uvec4 indices;\n"
+			"    vec4 params;\n"
+			"};\n"
+			"\n"
+			"#ifdef LEXVI_MODEL_BATCH\n"
+			"layout(std430, binding = " + std::to_string(BindingPoints::BatchObjectDataSSBO) + ") readonly buffer LexviBatchObjectData {\n"
+			"    LexviObject lexviObjects[];\n"
+			"};\n"
+			"\n"
+			"// vertex stage only\n"
+			"#define LEXVI_OBJECT_INDEX (uint(gl_BaseInstance) + uint(gl_InstanceID))\n"
+			"#else\n"
+			"layout(std430, binding = " + std::to_string(BindingPoints::ObjectDataSSBO) + ") readonly buffer LexviObjectData {\n"
+			"    LexviObject lexviObjects[];\n"
+			"};\n"
+			"\n"
+			"// offset for draws that can't pass a base instance, 0 everywhere else\n"
+			"uniform uint lexviObjectBase;\n"
+			"\n"
+			"// vertex stage only\n"
+			"#define LEXVI_OBJECT_INDEX (lexviObjectBase + uint(gl_BaseInstance) + uint(gl_InstanceID))\n"
+			"#endif\n";
+	}
+}
@@ -0,0 +1,302 @@
+#include "pch.h"
+
+#include "Renderer/RenderQueue.hpp"
+#include "Renderer/GLState.hpp"
+#include "Renderer/BindingPoints.hpp"
+
+namespace Lexvi {
+	namespace {
+		constexpr uint32_t DEPTH_BITS = 24;
+		constexpr uint32_t PROGRAM_BITS = 12;
+		constexpr uint32_t MATERIAL_BITS = 12;
+		constexpr uint32_t GEOMETRY_BITS = 11;
+
+		constexpr uint64_t Mask(uint32_t bits) { return (uint64_t(1) << bits) - 1; }
+
+		constexpr const char* OBJECT_DATA_BLOCK = "LexviObjectData";
+		constexpr size_t MIN_STREAM_CAPACITY = 64 * 1024;
+
+		bool IsTranslucent(uint64_t key) { return (key >> 59) & 1; }
+
+		// Rewrites a per-flush buffer, growing it when needed. The previous contents are orphaned
+		// so the upload never waits on draws that still read them.
+		void UploadStreaming(unsigned int& buffer, size_t& capacity, const void* data, size_t size)
+		{
+			if (!buffer) glCreateBuffers(1, &buffer);
+
+			if (size > capacity) {
+				capacity = std::max(size * 2, MIN_STREAM_CAPACITY);
+				glNamedBufferData(buffer, capacity, nullptr, GL_STREAM_DRAW);
+			}
+			else {
+				glInvalidateBufferData(buffer);
+			}
+			glNamedBufferSubData(buffer, 0, size, data);
+		}
+	}
+
+	uint64_t RenderQueue::MakeKey(const SubmitInfo& info, unsigned int program, unsigned int geometry, float depth)
+	{
+		uint64_t pass = static_cast<uint64_t>(info.pass) & 0xF;
+		uint64_t quantisedDepth = static_cast<uint64_t>(glm::clamp(depth, 0.0f, 1.0f) * static_cast<float>(Mask(DEPTH_BITS)));
+		uint64_t state = ((program & Mask(PROGRAM_BITS)) << (MATERIAL_BITS + GEOMETRY_BITS))
+			| ((info.material & Mask(MATERIAL_BITS)) << GEOMETRY_BITS)
+			| (geometry & Mask(GEOMETRY_BITS));
+
+		uint64_t key = pass << 60;
+		if (!info.translucent) {
+			// state changes first, front to back inside a state bucket
+			key |= state << DEPTH_BITS;
+			key |= quantisedDepth;
+		}
+		else {
+			// blending needs strict back to front, state only breaks ties
+			key |= uint64_t(1) << 59;
+			key |= (Mask(DEPTH_BITS) - quantisedDepth) << (PROGRAM_BITS + MATERIAL_BITS + GEOMETRY_BITS);
+			key |= state;
+		}
+		return key;
+	}
+
+	void RenderQueue::Submit(IRenderable& obj, const Shader* shader, const Camera& camera, const SubmitInfo& info)
+	{
+		if (!obj.isVisible(camera)) {
+			stats.submitted++;
+			stats.culled++;
+			return;
+		}
+		SubmitVisible(obj, shader, camera, info);
+	}
+
+	void RenderQueue::SubmitVisible(IRenderable& obj, const Shader* shader, const Camera& camera, const SubmitInfo& info)
+	{
+		stats.submitted++;
+
+		// distance of the object's origin, normalised over the camera's depth range
+		glm::vec2 nearFar = camera.getZNearAndZFar();
+		glm::vec3 origin = glm::vec3(obj.getTransforms()[3]);
+		float distance = glm::length(origin - camera.getPosition());
+		float depth = (distance - nearFar.x) / (nearFar.y - nearFar.x);
+
+		keys.push_back(MakeKey(info, shader->ID, obj.getGeometryID(), depth));
+		items.push_back({ &obj, shader, info.material, info.params });
+	}
+
+	void RenderQueue::Sort()
+	{
+		size_t count = keys.size();
+		order.resize(count);
+		for (uint32_t i = 0; i < count; ++i) order[i] = i;
+
+		keysScratch.resize(count);
+		orderScratch.resize(count);
+
+		// LSD radix sort, 8 bits per pass; passes where every key has the same byte are skipped
+		for (uint32_t shift = 0; shift < 64; shift += 8) {
+			uint32_t histogram[256] = {};
+			for (uint64_t key : keys) histogram[(key >> shift) & 0xFF]++;
+
+			if (histogram[(keys[0] >> shift) & 0xFF] == count) continue;
+
+			uint32_t offset = 0;
+			for (uint32_t& bucket : histogram) {
+				uint32_t n = bucket;
+				bucket = offset;
+				offset += n;
+			}
+
+			for (size_t i = 0; i < count; ++i) {
+				uint32_t dst = histogram[(keys[i] >> shift) & 0xFF]++;
+				keysScratch[dst] = keys[i];
+				orderScratch[dst] = order[i];
+			}
+			keys.swap(keysScratch);
+			order.swap(orderScratch);
+		}
+	}
+
+	RenderQueue::~RenderQueue()
+	{
+		for (unsigned int* buffer : { &objectDataBuffer, &commandBuffer }) {
+			if (!*buffer) continue;
+			GLState::ForgetBuffer(*buffer);
+			glDeleteBuffers(1, buffer);
+		}
+	}
+
+	bool RenderQueue::usesObjectData(const Shader* shader)
+	{
+		auto it = objectDataPrograms.find(shader->ID);
+		if (it != objectDataPrograms.end()) return it->second;
+
+		bool uses = shader->hasStorageBlock(OBJECT_DATA_BLOCK);
+		objectDataPrograms[shader->ID] = uses;
+		return uses;
+	}
+
+	size_t RenderQueue::findBatchEnd(size_t first) const
+	{
+		const Item& leader = items[order[first]];
+		unsigned int geometry = leader.object->getGeometryID();
+		if (geometry == 0) return first + 1;
+
+		size_t end = first + 1;
+		while (end < order.size()) {
+			const Item& item = items[order[end]];
+			if (item.shader != leader.shader || item.material != leader.material ||
+				item.object->getGeometryID() != geometry || IsTranslucent(keys[end]) != IsTranslucent(keys[first])) {
+				break;
+			}
+			end++;
+		}
+		return end;
+	}
+
+	void RenderQueue::buildDrawOps()
+	{
+		ops.clear();
+		commands.clear();
+		objectData.clear();
+
+		size_t i = 0;
+		while (i < order.size()) {
+			const Item& item = items[order[i]];
+
+			DrawOp op{};
+			op.first = static_cast<uint32_t>(i);
+
+			if (!usesObjectData(item.shader)) {
+				op.type = DrawOp::Single;
+				op.end = op.first + 1;
+				ops.push_back(op);
+				i++;
+				continue;
+			}
+
+			// one ObjectData entry per object, in sorted order so every batch reads a contiguous range
+			op.end = static_cast<uint32_t>(findBatchEnd(i));
+			op.baseInstance = static_cast<uint32_t>(objectData.size());
+			for (size_t j = op.first; j < op.end; ++j) {
+				const Item& batched = items[order[j]];
+				objectData.push_back(BuildObjectData(batched.object->getTransforms(), batched.material, batched.params));
+			}
+
+			unsigned int vao = 0;
+			DrawElementsIndirectCommand command{};
+			if (!item.object->getDrawCommand(vao, command)) {
+				op.type = DrawOp::Instanced;
+				ops.push_back(op);
+				i = op.end;
+				continue;
+			}
+
+			command.instanceCount = static_cast<GLsizei>(op.end - op.first);
+			command.baseInstance = static_cast<GLsizei>(op.baseInstance);
+
+			// consecutive batches on the same program and VAO share one multi-draw
+			DrawOp* previous = ops.empty() ? nullptr : &ops.back();
+			if (previous && previous->type == DrawOp::MultiDraw && previous->vao == vao &&
+				items[order[previous->first]].shader == item.shader &&
+				IsTranslucent(keys[previous->first]) == IsTranslucent(keys[i])) {
+				previous->end = op.end;
+				previous->commandCount++;
+			}
+			else {
+				op.type = DrawOp::MultiDraw;
+				op.vao = vao;
+				op.firstCommand = static_cast<uint32_t>(commands.size());
+				op.commandCount = 1;
+				ops.push_back(op);
+			}
+			commands.push_back(command);
+			i = op.end;
+		}
+
+		if (!objectData.empty()) {
+			UploadStreaming(objectDataBuffer, objectDataCapacity, objectData.data(), objectData.size() * sizeof(ObjectData));
+			GLState::BindBufferBase(GL_SHADER_STORAGE_BUFFER, BindingPoints::ObjectDataSSBO, objectDataBuffer);
+		}
+		if (!commands.empty()) {
+			UploadStreaming(commandBuffer, commandCapacity, commands.data(), commands.size() * sizeof(DrawElementsIndirectCommand));
+		}
+	}
+
+	void RenderQueue::Flush()
+	{
+		if (!items.empty()) {
+			Sort();
+			buildDrawOps();
+
+			const Shader* currentShader = nullptr;
+			bool translucent = false;
+			GLState::SetBlend(false);
+
+			for (const DrawOp& op : ops) {
+				const Item& leader = items[order[op.first]];
+
+				bool opTranslucent = IsTranslucent(keys[op.first]);
+				if (opTranslucent != translucent) {
+					translucent = opTranslucent;
+					GLState::SetBlend(translucent);
+					GLState::SetDepthWrite(!translucent);
+				}
+
+				if (leader.shader != currentShader) {
+					currentShader = leader.shader;
+					currentShader->use();
+					stats.programChanges++;
+				}
+
+				uint32_t count = op.end - op.first;
+				switch (op.type) {
+				case DrawOp::Single:
+					currentShader->setMat4("model", leader.object->getTransforms());
+					leader.object->Draw(currentShader);
+					stats.drawCalls++;
+					break;
+
+				case DrawOp::Instanced:
+					if (leader.object->DrawInstanced(currentShader, count, op.baseInstance)) {
+						stats.drawCalls++;
+						if (count > 1) stats.instancedBatches++;
+					}
+					else {
+						// no instanced path: plain draws see gl_BaseInstance = 0, so the entry comes through lexviObjectBase
+						for (uint32_t j = op.first; j < op.end; ++j) {
+							const Item& single = items[order[j]];
+							currentShader->setUint("lexviObjectBase", op.baseInstance + (j - op.first));
+							currentShader->setMat4("model", single.object->getTransforms());
+							single.object->Draw(currentShader);
+							stats.drawCalls++;
+						}
+						currentShader->setUint("lexviObjectBase", 0);
+					}
+					break;
+
+				case DrawOp::MultiDraw:
+					GLState::BindVertexArray(op.vao);
+					GLState::BindDrawIndirectBuffer(commandBuffer);
+					glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT,
+						reinterpret_cast<const void*>(op.firstCommand * sizeof(DrawElementsIndirectCommand)), op.commandCount, 0);
+					stats.drawCalls++;
+					if (count > 1) stats.instancedBatches++;
+					if (op.commandCount > 1) stats.multiDraws++;
+					break;
+				}
+
+				stats.drawn += count;
+			}
+
+			// back to the engine defaults
+			GLState::SetBlend(true);
+			GLState::SetDepthWrite(true);
+		}
+
+		items.clear();
+		keys.clear();
+		order.clear();
+
+		lastStats = stats;
+		stats = {};
+	}
+}
@@ -1,9 +1,123 @@
 #include "pch.h"
 
 #include "Renderer/Renderer.hpp"
+#include "Renderer/GLState.hpp"
+#include "Renderer/BindingPoints.hpp"
+#include "Shader/ShaderPreprocessor.hpp"
+#include "Textures/MaterialTextureTable.hpp"
+#include "Renderer/Material.hpp"
+#include "Renderer/CascadedShadows.hpp"
+#include "Renderable/Model/Mesh/VertexFormat.hpp"
+#include "Renderable/Model/Mesh/Mesh.hpp"
+
+#include <bit>
 
 using namespace Lexvi;
 
+Lexvi::Renderer::~Renderer()
+{
+	if (drawObjectDataSSBO.id) DeleteSSBO(drawObjectDataSSBO);
+}
+
+void Lexvi::Renderer::Init()
+{
+	CreateUBO(frameConstantsUBO, sizeof(FrameConstants), BindingPoints::FrameConstantsUBO);
+	RegisterShaderInclude("Lexvi/FrameConstants.glsl", GetFrameConstantsGLSL());
+	RegisterShaderInclude("Lexvi/Culling.glsl", GetCullingGLSL());
+	RegisterShaderInclude("Lexvi/ObjectData.glsl", GetObjectDataGLSL());
+	RegisterShaderInclude("Lexvi/MaterialTextures.glsl", GetMaterialTextureTable().GetGLSL());
+	RegisterShaderInclude("Lexvi/Material.glsl", GetMaterialGLSL());
+	RegisterShaderInclude("Lexvi/Lighting.glsl", ClusteredLighting::GetGLSL());
+	RegisterShaderInclude("Lexvi/Shadows.glsl", CascadedShadowMap::GetGLSL());
+	RegisterShaderInclude("Lexvi/GBufferPacking.glsl", DeferredShading::GetPackingGLSL());
+	RegisterShaderInclude("Lexvi/GBuffer.glsl", DeferredShading::GetGLSL());
+	RegisterShaderInclude("Lexvi/VertexFormat.glsl", GetVertexFormatGLSL());
+	RegisterShaderInclude("Lexvi/HiZ.glsl", HiZBuffer::GetGLSL());
+}
+
+void Lexvi::Renderer::BeginFrame(const Camera* camera, float time, float deltaTime, uint32_t width, uint32_t height)
+{
+	// the scene is drawn at the scaled size, the window only sees the upscale
+	dynamicResolution.BeginFrame(width, height);
+	uint32_t renderWidth, renderHeight;
+	dynamicResolution.getRenderSize(renderWidth, renderHeight);
+
+	frameConstants = BuildFrameConstants(camera, time, deltaTime, frameIndex++, renderWidth, renderHeight);
+
+	// one upload per frame, every shader reads the same block
+	UpdateUBO(frameConstantsUBO, &frameConstants, sizeof(FrameConstants), 0);
+	GLState::BindBufferBase(GL_UNIFORM_BUFFER, BindingPoints::FrameConstantsUBO, frameConstantsUBO.id);
+
+	// the bin pass reads the view matrix from the frame constants
+	if (camera) lighting.Update(*camera);
+
+	// LOD errors are judged in window pixels, resolution scaling shouldn't swap levels
+	LodView& lodView = GetLodView();
+	lodView.cameraPosition = glm::vec3(frameConstants.cameraPosition);
+	lodView.projectionScale = camera ? height / (2.0f * std::tan(frameConstants.clipPlanes.z * 0.5f)) : 0.0f;
+
+	uint32_t capacityWidth, capacityHeight;
+	dynamicResolution.getCapacity(capacityWidth, capacityHeight);
+	deferredShading.Resize(renderWidth, renderHeight, capacityWidth, capacityHeight);
+	visibilityBuffer.Begin();
+
+	frameGraph.BeginFrame(renderWidth, renderHeight, dynamicResolution.getSceneFramebuffer());
+	dynamicResolution.BeginScene();
+}
+
+void Lexvi::Renderer::EndFrame()
+{
+	if (hiZ.isEnabled()) {
+		const Texture* depth = dynamicResolution.getSceneFramebuffer() ? dynamicResolution.getTarget().getAttachment(DEPTH) : nullptr;
+		if (depth) {
+			uint32_t textureWidth, textureHeight, renderWidth, renderHeight;
+			dynamicResolution.getTarget().getFrameBufferSize(textureWidth, textureHeight);
+			dynamicResolution.getRenderSize(renderWidth, renderHeight);
+			hiZ.Build(depth->id, textureWidth, textureHeight, renderWidth, renderHeight, frameConstants.viewProjection);
+		}
+		else {
+			hiZ.Invalidate();
+		}
+	}
+
+	dynamicResolution.EndScene();
+}
+
+const FrameConstants& Lexvi::Renderer::getFrameConstants() const
+{
+	return frameConstants;
+}
+
+ClusteredLighting& Lexvi::Renderer::getLighting()
+{
+	return lighting;
+}
+
+FrameGraph& Lexvi::Renderer::getFrameGraph()
+{
+	return frameGraph;
+}
+
+DynamicResolution& Lexvi::Renderer::getDynamicResolution()
+{
+	return dynamicResolution;
+}
+
+DeferredShading& Lexvi::Renderer::getDeferredShading()
+{
+	return deferredShading;
+}
+
+VisibilityBuffer& Lexvi::Renderer::getVisibilityBuffer()
+{
+	return visibilityBuffer;
+}
+
+HiZBuffer& Lexvi::Renderer::getHiZ()
+{
+	return hiZ;
+}
+
 void Lexvi::Renderer::setDefaultShader(Shader* shader)
 {
 	defaultShader = shader;
@@ -24,11 +138,106 @@ void Lexvi::Renderer::Draw(IRenderable& obj, const Camera& camera, const Shader*
 	obj.Draw(currentShader);
 }
 
-void Lexvi::Renderer::Draw(std::vector<Renderable_Shader>& objects, const Camera& camera) const
+void Lexvi::Renderer::Draw(std::vector<Renderable_Shader>& objects, const Camera& camera)
 {
+	drawStats = {};
+	drawStats.submitted = static_cast<uint32_t>(objects.size());
+
+	// culled objects draw nothing, so they don't break a group of their neighbours
+	drawEntries.clear();
 	for (auto& obj_shader : objects) {
 		IRenderable& obj = *obj_shader.first;
-		Draw(obj, camera, obj_shader.second.get());
+		if (!obj.isVisible(camera)) {
+			drawStats.culled++;
+			continue;
+		}
+
+		const Shader* currentShader = setCurrentShader(obj_shader.second.get());
+		if (!currentShader) {
+			throw std::exception("No Shader availabe to draw.");
+			return;
+		}
+		drawEntries.push_back({ &obj, currentShader });
+	}
+
+	// groups only ever span consecutive entries, the caller's order is kept
+	drawGroups.clear();
+	drawObjectData.clear();
+	size_t i = 0;
+	while (i < drawEntries.size()) {
+		const DrawEntry& leader = drawEntries[i];
+
+		DrawGroup group{};
+		group.first = static_cast<uint32_t>(i);
+		group.end = group.first + 1;
+		group.objectData = renderQueue.usesObjectData(leader.shader);
+
+		if (group.objectData) {
+			unsigned int geometry = leader.object->getGeometryID();
+			if (geometry != 0) {
+				while (group.end < drawEntries.size() && drawEntries[group.end].shader == leader.shader &&
+					drawEntries[group.end].object->getGeometryID() == geometry) {
+					group.end++;
+				}
+			}
+
+			group.baseInstance = static_cast<uint32_t>(drawObjectData.size());
+			for (uint32_t j = group.first; j < group.end; ++j) {
+				drawObjectData.push_back(BuildObjectData(drawEntries[j].object->getTransforms(), 0, glm::vec4(0.0f)));
+			}
+		}
+
+		drawGroups.push_back(group);
+		i = group.end;
+	}
+
+	if (!drawObjectData.empty()) {
+		size_t size = drawObjectData.size() * sizeof(ObjectData);
+		if (size > drawObjectDataSSBO.size) {
+			if (drawObjectDataSSBO.id) DeleteSSBO(drawObjectDataSSBO);
+			CreateSSBO(drawObjectDataSSBO, size * 2, BindingPoints::ObjectDataSSBO);
+		}
+		else {
+			// orphaned so the upload doesn't wait on the previous call's draws
+			glInvalidateBufferData(drawObjectDataSSBO.id);
+		}
+		UpdateSSBO(drawObjectDataSSBO, drawObjectData.data(), size, 0);
+		// the render queue binds its own buffer here on Flush
+		BindSSBO(drawObjectDataSSBO);
+	}
+
+	const Shader* currentShader = nullptr;
+	for (const DrawGroup& group : drawGroups) {
+		const DrawEntry& leader = drawEntries[group.first];
+
+		if (leader.shader != currentShader) {
+			currentShader = leader.shader;
+			currentShader->use();
+			drawStats.programChanges++;
+		}
+
+		uint32_t count = group.end - group.first;
+		if (!group.objectData) {
+			leader.object->Draw(currentShader);
+			drawStats.drawCalls++;
+		}
+		else if (count > 1 && leader.object->DrawInstanced(currentShader, count, group.baseInstance)) {
+			drawStats.drawCalls++;
+			drawStats.instancedBatches++;
+		}
+		else {
+			// plain draws see gl_BaseInstance = 0, so the entry comes through lexviObjectBase
+			for (uint32_t j = group.first; j < group.end; ++j) {
+				IRenderable& single = *drawEntries[j].object;
+				currentShader->setUint("lexviObjectBase", group.baseInstance + (j - group.first));
+				currentShader->setMat4("model", single.getTransforms());
+				single.Draw(currentShader);
+				drawStats.drawCalls++;
+			}
+			currentShader->setUint("lexviObjectBase", 0);
+		}
+
+		drawStats.drawn += count;
 	}
 }
 
@@ -49,19 +258,87 @@ void Lexvi::Renderer::Draw(std::vector<IRenderable>& objects, const Camera& came
 	}
 }
 
+void Lexvi::Renderer::Submit(IRenderable& obj, const Camera& camera, const Shader* shader, const SubmitInfo& info)
+{
+	const Shader* currentShader = setCurrentShader(shader);
+
+	if (!currentShader) {
+		throw std::exception("No Shader availabe to draw.");
+		return;
+	}
+
+	renderQueue.Submit(obj, currentShader, camera, info);
+}
+
+void Lexvi::Renderer::Submit(const std::vector<IRenderable*>& objects, const BatchCuller& culler, const Camera& camera, const Shader* shader, const SubmitInfo& info)
+{
+	const Shader* currentShader = setCurrentShader(shader);
+
+	if (!currentShader) {
+		throw std::exception("No Shader availabe to draw.");
+		return;
+	}
+
+	const std::vector<uint64_t>& visibility = culler.getVisibility();
+	for (size_t word = 0; word < visibility.size(); ++word) {
+		uint64_t bits = visibility[word];
+		while (bits) {
+			size_t index = word * 64 + std::countr_zero(bits);
+			bits &= bits - 1;
+			renderQueue.SubmitVisible(*objects[index], currentShader, camera, info);
+		}
+	}
+	renderQueue.AddCulled(static_cast<uint32_t>(objects.size()) - culler.getVisibleCount());
+}
+
+void Lexvi::Renderer::Submit(const SpatialIndex& index, const Camera& camera, const Shader* shader, const SubmitInfo& info)
+{
+	const Shader* currentShader = setCurrentShader(shader);
+
+	if (!currentShader) {
+		throw std::exception("No Shader availabe to draw.");
+		return;
+	}
+
+	uint32_t visible = 0;
+	index.QueryFrustum(camera.getFrustum(), [&](int32_t proxy) {
+		if (index.getUserIndex(proxy) == SpatialIndex::WHOLE_OBJECT) {
+			renderQueue.SubmitVisible(*index.getObject(proxy), currentShader, camera, info);
+			visible++;
+		}
+		return true;
+	});
+	renderQueue.AddCulled(index.getObjectCount() - visible);
+}
+
+void Lexvi::Renderer::Flush()
+{
+	renderQueue.Flush();
+}
+
+const RenderQueueStats& Lexvi::Renderer::getRenderQueueStats() const
+{
+	return renderQueue.getStats();
+}
+
+const RenderQueueStats& Lexvi::Renderer::getDrawStats() const
+{
+	return drawStats;
+}
+
 void Lexvi::Renderer::DisableBackFaceCulling()
 {
-	glDisable(GL_CULL_FACE);
+	GLState::SetCullFace(false);
 }
 
 void Lexvi::Renderer::EnableBackFaceCulling()
 {
-	glEnable(GL_CULL_FACE);
+	GLState::SetCullFace(true);
 }
 
 void Lexvi::Renderer::SetBackFace(bool CW)
 {
-	glFrontFace(CW ? GL_CCW : GL_CW);
+	GLState::SetFrontFace(CW ? GL_CCW : GL_CW);
 }
 
 void Lexvi::Renderer::ViewportSize(uint32_t offsetX, uint32_t offsetY, uint32_t width, uint32_t height)
@@ -0,0 +1,256 @@
+#include "pch.h"
+
+#include "Renderer/SpatialIndex.hpp"
+
+namespace Lexvi {
+	namespace {
+		CameraAABB Union(const CameraAABB& a, const CameraAABB& b) {
+			return { glm::min(a.min, b.min), glm::max(a.max, b.max) };
+		}
+
+		// half the surface area, the SAH only compares costs
+		float Area(const CameraAABB& box) {
+			glm::vec3 d = box.max - box.min;
+			return d.x * d.y + d.y * d.z + d.z * d.x;
+		}
+
+		bool Contains(const CameraAABB& outer, const CameraAABB& inner) {
+			return glm::all(glm::lessThanEqual(outer.min, inner.min)) && glm::all(glm::lessThanEqual(inner.max, outer.max));
+		}
+
+		CameraAABB Enlarge(const CameraAABB& box, float amount) {
+			return { box.min - glm::vec3(amount), box.max + glm::vec3(amount) };
+		}
+	}
+
+	int32_t SpatialIndex::allocateNode()
+	{
+		if (freeList == NULL_NODE) {
+			nodes.emplace_back();
+			return static_cast<int32_t>(nodes.size() - 1);
+		}
+
+		int32_t index = freeList;
+		freeList = nodes[index].parent;
+		nodes[index] = Node();
+		return index;
+	}
+
+	void SpatialIndex::freeNode(int32_t index)
+	{
+		nodes[index].parent = freeList;
+		nodes[index].height = -1;
+		freeList = index;
+	}
+
+	int32_t SpatialIndex::Insert(const CameraAABB& box, IRenderable* object, uint32_t userIndex)
+	{
+		int32_t leaf = allocateNode();
+		Node& node = nodes[leaf];
+		node.box = Enlarge(box, margin);
+		node.height = 0;
+		node.object = object;
+		node.userIndex = userIndex;
+
+		leafCount++;
+		if (userIndex == WHOLE_OBJECT) objectCount++;
+
+		insertLeaf(leaf);
+		return leaf;
+	}
+
+	void SpatialIndex::Remove(int32_t proxy)
+	{
+		leafCount--;
+		if (nodes[proxy].userIndex == WHOLE_OBJECT) objectCount--;
+
+		removeLeaf(proxy);
+		freeNode(proxy);
+	}
+
+	bool SpatialIndex::Move(int32_t proxy, const CameraAABB& box)
+	{
+		// still inside the fat box and the fat box is not much larger than needed
+		const CameraAABB& fat = nodes[proxy].box;
+		if (Contains(fat, box) && Contains(Enlarge(box, margin * 4.0f), fat)) return false;
+
+		removeLeaf(proxy);
+		nodes[proxy].box = Enlarge(box, margin);
+		insertLeaf(proxy);
+		return true;
+	}
+
+	void SpatialIndex::Clear()
+	{
+		nodes.clear();
+		root = NULL_NODE;
+		freeList = NULL_NODE;
+		leafCount = 0;
+		objectCount = 0;
+	}
+
+	void SpatialIndex::insertLeaf(int32_t leaf)
+	{
+		if (root == NULL_NODE) {
+			root = leaf;
+			nodes[root].parent = NULL_NODE;
+			return;
+		}
+
+		// descend towards the cheapest sibling, the cost of a subtree includes the growth of its ancestors
+		CameraAABB box = nodes[leaf].box;
+		int32_t index = root;
+		while (!nodes[index].isLeaf()) {
+			const Node& node = nodes[index];
+			float area = Area(node.box);
+			float combinedArea = Area(Union(node.box, box));
+
+			// pairing with this node creates a parent of combinedArea
+			float cost = 2.0f * combinedArea;
+			float inheritance = 2.0f * (combinedArea - area);
+
+			auto childCost = [&](int32_t child) {
+				const Node& c = nodes[child];
+				float grown = Area(Union(c.box, box));
+				return (c.isLeaf() ? grown : grown - Area(c.box)) + inheritance;
+			};
+			float cost1 = childCost(node.child1);
+			float cost2 = childCost(node.child2);
+
+			if (cost < cost1 && cost < cost2) break;
+			index = cost1 < cost2 ? node.child1 : node.child2;
+		}
+
+		int32_t sibling = index;
+		int32_t oldParent = nodes[sibling].parent;
+		int32_t newParent = allocateNode(); // may reallocate nodes
+
+		nodes[newParent].parent = oldParent;
+		nodes[newParent].box = Union(box, nodes[sibling].box);
+		nodes[newParent].height = nodes[sibling].height + 1;
+		nodes[newParent].child1 = sibling;
+		nodes[newParent].child2 = leaf;
+		nodes[sibling].parent = newParent;
+		nodes[leaf].parent = newParent;
+
+		if (oldParent == NULL_NODE) root = newParent;
+		else if (nodes[oldParent].child1 == sibling) nodes[oldParent].child1 = newParent;
+		else nodes[oldParent].child2 = newParent;
+
+		// refit and rebalance the ancestors
+		index = nodes[leaf].parent;
+		while (index != NULL_NODE) {
+			index = balance(index);
+
+			Node& node = nodes[index];
+			node.height = 1 + std::max(nodes[node.child1].height, nodes[node.child2].height);
+			node.box = Union(nodes[node.child1].box, nodes[node.child2].box);
+			index = node.parent;
+		}
+	}
+
+	void SpatialIndex::removeLeaf(int32_t leaf)
+	{
+		if (leaf == root) {
+			root = NULL_NODE;
+			return;
+		}
+
+		int32_t parent = nodes[leaf].parent;
+		int32_t grandParent = nodes[parent].parent;
+		int32_t sibling = nodes[parent].child1 == leaf ? nodes[parent].child2 : nodes[parent].child1;
+
+		freeNode(parent);
+		if (grandParent == NULL_NODE) {
+			root = sibling;
+			nodes[sibling].parent = NULL_NODE;
+			return;
+		}
+
+		if (nodes[grandParent].child1 == parent) nodes[grandParent].child1 = sibling;
+		else nodes[grandParent].child2 = sibling;
+		nodes[sibling].parent = grandParent;
+
+		int32_t index = grandParent;
+		while (index != NULL_NODE) {
+			index = balance(index);
+
+			Node& node = nodes[index];
+			node.height = 1 + std::max(nodes[node.child1].height, nodes[node.child2].height);
+			node.box = Union(nodes[node.child1].box, nodes[node.child2].box);
+			index = node.parent;
+		}
+	}
+
+	// Rotates the taller child of A up when the heights differ by more than one, returns the new subtree root
+	int32_t SpatialIndex::balance(int32_t iA)
+	{
+		Node& A = nodes[iA];
+		if (A.isLeaf() || A.height < 2) return iA;
+
+		int32_t iB = A.child1;
+		int32_t iC = A.child2;
+		Node& B = nodes[iB];
+		Node& C = nodes[iC];
+		int32_t difference = C.height - B.height;
+
+		// the child that moves up replaces A under A's parent
+		auto replaceInParent = [&](int32_t up) {
+			int32_t parent = nodes[up].parent;
+			if (parent == NULL_NODE) root = up;
+			else if (nodes[parent].child1 == iA) nodes[parent].child1 = up;
+			else nodes[parent].child2 = up;
+		};
+
+		if (difference > 1) {
+			int32_t iF = C.child1;
+			int32_t iG = C.child2;
+			Node& F = nodes[iF];
+			Node& G = nodes[iG];
+
+			C.child1 = iA;
+			C.parent = A.parent;
+			A.parent = iC;
+			replaceInParent(iC);
+
+			// the taller grandchild stays with C
+			int32_t iKeep = F.height > G.height ? iF : iG;
+			int32_t iMove = F.height > G.height ? iG : iF;
+			C.child2 = iKeep;
+			A.child2 = iMove;
+			nodes[iMove].parent = iA;
+
+			A.box = Union(B.box, nodes[iMove].box);
+			A.height = 1 + std::max(B.height, nodes[iMove].height);
+			C.box = Union(A.box, nodes[iKeep].box);
+			C.height = 1 + std::max(A.height, nodes[iKeep].height);
+			return iC;
+		}
+
+		if (difference < -1) {
+			int32_t iD = B.child1;
+			int32_t iE = B.child2;
+			Node& D = nodes[iD];
+			Node& E = nodes[iE];
+
+			B.child1 = iA;
+			B.parent = A.parent;
+			A.parent = iB;
+			replaceInParent(iB);
+
+			int32_t iKeep = D.height > E.height ? iD : iE;
+			int32_t iMove = D.height > E.height ? iE : iD;
+			B.child2 = iKeep;
+			A.child1 = iMove;
+			nodes[iMove].parent = iA;
+
+			A.box = Union(C.box, nodes[iMove].box);
+			A.height = 1 + std::max(C.height, nodes[iMove].height);
+			B.box = Union(A.box, nodes[iKeep].box);
+			B.height = 1 + std::max(A.height, nodes[iKeep].height);
+			return iB;
+		}
+
+		return iA;
+	}
+}
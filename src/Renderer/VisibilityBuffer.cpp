@@ -0,0 +1,502 @@
+#include "pch.h"
+
+#include "Renderer/VisibilityBuffer.hpp"
+#include "Renderer/BindingPoints.hpp"
+#include "Renderer/GLState.hpp"
+#include "Shader/ShaderCache.hpp"
+#include "Shader/ShaderPreprocessor.hpp"
+
+namespace Lexvi {
+	namespace {
+		// bins are indexed by the 4-bit draw id, the reserved id 15 included
+		constexpr uint32_t BIN_COUNT = 16;
+		// uint count[16], offset[16], cursor[16], then DispatchIndirectCommand[16]
+		constexpr GLintptr BIN_DISPATCH_OFFSET = BIN_COUNT * 3 * sizeof(uint32_t);
+		constexpr size_t BIN_BUFFER_SIZE = BIN_DISPATCH_OFFSET + BIN_COUNT * sizeof(DispatchIndirectCommand);
+
+		constexpr uint32_t MATERIAL_GROUP_SIZE = 256;
+		constexpr uint32_t TILE_SIZE = 16;
+		// InstanceSystem binds its visible list here, see InstancedRenderable.hpp
+		constexpr uint32_t RASTER_INSTANCES_SSBO = 1;
+
+		const char* RASTER_VERTEX_SOURCE = R"(#version 460
+#include <Lexvi/FrameConstants.glsl>
+
+layout(location = 0) in vec3 position;
+
+struct Instance {
+    mat4 model;
+    vec4 extra;
+};
+layout(std430, binding = LEXVI_INSTANCES_SSBO) readonly buffer VisibleInstances {
+    Instance visibleInstances[];
+};
+
+uniform uint instanceLimit;
+
+flat out uint instanceIndex;
+
+void main() {
+    instanceIndex = uint(gl_InstanceID);
+    // instances the id can't address collapse to a point and are never rasterised
+    if (instanceIndex >= instanceLimit) {
+        gl_Position = vec4(0.0, 0.0, 0.0, 1.0);
+        return;
+    }
+    gl_Position = lexviViewProjection * visibleInstances[gl_InstanceID].model * vec4(position, 1.0);
+}
+)";
+
+		const char* RASTER_FRAGMENT_SOURCE = R"(#version 460
+flat in uint instanceIndex;
+
+uniform uint drawBits; // draw << 28
+uniform uint triangleBits;
+
+layout(location = 0) out uint visibilityId;
+
+void main() {
+    visibilityId = drawBits | (instanceIndex << triangleBits) | uint(gl_PrimitiveID);
+}
+)";
+
+		// LEXVI_VIS_PASS 0 counts covered pixels per draw, 1 turns the counts into offsets and indirect
+		// dispatches, 2 writes every pixel into its draw's range
+		const char* BIN_SHADER_SOURCE = R"(#version 460
+#if LEXVI_VIS_PASS == 1
+layout(local_size_x = 1) in;
+#else
+layout(local_size_x = LEXVI_TILE_SIZE, local_size_y = LEXVI_TILE_SIZE) in;
+#endif
+
+layout(binding = LEXVI_VISIBILITY_UNIT) uniform usampler2D visibility;
+
+layout(std430, binding = LEXVI_BINS_SSBO) buffer Bins {
+    uint binCount[LEXVI_BIN_COUNT];
+    uint binOffset[LEXVI_BIN_COUNT];
+    uint binCursor[LEXVI_BIN_COUNT];
+    uint binDispatch[LEXVI_BIN_COUNT * 3u];
+};
+
+layout(std430, binding = LEXVI_PIXELS_SSBO) writeonly buffer Pixels {
+    uint pixels[];
+};
+
+uniform vec2 renderSize;
+
+shared uint localCount[LEXVI_BIN_COUNT];
+shared uint localBase[LEXVI_BIN_COUNT];
+
+void main() {
+#if LEXVI_VIS_PASS == 1
+    uint offset = 0u;
+    for (uint i = 0u; i < LEXVI_BIN_COUNT; ++i) {
+        binOffset[i] = offset;
+        offset += binCount[i];
+        // the material pass strides over whatever doesn't fit the group limit
+        binDispatch[i * 3u] = min((binCount[i] + LEXVI_GROUP_SIZE - 1u) / LEXVI_GROUP_SIZE, 65535u);
+        binDispatch[i * 3u + 1u] = 1u;
+        binDispatch[i * 3u + 2u] = 1u;
+    }
+#else
+    uint local = gl_LocalInvocationIndex;
+    if (local < LEXVI_BIN_COUNT) localCount[local] = 0u;
+    barrier();
+
+    ivec2 pixel = ivec2(gl_GlobalInvocationID.xy);
+    bool inside = all(lessThan(vec2(gl_GlobalInvocationID.xy), renderSize));
+    uint id = inside ? texelFetch(visibility, pixel, 0).r : LEXVI_EMPTY;
+    bool covered = id != LEXVI_EMPTY;
+    uint draw = id >> 28u;
+
+    uint slot = 0u;
+    if (covered) slot = atomicAdd(localCount[draw], 1u);
+    barrier();
+
+    // one global atomic per draw and tile
+    if (local < LEXVI_BIN_COUNT && localCount[local] > 0u) {
+#if LEXVI_VIS_PASS == 0
+        atomicAdd(binCount[local], localCount[local]);
+#else
+        localBase[local] = binOffset[local] + atomicAdd(binCursor[local], localCount[local]);
+#endif
+    }
+
+#if LEXVI_VIS_PASS == 2
+    barrier();
+    if (covered) pixels[localBase[draw] + slot] = uint(pixel.x) | (uint(pixel.y) << 16u);
+#endif
+#endif
+}
+)";
+
+		const char* MATERIAL_HEADER_SOURCE = R"(#version 460
+layout(local_size_x = LEXVI_GROUP_SIZE) in;
+
+#include <Lexvi/FrameConstants.glsl>
+#include <Lexvi/GBufferPacking.glsl>
+
+layout(binding = LEXVI_VISIBILITY_UNIT) uniform usampler2D visibility;
+layout(rgba8, binding = 1) uniform writeonly image2D gAlbedo;
+layout(rg16, binding = 2) uniform writeonly image2D gNormal;
+layout(rg8, binding = 3) uniform writeonly image2D gMaterial;
+
+layout(std430, binding = LEXVI_BINS_SSBO) readonly buffer Bins {
+    uint binCount[LEXVI_BIN_COUNT];
+    uint binOffset[LEXVI_BIN_COUNT];
+};
+layout(std430, binding = LEXVI_PIXELS_SSBO) readonly buffer Pixels {
+    uint pixels[];
+};
+layout(std430, binding = LEXVI_VERTICES_SSBO) readonly buffer Vertices {
+    float vertices[];
+};
+layout(std430, binding = LEXVI_INDICES_SSBO) readonly buffer Indices {
+    uint indices[];
+};
+
+struct LexviVisibilityInstance {
+    mat4 model;
+    vec4 extra;
+};
+layout(std430, binding = LEXVI_INSTANCES_SSBO) readonly buffer Instances {
+    LexviVisibilityInstance instances[];
+};
+
+uniform uint drawIndex;
+uniform uint triangleBits;
+uniform vec2 renderSize;
+// in floats
+uniform uint vertexStride;
+uniform uint positionOffset;
+uniform uint normalOffset;
+
+struct LexviVisibilitySurface {
+    vec3 worldPosition;
+    vec3 worldNormal;
+    vec3 barycentrics;
+    uint triangle;
+    uint instance;
+    vec4 instanceData;
+
+    vec3 albedo;
+    float roughness;
+    float metallic;
+    float occlusion;
+};
+)";
+
+		const char* DEFAULT_MATERIAL_SOURCE = R"(
+void LexviVisibilityMaterial(inout LexviVisibilitySurface surface) {
+}
+)";
+
+		const char* MATERIAL_MAIN_SOURCE = R"(
+vec3 FetchVec3(uint offset) {
+    return vec3(vertices[offset], vertices[offset + 1u], vertices[offset + 2u]);
+}
+
+void main() {
+    uint count = binCount[drawIndex];
+    uint first = binOffset[drawIndex];
+    uint stride = gl_NumWorkGroups.x * gl_WorkGroupSize.x;
+
+    // the camera ray is the same for every triangle, only the pixel changes
+    mat3 inverseView = transpose(mat3(lexviView));
+
+    for (uint i = gl_GlobalInvocationID.x; i < count; i += stride) {
+        uint packedPixel = pixels[first + i];
+        ivec2 pixel = ivec2(packedPixel & 0xFFFFu, packedPixel >> 16u);
+
+        uint id = texelFetch(visibility, pixel, 0).r;
+        uint triangle = id & ((1u << triangleBits) - 1u);
+        uint instance = (id & 0x0FFFFFFFu) >> triangleBits;
+
+        LexviVisibilityInstance data = instances[instance];
+
+        vec3 p[3];
+        vec3 n[3];
+        for (uint k = 0u; k < 3u; ++k) {
+            uint base = indices[triangle * 3u + k] * vertexStride;
+            p[k] = (data.model * vec4(FetchVec3(base + positionOffset), 1.0)).xyz;
+#if LEXVI_HAS_NORMALS
+            n[k] = FetchVec3(base + normalOffset);
+#endif
+        }
+
+        // ray through the pixel center against the triangle's plane (Moller-Trumbore without the
+        // range checks, the rasteriser already decided the hit). Unlike screen space barycentrics
+        // this stays valid for triangles crossing the near plane.
+        vec2 ndc = (vec2(pixel) + 0.5) / renderSize * 2.0 - 1.0;
+        vec3 viewRay = vec3((ndc.x + lexviProjection[2][0]) / lexviProjection[0][0], (ndc.y + lexviProjection[2][1]) / lexviProjection[1][1], -1.0);
+        vec3 direction = inverseView * viewRay;
+        vec3 origin = lexviCameraPosition.xyz;
+
+        vec3 e1 = p[1] - p[0];
+        vec3 e2 = p[2] - p[0];
+        vec3 pv = cross(direction, e2);
+        float det = dot(e1, pv);
+
+        vec3 barycentrics = vec3(1.0 / 3.0);
+        if (abs(det) > 1e-12) {
+            vec3 tv = origin - p[0];
+            float u = dot(tv, pv) / det;
+            float v = dot(direction, cross(tv, e1)) / det;
+            // pixels on the edge land marginally outside
+            barycentrics = clamp(vec3(1.0 - u - v, u, v), 0.0, 1.0);
+            barycentrics /= max(barycentrics.x + barycentrics.y + barycentrics.z, 1e-6);
+        }
+
+        LexviVisibilitySurface surface;
+        surface.worldPosition = p[0] * barycentrics.x + p[1] * barycentrics.y + p[2] * barycentrics.z;
+#if LEXVI_HAS_NORMALS
+        // cofactor matrix, the inverse transpose up to a scale that normalize removes
+        mat3 m = mat3(data.model);
+        mat3 normalMatrix = mat3(cross(m[1], m[2]), cross(m[2], m[0]), cross(m[0], m[1]));
+        surface.worldNormal = normalize(normalMatrix * (n[0] * barycentrics.x + n[1] * barycentrics.y + n[2] * barycentrics.z));
+#else
+        surface.worldNormal = normalize(cross(e1, e2));
+#endif
+        surface.barycentrics = barycentrics;
+        surface.triangle = triangle;
+        surface.instance = instance;
+        surface.instanceData = data.extra;
+        surface.albedo = vec3(0.8);
+        surface.roughness = 0.6;
+        surface.metallic = 0.0;
+        surface.occlusion = 1.0;
+
+        LexviVisibilityMaterial(surface);
+
+        imageStore(gAlbedo, pixel, vec4(surface.albedo, surface.occlusion));
+        imageStore(gNormal, pixel, vec4(LexviEncodeNormal(normalize(surface.worldNormal)), 0.0, 0.0));
+        imageStore(gMaterial, pixel, vec4(surface.roughness, surface.metallic, 0.0, 0.0));
+    }
+}
+)";
+
+		ShaderDefines GetBinDefines(int pass)
+		{
+			return {
+				{ "LEXVI_VIS_PASS", std::to_string(pass) },
+				{ "LEXVI_TILE_SIZE", std::to_string(TILE_SIZE) },
+				{ "LEXVI_GROUP_SIZE", std::to_string(MATERIAL_GROUP_SIZE) + "u" },
+				{ "LEXVI_BIN_COUNT", std::to_string(BIN_COUNT) + "u" },
+				{ "LEXVI_EMPTY", std::to_string(VisibilityBuffer::EMPTY) + "u" },
+				{ "LEXVI_VISIBILITY_UNIT", std::to_string(BindingPoints::VisibilityUnit) },
+				{ "LEXVI_BINS_SSBO", std::to_string(BindingPoints::VisibilityBinsSSBO) },
+				{ "LEXVI_PIXELS_SSBO", std::to_string(BindingPoints::VisibilityPixelsSSBO) },
+			};
+		}
+
+		// bits needed to address every triangle of a draw
+		uint32_t TriangleBits(uint32_t triangleCount)
+		{
+			uint32_t bits = 0;
+			while (bits < 32 && (1ull << bits) < triangleCount) bits++;
+			return bits;
+		}
+	}
+
+	VisibilityBuffer::~VisibilityBuffer()
+	{
+		deleteResources();
+	}
+
+	void VisibilityBuffer::Begin()
+	{
+		draws.clear();
+		stats = {};
+	}
+
+	bool VisibilityBuffer::AddDraw(IRenderable& object, const VisibilityDrawDesc& desc)
+	{
+		uint32_t triangleBits = TriangleBits(desc.indexCount / 3);
+		if (draws.size() >= MAX_DRAWS || triangleBits > 28 || !desc.vbo || !desc.ebo || !desc.visibleInstances || desc.layout.stride == 0) {
+			stats.droppedDraws++;
+			return false;
+		}
+
+		Draw draw;
+		draw.object = &object;
+		draw.desc = desc;
+		draw.triangleBits = triangleBits;
+		draw.materialShader = getMaterialShader(desc.material, desc.layout.normalOffset != VisibilityVertexLayout::NONE);
+		draws.push_back(std::move(draw));
+
+		stats.draws++;
+		return true;
+	}
+
+	void VisibilityBuffer::Render(DeferredShading& deferred)
+	{
+		deferred.PrepareGBuffer();
+
+		unsigned int depth = deferred.getGBuffer().getAttachment(DEPTH)->id;
+		unsigned int capacityWidth = 0, capacityHeight = 0;
+		deferred.getGBuffer().getFrameBufferSize(capacityWidth, capacityHeight);
+		if (depth != allocatedDepth || capacityWidth != allocatedWidth || capacityHeight != allocatedHeight) allocate(deferred);
+
+		uint32_t width = 0, height = 0;
+		deferred.getRenderSize(width, height);
+
+		framebuffer.BindFrameBuffer();
+		glViewport(0, 0, width, height);
+		GLState::SetBlend(false);
+		GLState::SetDepthTest(true);
+		GLState::SetDepthWrite(true);
+
+		glEnable(GL_SCISSOR_TEST);
+		glScissor(0, 0, width, height);
+		GLuint empty[4] = { EMPTY, EMPTY, EMPTY, EMPTY };
+		float one = 1.0f;
+		glClearNamedFramebufferuiv(framebuffer.getID(), GL_COLOR, 0, empty);
+		glClearNamedFramebufferfv(framebuffer.getID(), GL_DEPTH, 0, &one);
+		glDisable(GL_SCISSOR_TEST);
+
+		if (!rasterShader) {
+			ShaderDefines defines = { { "LEXVI_INSTANCES_SSBO", std::to_string(RASTER_INSTANCES_SSBO) } };
+			rasterShader = GetShaderCache().GetShaderFromSource(RASTER_VERTEX_SOURCE, RASTER_FRAGMENT_SOURCE, defines);
+		}
+
+		for (size_t i = 0; i < draws.size(); ++i) {
+			const Draw& draw = draws[i];
+			// uniforms stay with the program, the renderable only binds it after its culling pass
+			rasterShader->use();
+			rasterShader->setUint("drawBits", static_cast<uint32_t>(i) << 28);
+			rasterShader->setUint("triangleBits", draw.triangleBits);
+			rasterShader->setUint("instanceLimit", 1u << (28 - draw.triangleBits));
+			draw.object->Draw(rasterShader.get());
+		}
+	}
+
+	void VisibilityBuffer::Resolve(DeferredShading& deferred)
+	{
+		if (!visibility || draws.empty()) return;
+
+		uint32_t width = 0, height = 0;
+		deferred.getRenderSize(width, height);
+		glm::vec2 renderSize(static_cast<float>(width), static_cast<float>(height));
+		glm::uvec3 tiles((width + TILE_SIZE - 1) / TILE_SIZE, (height + TILE_SIZE - 1) / TILE_SIZE, 1);
+
+		if (!countShader) {
+			countShader = GetShaderCache().GetComputeShaderFromSource(BIN_SHADER_SOURCE, GetBinDefines(0));
+			prefixShader = GetShaderCache().GetComputeShaderFromSource(BIN_SHADER_SOURCE, GetBinDefines(1));
+			scatterShader = GetShaderCache().GetComputeShaderFromSource(BIN_SHADER_SOURCE, GetBinDefines(2));
+		}
+
+		glClearNamedBufferData(binBuffer, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+		GLState::BindTextureUnit(BindingPoints::VisibilityUnit, visibility);
+		GLState::BindBufferBase(GL_SHADER_STORAGE_BUFFER, BindingPoints::VisibilityBinsSSBO, binBuffer);
+		GLState::BindBufferBase(GL_SHADER_STORAGE_BUFFER, BindingPoints::VisibilityPixelsSSBO, pixelBuffer);
+
+		countShader->use();
+		countShader->setVec2("renderSize", renderSize);
+		countShader->Dispatch(tiles);
+		glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+		prefixShader->use();
+		prefixShader->Dispatch(glm::uvec3(1));
+		glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_COMMAND_BARRIER_BIT);
+
+		scatterShader->use();
+		scatterShader->setVec2("renderSize", renderSize);
+		scatterShader->Dispatch(tiles);
+		glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+		const FrameBuffer& gBuffer = deferred.getGBuffer();
+		glBindImageTexture(1, gBuffer.getAttachment(COLOR, 0)->id, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA8);
+		glBindImageTexture(2, gBuffer.getAttachment(COLOR, 1)->id, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RG16);
+		glBindImageTexture(3, gBuffer.getAttachment(COLOR, 2)->id, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RG8);
+
+		for (size_t i = 0; i < draws.size(); ++i) {
+			const Draw& draw = draws[i];
+			const VisibilityVertexLayout& layout = draw.desc.layout;
+
+			GLState::BindBufferBase(GL_SHADER_STORAGE_BUFFER, BindingPoints::VisibilityVerticesSSBO, draw.desc.vbo);
+			GLState::BindBufferBase(GL_SHADER_STORAGE_BUFFER, BindingPoints::VisibilityIndicesSSBO, draw.desc.ebo);
+			GLState::BindBufferBase(GL_SHADER_STORAGE_BUFFER, BindingPoints::VisibilityInstancesSSBO, draw.desc.visibleInstances);
+
+			ComputeShader& shader = *draw.materialShader;
+			shader.use();
+			shader.setUint("drawIndex", static_cast<uint32_t>(i));
+			shader.setUint("triangleBits", draw.triangleBits);
+			shader.setVec2("renderSize", renderSize);
+			shader.setUint("vertexStride", layout.stride / sizeof(float));
+			shader.setUint("positionOffset", layout.positionOffset / sizeof(float));
+			shader.setUint("normalOffset", layout.normalOffset == VisibilityVertexLayout::NONE ? 0u : layout.normalOffset / sizeof(float));
+			shader.DispatchIndirect(binBuffer, BIN_DISPATCH_OFFSET + i * sizeof(DispatchIndirectCommand));
+		}
+
+		// DeferredShading::Resolve samples the G-buffer next
+		glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+	}
+
+	void VisibilityBuffer::allocate(const DeferredShading& deferred)
+	{
+		deleteResources();
+
+		const FrameBuffer& gBuffer = deferred.getGBuffer();
+		gBuffer.getFrameBufferSize(allocatedWidth, allocatedHeight);
+		allocatedDepth = gBuffer.getAttachment(DEPTH)->id;
+
+		glCreateTextures(GL_TEXTURE_2D, 1, &visibility);
+		glTextureStorage2D(visibility, 1, GL_R32UI, allocatedWidth, allocatedHeight);
+		glTextureParameteri(visibility, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTextureParameteri(visibility, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		framebuffer = FrameBuffer(std::vector<unsigned int>{ visibility }, allocatedDepth, GL_DEPTH_ATTACHMENT, allocatedWidth, allocatedHeight);
+
+		glCreateBuffers(1, &binBuffer);
+		glNamedBufferStorage(binBuffer, BIN_BUFFER_SIZE, nullptr, GL_DYNAMIC_STORAGE_BIT);
+
+		// every pixel can be covered by at most one draw
+		pixelCapacity = static_cast<size_t>(allocatedWidth) * allocatedHeight;
+		glCreateBuffers(1, &pixelBuffer);
+		glNamedBufferStorage(pixelBuffer, pixelCapacity * sizeof(uint32_t), nullptr, 0);
+	}
+
+	void VisibilityBuffer::deleteResources()
+	{
+		framebuffer = FrameBuffer();
+		if (visibility) {
+			GLState::ForgetTexture(visibility);
+			glDeleteTextures(1, &visibility);
+			visibility = 0;
+		}
+		if (binBuffer) {
+			GLState::ForgetBuffer(binBuffer);
+			glDeleteBuffers(1, &binBuffer);
+			binBuffer = 0;
+		}
+		if (pixelBuffer) {
+			GLState::ForgetBuffer(pixelBuffer);
+			glDeleteBuffers(1, &pixelBuffer);
+			pixelBuffer = 0;
+		}
+		pixelCapacity = 0;
+		allocatedDepth = 0;
+		allocatedWidth = allocatedHeight = 0;
+	}
+
+	std::shared_ptr<ComputeShader> VisibilityBuffer::getMaterialShader(const std::string& material, bool hasNormals)
+	{
+		std::string key = (hasNormals ? "1" : "0") + material;
+		auto it = materialShaders.find(key);
+		if (it != materialShaders.end()) return it->second;
+
+		std::string source = std::string(MATERIAL_HEADER_SOURCE) + (material.empty() ? DEFAULT_MATERIAL_SOURCE : material) + MATERIAL_MAIN_SOURCE;
+		std::shared_ptr<ComputeShader> shader = GetShaderCache().GetComputeShaderFromSource(source, {
+			{ "LEXVI_GROUP_SIZE", std::to_string(MATERIAL_GROUP_SIZE) },
+			{ "LEXVI_BIN_COUNT", std::to_string(BIN_COUNT) },
+			{ "LEXVI_HAS_NORMALS", hasNormals ? "1" : "0" },
+			{ "LEXVI_VISIBILITY_UNIT", std::to_string(BindingPoints::VisibilityUnit) },
+			{ "LEXVI_BINS_SSBO", std::to_string(BindingPoints::VisibilityBinsSSBO) },
+			{ "LEXVI_PIXELS_SSBO", std::to_string(BindingPoints::VisibilityPixelsSSBO) },
+			{ "LEXVI_VERTICES_SSBO", std::to_string(BindingPoints::VisibilityVerticesSSBO) },
+			{ "LEXVI_INDICES_SSBO", std::to_string(BindingPoints::VisibilityIndicesSSBO) },
+			{ "LEXVI_INSTANCES_SSBO", std::to_string(BindingPoints::VisibilityInstancesSSBO) },
+		});
+		materialShaders[key] = shader;
+		return shader;
+	}
+}
@@ -1,6 +1,8 @@
 #include "pch.h"
 
 #include "Shader/ComputeShader.hpp"
+#include "Shader/ShaderPreprocessor.hpp"
+#include "Renderer/GLState.hpp"
 
 using namespace Lexvi;
 
@@ -8,25 +10,8 @@ ComputeShader::ComputeShader(std::string src, bool isFromFile)
 {
     std::string shaderCode = src;
     if (isFromFile) {
-        std::ifstream ShaderFile;
-        // ensure ifstream objects can throw exceptions:
-        ShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-        try
-        {
-            // open files
-            ShaderFile.open(src);
-            std::stringstream vShaderStream;
-            // read file's buffer contents into streams
-            vShaderStream << ShaderFile.rdbuf();
-            // close file handlers
-            ShaderFile.close();
-            // convert stream into string
-            shaderCode = vShaderStream.str();
-        }
-        catch (std::ifstream::failure& e)
-        {
-            std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ: " << e.what() << std::endl;
-        }
+        // expands #include directives
+        shaderCode = PreprocessShaderFile(src).source;
     }
     const char* ShaderCode = shaderCode.c_str();
 
@@ -36,14 +21,35 @@ ComputeShader::ComputeShader(std::string src, bool isFromFile)
     checkCompileErrors(compute, "COMPUTE");
 
     ID = glCreateProgram();
+    // lets ShaderCache store the linked binary
+    glProgramParameteri(ID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
     glAttachShader(ID, compute);
     glLinkProgram(ID);
     checkCompileErrors(ID, "PROGRAM");
+    glDeleteShader(compute);
+
+    reflectWorkGroupSize();
+}
+
+ComputeShader::ComputeShader(unsigned int programID) : ID(programID)
+{
+    reflectWorkGroupSize();
+}
+
+void ComputeShader::reflectWorkGroupSize()
+{
+    int success = 0;
+    glGetProgramiv(ID, GL_LINK_STATUS, &success);
+    if (!success) return;
+
+    GLint size[3] = { 1, 1, 1 };
+    glGetProgramiv(ID, GL_COMPUTE_WORK_GROUP_SIZE, size);
+    localSize = glm::uvec3(size[0], size[1], size[2]);
 }
 
 void ComputeShader::use() const
 {
-    glUseProgram(ID);
+    GLState::UseProgram(ID);
 }
 
 void ComputeShader::checkCompileErrors(unsigned int shader, std::string type)
@@ -105,6 +111,11 @@ void ComputeShader::setVec3(const std::string& name, const glm::vec3& value) con
     glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
 }
 
+void ComputeShader::setiVec2(const std::string& name, const glm::ivec2& value) const
+{
+    glUniform2iv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+}
+
 void ComputeShader::setiVec3(const std::string& name, const glm::ivec3& value) const
 {
     glUniform3iv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
@@ -145,3 +156,57 @@ void Lexvi::ComputeShader::Dispatch(glm::uvec3 groupNum) const
     this->use();
     glDispatchCompute(groupNum.x, groupNum.y, groupNum.z);
 }
+
+glm::uvec3 Lexvi::ComputeShader::DispatchThreads(uint64_t threadCount) const
+{
+    if (threadCount == 0) return glm::uvec3(0);
+
+    glm::uvec3 maxGroups = GetMaxComputeWorkGroupCount();
+    uint64_t threadsPerGroup = static_cast<uint64_t>(localSize.x) * localSize.y * localSize.z;
+
+    // Total groups needed to cover all threads
+    uint64_t totalGroups = (threadCount + threadsPerGroup - 1) / threadsPerGroup;
+
+    // Fill X first, then spill into Y and Z
+    uint64_t groupsX = std::min<uint64_t>(maxGroups.x, totalGroups);
+    uint64_t groupsY = std::min<uint64_t>(maxGroups.y, (totalGroups + groupsX - 1) / groupsX);
+    uint64_t groupsZ = std::min<uint64_t>(maxGroups.z, (totalGroups + groupsX * groupsY - 1) / (groupsX * groupsY));
+
+    if (groupsX * groupsY * groupsZ < totalGroups) {
+        std::cout << "ERROR::COMPUTE::DISPATCH_TOO_LARGE: " << threadCount << " threads exceed the device limits" << std::endl;
+    }
+
+    glm::uvec3 groups(static_cast<uint32_t>(groupsX), static_cast<uint32_t>(groupsY), static_cast<uint32_t>(groupsZ));
+    Dispatch(groups);
+    return groups;
+}
+
+glm::uvec3 Lexvi::ComputeShader::DispatchThreads(glm::uvec3 threadCount) const
+{
+    if (threadCount.x == 0 || threadCount.y == 0 || threadCount.z == 0) return glm::uvec3(0);
+
+    glm::uvec3 groups = (threadCount + localSize - glm::uvec3(1)) / localSize;
+    groups = glm::min(groups, GetMaxComputeWorkGroupCount());
+
+    Dispatch(groups);
+    return groups;
+}
+
+void Lexvi::ComputeShader::DispatchIndirect(unsigned int buffer, GLintptr offset) const
+{
+    this->use();
+    GLState::BindDispatchIndirectBuffer(buffer);
+    glDispatchComputeIndirect(offset);
+}
+
+glm::uvec3 Lexvi::GetMaxComputeWorkGroupCount()
+{
+    static glm::uvec3 maxGroups = []() {
+        GLint count[3];
+        glGetIntegeri_v(GL_MAX_COMPUTE_WORK_GROUP_COUNT, 0, &count[0]);
+        glGetIntegeri_v(GL_MAX_COMPUTE_WORK_GROUP_COUNT, 1, &count[1]);
+        glGetIntegeri_v(GL_MAX_COMPUTE_WORK_GROUP_COUNT, 2, &count[2]);
+        return glm::uvec3(count[0], count[1], count[2]);
+    }();
+    return maxGroups;
+}
@@ -1,6 +1,9 @@
 #include "pch.h"
 
 #include "Shader/Shader.hpp"
+#include "Shader/ShaderPreprocessor.hpp"
+#include "Renderer/GLState.hpp"
+#include "Shader/ComputeShader.hpp"
 
 using namespace Lexvi;
 
@@ -10,42 +13,12 @@ Shader::Shader(std::string vertexSrc, std::string fragmentSrc, std::string geome
     std::string fragmentCode = fragmentSrc;
     std::string geometryCode = geometrySrc;
     if (isFromFile) {
-        std::ifstream vShaderFile;
-        std::ifstream fShaderFile;
-        std::ifstream gShaderFile;
-        // ensure ifstream objects can throw exceptions:
-        vShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-        fShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-        gShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-        try
-        {
-            // open files
-            vShaderFile.open(vertexSrc);
-            fShaderFile.open(fragmentSrc);
-            std::stringstream vShaderStream, fShaderStream;
-            // read file's buffer contents into streams
-            vShaderStream << vShaderFile.rdbuf();
-            fShaderStream << fShaderFile.rdbuf();
-            // close file handlers
-            vShaderFile.close();
-            fShaderFile.close();
-            // convert stream into string
-            vertexCode = vShaderStream.str();
-            fragmentCode = fShaderStream.str();
-            // if geometry shader path is present, also load a geometry shader
-            if (geometrySrc != "")
-            {
-                gShaderFile.open(geometrySrc);
-                std::stringstream gShaderStream;
-                gShaderStream << gShaderFile.rdbuf();
-                gShaderFile.close();
-                geometryCode = gShaderStream.str();
-            }
-        }
-        catch (std::ifstream::failure& e)
-        {
-            std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ: " << e.what() << std::endl;
-        }
+        // expands #include directives
+        vertexCode = PreprocessShaderFile(vertexSrc).source;
+        fragmentCode = PreprocessShaderFile(fragmentSrc).source;
+        // if geometry shader path is present, also load a geometry shader
+        if (geometrySrc != "")
+            geometryCode = PreprocessShaderFile(geometrySrc).source;
     }
     const char* vShaderCode = vertexCode.c_str();
     const char* fShaderCode = fragmentCode.c_str();
@@ -73,6 +46,8 @@ Shader::Shader(std::string vertexSrc, std::string fragmentSrc, std::string geome
     }
     // shader Program
     ID = glCreateProgram();
+    // lets ShaderCache store the linked binary
+    glProgramParameteri(ID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
     glAttachShader(ID, vertex);
     glAttachShader(ID, fragment);
     if (geometrySrc != "")
@@ -88,7 +63,12 @@ Shader::Shader(std::string vertexSrc, std::string fragmentSrc, std::string geome
 
 void Shader::use() const
 {
-    glUseProgram(ID);
+    GLState::UseProgram(ID);
+}
+
+bool Shader::hasStorageBlock(const std::string& name) const
+{
+    return glGetProgramResourceIndex(ID, GL_SHADER_STORAGE_BLOCK, name.c_str()) != GL_INVALID_INDEX;
 }
 
 void Shader::checkCompileErrors(unsigned int shader, std::string type)
@@ -187,17 +167,14 @@ void Shader::setMat4(const std::string& name, const glm::mat4& mat) const
 
 uint64_t Lexvi::GetMaxThreadsPerDispatch(int localSizeX, int localSizeY, int localSizeZ)
 {
-    // Query how many groups you can launch per dimension
-    GLint maxGroups[3];
-    glGetIntegeri_v(GL_MAX_COMPUTE_WORK_GROUP_COUNT, 0, &maxGroups[0]);
-    glGetIntegeri_v(GL_MAX_COMPUTE_WORK_GROUP_COUNT, 1, &maxGroups[1]);
-    glGetIntegeri_v(GL_MAX_COMPUTE_WORK_GROUP_COUNT, 2, &maxGroups[2]);
+    // How many groups can be launched per dimension
+    glm::uvec3 maxGroups = GetMaxComputeWorkGroupCount();
 
     // Total number of threads = groups * local size
     uint64_t totalThreads =
-        static_cast<uint64_t>(maxGroups[0]) *
-        static_cast<uint64_t>(maxGroups[1]) *
-        static_cast<uint64_t>(maxGroups[2]) *
+        static_cast<uint64_t>(maxGroups.x) *
+        static_cast<uint64_t>(maxGroups.y) *
+        static_cast<uint64_t>(maxGroups.z) *
         static_cast<uint64_t>(localSizeX * localSizeY * localSizeZ);
 
     return totalThreads;
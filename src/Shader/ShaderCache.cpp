@@ -0,0 +1,337 @@
+#include "pch.h"
+
+#include "Shader/ShaderCache.hpp"
+#include "Utils/Hash.hpp"
+#include "Renderer/GLState.hpp"
+
+#include <iomanip>
+
+namespace fs = std::filesystem;
+
+namespace Lexvi {
+    namespace {
+        constexpr uint32_t BINARY_MAGIC = 0x4250584C; // "LXPB"
+        constexpr uint32_t BINARY_VERSION = 1;
+
+        struct ProgramBinaryHeader {
+            uint32_t magic;
+            uint32_t version;
+            uint64_t key;
+            uint32_t format;
+            uint32_t size;
+        };
+
+        uint64_t HashDefines(const ShaderDefines& defines, uint64_t seed) {
+            // order of the define list must not create a new variant
+            ShaderDefines sorted = defines;
+            std::sort(sorted.begin(), sorted.end());
+
+            uint64_t h = seed;
+            for (const auto& [name, value] : sorted) h = Hash::FNV1a(name + "=" + value + ";", h);
+            return h;
+        }
+
+        bool IsLinked(unsigned int program) {
+            int success = 0;
+            glGetProgramiv(program, GL_LINK_STATUS, &success);
+            return success != 0;
+        }
+
+        void PrintSourceTable(const PreprocessedShader& shader) {
+            for (size_t i = 0; i < shader.files.size(); ++i) {
+                std::cout << "    source " << i << ": " << shader.files[i] << std::endl;
+            }
+        }
+
+        std::shared_ptr<Shader> WrapProgram(unsigned int program) {
+            return std::shared_ptr<Shader>(new Shader(program), [](Shader* shader) {
+                GLState::ForgetProgram(shader->ID);
+                glDeleteProgram(shader->ID);
+                delete shader;
+            });
+        }
+
+        std::shared_ptr<ComputeShader> WrapComputeProgram(ComputeShader* shader) {
+            return std::shared_ptr<ComputeShader>(shader, [](ComputeShader* s) {
+                GLState::ForgetProgram(s->ID);
+                glDeleteProgram(s->ID);
+                delete s;
+            });
+        }
+    }
+
+    bool ProgramBinaryCache::EnsureInitialised()
+    {
+        if (initialised) return supported;
+        initialised = true;
+
+        GLint formats = 0;
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+        if (formats <= 0 || directory.empty()) return supported = false;
+
+        // binaries are only valid for the driver that produced them
+        auto glString = [](GLenum name) {
+            const GLubyte* str = glGetString(name);
+            return str ? std::string(reinterpret_cast<const char*>(str)) : std::string();
+        };
+        driverHash = Hash::FNV1a(glString(GL_VENDOR));
+        driverHash = Hash::FNV1a(glString(GL_RENDERER), driverHash);
+        driverHash = Hash::FNV1a(glString(GL_VERSION), driverHash);
+
+        std::error_code ec;
+        fs::create_directories(directory, ec);
+        supported = !ec;
+        return supported;
+    }
+
+    std::string ProgramBinaryCache::getPath(uint64_t sourceHash) const
+    {
+        std::stringstream name;
+        name << std::hex << std::setw(16) << std::setfill('0') << (sourceHash ^ driverHash) << ".bin";
+        return (fs::path(directory) / name.str()).string();
+    }
+
+    unsigned int ProgramBinaryCache::Load(uint64_t sourceHash)
+    {
+        if (!EnsureInitialised()) return 0;
+
+        std::ifstream file(getPath(sourceHash), std::ios::binary);
+        if (!file) return 0;
+
+        ProgramBinaryHeader header{};
+        file.read(reinterpret_cast<char*>(&header), sizeof(header));
+        if (!file || header.magic != BINARY_MAGIC || header.version != BINARY_VERSION ||
+            header.key != (sourceHash ^ driverHash) || header.size == 0) {
+            return 0;
+        }
+
+        std::vector<char> binary(header.size);
+        file.read(binary.data(), header.size);
+        if (!file) return 0;
+
+        unsigned int program = glCreateProgram();
+        glProgramBinary(program, header.format, binary.data(), static_cast<GLsizei>(header.size));
+
+        // drivers reject binaries after updates, fall back to compiling
+        if (!IsLinked(program)) {
+            glDeleteProgram(program);
+            return 0;
+        }
+        return program;
+    }
+
+    void ProgramBinaryCache::Store(uint64_t sourceHash, unsigned int program)
+    {
+        if (!EnsureInitialised()) return;
+
+        GLint length = 0;
+        glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+        if (length <= 0) return;
+
+        std::vector<char> binary(length);
+        GLenum format = 0;
+        glGetProgramBinary(program, length, nullptr, &format, binary.data());
+
+        ProgramBinaryHeader header{ BINARY_MAGIC, BINARY_VERSION, sourceHash ^ driverHash, format, static_cast<uint32_t>(length) };
+
+        std::ofstream file(getPath(sourceHash), std::ios::binary | std::ios::trunc);
+        if (!file) return;
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(binary.data(), length);
+    }
+
+    std::shared_ptr<Shader> ShaderCache::GetShader(const std::string& vertexPath, const std::string& fragmentPath, const ShaderDefines& defines, const std::string& geometryPath)
+    {
+        stats.requests++;
+
+        uint64_t key = Hash::FNV1a("graphics");
+        key = Hash::FNV1a(vertexPath, key);
+        key = Hash::FNV1a(fragmentPath, key);
+        key = Hash::FNV1a(geometryPath, key);
+        key = HashDefines(defines, key);
+
+        auto variant = shaderVariants.find(key);
+        if (variant != shaderVariants.end()) return variant->second;
+        stats.variants++;
+
+        PreprocessedShader vertex = PreprocessShaderFile(vertexPath, defines);
+        PreprocessedShader fragment = PreprocessShaderFile(fragmentPath, defines);
+        PreprocessedShader geometry;
+        if (!geometryPath.empty()) geometry = PreprocessShaderFile(geometryPath, defines);
+
+        uint64_t sourceHash = Hash::FNV1a(vertex.source);
+        sourceHash = Hash::FNV1a(fragment.source, sourceHash);
+        sourceHash = Hash::FNV1a(geometry.source, sourceHash);
+
+        auto existing = shaderPrograms.find(sourceHash);
+        if (existing != shaderPrograms.end()) {
+            stats.deduplicated++;
+            shaderVariants[key] = existing->second;
+            return existing->second;
+        }
+
+        std::shared_ptr<Shader> shader;
+        if (unsigned int program = binaryCache.Load(sourceHash)) {
+            stats.loadedFromBinary++;
+            shader = WrapProgram(program);
+        }
+        else {
+            stats.compiled++;
+            Shader compiled(vertex.source, fragment.source, geometry.source, false);
+            shader = WrapProgram(compiled.ID);
+
+            if (IsLinked(shader->ID)) {
+                binaryCache.Store(sourceHash, shader->ID);
+            }
+            else {
+                std::cout << "ERROR::SHADER_CACHE::VARIANT_FAILED: " << vertexPath << " / " << fragmentPath << std::endl;
+                PrintSourceTable(vertex);
+                PrintSourceTable(fragment);
+            }
+        }
+
+        stats.programs++;
+        shaderPrograms[sourceHash] = shader;
+        shaderVariants[key] = shader;
+        return shader;
+    }
+
+    std::shared_ptr<ComputeShader> ShaderCache::GetComputeShader(const std::string& path, const ShaderDefines& defines)
+    {
+        stats.requests++;
+
+        uint64_t key = Hash::FNV1a("compute");
+        key = Hash::FNV1a(path, key);
+        key = HashDefines(defines, key);
+
+        auto variant = computeVariants.find(key);
+        if (variant != computeVariants.end()) return variant->second;
+        stats.variants++;
+
+        PreprocessedShader compute = PreprocessShaderFile(path, defines);
+        uint64_t sourceHash = Hash::FNV1a(compute.source, Hash::FNV1a("compute"));
+
+        auto existing = computePrograms.find(sourceHash);
+        if (existing != computePrograms.end()) {
+            stats.deduplicated++;
+            computeVariants[key] = existing->second;
+            return existing->second;
+        }
+
+        std::shared_ptr<ComputeShader> shader;
+        if (unsigned int program = binaryCache.Load(sourceHash)) {
+            stats.loadedFromBinary++;
+            shader = WrapComputeProgram(new ComputeShader(program));
+        }
+        else {
+            stats.compiled++;
+            shader = WrapComputeProgram(new ComputeShader(compute.source, false));
+
+            if (IsLinked(shader->ID)) {
+                binaryCache.Store(sourceHash, shader->ID);
+            }
+            else {
+                std::cout << "ERROR::SHADER_CACHE::VARIANT_FAILED: " << path << std::endl;
+                PrintSourceTable(compute);
+            }
+        }
+
+        stats.programs++;
+        computePrograms[sourceHash] = shader;
+        computeVariants[key] = shader;
+        return shader;
+    }
+
+    std::shared_ptr<Shader> ShaderCache::GetShaderFromSource(const std::string& vertexSource, const std::string& fragmentSource, const ShaderDefines& defines, const std::string& geometrySource)
+    {
+        stats.requests++;
+
+        // embedded sources are keyed by their expansion, there is no path to key on
+        PreprocessedShader vertex = PreprocessShader(vertexSource, "", defines);
+        PreprocessedShader fragment = PreprocessShader(fragmentSource, "", defines);
+        PreprocessedShader geometry;
+        if (!geometrySource.empty()) geometry = PreprocessShader(geometrySource, "", defines);
+
+        uint64_t sourceHash = Hash::FNV1a(vertex.source);
+        sourceHash = Hash::FNV1a(fragment.source, sourceHash);
+        sourceHash = Hash::FNV1a(geometry.source, sourceHash);
+
+        auto existing = shaderPrograms.find(sourceHash);
+        if (existing != shaderPrograms.end()) return existing->second;
+        stats.variants++;
+
+        std::shared_ptr<Shader> shader;
+        if (unsigned int program = binaryCache.Load(sourceHash)) {
+            stats.loadedFromBinary++;
+            shader = WrapProgram(program);
+        }
+        else {
+            stats.compiled++;
+            Shader compiled(vertex.source, fragment.source, geometry.source, false);
+            shader = WrapProgram(compiled.ID);
+
+            if (IsLinked(shader->ID)) {
+                binaryCache.Store(sourceHash, shader->ID);
+            }
+            else {
+                std::cout << "ERROR::SHADER_CACHE::VARIANT_FAILED: <embedded shader>" << std::endl;
+                PrintSourceTable(vertex);
+                PrintSourceTable(fragment);
+            }
+        }
+
+        stats.programs++;
+        shaderPrograms[sourceHash] = shader;
+        return shader;
+    }
+
+    std::shared_ptr<ComputeShader> ShaderCache::GetComputeShaderFromSource(const std::string& source, const ShaderDefines& defines)
+    {
+        stats.requests++;
+
+        // embedded sources are keyed by their expansion, there is no path to key on
+        PreprocessedShader compute = PreprocessShader(source, "", defines);
+        uint64_t sourceHash = Hash::FNV1a(compute.source, Hash::FNV1a("compute"));
+
+        auto existing = computePrograms.find(sourceHash);
+        if (existing != computePrograms.end()) return existing->second;
+        stats.variants++;
+
+        std::shared_ptr<ComputeShader> shader;
+        if (unsigned int program = binaryCache.Load(sourceHash)) {
+            stats.loadedFromBinary++;
+            shader = WrapComputeProgram(new ComputeShader(program));
+        }
+        else {
+            stats.compiled++;
+            shader = WrapComputeProgram(new ComputeShader(compute.source, false));
+
+            if (IsLinked(shader->ID)) {
+                binaryCache.Store(sourceHash, shader->ID);
+            }
+            else {
+                std::cout << "ERROR::SHADER_CACHE::VARIANT_FAILED: <embedded compute shader>" << std::endl;
+                PrintSourceTable(compute);
+            }
+        }
+
+        stats.programs++;
+        computePrograms[sourceHash] = shader;
+        return shader;
+    }
+
+    void ShaderCache::Clear()
+    {
+        shaderVariants.clear();
+        shaderPrograms.clear();
+        computeVariants.clear();
+        computePrograms.clear();
+        stats = {};
+    }
+
+    ShaderCache& GetShaderCache()
+    {
+        static ShaderCache cache("ShaderCache");
+        return cache;
+    }
+}
@@ -0,0 +1,218 @@
+#include "pch.h"
+
+#include "Shader/ShaderPreprocessor.hpp"
+
+namespace fs = std::filesystem;
+
+namespace Lexvi {
+    namespace {
+        constexpr int MAX_INCLUDE_DEPTH = 32;
+
+        std::unordered_map<std::string, std::string>& IncludeRegistry() {
+            static std::unordered_map<std::string, std::string> registry;
+            return registry;
+        }
+
+        struct ExpandContext {
+            std::vector<std::string> files;
+            std::vector<std::string> included;
+            std::string versionLine;
+        };
+
+        bool IsIdentifierChar(char c) {
+            return std::isalnum(static_cast<unsigned char>(c)) || c == '_';
+        }
+
+        bool ContainsIdentifier(const std::string& text, const std::string& name) {
+            size_t pos = text.find(name);
+            while (pos != std::string::npos) {
+                bool startOk = pos == 0 || !IsIdentifierChar(text[pos - 1]);
+                size_t end = pos + name.size();
+                bool endOk = end >= text.size() || !IsIdentifierChar(text[end]);
+                if (startOk && endOk) return true;
+                pos = text.find(name, pos + 1);
+            }
+            return false;
+        }
+
+        bool StartsWithDirective(const std::string& trimmed, const char* directive) {
+            if (trimmed.empty() || trimmed[0] != '#') return false;
+            size_t i = 1;
+            while (i < trimmed.size() && (trimmed[i] == ' ' || trimmed[i] == '\t')) i++;
+            return trimmed.compare(i, std::strlen(directive), directive) == 0;
+        }
+
+        // Returns false when the line is not a well formed #include
+        bool ParseInclude(const std::string& trimmed, std::string& outName, bool& outSystem) {
+            size_t start = trimmed.find_first_of("\"<");
+            if (start == std::string::npos) return false;
+
+            outSystem = trimmed[start] == '<';
+            size_t end = trimmed.find(outSystem ? '>' : '"', start + 1);
+            if (end == std::string::npos) return false;
+
+            outName = trimmed.substr(start + 1, end - start - 1);
+            return !outName.empty();
+        }
+
+        // Resolves an include to a unique key and its source; key is empty if nothing was found
+        bool ResolveInclude(const std::string& name, bool system, const std::string& directory, std::string& outKey, std::string& outSource, std::string& outDirectory) {
+            auto& registry = IncludeRegistry();
+            auto fromRegistry = [&]() {
+                auto it = registry.find(name);
+                if (it == registry.end()) return false;
+                outKey = "<" + name + ">";
+                outSource = it->second;
+                outDirectory = directory;
+                return true;
+            };
+            auto fromDisk = [&]() {
+                fs::path path = (fs::path(directory) / fs::path(name)).lexically_normal();
+                if (!fs::exists(path)) return false;
+                if (!ReadShaderFile(path.string(), outSource)) return false;
+                outKey = path.generic_string();
+                outDirectory = path.parent_path().string();
+                return true;
+            };
+
+            if (system) return fromRegistry() || fromDisk();
+            return fromDisk() || fromRegistry();
+        }
+
+        void Expand(const std::string& source, const std::string& directory, size_t fileIndex, int depth, ExpandContext& ctx, std::string& out) {
+            std::istringstream stream(source);
+            std::string line;
+            size_t lineNumber = 0;
+
+            out += "#line 1 " + std::to_string(fileIndex) + "\n";
+
+            while (std::getline(stream, line)) {
+                lineNumber++;
+                if (!line.empty() && line.back() == '\r') line.pop_back();
+
+                size_t first = line.find_first_not_of(" \t");
+                std::string trimmed = (first == std::string::npos) ? std::string() : line.substr(first);
+
+                if (StartsWithDirective(trimmed, "version")) {
+                    // only the root file's #version survives, it is re-emitted ahead of the defines
+                    if (depth == 0 && ctx.versionLine.empty()) ctx.versionLine = trimmed;
+                    out += "\n";
+                    continue;
+                }
+
+                if (StartsWithDirective(trimmed, "pragma") && ContainsIdentifier(trimmed, "once")) {
+                    out += "\n";
+                    continue;
+                }
+
+                if (!StartsWithDirective(trimmed, "include")) {
+                    out += line;
+                    out += "\n";
+                    continue;
+                }
+
+                std::string name;
+                bool system = false;
+                if (!ParseInclude(trimmed, name, system)) {
+                    std::cout << "ERROR::SHADER::MALFORMED_INCLUDE: " << ctx.files[fileIndex] << "(" << lineNumber << "): " << trimmed << std::endl;
+                    out += "\n";
+                    continue;
+                }
+
+                if (depth + 1 > MAX_INCLUDE_DEPTH) {
+                    std::cout << "ERROR::SHADER::INCLUDE_DEPTH_EXCEEDED: " << name << std::endl;
+                    out += "\n";
+                    continue;
+                }
+
+                std::string key, includeSource, includeDirectory;
+                if (!ResolveInclude(name, system, directory, key, includeSource, includeDirectory)) {
+                    std::cout << "ERROR::SHADER::INCLUDE_NOT_FOUND: " << name << " (from " << ctx.files[fileIndex] << ")" << std::endl;
+                    out += "\n";
+                    continue;
+                }
+
+                // include once
+                if (std::find(ctx.included.begin(), ctx.included.end(), key) == ctx.included.end()) {
+                    ctx.included.push_back(key);
+
+                    size_t includeIndex = ctx.files.size();
+                    ctx.files.push_back(key);
+                    Expand(includeSource, includeDirectory, includeIndex, depth + 1, ctx, out);
+                }
+
+                out += "#line " + std::to_string(lineNumber + 1) + " " + std::to_string(fileIndex) + "\n";
+            }
+        }
+    }
+
+    void RegisterShaderInclude(const std::string& name, const std::string& source)
+    {
+        IncludeRegistry()[name] = source;
+    }
+
+    bool ReadShaderFile(const std::string& path, std::string& outSource)
+    {
+        std::ifstream ShaderFile;
+        // ensure ifstream objects can throw exceptions:
+        ShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+        try
+        {
+            ShaderFile.open(path);
+            std::stringstream ShaderStream;
+            ShaderStream << ShaderFile.rdbuf();
+            ShaderFile.close();
+            outSource = ShaderStream.str();
+        }
+        catch (std::ifstream::failure& e)
+        {
+            std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ: " << path << " " << e.what() << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    PreprocessedShader PreprocessShader(const std::string& source, const std::string& directory, const ShaderDefines& defines)
+    {
+        ExpandContext ctx;
+        ctx.files.push_back("<source>");
+
+        std::string body;
+        body.reserve(source.size());
+        Expand(source, directory, 0, 0, ctx, body);
+
+        PreprocessedShader result;
+        result.files = std::move(ctx.files);
+
+        if (!ctx.versionLine.empty()) {
+            result.source += ctx.versionLine;
+            result.source += "\n";
+        }
+
+        // written sorted so the define order of a request can't change the expansion (or its source hash)
+        ShaderDefines sorted = defines;
+        std::sort(sorted.begin(), sorted.end());
+
+        for (const auto& [name, value] : sorted) {
+            if (!ContainsIdentifier(body, name)) continue;
+
+            result.source += "#define " + name;
+            if (!value.empty()) result.source += " " + value;
+            result.source += "\n";
+        }
+
+        result.source += body;
+        return result;
+    }
+
+    PreprocessedShader PreprocessShaderFile(const std::string& path, const ShaderDefines& defines)
+    {
+        std::string source;
+        if (!ReadShaderFile(path, source)) return {};
+
+        fs::path p(path);
+        PreprocessedShader result = PreprocessShader(source, p.parent_path().string(), defines);
+        result.files[0] = p.lexically_normal().generic_string();
+        return result;
+    }
+}
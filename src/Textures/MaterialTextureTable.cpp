@@ -0,0 +1,252 @@
+#include "pch.h"
+
+#include "Textures/MaterialTextureTable.hpp"
+#include "Renderer/BindingPoints.hpp"
+#include "Renderer/GLState.hpp"
+#include "Utils/Hash.hpp"
+
+namespace Lexvi {
+    namespace {
+        constexpr uint32_t SLOT_COUNT = static_cast<uint32_t>(MaterialTextureSlot::Count);
+        constexpr uint32_t INITIAL_PAGE_LAYERS = 16;
+
+        const char* SLOT_TYPES[SLOT_COUNT] = {
+            "texture_diffuse",
+            "texture_specular",
+            "texture_normal",
+            "texture_roughness",
+            "texture_metallic",
+            "texture_ao",
+        };
+
+        const char* SLOT_DEFINES[SLOT_COUNT] = {
+            "LEXVI_SLOT_DIFFUSE",
+            "LEXVI_SLOT_SPECULAR",
+            "LEXVI_SLOT_NORMAL",
+            "LEXVI_SLOT_ROUGHNESS",
+            "LEXVI_SLOT_METALLIC",
+            "LEXVI_SLOT_AO",
+        };
+    }
+
+    MaterialTextureSlot MaterialTextureSlotFromType(const std::string& type)
+    {
+        for (uint32_t i = 0; i < SLOT_COUNT; ++i) {
+            if (type == SLOT_TYPES[i]) return static_cast<MaterialTextureSlot>(i);
+        }
+        return MaterialTextureSlot::Count;
+    }
+
+    MaterialTextureTable::~MaterialTextureTable()
+    {
+        for (ArrayPage& page : pages) {
+            GLState::ForgetTexture(page.texture);
+            glDeleteTextures(1, &page.texture);
+        }
+        if (tableBuffer) {
+            GLState::ForgetBuffer(tableBuffer);
+            glDeleteBuffers(1, &tableBuffer);
+        }
+    }
+
+    void MaterialTextureTable::EnsureInitialised()
+    {
+        if (initialised) return;
+        initialised = true;
+
+#ifdef GL_ARB_bindless_texture
+        bindless = GLAD_GL_ARB_bindless_texture != 0;
+#endif
+    }
+
+    bool MaterialTextureTable::isBindless()
+    {
+        EnsureInitialised();
+        return bindless;
+    }
+
+    uint32_t MaterialTextureTable::AddMaterial(const std::vector<Texture>& textures)
+    {
+        EnsureInitialised();
+
+        // first texture of each kind, the rest are not addressable through the table
+        unsigned int slotTextures[SLOT_COUNT] = {};
+        for (const Texture& texture : textures) {
+            MaterialTextureSlot slot = MaterialTextureSlotFromType(texture.type);
+            if (slot == MaterialTextureSlot::Count || !texture.id) continue;
+
+            unsigned int& slotTexture = slotTextures[static_cast<uint32_t>(slot)];
+            if (!slotTexture) slotTexture = texture.id;
+        }
+
+        uint64_t key = Hash::FNV1a(slotTextures, sizeof(slotTextures));
+        auto existing = materialLookup.find(key);
+        if (existing != materialLookup.end()) return existing->second;
+
+        Entry entry{};
+        for (uint32_t i = 0; i < SLOT_COUNT; ++i) {
+            if (slotTextures[i]) entry.slots[i] = resolveTexture(slotTextures[i]);
+        }
+
+        uint32_t index = static_cast<uint32_t>(entries.size());
+        entries.push_back(entry);
+        materialLookup[key] = index;
+        dirty = true;
+        return index;
+    }
+
+    glm::uvec4 MaterialTextureTable::resolveTexture(unsigned int texture)
+    {
+        auto cached = textureSlots.find(texture);
+        if (cached != textureSlots.end()) return cached->second;
+
+        glm::uvec4 slot(0u);
+#ifdef GL_ARB_bindless_texture
+        if (bindless) {
+            GLuint64 handle = glGetTextureHandleARB(texture);
+            glMakeTextureHandleResidentARB(handle);
+            slot = glm::uvec4(static_cast<uint32_t>(handle), static_cast<uint32_t>(handle >> 32), 1u, 0u);
+        }
+#endif
+        if (!bindless) slot = addToArray(texture);
+
+        textureSlots[texture] = slot;
+        return slot;
+    }
+
+    glm::uvec4 MaterialTextureTable::addToArray(unsigned int texture)
+    {
+        GLint width = 0, height = 0, format = 0;
+        glGetTextureLevelParameteriv(texture, 0, GL_TEXTURE_WIDTH, &width);
+        glGetTextureLevelParameteriv(texture, 0, GL_TEXTURE_HEIGHT, &height);
+        glGetTextureLevelParameteriv(texture, 0, GL_TEXTURE_INTERNAL_FORMAT, &format);
+        if (width <= 0 || height <= 0) return glm::uvec4(0u);
+
+        uint32_t pageIndex = 0;
+        while (pageIndex < pages.size()) {
+            const ArrayPage& page = pages[pageIndex];
+            if (page.width == width && page.height == height && page.format == static_cast<GLenum>(format)) break;
+            pageIndex++;
+        }
+
+        if (pageIndex == pages.size()) {
+            if (pages.size() >= BindingPoints::MaxMaterialArrays) {
+                std::cout << "ERROR::MATERIAL_TEXTURES::TOO_MANY_ARRAYS: no page left for " << width << "x" << height << " textures" << std::endl;
+                return glm::uvec4(0u);
+            }
+            ArrayPage page;
+            page.width = width;
+            page.height = height;
+            page.format = static_cast<GLenum>(format);
+            pages.push_back(page);
+        }
+
+        ArrayPage& page = pages[pageIndex];
+        if (page.layers == page.capacity) growPage(page, std::max(INITIAL_PAGE_LAYERS, page.capacity * 2));
+
+        uint32_t layer = page.layers++;
+        glCopyImageSubData(texture, GL_TEXTURE_2D, 0, 0, 0, 0,
+            page.texture, GL_TEXTURE_2D_ARRAY, 0, 0, 0, static_cast<GLint>(layer),
+            width, height, 1);
+
+        return glm::uvec4(pageIndex, layer, 1u, 0u);
+    }
+
+    void MaterialTextureTable::growPage(ArrayPage& page, uint32_t capacity)
+    {
+        GLsizei levels = static_cast<GLsizei>(std::floor(std::log2(std::max(page.width, page.height)))) + 1;
+
+        unsigned int texture;
+        glCreateTextures(GL_TEXTURE_2D_ARRAY, 1, &texture);
+        glTextureStorage3D(texture, levels, page.format, page.width, page.height, static_cast<GLsizei>(capacity));
+
+        glTextureParameteri(texture, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTextureParameteri(texture, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTextureParameteri(texture, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTextureParameteri(texture, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+        if (page.texture) {
+            // only the base level, mips are rebuilt on the next Bind
+            if (page.layers) {
+                glCopyImageSubData(page.texture, GL_TEXTURE_2D_ARRAY, 0, 0, 0, 0,
+                    texture, GL_TEXTURE_2D_ARRAY, 0, 0, 0, 0,
+                    page.width, page.height, static_cast<GLsizei>(page.layers));
+            }
+            GLState::ForgetTexture(page.texture);
+            glDeleteTextures(1, &page.texture);
+        }
+
+        page.texture = texture;
+        page.capacity = capacity;
+    }
+
+    void MaterialTextureTable::Bind()
+    {
+        EnsureInitialised();
+
+        if (dirty || !tableBuffer) {
+            size_t size = std::max<size_t>(entries.size(), 1) * sizeof(Entry);
+            if (!tableBuffer) glCreateBuffers(1, &tableBuffer);
+            if (size > tableCapacity) {
+                tableCapacity = size * 2;
+                glNamedBufferData(tableBuffer, tableCapacity, nullptr, GL_DYNAMIC_DRAW);
+            }
+            if (!entries.empty()) glNamedBufferSubData(tableBuffer, 0, entries.size() * sizeof(Entry), entries.data());
+
+            for (const ArrayPage& page : pages) glGenerateTextureMipmap(page.texture);
+            dirty = false;
+        }
+
+        GLState::BindBufferBase(GL_SHADER_STORAGE_BUFFER, BindingPoints::MaterialTexturesSSBO, tableBuffer);
+        for (uint32_t i = 0; i < pages.size(); ++i) {
+            GLState::BindTextureUnit(BindingPoints::MaterialArrayUnitBase + i, pages[i].texture);
+        }
+    }
+
+    std::string MaterialTextureTable::GetGLSL()
+    {
+        EnsureInitialised();
+
+        std::string glsl;
+        // the extension directive has to come first, include this before other declarations
+        if (bindless) glsl += "#extension GL_ARB_bindless_texture : require\n\n";
+
+        for (uint32_t i = 0; i < SLOT_COUNT; ++i) {
+            glsl += "#define " + std::string(SLOT_DEFINES[i]) + " " + std::to_string(i) + "u\n";
+        }
+
+        glsl +=
+            "\n"
+            "struct LexviMaterialTextures {\n"
+            "    uvec4 slots[" + std::to_string(SLOT_COUNT) + "];\n"
+            "};\n"
+            "\n"
+            "layout(std430, binding = " + std::to_string(BindingPoints::MaterialTexturesSSBO) + ") readonly buffer LexviMaterialTextureTable {\n"
+            "    LexviMaterialTextures lexviMaterialTextures[];\n"
+            "};\n"
+            "\n";
+
+        if (!bindless) {
+            glsl += "layout(binding = " + std::to_string(BindingPoints::MaterialArrayUnitBase) + ") uniform sampler2DArray lexviMaterialArrays[" +
+                std::to_string(BindingPoints::MaxMaterialArrays) + "];\n\n";
+        }
+
+        glsl +=
+            "// material must be dynamically uniform (e.g. read from the object data of the current draw)\n"
+            "vec4 LexviSampleMaterial(uint material, uint slot, vec2 uv, vec4 fallback) {\n"
+            "    uvec4 entry = lexviMaterialTextures[material].slots[slot];\n"
+            "    if (entry.z == 0u) return fallback;\n";
+        glsl += bindless
+            ? "    return texture(sampler2D(entry.xy), uv);\n"
+            : "    return texture(lexviMaterialArrays[entry.x], vec3(uv, float(entry.y)));\n";
+        glsl += "}\n";
+
+        return glsl;
+    }
+
+    MaterialTextureTable& GetMaterialTextureTable()
+    {
+        static MaterialTextureTable table;
+        return table;
+    }
+}
@@ -1,6 +1,7 @@
 #include "pch.h"
 
 #include "Textures/Textures.hpp"
+#include "Renderer/GLState.hpp"
 
 namespace fs = std::filesystem;
 
@@ -56,18 +57,32 @@ namespace Lexvi {
     }
 
     unsigned int TextureFromFile(const char* path, const std::string& directory)
+    {
+        DecodedImage image;
+        DecodeTextureFile(path, directory, image);
+        return TextureFromImage(image);
+    }
+
+    bool DecodeTextureFile(const char* path, const std::string& directory, DecodedImage& image)
     {
         namespace fs = std::filesystem;
 
         fs::path texPath = fs::path(directory) / fs::path(path);
         texPath = texPath.lexically_normal(); // resolves .. and mixed slashes
 
-        std::string filename = texPath.string();
+        image.path = texPath.string();
 
+        unsigned char* data = stbi_load(image.path.c_str(), &image.width, &image.height, &image.components, 0);
+        image.pixels = std::shared_ptr<unsigned char>(data, [](unsigned char* pixels) { if (pixels) stbi_image_free(pixels); });
+        return data != nullptr;
+    }
+
+    unsigned int TextureFromImage(const DecodedImage& image)
+    {
         unsigned int textureID = 0;
 
-        int width, height, nrComponents;
-        unsigned char* data = stbi_load(filename.c_str(), &width, &height, &nrComponents, 0);
+        int width = image.width, height = image.height, nrComponents = image.components;
+        const unsigned char* data = image.pixels.get();
         if (data)
         {
             GLenum format = GL_RGB;
@@ -99,13 +114,10 @@ namespace Lexvi {
             glTextureParameteri(textureID, GL_TEXTURE_WRAP_T, GL_REPEAT);
             glTextureParameteri(textureID, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
             glTextureParameteri(textureID, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-            stbi_image_free(data);
         }
         else
         {
-            std::cout << "Texture failed to load at path: " << filename << std::endl;
-            stbi_image_free(data);
+            std::cout << "Texture failed to load at path: " << image.path << std::endl;
         }
 
         return textureID;
@@ -203,6 +215,25 @@ namespace Lexvi {
         return depthMap;
     }
 
+    unsigned int GenerateDepthTextureArray(int width, int height, int layers)
+    {
+        unsigned int depthMap;
+        glCreateTextures(GL_TEXTURE_2D_ARRAY, 1, &depthMap);
+
+        glTextureStorage3D(depthMap, 1, GL_DEPTH_COMPONENT32F, width, height, layers);
+
+        glTextureParameteri(depthMap, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTextureParameteri(depthMap, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTextureParameteri(depthMap, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+        glTextureParameteri(depthMap, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+        glTextureParameteri(depthMap, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+        glTextureParameteri(depthMap, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+        float borderColor[] = { 1.0, 1.0, 1.0, 1.0 };
+        glTextureParameterfv(depthMap, GL_TEXTURE_BORDER_COLOR, borderColor);
+
+        return depthMap;
+    }
+
     void CreateComputeTexture(Texture& tex, unsigned int width, unsigned int height)
     {
         glCreateTextures(GL_TEXTURE_2D, 1, &tex.id);
@@ -223,8 +254,8 @@ namespace Lexvi {
     {
         std::vector<unsigned char> pixels(width * height * 4); // RGBA8 -> 4 bytes per pixel
 
-        glBindTexture(GL_TEXTURE_2D, tex.id);
-        glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+        // DSA read back, does not disturb the texture unit bindings
+        glGetTextureImage(tex.id, 0, GL_RGBA, GL_UNSIGNED_BYTE, static_cast<GLsizei>(pixels.size()), pixels.data());
 
         stbi_flip_vertically_on_write(1); // OpenGLs origin is bottom-left
 
@@ -234,7 +265,7 @@ namespace Lexvi {
 
     void BindTexture(unsigned int unit, unsigned int id)
     {
-        glBindTextureUnit(unit, id);
+        GLState::BindTextureUnit(unit, id);
     }
 
 }
\ No newline at end of file
@@ -1,20 +1,67 @@
 #include "pch.h"
 
 #include "Utils/FrameBuffer.hpp"
+#include "Renderer/GLState.hpp"
 
 namespace Lexvi {
+	FrameBuffer::FrameBuffer(const std::vector<GLenum>& colorFormats, FrameBufferAttachments depthStencil, unsigned int width, unsigned int height)
+		: attachments(colorFormats.empty() ? depthStencil : COLOR | depthStencil),
+		width(width), height(height), colorAttachmentNum(static_cast<unsigned int>(colorFormats.size())), colorFormats(colorFormats)
+	{
+		CreateFrameBuffer();
+	}
+
+	FrameBuffer::FrameBuffer(const std::vector<unsigned int>& colorTextures, unsigned int depthTexture, GLenum depthAttachment, unsigned int width, unsigned int height)
+		: colorAttachmentNum(static_cast<unsigned int>(colorTextures.size())), width(width), height(height), ownsTextures(false)
+	{
+		glCreateFramebuffers(1, &fbo);
+
+		std::vector<GLenum> drawBuffers;
+		for (uint32_t i = 0; i < colorTextures.size(); ++i) {
+			GLenum attachment = GL_COLOR_ATTACHMENT0 + i;
+			glNamedFramebufferTexture(fbo, attachment, colorTextures[i], 0);
+			drawBuffers.push_back(attachment);
+
+			attachedTextures["COLOR" + std::to_string(i)] = Texture{ colorTextures[i], "FBO_COLOR" };
+			attachments = attachments | COLOR;
+		}
+
+		if (depthTexture) {
+			glNamedFramebufferTexture(fbo, depthAttachment, depthTexture, 0);
+			attachedTextures["DEPTH"] = Texture{ depthTexture, "FBO_DEPTH" };
+			attachments = attachments | DEPTH;
+			if (depthAttachment == GL_DEPTH_STENCIL_ATTACHMENT) {
+				attachedTextures["STENCIL"] = Texture{ depthTexture, "FBO_STENCIL" };
+				attachments = attachments | STENCIL;
+			}
+		}
+
+		if (drawBuffers.empty()) glNamedFramebufferDrawBuffer(fbo, GL_NONE);
+		else glNamedFramebufferDrawBuffers(fbo, static_cast<GLsizei>(drawBuffers.size()), drawBuffers.data());
+
+		GLenum status = glCheckNamedFramebufferStatus(fbo, GL_FRAMEBUFFER);
+		if (status != GL_FRAMEBUFFER_COMPLETE) {
+			std::cerr << "Framebuffer incomplete! Status: " << status << std::endl;
+		}
+	}
+
 	FrameBuffer::~FrameBuffer()
 	{
 		DeleteFBO();
 	}
 
 	void FrameBuffer::AddAttachment(FrameBufferAttachments newAttachment) {
+		// recreating reallocates every attachment, skip it when nothing changes
+		if ((attachments & newAttachment) == newAttachment && fbo) return;
+
 		attachments = attachments | newAttachment;
 		CreateFrameBuffer();
 	}
 
 	void FrameBuffer::ResizeFrameBuffer(unsigned int width, unsigned int height)
 	{
+		if (this->width == width && this->height == height && fbo) return;
+
 		this->width = width;
 		this->height = height;
 
@@ -29,12 +76,12 @@ namespace Lexvi {
 
     void FrameBuffer::BindFrameBuffer() const
     {
-        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+        GLState::BindFramebuffer(fbo);
     }
 
     void FrameBuffer::UnBindFrameBuffer() const
     {
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        GLState::BindFramebuffer(0);
     }
 
 
@@ -56,6 +103,7 @@ namespace Lexvi {
 	void FrameBuffer::CreateFrameBuffer()
 	{
 		DeleteFBO();
+        ownsTextures = true;
 
         // Create FBO
         glCreateFramebuffers(1, &fbo);
@@ -67,14 +115,17 @@ namespace Lexvi {
         if (attachments & COLOR) {
             colorAttachmentNum = std::max(1u, colorAttachmentNum);
             for (uint32_t i = 0; i < colorAttachmentNum; ++i) {
+                GLenum format = i < colorFormats.size() ? colorFormats[i] : GL_RGBA8;
+
                 Texture colorTex;
                 colorTex.type = "FBO_COLOR";
                 glCreateTextures(GL_TEXTURE_2D, 1, &colorTex.id);
-                glTextureStorage2D(colorTex.id, 1, GL_RGBA8, width, height);
+                glTextureStorage2D(colorTex.id, 1, format, width, height);
 
-                // Filtering
-                glTextureParameteri(colorTex.id, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-                glTextureParameteri(colorTex.id, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+                // Filtering, integer formats are incomplete with linear filtering
+                bool integer = format == GL_R32UI || format == GL_RG32UI || format == GL_RGBA32UI || format == GL_R32I;
+                glTextureParameteri(colorTex.id, GL_TEXTURE_MIN_FILTER, integer ? GL_NEAREST : GL_LINEAR);
+                glTextureParameteri(colorTex.id, GL_TEXTURE_MAG_FILTER, integer ? GL_NEAREST : GL_LINEAR);
 
                 glTextureParameteri(colorTex.id, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
                 glTextureParameteri(colorTex.id, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
@@ -127,11 +178,15 @@ namespace Lexvi {
 	void FrameBuffer::DeleteFBO()
 	{
         if (fbo) {
+            GLState::ForgetFramebuffer(fbo);
             glDeleteFramebuffers(1, &fbo);
             fbo = 0;
         }
 		for (auto& attachedtex : attachedTextures) {
-			if (attachedtex.second.id) glDeleteTextures(1, &attachedtex.second.id);
+			if (ownsTextures && attachedtex.second.id) {
+				GLState::ForgetTexture(attachedtex.second.id);
+				glDeleteTextures(1, &attachedtex.second.id);
+			}
 		}
 		attachedTextures.clear();
 	}
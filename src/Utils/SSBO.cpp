@@ -1,13 +1,14 @@
 #include "pch.h"
 
 #include "Utils/SSBO.hpp"
+#include "Renderer/GLState.hpp"
 
 namespace Lexvi {
 	void CreateSSBO(SSBO& ssbo, size_t size, uint32_t bindingPoint)
 	{
 		glCreateBuffers(1, &ssbo.id);
 		glNamedBufferData(ssbo.id, size, nullptr, GL_DYNAMIC_DRAW);
-		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, bindingPoint, ssbo.id);
+		GLState::BindBufferBase(GL_SHADER_STORAGE_BUFFER, bindingPoint, ssbo.id);
 		ssbo.size = size;
 		ssbo.bindingPoint = bindingPoint;
 	}
@@ -24,12 +25,13 @@ namespace Lexvi {
 
 	void DeleteSSBO(SSBO& ssbo)
 	{
+		GLState::ForgetBuffer(ssbo.id);
 		glDeleteBuffers(1, &ssbo.id);
 		ssbo.id = 0;
 	}
 
 	void BindSSBO(const SSBO& ssbo) {
-		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, ssbo.bindingPoint, ssbo.id);
+		GLState::BindBufferBase(GL_SHADER_STORAGE_BUFFER, ssbo.bindingPoint, ssbo.id);
 	}
 
 	void MemorySSBOBarrier()
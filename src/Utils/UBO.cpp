@@ -1,13 +1,14 @@
 #include "pch.h"
 
 #include "Utils/UBO.hpp"
+#include "Renderer/GLState.hpp"
 
 namespace Lexvi {
 	void CreateUBO(UBO& ubo, size_t size, uint32_t bindingPoint)
 	{
 		glCreateBuffers(1, &ubo.id);
 		glNamedBufferData(ubo.id, size, nullptr, GL_DYNAMIC_DRAW);
-		glBindBufferBase(GL_UNIFORM_BUFFER, bindingPoint, ubo.id);
+		GLState::BindBufferBase(GL_UNIFORM_BUFFER, bindingPoint, ubo.id);
 		ubo.size = size;
 		ubo.bindingPoint = bindingPoint;
 	}
@@ -19,6 +20,7 @@ namespace Lexvi {
 
 	void DeleteUBO(UBO& ubo)
 	{
+		GLState::ForgetBuffer(ubo.id);
 		glDeleteBuffers(1, &ubo.id);
 		ubo.id = 0;
 	}
@@ -0,0 +1,52 @@
+#include "pch.h"
+
+#include "Utils/WorkerPool.hpp"
+
+namespace Lexvi {
+	WorkerPool::WorkerPool(size_t threadCount)
+	{
+		if (threadCount == 0) {
+			size_t cores = std::thread::hardware_concurrency();
+			threadCount = cores > 1 ? cores - 1 : 1;
+		}
+
+		threads.reserve(threadCount);
+		for (size_t i = 0; i < threadCount; ++i) threads.emplace_back(&WorkerPool::work, this);
+	}
+
+	WorkerPool::~WorkerPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+			jobs.clear();
+		}
+		wake.notify_all();
+		for (std::thread& thread : threads) thread.join();
+	}
+
+	void WorkerPool::Submit(std::function<void()> job)
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			jobs.push_back(std::move(job));
+		}
+		wake.notify_one();
+	}
+
+	void WorkerPool::work()
+	{
+		while (true) {
+			std::function<void()> job;
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				wake.wait(lock, [this] { return stopping || !jobs.empty(); });
+				if (stopping) return;
+
+				job = std::move(jobs.front());
+				jobs.pop_front();
+			}
+			job();
+		}
+	}
+}
@@ -0,0 +1,140 @@
+#include "pch.h"
+
+#include "Tests.hpp"
+#include "Renderable/Model/ModelBatch.hpp"
+#include "Renderable/Primitives/Quad.hpp"
+#include "Renderer/BindingPoints.hpp"
+#include "Renderer/FrameConstants.hpp"
+#include "Renderer/GLState.hpp"
+#include "Renderer/HiZBuffer.hpp"
+#include "Renderer/ObjectData.hpp"
+#include "Renderer/RenderQueue.hpp"
+#include "Shader/ShaderCache.hpp"
+#include "Shader/ShaderPreprocessor.hpp"
+#include "Utils/UBO.hpp"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+namespace {
+	constexpr int WIDTH = 64;
+	constexpr int HEIGHT = 16;
+
+	// every object paints its ObjectData params, so a pixel tells whose entry the draw read
+	const char* VERTEX_SOURCE = R"(#version 460
+layout(location = 0) in vec3 aPos;
+
+#include <Lexvi/ObjectData.glsl>
+
+flat out uint objectIndex;
+
+void main() {
+    objectIndex = LEXVI_OBJECT_INDEX;
+    gl_Position = lexviObjects[objectIndex].model * vec4(aPos, 1.0);
+}
+)";
+
+	const char* FRAGMENT_SOURCE = R"(#version 460
+#include <Lexvi/ObjectData.glsl>
+
+flat in uint objectIndex;
+out vec4 fragColor;
+
+void main() {
+    fragColor = lexviObjects[objectIndex].params;
+}
+)";
+
+	// a 0.4 x 1 quad in clip space
+	const char* MODEL_SOURCE =
+		"v -0.2 -0.5 0\n"
+		"v 0.2 -0.5 0\n"
+		"v 0.2 0.5 0\n"
+		"v -0.2 0.5 0\n"
+		"f 1 2 3\n"
+		"f 1 3 4\n";
+
+	bool PixelIs(const std::vector<glm::vec4>& pixels, float clipX, const glm::vec4& color)
+	{
+		int x = static_cast<int>((clipX * 0.5f + 0.5f) * WIDTH);
+		return glm::length(pixels[(HEIGHT / 2) * WIDTH + x] - color) < 0.01f;
+	}
+}
+
+void LexviTests::RunModelBatchTests()
+{
+	using namespace Lexvi;
+
+	RegisterShaderInclude("Lexvi/FrameConstants.glsl", GetFrameConstantsGLSL());
+	RegisterShaderInclude("Lexvi/Culling.glsl", GetCullingGLSL());
+	RegisterShaderInclude("Lexvi/ObjectData.glsl", GetObjectDataGLSL());
+	RegisterShaderInclude("Lexvi/HiZ.glsl", HiZBuffer::GetGLSL());
+
+	// identity camera and zero frustum planes: clip space is world space and nothing is culled
+	FrameConstants constants = BuildFrameConstants(nullptr, 0.0f, 0.0f, 0, WIDTH, HEIGHT);
+	UBO frameConstantsUBO{};
+	CreateUBO(frameConstantsUBO, sizeof(FrameConstants), BindingPoints::FrameConstantsUBO);
+	UpdateUBO(frameConstantsUBO, &constants, sizeof(FrameConstants), 0);
+	GLState::BindBufferBase(GL_UNIFORM_BUFFER, BindingPoints::FrameConstantsUBO, frameConstantsUBO.id);
+
+	unsigned int target = 0, framebuffer = 0;
+	glCreateTextures(GL_TEXTURE_2D, 1, &target);
+	glTextureStorage2D(target, 1, GL_RGBA8, WIDTH, HEIGHT);
+	glCreateFramebuffers(1, &framebuffer);
+	glNamedFramebufferTexture(framebuffer, GL_COLOR_ATTACHMENT0, target, 0);
+
+	std::filesystem::path modelPath = std::filesystem::temp_directory_path() / "LexviModelBatchTest.obj";
+	std::ofstream(modelPath) << MODEL_SOURCE;
+
+	{
+		std::shared_ptr<Shader> objectShader = GetShaderCache().GetShaderFromSource(VERTEX_SOURCE, FRAGMENT_SOURCE);
+		std::shared_ptr<Shader> batchShader = GetShaderCache().GetShaderFromSource(VERTEX_SOURCE, FRAGMENT_SOURCE, { { "LEXVI_MODEL_BATCH", "" } });
+
+		ModelImportOptions options;
+		options.useCache = false;
+		Model model(modelPath.string(), options);
+
+		ModelBatch batch;
+		batch.setConeCulling(false);
+		batch.Add(model, glm::mat4(1.0f), glm::vec4(0.0f, 1.0f, 0.0f, 1.0f));
+
+		Quad left(0.2f, 0.5f), right(0.2f, 0.5f);
+		left.setTransforms(glm::translate(glm::mat4(1.0f), glm::vec3(-0.6f, 0.0f, 0.0f)));
+		right.setTransforms(glm::translate(glm::mat4(1.0f), glm::vec3(0.6f, 0.0f, 0.0f)));
+
+		// passes force queued, batch, queued: the last quad is drawn after the batch bound its buffers
+		Camera camera;
+		RenderQueue queue;
+		queue.SubmitVisible(left, objectShader.get(), camera, { .pass = 0, .params = glm::vec4(1.0f, 0.0f, 0.0f, 1.0f) });
+		queue.SubmitVisible(batch, batchShader.get(), camera, { .pass = 1 });
+		queue.SubmitVisible(right, objectShader.get(), camera, { .pass = 2, .params = glm::vec4(0.0f, 0.0f, 1.0f, 1.0f) });
+
+		GLState::BindFramebuffer(framebuffer);
+		glViewport(0, 0, WIDTH, HEIGHT);
+		GLState::SetDepthTest(false);
+		GLState::SetCullFace(false);
+		float clear[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+		glClearNamedFramebufferfv(framebuffer, GL_COLOR, 0, clear);
+
+		queue.Flush();
+		// batch first this time, the quad after it still has to find the queue's entries
+		queue.SubmitVisible(batch, batchShader.get(), camera, { .pass = 0 });
+		queue.SubmitVisible(left, objectShader.get(), camera, { .pass = 1, .params = glm::vec4(1.0f, 0.0f, 0.0f, 1.0f) });
+		queue.Flush();
+
+		std::vector<glm::vec4> pixels(WIDTH * HEIGHT);
+		glGetTextureImage(target, 0, GL_RGBA, GL_FLOAT, static_cast<GLsizei>(pixels.size() * sizeof(glm::vec4)), pixels.data());
+
+		Check(PixelIs(pixels, -0.6f, glm::vec4(1.0f, 0.0f, 0.0f, 1.0f)), "queued draw before a batch reads its own object data");
+		Check(PixelIs(pixels, 0.0f, glm::vec4(0.0f, 1.0f, 0.0f, 1.0f)), "batch reads its own object data");
+		Check(PixelIs(pixels, 0.6f, glm::vec4(0.0f, 0.0f, 1.0f, 1.0f)), "queued draw after a batch reads the queue's object data");
+
+		GLState::BindFramebuffer(0);
+	}
+
+	std::filesystem::remove(modelPath);
+	GLState::ForgetFramebuffer(framebuffer);
+	glDeleteFramebuffers(1, &framebuffer);
+	GLState::ForgetTexture(target);
+	glDeleteTextures(1, &target);
+	DeleteUBO(frameConstantsUBO);
+}
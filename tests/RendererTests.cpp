@@ -0,0 +1,115 @@
+#include "pch.h"
+
+#include "Tests.hpp"
+#include "Renderable/Primitives/Quad.hpp"
+#include "Renderer/GLState.hpp"
+#include "Renderer/ObjectData.hpp"
+#include "Renderer/Renderer.hpp"
+#include "Shader/ShaderCache.hpp"
+#include "Shader/ShaderPreprocessor.hpp"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+namespace {
+	constexpr int WIDTH = 64;
+	constexpr int HEIGHT = 16;
+
+	const char* OBJECT_VERTEX_SOURCE = R"(#version 460
+layout(location = 0) in vec3 aPos;
+
+#include <Lexvi/ObjectData.glsl>
+
+void main() {
+    gl_Position = lexviObjects[LEXVI_OBJECT_INDEX].model * vec4(aPos, 1.0);
+}
+)";
+
+	const char* PLAIN_VERTEX_SOURCE = R"(#version 460
+layout(location = 0) in vec3 aPos;
+
+uniform mat4 model;
+
+void main() {
+    gl_Position = model * vec4(aPos, 1.0);
+}
+)";
+
+	const char* FRAGMENT_SOURCE = R"(#version 460
+out vec4 fragColor;
+
+void main() {
+    fragColor = vec4(1.0);
+}
+)";
+
+	bool Covered(const std::vector<glm::vec4>& pixels, float clipX)
+	{
+		int x = static_cast<int>((clipX * 0.5f + 0.5f) * WIDTH);
+		return pixels[(HEIGHT / 2) * WIDTH + x].a > 0.5f;
+	}
+}
+
+void LexviTests::RunRendererTests()
+{
+	using namespace Lexvi;
+
+	RegisterShaderInclude("Lexvi/ObjectData.glsl", GetObjectDataGLSL());
+
+	unsigned int target = 0, framebuffer = 0;
+	glCreateTextures(GL_TEXTURE_2D, 1, &target);
+	glTextureStorage2D(target, 1, GL_RGBA8, WIDTH, HEIGHT);
+	glCreateFramebuffers(1, &framebuffer);
+	glNamedFramebufferTexture(framebuffer, GL_COLOR_ATTACHMENT0, target, 0);
+
+	{
+		std::shared_ptr<Shader> objectShader = GetShaderCache().GetShaderFromSource(OBJECT_VERTEX_SOURCE, FRAGMENT_SOURCE);
+		std::shared_ptr<Shader> plainShader = GetShaderCache().GetShaderFromSource(PLAIN_VERTEX_SOURCE, FRAGMENT_SOURCE);
+
+		// small, small, small, large, small, small: the large quad has another geometry id and splits the run
+		const float xs[] = { -0.75f, -0.45f, -0.15f, 0.15f, 0.45f, 0.75f };
+		std::vector<std::pair<std::shared_ptr<IRenderable>, std::shared_ptr<Shader>>> objects;
+		for (int i = 0; i < 6; ++i) {
+			float halfWidth = i == 3 ? 0.1f : 0.05f;
+			auto quad = std::make_shared<Quad>(halfWidth, 0.5f);
+			quad->setTransforms(glm::translate(glm::mat4(1.0f), glm::vec3(xs[i], 0.0f, 0.0f)));
+			objects.push_back({ quad, objectShader });
+		}
+
+		// zero frustum planes, nothing is culled
+		Camera camera;
+		Renderer renderer;
+
+		GLState::BindFramebuffer(framebuffer);
+		glViewport(0, 0, WIDTH, HEIGHT);
+		GLState::SetDepthTest(false);
+		GLState::SetCullFace(false);
+		float clear[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+		glClearNamedFramebufferfv(framebuffer, GL_COLOR, 0, clear);
+
+		renderer.Draw(objects, camera);
+		const RenderQueueStats& stats = renderer.getDrawStats();
+		Check(stats.drawn == 6, "every object of the vector is drawn");
+		Check(stats.drawCalls == 3, "consecutive objects with the same shader and geometry share one draw call");
+		Check(stats.instancedBatches == 2, "both runs of small quads are instanced");
+		Check(stats.programChanges == 1, "one program for the whole vector");
+
+		std::vector<glm::vec4> pixels(WIDTH * HEIGHT);
+		glGetTextureImage(target, 0, GL_RGBA, GL_FLOAT, static_cast<GLsizei>(pixels.size() * sizeof(glm::vec4)), pixels.data());
+		bool allCovered = true;
+		for (float x : xs) allCovered = allCovered && Covered(pixels, x);
+		Check(allCovered, "instanced objects read their own transforms");
+
+		// without the LexviObjectData block every object stays a draw of its own
+		for (auto& obj_shader : objects) obj_shader.second = plainShader;
+		renderer.Draw(objects, camera);
+		Check(renderer.getDrawStats().drawCalls == 6, "programs without object data draw one object per call");
+		Check(renderer.getDrawStats().instancedBatches == 0, "programs without object data are never instanced");
+
+		GLState::BindFramebuffer(0);
+	}
+
+	GLState::ForgetFramebuffer(framebuffer);
+	glDeleteFramebuffers(1, &framebuffer);
+	GLState::ForgetTexture(target);
+	glDeleteTextures(1, &target);
+}
@@ -0,0 +1,37 @@
+#include "pch.h"
+
+#include "Tests.hpp"
+#include "Shader/ShaderCache.hpp"
+
+namespace {
+	const char* COMPUTE_SOURCE = R"(#version 460
+layout(local_size_x = WORKGROUP_SIZE) in;
+
+layout(std430, binding = 0) buffer Values { uint values[]; };
+
+void main() {
+    values[gl_GlobalInvocationID.x] = VALUE;
+}
+)";
+}
+
+void LexviTests::RunShaderCacheTests()
+{
+	Lexvi::ShaderCache& cache = Lexvi::GetShaderCache();
+
+	auto variant = cache.GetComputeShaderFromSource(COMPUTE_SOURCE, { { "WORKGROUP_SIZE", "64" }, { "VALUE", "1u" } });
+	Check(variant && variant->ID != 0, "variant with defines compiles");
+
+	// define order doesn't make a new variant, a different value does
+	auto reordered = cache.GetComputeShaderFromSource(COMPUTE_SOURCE, { { "VALUE", "1u" }, { "WORKGROUP_SIZE", "64" } });
+	Check(reordered == variant, "reordered defines share the variant");
+	auto other = cache.GetComputeShaderFromSource(COMPUTE_SOURCE, { { "WORKGROUP_SIZE", "64" }, { "VALUE", "2u" } });
+	Check(other && other != variant, "another define value is another variant");
+
+	// same variant through the file path
+	std::filesystem::path path = std::filesystem::temp_directory_path() / "LexviShaderCacheTest.comp";
+	std::ofstream(path) << COMPUTE_SOURCE;
+	auto fromFile = cache.GetComputeShader(path.string(), { { "WORKGROUP_SIZE", "32" }, { "VALUE", "3u" } });
+	Check(fromFile && fromFile->ID != 0, "file variant with defines compiles");
+	std::filesystem::remove(path);
+}
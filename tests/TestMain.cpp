@@ -0,0 +1,55 @@
+#include "pch.h"
+
+#include "Tests.hpp"
+#include "Shader/ShaderCache.hpp"
+
+// Runs every suite on a hidden GL 4.6 context. Exits non-zero if any check failed, so it can run as a
+// build step or from a CI job with a GPU.
+
+namespace {
+	int failures = 0;
+}
+
+void LexviTests::Check(bool condition, const char* what)
+{
+	if (!condition) {
+		std::cerr << "FAILED: " << what << std::endl;
+		++failures;
+	}
+}
+
+int main()
+{
+	if (!glfwInit()) {
+		std::cerr << "ERROR::TESTS::GLFW_INIT_FAILED" << std::endl;
+		return 1;
+	}
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 6);
+	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+	glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+	GLFWwindow* window = glfwCreateWindow(64, 64, "LexviEngineTests", nullptr, nullptr);
+	if (!window) {
+		std::cerr << "ERROR::TESTS::NO_GL_4_6_CONTEXT" << std::endl;
+		glfwTerminate();
+		return 1;
+	}
+	glfwMakeContextCurrent(window);
+	if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
+		std::cerr << "ERROR::TESTS::GLAD_INIT_FAILED" << std::endl;
+		return 1;
+	}
+
+	LexviTests::RunShaderCacheTests();
+	LexviTests::RunModelBatchTests();
+	LexviTests::RunRendererTests();
+
+	// programs have to go while the context is still alive
+	Lexvi::GetShaderCache().Clear();
+
+	glfwDestroyWindow(window);
+	glfwTerminate();
+
+	if (failures == 0) std::cout << "All tests passed" << std::endl;
+	return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,11 @@
+#pragma once
+
+// Suites run on the hidden GL 4.6 context TestMain creates, each one cleans up its GL objects before returning
+namespace LexviTests {
+	// Prints what and fails the run when condition is false
+	void Check(bool condition, const char* what);
+
+	void RunShaderCacheTests();
+	void RunModelBatchTests();
+	void RunRendererTests();
+}